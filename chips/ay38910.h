@@ -11,6 +11,9 @@
 
     CHIPS_ASSERT(c)     -- your own assert macro (default: assert(c))
 
+    Include chips/chips_common.h before this header (for the audio
+    sample type, see CHIPS_AUDIO_INT16).
+
     EMULATED PINS:
 
              +-----------+
@@ -199,6 +202,7 @@ typedef struct {
     ay38910_in_t in_cb;     /* I/O port input callback */
     ay38910_out_t out_cb;   /* I/O port output callback */
     void* user_data;        /* optional user-data for callbacks */
+    bool channel_samples;   /* if true, also output per-channel samples in ay38910_t.channel_sample[] */
 } ay38910_desc_t;
 
 // a tone channel
@@ -265,11 +269,16 @@ typedef struct {
     // sample generation state
     int sample_period;
     int sample_counter;
-    float mag;
-    float sample;
-    float dcadj_sum;
+    chips_audio_accum_t mag;
+    chips_audio_sample_t sample;
+    chips_audio_accum_t dcadj_sum;
     uint32_t dcadj_pos;
-    float dcadj_buf[AY38910_DCADJ_BUFLEN];
+    chips_audio_accum_t dcadj_buf[AY38910_DCADJ_BUFLEN];
+
+    // optional per-channel sample output (see ay38910_desc_t.channel_samples)
+    bool channel_samples;
+    chips_audio_sample_t channel_sample[AY38910_NUM_CHANNELS];
+    chips_audio_accum_t channel_dcadj[AY38910_NUM_CHANNELS];
 } ay38910_t;
 
 // extract 8-bit data bus from 64-bit pins
@@ -330,7 +339,28 @@ static const uint8_t _ay38910_reg_mask[AY38910_NUM_REGISTERS] = {
 };
 
 // volume table from: https://github.com/true-grue/ayumi/blob/master/ayumi.c
-static const float _ay38910_volumes[16] = {
+#if defined(CHIPS_AUDIO_INT16)
+// same table scaled to 0..32767
+static const chips_audio_accum_t _ay38910_volumes[16] = {
+  0,
+  327,
+  473,
+  690,
+  1006,
+  1492,
+  2113,
+  3518,
+  4148,
+  6717,
+  9575,
+  12217,
+  16139,
+  20818,
+  26397,
+  32767
+};
+#else
+static const chips_audio_accum_t _ay38910_volumes[16] = {
   0.0f,
   0.00999465934234f,
   0.0144502937362f,
@@ -348,6 +378,7 @@ static const float _ay38910_volumes[16] = {
   0.805584802014f,
   1.0f
 };
+#endif
 
 // canned envelope generator shapes
 static const uint8_t _ay38910_shapes[16][32] = {
@@ -385,7 +416,7 @@ static const uint8_t _ay38910_shapes[16][32] = {
    from the chip simulation which is >0.0 gets converted to
    a +/- sample value)
 */
-static float _ay38910_dcadjust(ay38910_t* ay, float s) {
+static chips_audio_accum_t _ay38910_dcadjust(ay38910_t* ay, chips_audio_accum_t s) {
     ay->dcadj_sum -= ay->dcadj_buf[ay->dcadj_pos];
     ay->dcadj_sum += s;
     ay->dcadj_buf[ay->dcadj_pos] = s;
@@ -393,6 +424,20 @@ static float _ay38910_dcadjust(ay38910_t* ay, float s) {
     return s - (ay->dcadj_sum / AY38910_DCADJ_BUFLEN);
 }
 
+/* The per-channel outputs use a cheaper one-pole DC filter with roughly
+   the same time constant as the ring-buffer filter above, so that the
+   channel samples only add up *approximately* to the mixed sample.
+*/
+static chips_audio_accum_t _ay38910_channel_dcadjust(ay38910_t* ay, int chn, chips_audio_accum_t s) {
+    #if defined(CHIPS_AUDIO_INT16)
+        // AY38910_DCADJ_BUFLEN is 512
+        ay->channel_dcadj[chn] += (s - ay->channel_dcadj[chn]) >> 9;
+    #else
+        ay->channel_dcadj[chn] += (s - ay->channel_dcadj[chn]) * (1.0f / AY38910_DCADJ_BUFLEN);
+    #endif
+    return s - ay->channel_dcadj[chn];
+}
+
 // update computed values after registers have been reprogrammed
 static void _ay38910_update_values(ay38910_t* ay) {
     for (int i = 0; i < AY38910_NUM_CHANNELS; i++) {
@@ -446,7 +491,8 @@ void ay38910_init(ay38910_t* ay, const ay38910_desc_t* desc) {
     ay->noise.rng = 1;
     ay->sample_period = (desc->tick_hz * AY38910_FIXEDPOINT_SCALE) / desc->sound_hz;
     ay->sample_counter = ay->sample_period;
-    ay->mag = desc->magnitude;
+    ay->mag = CHIPS_AUDIO_VOLUME(desc->magnitude);
+    ay->channel_samples = desc->channel_samples;
     _ay38910_update_values(ay);
     _ay38910_restart_env_shape(ay);
 }
@@ -508,10 +554,10 @@ bool ay38910_tick(ay38910_t* ay) {
     ay->sample_counter -= AY38910_FIXEDPOINT_SCALE;
     if (ay->sample_counter <= 0) {
         ay->sample_counter += ay->sample_period;
-        float sm = 0.0f;
+        chips_audio_accum_t sm = 0;
         for (int i = 0; i < AY38910_NUM_CHANNELS; i++) {
             const ay38910_tone_t* chn = &ay->tone[i];
-            float vol;
+            chips_audio_accum_t vol;
             if (0 == (ay->reg[AY38910_REG_AMP_A+i] & (1<<4))) {
                 // fixed amplitude
                 vol = _ay38910_volumes[ay->reg[AY38910_REG_AMP_A+i] & 0x0F];
@@ -524,8 +570,11 @@ bool ay38910_tick(ay38910_t* ay) {
             if (vol_enable) {
                 sm += vol;
             }
+            if (ay->channel_samples) {
+                ay->channel_sample[i] = chips_audio_clamp(chips_audio_scale(_ay38910_channel_dcadjust(ay, i, vol_enable ? vol : 0), ay->mag));
+            }
         }
-        ay->sample = _ay38910_dcadjust(ay, sm) * ay->mag;
+        ay->sample = chips_audio_clamp(chips_audio_scale(_ay38910_dcadjust(ay, sm), ay->mag));
         return true; // new sample is ready
     }
     // fallthrough: no new sample ready yet
@@ -4,6 +4,9 @@
 
     TODO: docs
 
+    Include chips/chips_common.h before this header (for the audio
+    sample type, see CHIPS_AUDIO_INT16).
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -48,10 +51,11 @@ typedef struct {
     int counter;
     float base_volume;
     float volume;
-    float sample;
-    float dcadj_sum;
+    chips_audio_accum_t level;      // base_volume * volume in sample range
+    chips_audio_sample_t sample;
+    chips_audio_accum_t dcadj_sum;
     uint32_t dcadj_pos;
-    float dcadj_buf[BEEPER_DCADJ_BUFLEN];
+    chips_audio_sample_t dcadj_buf[BEEPER_DCADJ_BUFLEN];
 } beeper_t;
 
 // initialize beeper instance
@@ -69,6 +73,7 @@ static inline void beeper_toggle(beeper_t* beeper) {
 // set current volume 0.0 to 1.0
 static inline void beeper_set_volume(beeper_t* beeper, float vol) {
     beeper->volume = vol;
+    beeper->level = chips_audio_clamp(CHIPS_AUDIO_VOLUME(vol * beeper->base_volume));
 }
 // tick the beeper, return true if a new sample is ready
 bool beeper_tick(beeper_t* beeper);
@@ -92,6 +97,7 @@ void beeper_init(beeper_t* b, const beeper_desc_t* desc) {
         .counter = b->period,
         .base_volume = desc->base_volume,
         .volume = 1.0f,
+        .level = chips_audio_clamp(CHIPS_AUDIO_VOLUME(desc->base_volume)),
     };
 }
 
@@ -107,7 +113,7 @@ void beeper_reset(beeper_t* b) {
    from the chip simulation which is >0.0 gets converted to
    a +/- sample value)
 */
-static void _beeper_dcadjust(beeper_t* bp, float s) {
+static void _beeper_dcadjust(beeper_t* bp, chips_audio_sample_t s) {
     bp->dcadj_sum -= bp->dcadj_buf[bp->dcadj_pos];
     bp->dcadj_sum += s;
     bp->dcadj_buf[bp->dcadj_pos] = s;
@@ -115,12 +121,12 @@ static void _beeper_dcadjust(beeper_t* bp, float s) {
 }
 
 bool beeper_tick(beeper_t* bp) {
-    _beeper_dcadjust(bp, (float)bp->state * bp->volume * bp->base_volume);
+    _beeper_dcadjust(bp, bp->state ? bp->level : 0);
     /* generate a new sample? */
     bp->counter -= BEEPER_FIXEDPOINT_SCALE;
     if (bp->counter <= 0) {
         bp->counter += bp->period;
-        bp->sample = bp->dcadj_sum / BEEPER_DCADJ_BUFLEN;
+        bp->sample = (chips_audio_sample_t)(bp->dcadj_sum / BEEPER_DCADJ_BUFLEN);
         return true;
     }
     return false;
@@ -4,6 +4,57 @@
 
     Common data types for chips system headers.
 
+    Define CHIPS_AUDIO_INT16 before including any chips headers to run the
+    audio path in fixed point: the sound chips (beeper, AY-3-8910, SID,
+    VIC, Namco WSG) then accumulate and filter in integer math, and the
+    system emulators output signed 16-bit samples instead of floats (see
+    chips_audio_sample_t). Volume settings in desc structs remain floats
+    and are converted to fixed point once at init time.
+
+    The optional debug hook (chips_debug_t) is called in each clock tick
+    by default. Hooks which only need to see specific events (for instance
+    completed instructions) can set chips_debug_t.events to a mask of
+    CHIPS_DEBUG_EVENT_* flags, the system emulators then check the CPU
+    pins after each tick and only call the hook when one of the requested
+    events happens. The debuggers (chips/dbg.h, ui/ui_dbg.h), trace.h and
+    prof.h keep the per-tick default, since they count clock cycles and
+    record memory reads and tick-level breakpoints in each tick.
+
+    Tape images are not copied into the system emulators, instead they
+    are read through a chips_tape_source_t: either an external read-only
+    memory range (for instance a memory-mapped file) which must remain
+    valid while the tape is inserted, or a read callback which is called
+    with an absolute position in the tape image whenever the emulator
+    needs more data. Only the tape position is part of snapshots, after
+    loading a snapshot the tape which is currently inserted continues
+    to be used.
+
+    Define CHIPS_PERF_COUNTERS before including any chips headers to
+    enable per-chip performance counters: the system tick functions then
+    count the invocations of each emulated chip, and measure the host time
+    of every CHIPS_PERF_SAMPLE_INTERVAL'th invocation (default: 64) into a
+    chips_perf_counters_t, which is returned by the *_perf_counters()
+    function of each system. Without CHIPS_PERF_COUNTERS the instrumentation
+    compiles to nothing, and the systems don't have a perf member or
+    *_perf_counters() function (so that the system structs and snapshots
+    have the same layout as without performance counters, snapshots are
+    not compatible between builds with and without CHIPS_PERF_COUNTERS).
+    The measured times include the host timer overhead, so they are mainly
+    useful to compare the chips of a system relative to each other.
+
+    The host timer chips_perf_now_ns() uses clock_gettime(CLOCK_MONOTONIC)
+    on POSIX platforms, this requires _POSIX_C_SOURCE >= 199309L (or a gnu
+    mode) when compiling with a strict C standard, otherwise the less
+    precise C11 timespec_get() or clock() is used. On Windows the timer
+    uses timespec_get().
+
+    Define CHIPS_THREADS before including any chips headers to enable the
+    functions which run parts of a system emulator on a separate host
+    thread (the threaded C1541 drive of the C64, and the separate main
+    and sound board threads of Bomb Jack). Only then the implementation
+    includes <windows.h> or <sched.h> to give up the rest of a time slice
+    while waiting for the other thread.
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -54,22 +105,149 @@ typedef struct {
     bool portrait;
 } chips_display_info_t;
 
+// audio sample type, and intermediate type for mixing and accumulation
+#if defined(CHIPS_AUDIO_INT16)
+typedef int16_t chips_audio_sample_t;
+typedef int32_t chips_audio_accum_t;
+// fixed point audio volumes are 1.15
+#define CHIPS_AUDIO_VOLUME_SHIFT (15)
+#define CHIPS_AUDIO_VOLUME(f) ((chips_audio_accum_t)((f) * (float)(1<<CHIPS_AUDIO_VOLUME_SHIFT)))
+#else
+typedef float chips_audio_sample_t;
+typedef float chips_audio_accum_t;
+#define CHIPS_AUDIO_VOLUME(f) ((chips_audio_accum_t)(f))
+#endif
+
+// clamp an accumulated value into the audio sample range (no-op for float samples)
+static inline chips_audio_sample_t chips_audio_clamp(chips_audio_accum_t v) {
+    #if defined(CHIPS_AUDIO_INT16)
+        return (chips_audio_sample_t)((v < -32768) ? -32768 : ((v > 32767) ? 32767 : v));
+    #else
+        return v;
+    #endif
+}
+
+// scale an audio value by a volume created with CHIPS_AUDIO_VOLUME()
+static inline chips_audio_accum_t chips_audio_scale(chips_audio_accum_t v, chips_audio_accum_t vol) {
+    #if defined(CHIPS_AUDIO_INT16)
+        return (chips_audio_accum_t)(((int64_t)v * vol) >> CHIPS_AUDIO_VOLUME_SHIFT);
+    #else
+        return v * vol;
+    #endif
+}
+
 typedef struct {
-    void (*func)(const float* samples, int num_samples, void* user_data);
+    void (*func)(const chips_audio_sample_t* samples, int num_samples, void* user_data);
     void* user_data;
 } chips_audio_callback_t;
 
+// optional per-voice audio output, samples are interleaved (num_samples * num_tracks values)
+typedef struct {
+    void (*func)(const chips_audio_sample_t* samples, int num_samples, int num_tracks, void* user_data);
+    void* user_data;
+} chips_audio_tracks_callback_t;
+
+// debug hook events, if chips_debug_t.events is 0 the debug callback is called in each tick
+#define CHIPS_DEBUG_EVENT_OPCODE    (1<<0)  // an instruction has completed (z80_opdone() or M6502_SYNC)
+#define CHIPS_DEBUG_EVENT_MEM_WRITE (1<<1)  // the CPU writes to memory
+#define CHIPS_DEBUG_EVENT_IO        (1<<2)  // Z80 IO request (IN/OUT instructions)
+#define CHIPS_DEBUG_EVENT_INT       (1<<3)  // an interrupt request pin (INT/IRQ or NMI) is active
+
 typedef void (*chips_debug_func_t)(void* user_data, uint64_t pins);
 typedef struct {
     struct {
         chips_debug_func_t func;
         void* user_data;
     } callback;
+    uint32_t events;    // 0 (call in each tick), or CHIPS_DEBUG_EVENT_* mask
     bool* stopped;
 } chips_debug_t;
 
+// input event types reported through chips_input_callback_t
+typedef enum {
+    CHIPS_INPUT_NONE,
+    CHIPS_INPUT_EXEC,           // the system has run for 'a' ticks (end of an exec function), b: CHIPS_INPUT_EXEC_* flags
+    CHIPS_INPUT_KEY_DOWN,       // a: key code
+    CHIPS_INPUT_KEY_UP,         // a: key code
+    CHIPS_INPUT_JOYSTICK,       // a: joystick mask, b: second joystick mask (only some systems)
+    CHIPS_INPUT_JOYSTICK_TYPE,  // a: joystick emulation type
+    CHIPS_INPUT_SET,            // a: input bits to set (arcade machines)
+    CHIPS_INPUT_CLEAR,          // a: input bits to clear (arcade machines)
+    CHIPS_INPUT_NUM,
+} chips_input_type_t;
+
+// CHIPS_INPUT_EXEC flags
+#define CHIPS_INPUT_EXEC_WARP (1<<0)    // the ticks ran in warp mode (C64 tape warp)
+
+typedef struct {
+    chips_input_type_t type;
+    uint32_t a;
+    uint32_t b;
+} chips_input_event_t;
+
+// optional callback which is called for each input event and at the end of each exec function
+typedef struct {
+    void (*func)(const chips_input_event_t* event, void* user_data);
+    void* user_data;
+} chips_input_callback_t;
+
+// a read-only tape image, either an external memory range or a read callback
+typedef struct {
+    chips_range_t data;     // external tape image data (not copied)
+    struct {
+        // read up to num_bytes at pos into dst, return number of bytes read
+        size_t (*func)(size_t pos, void* dst, size_t num_bytes, void* user_data);
+        void* user_data;
+        size_t size;        // total size of the tape image
+    } read;
+} chips_tape_source_t;
+
+#define CHIPS_TAPE_CACHE_SIZE (256)
+
+// tape image access with a small read cache for callback sources
+typedef struct {
+    chips_tape_source_t source;
+    size_t size;            // total size of the tape image, 0 if no tape inserted
+    size_t cache_pos;       // tape position of cached data
+    size_t cache_len;       // number of valid bytes in cache
+    uint8_t cache[CHIPS_TAPE_CACHE_SIZE];
+} chips_tape_t;
+
+#define CHIPS_PERF_MAX_CHIPS (8)
+#ifndef CHIPS_PERF_SAMPLE_INTERVAL
+#define CHIPS_PERF_SAMPLE_INTERVAL (64)     // must be 2^N
+#endif
+
+// performance counters of one emulated chip
+typedef struct {
+    const char* name;       // chip name (a static string)
+    uint64_t calls;         // number of invocations
+    uint64_t samples;       // number of invocations with measured host time
+    uint64_t sampled_ns;    // sum of measured host time in nanoseconds
+} chips_perf_chip_t;
+
+// per-chip performance counters of a system emulator
+typedef struct {
+    int num_chips;
+    chips_perf_chip_t chips[CHIPS_PERF_MAX_CHIPS];
+} chips_perf_counters_t;
+
+/*
+    Instrument the code between CHIPS_PERF_BEGIN() and CHIPS_PERF_END(),
+    'index' must be an identifier (a system's *_PERF_* enum value), and
+    both macros must be used in the same scope.
+*/
+#if defined(CHIPS_PERF_COUNTERS)
+#define CHIPS_PERF_BEGIN(perf, index) const uint64_t _chips_perf_t0_##index = chips_perf_begin(&(perf)->chips[index])
+#define CHIPS_PERF_END(perf, index) chips_perf_end(&(perf)->chips[index], _chips_perf_t0_##index)
+#else
+#define CHIPS_PERF_BEGIN(perf, index)
+#define CHIPS_PERF_END(perf, index)
+#endif
+
 typedef struct {
     chips_audio_callback_t callback;
+    chips_audio_tracks_callback_t tracks_callback;  // optional per-voice output (only some systems)
     int num_samples;
     int sample_rate;
     float volume;
@@ -79,10 +257,83 @@ typedef struct {
 void chips_audio_callback_snapshot_onsave(chips_audio_callback_t* snapshot);
 // fixup chips_audio_t snapshot after loading
 void chips_audio_callback_snapshot_onload(chips_audio_callback_t* snapshot, chips_audio_callback_t* sys);
+// prepare chips_audio_tracks_callback_t snapshot for saving
+void chips_audio_tracks_callback_snapshot_onsave(chips_audio_tracks_callback_t* snapshot);
+// fixup chips_audio_tracks_callback_t snapshot after loading
+void chips_audio_tracks_callback_snapshot_onload(chips_audio_tracks_callback_t* snapshot, chips_audio_tracks_callback_t* sys);
+// insert a tape image, return false if the source is invalid
+bool chips_tape_insert(chips_tape_t* tape, const chips_tape_source_t* source);
+// remove tape image
+void chips_tape_remove(chips_tape_t* tape);
+// read bytes from tape image, return number of bytes read
+size_t chips_tape_read(chips_tape_t* tape, size_t pos, void* dst, size_t num_bytes);
+// refill the read cache (called by chips_tape_byte())
+uint8_t chips_tape_fill(chips_tape_t* tape, size_t pos);
+// prepare chips_tape_t snapshot for saving
+void chips_tape_snapshot_onsave(chips_tape_t* snapshot);
+// fixup chips_tape_t snapshot after loading
+void chips_tape_snapshot_onload(chips_tape_t* snapshot, chips_tape_t* sys);
 // prepare chips_debut_t snapshot for saving
 void chips_debug_snapshot_onsave(chips_debug_t* snapshot);
 // fixup chips_debug_t snapshot after loading
 void chips_debug_snapshot_onload(chips_debug_t* snapshot, chips_debug_t* sys);
+// prepare chips_input_callback_t snapshot for saving
+void chips_input_callback_snapshot_onsave(chips_input_callback_t* snapshot);
+// fixup chips_input_callback_t snapshot after loading
+void chips_input_callback_snapshot_onload(chips_input_callback_t* snapshot, chips_input_callback_t* sys);
+// compute a fast 64-bit hash over a memory range (xxHash64 algorithm), chain hashes through seed
+uint64_t chips_hash(const void* ptr, size_t num_bytes, uint64_t seed);
+// initialize performance counters with chip names (called by system init functions)
+void chips_perf_init(chips_perf_counters_t* perf, int num_chips, const char* const* names);
+// clear performance counters, but keep the chip names
+void chips_perf_reset(chips_perf_counters_t* perf);
+// get estimated total host time of a chip in nanoseconds (extrapolated from measured invocations)
+uint64_t chips_perf_estimated_ns(const chips_perf_chip_t* chip);
+// prepare chips_perf_counters_t snapshot for saving
+void chips_perf_snapshot_onsave(chips_perf_counters_t* snapshot);
+// fixup chips_perf_counters_t snapshot after loading (keeps the current counters)
+void chips_perf_snapshot_onload(chips_perf_counters_t* snapshot, chips_perf_counters_t* sys);
+// get a monotonic host timestamp in nanoseconds (also used by util/bench.h)
+uint64_t chips_perf_now_ns(void);
+#if defined(CHIPS_PERF_COUNTERS)
+// start a chip invocation, returns the start timestamp or 0 if not measured
+static inline uint64_t chips_perf_begin(chips_perf_chip_t* chip) {
+    if (0 == (chip->calls++ & (CHIPS_PERF_SAMPLE_INTERVAL - 1))) {
+        return chips_perf_now_ns();
+    }
+    return 0;
+}
+
+// end a chip invocation
+static inline void chips_perf_end(chips_perf_chip_t* chip, uint64_t t0) {
+    if (t0 != 0) {
+        chip->sampled_ns += chips_perf_now_ns() - t0;
+        chip->samples++;
+    }
+}
+#endif
+
+// report an input event to the optional input callback (called by the system emulators)
+static inline void chips_input_record(const chips_input_callback_t* cb, chips_input_type_t type, uint32_t a, uint32_t b) {
+    if (cb->func) {
+        const chips_input_event_t event = { type, a, b };
+        cb->func(&event, cb->user_data);
+    }
+}
+
+// read a single byte from tape image, returns 0 past the end of the tape
+static inline uint8_t chips_tape_byte(chips_tape_t* tape, size_t pos) {
+    if (pos >= tape->size) {
+        return 0;
+    }
+    if (tape->source.data.ptr) {
+        return ((const uint8_t*)tape->source.data.ptr)[pos];
+    }
+    if ((pos - tape->cache_pos) < tape->cache_len) {
+        return tape->cache[pos - tape->cache_pos];
+    }
+    return chips_tape_fill(tape, pos);
+}
 
 #ifdef __cplusplus
 } // extern "C"
@@ -90,6 +341,11 @@ void chips_debug_snapshot_onload(chips_debug_t* snapshot, chips_debug_t* sys);
 
 /*--- IMPLEMENTATION ---------------------------------------------------------*/
 #ifdef CHIPS_IMPL
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
 
 void chips_audio_callback_snapshot_onsave(chips_audio_callback_t* snapshot) {
     snapshot->func = 0;
@@ -101,16 +357,330 @@ void chips_audio_callback_snapshot_onload(chips_audio_callback_t* snapshot, chip
     snapshot->user_data = sys->user_data;
 }
 
+void chips_audio_tracks_callback_snapshot_onsave(chips_audio_tracks_callback_t* snapshot) {
+    snapshot->func = 0;
+    snapshot->user_data = 0;
+}
+
+void chips_audio_tracks_callback_snapshot_onload(chips_audio_tracks_callback_t* snapshot, chips_audio_tracks_callback_t* sys) {
+    snapshot->func = sys->func;
+    snapshot->user_data = sys->user_data;
+}
+
 void chips_debug_snapshot_onsave(chips_debug_t* snapshot) {
     snapshot->callback.func = 0;
     snapshot->callback.user_data = 0;
+    snapshot->events = 0;
     snapshot->stopped = 0;
 }
 
 void chips_debug_snapshot_onload(chips_debug_t* snapshot, chips_debug_t* sys) {
     snapshot->callback.func = sys->callback.func;
     snapshot->callback.user_data = sys->callback.user_data;
+    snapshot->events = sys->events;
     snapshot->stopped = sys->stopped;
 }
 
+void chips_input_callback_snapshot_onsave(chips_input_callback_t* snapshot) {
+    snapshot->func = 0;
+    snapshot->user_data = 0;
+}
+
+void chips_input_callback_snapshot_onload(chips_input_callback_t* snapshot, chips_input_callback_t* sys) {
+    snapshot->func = sys->func;
+    snapshot->user_data = sys->user_data;
+}
+
+bool chips_tape_insert(chips_tape_t* tape, const chips_tape_source_t* source) {
+    chips_tape_remove(tape);
+    if (source->data.ptr && (source->data.size > 0)) {
+        tape->source.data = source->data;
+        tape->size = source->data.size;
+        return true;
+    }
+    else if (source->read.func && (source->read.size > 0)) {
+        tape->source.read = source->read;
+        tape->size = source->read.size;
+        return true;
+    }
+    return false;
+}
+
+void chips_tape_remove(chips_tape_t* tape) {
+    memset(&tape->source, 0, sizeof(tape->source));
+    tape->size = 0;
+    tape->cache_pos = 0;
+    tape->cache_len = 0;
+}
+
+size_t chips_tape_read(chips_tape_t* tape, size_t pos, void* dst, size_t num_bytes) {
+    if (pos >= tape->size) {
+        return 0;
+    }
+    if (num_bytes > (tape->size - pos)) {
+        num_bytes = tape->size - pos;
+    }
+    if (tape->source.data.ptr) {
+        memcpy(dst, (const uint8_t*)tape->source.data.ptr + pos, num_bytes);
+        return num_bytes;
+    }
+    // the read callback may return less than requested
+    size_t num_read = 0;
+    while (num_read < num_bytes) {
+        const size_t n = tape->source.read.func(pos + num_read, (uint8_t*)dst + num_read, num_bytes - num_read, tape->source.read.user_data);
+        if (n == 0) {
+            break;
+        }
+        num_read += n;
+    }
+    return num_read;
+}
+
+uint8_t chips_tape_fill(chips_tape_t* tape, size_t pos) {
+    tape->cache_pos = pos;
+    tape->cache_len = chips_tape_read(tape, pos, tape->cache, sizeof(tape->cache));
+    return (tape->cache_len > 0) ? tape->cache[0] : 0;
+}
+
+void chips_tape_snapshot_onsave(chips_tape_t* snapshot) {
+    memset(&snapshot->source, 0, sizeof(snapshot->source));
+    snapshot->size = 0;
+    snapshot->cache_pos = 0;
+    snapshot->cache_len = 0;
+}
+
+void chips_tape_snapshot_onload(chips_tape_t* snapshot, chips_tape_t* sys) {
+    snapshot->source = sys->source;
+    snapshot->size = sys->size;
+    snapshot->cache_pos = 0;
+    snapshot->cache_len = 0;
+}
+
+void chips_perf_init(chips_perf_counters_t* perf, int num_chips, const char* const* names) {
+    CHIPS_ASSERT(perf && names && (num_chips >= 0) && (num_chips <= CHIPS_PERF_MAX_CHIPS));
+    memset(perf, 0, sizeof(chips_perf_counters_t));
+    perf->num_chips = num_chips;
+    for (int i = 0; i < num_chips; i++) {
+        perf->chips[i].name = names[i];
+    }
+}
+
+void chips_perf_reset(chips_perf_counters_t* perf) {
+    CHIPS_ASSERT(perf);
+    for (int i = 0; i < perf->num_chips; i++) {
+        perf->chips[i].calls = 0;
+        perf->chips[i].samples = 0;
+        perf->chips[i].sampled_ns = 0;
+    }
+}
+
+uint64_t chips_perf_estimated_ns(const chips_perf_chip_t* chip) {
+    CHIPS_ASSERT(chip);
+    if (chip->samples == 0) {
+        return 0;
+    }
+    return (uint64_t)(((double)chip->sampled_ns * (double)chip->calls) / (double)chip->samples);
+}
+
+void chips_perf_snapshot_onsave(chips_perf_counters_t* snapshot) {
+    memset(snapshot, 0, sizeof(chips_perf_counters_t));
+}
+
+void chips_perf_snapshot_onload(chips_perf_counters_t* snapshot, chips_perf_counters_t* sys) {
+    *snapshot = *sys;
+}
+
+#define _CHIPS_HASH_PRIME1 (0x9E3779B185EBCA87ULL)
+#define _CHIPS_HASH_PRIME2 (0xC2B2AE3D27D4EB4FULL)
+#define _CHIPS_HASH_PRIME3 (0x165667B19E3779F9ULL)
+#define _CHIPS_HASH_PRIME4 (0x85EBCA77C2B2AE63ULL)
+#define _CHIPS_HASH_PRIME5 (0x27D4EB2F165667C5ULL)
+
+static inline uint64_t _chips_hash_rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// unaligned loads, memcpy compiles to a single load instruction (hashes assume a little-endian host)
+static inline uint64_t _chips_hash_rd64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t _chips_hash_rd32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t _chips_hash_round(uint64_t acc, uint64_t val) {
+    acc += val * _CHIPS_HASH_PRIME2;
+    acc = _chips_hash_rotl(acc, 31);
+    return acc * _CHIPS_HASH_PRIME1;
+}
+
+static inline uint64_t _chips_hash_merge(uint64_t acc, uint64_t val) {
+    acc ^= _chips_hash_round(0, val);
+    return acc * _CHIPS_HASH_PRIME1 + _CHIPS_HASH_PRIME4;
+}
+
+uint64_t chips_hash(const void* ptr, size_t num_bytes, uint64_t seed) {
+    CHIPS_ASSERT(ptr || (num_bytes == 0));
+    const uint8_t* p = (const uint8_t*) ptr;
+    const uint8_t* end = p + num_bytes;
+    uint64_t h;
+    if (num_bytes >= 32) {
+        // 4 independent lanes over 32-byte stripes
+        uint64_t v1 = seed + _CHIPS_HASH_PRIME1 + _CHIPS_HASH_PRIME2;
+        uint64_t v2 = seed + _CHIPS_HASH_PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - _CHIPS_HASH_PRIME1;
+        const uint8_t* limit = end - 32;
+        do {
+            v1 = _chips_hash_round(v1, _chips_hash_rd64(p));
+            v2 = _chips_hash_round(v2, _chips_hash_rd64(p + 8));
+            v3 = _chips_hash_round(v3, _chips_hash_rd64(p + 16));
+            v4 = _chips_hash_round(v4, _chips_hash_rd64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = _chips_hash_rotl(v1, 1) + _chips_hash_rotl(v2, 7) + _chips_hash_rotl(v3, 12) + _chips_hash_rotl(v4, 18);
+        h = _chips_hash_merge(h, v1);
+        h = _chips_hash_merge(h, v2);
+        h = _chips_hash_merge(h, v3);
+        h = _chips_hash_merge(h, v4);
+    }
+    else {
+        h = seed + _CHIPS_HASH_PRIME5;
+    }
+    h += (uint64_t)num_bytes;
+    while ((p + 8) <= end) {
+        h ^= _chips_hash_round(0, _chips_hash_rd64(p));
+        h = _chips_hash_rotl(h, 27) * _CHIPS_HASH_PRIME1 + _CHIPS_HASH_PRIME4;
+        p += 8;
+    }
+    if ((p + 4) <= end) {
+        h ^= (uint64_t)_chips_hash_rd32(p) * _CHIPS_HASH_PRIME1;
+        h = _chips_hash_rotl(h, 23) * _CHIPS_HASH_PRIME2 + _CHIPS_HASH_PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p++) * _CHIPS_HASH_PRIME5;
+        h = _chips_hash_rotl(h, 11) * _CHIPS_HASH_PRIME1;
+    }
+    // final avalanche
+    h ^= h >> 33;
+    h *= _CHIPS_HASH_PRIME2;
+    h ^= h >> 29;
+    h *= _CHIPS_HASH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+// atomic accessors and spin-wait helper for systems which run chips on separate threads
+#define _CHIPS_SPIN_PAUSE_COUNT (64) // number of CPU pauses in a spin-wait loop before yielding the thread
+
+#if defined(CHIPS_THREADS)
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <sched.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline uint32_t _chips_load_acquire32(const uint32_t* ptr) {
+    return (uint32_t)_InterlockedOr((volatile long*)ptr, 0);
+}
+static inline void _chips_store_release32(uint32_t* ptr, uint32_t val) {
+    _InterlockedExchange((volatile long*)ptr, (long)val);
+}
+static inline uint64_t _chips_load_acquire64(const uint64_t* ptr) {
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64*)ptr, 0, 0);
+}
+static inline void _chips_store_release64(uint64_t* ptr, uint64_t val) {
+    __int64 old = *(volatile __int64*)ptr;
+    __int64 prev;
+    while ((prev = _InterlockedCompareExchange64((volatile __int64*)ptr, (__int64)val, old)) != old) {
+        old = prev;
+    }
+}
+static inline void _chips_cpu_relax(void) {
+    #if defined(_M_ARM64) || defined(_M_ARM)
+        __yield();
+    #else
+        _mm_pause();
+    #endif
+}
+#else
+static inline uint32_t _chips_load_acquire32(const uint32_t* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+static inline void _chips_store_release32(uint32_t* ptr, uint32_t val) {
+    __atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+}
+static inline uint64_t _chips_load_acquire64(const uint64_t* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+static inline void _chips_store_release64(uint64_t* ptr, uint64_t val) {
+    __atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+}
+static inline void _chips_cpu_relax(void) {
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+    #elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
+    #endif
+}
+#endif
+
+// without CHIPS_THREADS nothing runs on other threads, and the spin-wait loops are never entered
+static inline void _chips_yield_thread(void) {
+    #if defined(CHIPS_THREADS) && defined(_WIN32)
+        SwitchToThread();
+    #elif defined(CHIPS_THREADS) && !defined(__EMSCRIPTEN__)
+        sched_yield();
+    #endif
+}
+
+/* Called in each iteration of a loop which waits for another thread:
+   pause the CPU for a short time in the first iterations, and then give
+   up the rest of the time slice, so that the waiting thread doesn't burn
+   a CPU core. Reset the spin counter to zero when progress was made.
+*/
+static inline void _chips_spin_wait(uint32_t* spin_count) {
+    if (*spin_count < _CHIPS_SPIN_PAUSE_COUNT) {
+        (*spin_count)++;
+        _chips_cpu_relax();
+    }
+    else {
+        _chips_yield_thread();
+    }
+}
+
+#include <time.h>
+
+/* NOTE: clock_gettime() and CLOCK_MONOTONIC are only visible with
+   _POSIX_C_SOURCE >= 199309L (or in a gnu mode), with a strict C standard
+   the C11 timespec_get() is used instead, and clock() as last resort
+   (which has a low resolution and measures CPU time). On Windows,
+   timespec_get() is used so that <windows.h> isn't needed.
+*/
+uint64_t chips_perf_now_ns(void) {
+    #if defined(CLOCK_MONOTONIC) && !defined(_WIN32)
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    #elif defined(TIME_UTC)
+        struct timespec ts;
+        timespec_get(&ts, TIME_UTC);
+        return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    #else
+        return ((uint64_t)clock() * 1000000000) / (uint64_t)CLOCKS_PER_SEC;
+    #endif
+}
+
 #endif // CHIPS_IMPL
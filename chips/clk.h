@@ -25,6 +25,34 @@
     ~~~
         Convert micro-seconds to system ticks.
 
+    ~~~C
+    uint32_t clk_ticks_to_us(uint64_t freq_hz, uint32_t ticks)
+    ~~~
+        Convert system ticks to micro-seconds.
+
+    ~~~C
+    void clk_init(clk_t* clk, uint64_t freq_hz)
+    ~~~
+        Initialize a clock accumulator for a given frequency. Unlike
+        clk_us_to_ticks(), a clock accumulator carries the fractional tick
+        remainder over into the next call, so that repeatedly converting
+        short time slices (e.g. 60Hz host frames) doesn't lose ticks.
+
+    ~~~C
+    uint32_t clk_advance_us(clk_t* clk, uint32_t micro_seconds)
+    ~~~
+        Advance the clock accumulator by a number of micro-seconds and
+        return the number of ticks to execute.
+
+    ~~~C
+    uint32_t clk_advance_ticks(clk_t* clk, uint64_t src_freq_hz, uint32_t src_ticks)
+    ~~~
+        Advance the clock accumulator by a number of ticks of another
+        clock with the frequency src_freq_hz, and return the number of ticks
+        to execute (e.g. to run a second CPU in lockstep with a main CPU).
+        Don't mix calls to clk_advance_us() and clk_advance_ticks() on the
+        same clock accumulator (the remainder is in units of the source clock).
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -49,8 +77,22 @@
 extern "C" {
 #endif
 
+// a clock accumulator which carries the fractional tick remainder across calls
+typedef struct {
+    uint64_t freq_hz;
+    uint64_t rem;       // fractional tick remainder, in units of the source clock
+} clk_t;
+
 // helper func to convert micro_seconds into ticks
 uint32_t clk_us_to_ticks(uint64_t freq_hz, uint32_t micro_seconds);
+// helper func to convert ticks into micro_seconds
+uint32_t clk_ticks_to_us(uint64_t freq_hz, uint32_t ticks);
+// initialize a clock accumulator
+void clk_init(clk_t* clk, uint64_t freq_hz);
+// advance clock accumulator by micro_seconds, return number of ticks
+uint32_t clk_advance_us(clk_t* clk, uint32_t micro_seconds);
+// advance clock accumulator by ticks of another clock, return number of ticks
+uint32_t clk_advance_ticks(clk_t* clk, uint64_t src_freq_hz, uint32_t src_ticks);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -66,4 +108,25 @@ uint32_t clk_us_to_ticks(uint64_t freq_hz, uint32_t micro_seconds);
 uint32_t clk_us_to_ticks(uint64_t freq_hz, uint32_t micro_seconds) {
     return (uint32_t) ((freq_hz * micro_seconds) / 1000000);
 }
+
+uint32_t clk_ticks_to_us(uint64_t freq_hz, uint32_t ticks) {
+    return (uint32_t) ((ticks * 1000000ULL) / freq_hz);
+}
+
+void clk_init(clk_t* clk, uint64_t freq_hz) {
+    CHIPS_ASSERT(clk && (freq_hz > 0));
+    clk->freq_hz = freq_hz;
+    clk->rem = 0;
+}
+
+uint32_t clk_advance_ticks(clk_t* clk, uint64_t src_freq_hz, uint32_t src_ticks) {
+    CHIPS_ASSERT(clk && (clk->freq_hz > 0) && (src_freq_hz > 0));
+    const uint64_t t = clk->freq_hz * src_ticks + clk->rem;
+    clk->rem = t % src_freq_hz;
+    return (uint32_t) (t / src_freq_hz);
+}
+
+uint32_t clk_advance_us(clk_t* clk, uint32_t micro_seconds) {
+    return clk_advance_ticks(clk, 1000000, micro_seconds);
+}
 #endif
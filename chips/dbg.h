@@ -0,0 +1,911 @@
+#pragma once
+/*#
+    # dbg.h
+
+    UI-independent CPU debugger core: breakpoints and memory watchpoints,
+    execution stepping, execution history, memory access heatmap and
+    stopwatch counters.
+
+    This is the debugger state behind ui_dbg.h, which only adds the
+    Dear ImGui views on top. Use dbg.h directly for headless debugging
+    (e.g. stop a test run when a memory location changes).
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C or C++ file to create the
+    implementation.
+
+    Select the supported CPU with the following macros (define one
+    or the other, but not both):
+
+    DBG_USE_Z80
+    DBG_USE_M6502
+
+    (for compatibility with existing ui_dbg.h code, UI_DBG_USE_Z80 and
+    UI_DBG_USE_M6502 select the CPU as well)
+
+    Optionally provide the following macros with your own implementation
+
+    ~~~C
+    CHIPS_ASSERT(c)
+    ~~~
+        your own assert macro (default: assert(c))
+
+    You need to include the following headers before including dbg.h:
+
+        - chips_common.h
+        - z80.h         (only if DBG_USE_Z80 is defined)
+        - m6502.h       (only if DBG_USE_M6502 is defined)
+
+    ...and the following headers before including the *implementation*:
+
+        - z80dasm.h     (only if DBG_USE_Z80 is defined)
+        - m6502dasm.h   (only if DBG_USE_M6502 is defined)
+
+    ## Usage
+
+    Initialize a dbg_t with a pointer to the CPU and a memory read callback,
+    and hook it into the system emulator via the chips_debug_t debug hook:
+
+    ~~~C
+    dbg_init(&dbg, &(dbg_desc_t){
+        .z80 = &sys.cpu,
+        .read_cb = my_read_func,
+    });
+    zx_init(&sys, &(zx_desc_t){
+        ...
+        .debug = dbg_debug(&dbg),
+    });
+    ~~~
+
+    The dbg_t struct must stay at a fixed memory location while it's
+    hooked into the system emulator.
+
+    When a breakpoint triggers or a step has completed, the dbg_t is
+    put into stopped state (dbg.stopped is true), which stops the system
+    emulator's exec function, and the optional stopped callback is called.
+    Call dbg_continue(), dbg_step_into(), dbg_step_over() or
+    dbg_step_tick() to resume execution.
+
+    ## Breakpoints
+
+    Breakpoints are stored in the dbg.breakpoints[] array (with
+    dbg.num_breakpoints entries), use the dbg_bp_*() functions to add,
+    find and remove breakpoints. If the breakpoint array is modified
+    directly, dbg_bp_update() must be called afterwards.
+
+    The following breakpoint types exist:
+
+    - DBG_BREAKTYPE_EXEC: stop before the instruction at 'addr' is executed
+    - DBG_BREAKTYPE_BYTE: stop when the byte at 'addr' compared with 'val'
+      (using the DBG_BREAKCOND_* condition) is true (a watchpoint, this
+      is only evaluated after the CPU has written to 'addr')
+    - DBG_BREAKTYPE_WORD: same as DBG_BREAKTYPE_BYTE for a 16-bit value
+    - DBG_BREAKTYPE_IRQ, DBG_BREAKTYPE_NMI: stop when an interrupt is requested
+    - DBG_BREAKTYPE_OUT, DBG_BREAKTYPE_IN (Z80 only): stop on IO access
+      where (port & val) == (addr & val)
+    - DBG_BREAKTYPE_USER+N: evaluated by the optional user break callback
+
+    ## zlib/libpng license
+
+    Copyright (c) 2018 Andre Weissflog
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+#*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(UI_DBG_USE_Z80) && !defined(DBG_USE_Z80)
+#define DBG_USE_Z80
+#endif
+#if defined(UI_DBG_USE_M6502) && !defined(DBG_USE_M6502)
+#define DBG_USE_M6502
+#endif
+#if !defined(DBG_USE_Z80) && !defined(DBG_USE_M6502)
+#error "please define DBG_USE_Z80 or DBG_USE_M6502"
+#endif
+#if defined(DBG_USE_Z80) && defined(DBG_USE_M6502)
+#error "please define only one of DBG_USE_Z80 or DBG_USE_M6502"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NOTE: keep all MAX and NUM values 2^N
+#define DBG_MAX_BREAKPOINTS (1024)
+#define DBG_STEP_TRAPID (128)                       // special trap id when step-mode active
+#define DBG_BP_BASE_TRAPID (DBG_STEP_TRAPID+1)      // first trap id used for breakpoints
+#define DBG_NUM_HISTORY_ITEMS (256)
+#define DBG_STOPWATCH_NUM (8)
+
+// breakpoint types
+enum {
+    DBG_BREAKTYPE_EXEC,         // break on executed address
+    DBG_BREAKTYPE_BYTE,         // break on a specific 8-bit value at address
+    DBG_BREAKTYPE_WORD,         // break on a specific 16-bit value at address
+    DBG_BREAKTYPE_IRQ,          // break on maskable interrupt
+    DBG_BREAKTYPE_NMI,          // break on non-maskable interrupt
+    #if defined(DBG_USE_Z80)
+        DBG_BREAKTYPE_OUT,      // break on a Z80 out operation
+        DBG_BREAKTYPE_IN,       // break on a Z80 in operation
+    #endif
+    DBG_BREAKTYPE_USER,         // user breakpoint types start here
+};
+
+// breakpoint conditions
+enum {
+    DBG_BREAKCOND_EQUAL = 0,
+    DBG_BREAKCOND_NONEQUAL,
+    DBG_BREAKCOND_GREATER,
+    DBG_BREAKCOND_LESS,
+    DBG_BREAKCOND_GREATER_EQUAL,
+    DBG_BREAKCOND_LESS_EQUAL,
+};
+
+// current step mode
+enum {
+    DBG_STEPMODE_NONE = 0,
+    DBG_STEPMODE_INTO,
+    DBG_STEPMODE_OVER,
+    DBG_STEPMODE_TICK,
+};
+
+// reasons for entering the stopped state
+enum {
+    DBG_STOP_REASON_UNKNOWN = 0,
+    DBG_STOP_REASON_BREAK = 1,
+    DBG_STOP_REASON_BREAKPOINT = 2,
+    DBG_STOP_REASON_STEP = 3,
+};
+
+// heatmap item state bits
+enum {
+    DBG_HEATMAP_ITEM_OPCODE = (1<<0),
+    DBG_HEATMAP_ITEM_WRITE  = (1<<1),
+    DBG_HEATMAP_ITEM_READ   = (1<<2),
+};
+
+// a breakpoint
+typedef struct dbg_breakpoint_t {
+    int type;           // DBG_BREAKTYPE_*
+    int cond;           // DBG_BREAKCOND_*
+    bool enabled;
+    uint16_t addr;
+    int val;
+} dbg_breakpoint_t;
+
+// forward decl
+struct dbg_t;
+// callback for reading a byte from memory
+typedef uint8_t (*dbg_read_t)(uint16_t addr, void* user_data);
+// callback for evaluating user breakpoints, return trap id or the unmodified trap_id
+typedef int (*dbg_user_break_t)(struct dbg_t* dbg, int trap_id, uint64_t pins, void* user_data);
+// callback when the debugger has entered the stopped state (stop_reason is DBG_STOP_REASON_*)
+typedef void (*dbg_stopped_t)(int stop_reason, uint16_t addr, void* user_data);
+// callback when the debugger has continued after stopped state
+typedef void (*dbg_continued_t)(void* user_data);
+
+// debugger setup parameters
+typedef struct dbg_desc_t {
+    #if defined(DBG_USE_Z80)
+    z80_t* z80;                     // Z80 CPU to track
+    #else
+    m6502_t* m6502;                 // 6502 CPU to track
+    #endif
+    uint32_t freq_hz;               // CPU clock frequency in Hz (for the stopwatch)
+    uint32_t scanline_ticks;        // length of a raster line in clock cycles (for the stopwatch)
+    uint32_t frame_ticks;           // length of a frame in clock cycles (for the stopwatch)
+    dbg_read_t read_cb;             // callback to read memory
+    dbg_user_break_t break_cb;      // optional user-breakpoint evaluation callback
+    dbg_stopped_t stopped_cb;       // optional callback when entering stopped state
+    dbg_continued_t continued_cb;   // optional callback when leaving stopped state
+    void* user_data;                // user data for callbacks
+} dbg_desc_t;
+
+// memory access heatmap item
+typedef struct dbg_heatmap_item_t {
+    uint8_t state;  // DBG_HEATMAP_ITEM_*
+    uint8_t ticks;  // instruction tick count
+} dbg_heatmap_item_t;
+
+typedef struct dbg_heatmap_t {
+    dbg_heatmap_item_t items[1<<16];
+} dbg_heatmap_t;
+
+// ring buffer of recently executed instruction addresses
+typedef struct dbg_history_t {
+    uint16_t pc[DBG_NUM_HISTORY_ITEMS];
+    uint16_t pos;
+} dbg_history_t;
+
+typedef struct dbg_stopwatch_t {
+    uint32_t freq_hz;
+    uint32_t scanline_ticks;
+    uint32_t frame_ticks;
+    uint64_t cur_ticks;
+    uint64_t start_ticks[DBG_STOPWATCH_NUM];
+} dbg_stopwatch_t;
+
+// debugger state
+typedef struct dbg_t {
+    bool valid;
+    #if defined(DBG_USE_Z80)
+    z80_t* z80;
+    #else
+    m6502_t* m6502;
+    #endif
+    dbg_read_t read_cb;
+    dbg_user_break_t break_cb;
+    dbg_stopped_t stopped_cb;
+    dbg_continued_t continued_cb;
+    void* user_data;
+    bool stopped;
+    bool external_debugger_connected;
+    int step_mode;
+    uint64_t last_tick_pins;    // cpu pins in last tick
+    uint32_t cur_op_ticks;
+    uint16_t cur_op_pc;         // PC of current instruction
+    uint16_t stepover_pc;
+    int last_trap_id;           // can be used to identify breakpoint which caused trap
+    int num_breakpoints;
+    dbg_breakpoint_t breakpoints[DBG_MAX_BREAKPOINTS];
+    // lookup tables for enabled breakpoints (rebuilt when breakpoints change)
+    bool mem_written;           // a memory location watched by a BYTE/WORD breakpoint was written
+    int num_mem_bps;
+    int num_tick_bps;
+    uint16_t mem_bps[DBG_MAX_BREAKPOINTS];  // indices of enabled BYTE/WORD breakpoints
+    uint16_t tick_bps[DBG_MAX_BREAKPOINTS]; // indices of enabled per-tick breakpoints
+    uint8_t exec_bits[(1<<16)/8];   // one bit per address with an enabled EXEC breakpoint
+    uint8_t mem_bits[(1<<16)/8];    // one bit per address watched by an enabled BYTE/WORD breakpoint
+    dbg_heatmap_t heatmap;
+    dbg_history_t history;
+    dbg_stopwatch_t stopwatch;
+} dbg_t;
+
+// initialize a new dbg_t instance
+void dbg_init(dbg_t* dbg, const dbg_desc_t* desc);
+// discard dbg_t instance
+void dbg_discard(dbg_t* dbg);
+// call when resetting the emulated machine
+void dbg_reset(dbg_t* dbg);
+// call when rebooting the emulated machine
+void dbg_reboot(dbg_t* dbg);
+// get a debug hook for the system emulator desc
+chips_debug_t dbg_debug(dbg_t* dbg);
+// call after ticking the system (this is the debug hook callback)
+void dbg_tick(dbg_t* dbg, uint64_t pins);
+// pause/stop execution
+void dbg_break(dbg_t* dbg);
+// continue execution
+void dbg_continue(dbg_t* dbg, bool invoke_continued_cb);
+// step into the next instruction
+void dbg_step_into(dbg_t* dbg);
+// step over the next instruction (don't stop in subroutines)
+void dbg_step_over(dbg_t* dbg);
+// step a single clock tick
+void dbg_step_tick(dbg_t* dbg);
+// add an execution breakpoint, return false if no free breakpoint slots
+bool dbg_bp_add_exec(dbg_t* dbg, bool enabled, uint16_t addr);
+// add a byte watchpoint with the current memory content as value
+bool dbg_bp_add_byte(dbg_t* dbg, bool enabled, uint16_t addr);
+// add a word watchpoint with the current memory content as value
+bool dbg_bp_add_word(dbg_t* dbg, bool enabled, uint16_t addr);
+// find breakpoint index by type and address, return -1 if not found
+int dbg_bp_find(const dbg_t* dbg, int type, uint16_t addr);
+// delete breakpoint by index
+void dbg_bp_del(dbg_t* dbg, int index);
+// add an execution breakpoint, or delete an existing one
+void dbg_bp_toggle_exec(dbg_t* dbg, uint16_t addr);
+// return true if breakpoint is enabled, false if disabled or index out of bounds
+bool dbg_bp_enabled(const dbg_t* dbg, int index);
+// enable all breakpoints
+void dbg_bp_enable_all(dbg_t* dbg);
+// disable all breakpoints
+void dbg_bp_disable_all(dbg_t* dbg);
+// delete all breakpoints
+void dbg_bp_delete_all(dbg_t* dbg);
+// rebuild breakpoint lookup tables, call after modifying dbg.breakpoints[] directly
+void dbg_bp_update(dbg_t* dbg);
+// clear heatmap
+void dbg_heatmap_clear_all(dbg_t* dbg);
+// clear read/write state in heatmap, but keep opcode state
+void dbg_heatmap_clear_rw(dbg_t* dbg);
+// return true if address has been executed as instruction
+bool dbg_heatmap_is_opcode(const dbg_t* dbg, uint16_t addr);
+// return true if address has been read from
+bool dbg_heatmap_is_read(const dbg_t* dbg, uint16_t addr);
+// return true if address has been written to
+bool dbg_heatmap_is_write(const dbg_t* dbg, uint16_t addr);
+// get PC from execution history (0 is current instruction, 1 is previous...)
+uint16_t dbg_history_get(const dbg_t* dbg, uint16_t rel_pos);
+// reset a stopwatch
+void dbg_stopwatch_reset(dbg_t* dbg, int index);
+// get number of ticks since stopwatch was reset
+uint64_t dbg_stopwatch_ticks(const dbg_t* dbg, int index);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+static inline uint8_t _dbg_read_byte(dbg_t* dbg, uint16_t addr) {
+    return dbg->read_cb(addr, dbg->user_data);
+}
+
+static inline uint16_t _dbg_read_word(dbg_t* dbg, uint16_t addr) {
+    uint8_t l = dbg->read_cb(addr, dbg->user_data);
+    uint8_t h = dbg->read_cb(addr+1, dbg->user_data);
+    return (uint16_t) (h<<8)|l;
+}
+
+static inline bool _dbg_bit_test(const uint8_t* bits, uint16_t addr) {
+    return 0 != (bits[addr>>3] & (1<<(addr & 7)));
+}
+
+static inline void _dbg_bit_set(uint8_t* bits, uint16_t addr) {
+    bits[addr>>3] |= (1<<(addr & 7));
+}
+
+/*== STEPPING ================================================================*/
+typedef struct {
+    dbg_t* dbg;
+    uint16_t addr;
+    uint8_t opcode;
+    bool first;
+} _dbg_fetch_t;
+
+// disassembler callback to fetch the next instruction byte
+static uint8_t _dbg_dasm_in_cb(void* user_data) {
+    _dbg_fetch_t* f = (_dbg_fetch_t*) user_data;
+    const uint8_t val = _dbg_read_byte(f->dbg, f->addr++);
+    if (f->first) {
+        f->first = false;
+        f->opcode = val;
+    }
+    return val;
+}
+
+// check if an instruction is a 'step over' op
+static bool _dbg_is_stepover_op(uint8_t opcode) {
+    #if defined(DBG_USE_Z80)
+        switch (opcode) {
+            // CALL nnnn
+            case 0xCD:
+            // CALL cc,nnnn
+            case 0xDC: case 0xFC: case 0xD4: case 0xC4:
+            case 0xF4: case 0xEC: case 0xE4: case 0xCC:
+            // DJNZ d
+            case 0x10:
+                return true;
+            default:
+                return false;
+        }
+    #else
+        // on 6502, only JSR qualifies
+        return opcode == 0x20;
+    #endif
+}
+
+void dbg_break(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    dbg->stopped = true;
+    dbg->step_mode = DBG_STEPMODE_NONE;
+    if (dbg->stopped_cb) {
+        dbg->stopped_cb(DBG_STOP_REASON_BREAK, dbg->cur_op_pc, dbg->user_data);
+    }
+}
+
+void dbg_continue(dbg_t* dbg, bool invoke_continued_cb) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    dbg->stopped = false;
+    dbg->step_mode = DBG_STEPMODE_NONE;
+    if (invoke_continued_cb && dbg->continued_cb) {
+        dbg->continued_cb(dbg->user_data);
+    }
+}
+
+void dbg_step_into(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    dbg->stopped = false;
+    dbg->step_mode = DBG_STEPMODE_INTO;
+}
+
+void dbg_step_over(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    dbg->stopped = false;
+    _dbg_fetch_t fetch;
+    memset(&fetch, 0, sizeof(fetch));
+    fetch.dbg = dbg;
+    fetch.addr = dbg->cur_op_pc;
+    fetch.first = true;
+    #if defined(DBG_USE_Z80)
+        const uint16_t next_pc = z80dasm_op(dbg->cur_op_pc, _dbg_dasm_in_cb, 0, &fetch);
+    #else
+        const uint16_t next_pc = m6502dasm_op(dbg->cur_op_pc, _dbg_dasm_in_cb, 0, &fetch);
+    #endif
+    if (_dbg_is_stepover_op(fetch.opcode)) {
+        dbg->step_mode = DBG_STEPMODE_OVER;
+        dbg->stepover_pc = next_pc;
+    } else {
+        dbg->step_mode = DBG_STEPMODE_INTO;
+    }
+}
+
+void dbg_step_tick(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    dbg->stopped = false;
+    dbg->step_mode = DBG_STEPMODE_TICK;
+}
+
+/*== HISTORY =================================================================*/
+static void _dbg_history_reset(dbg_t* dbg) {
+    memset(&dbg->history, 0, sizeof(dbg->history));
+}
+
+static inline void _dbg_history_push(dbg_t* dbg, uint16_t pc) {
+    dbg->history.pc[dbg->history.pos] = pc;
+    dbg->history.pos = (dbg->history.pos + 1) & (DBG_NUM_HISTORY_ITEMS-1);
+}
+
+uint16_t dbg_history_get(const dbg_t* dbg, uint16_t rel_pos) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    uint16_t index = (dbg->history.pos - rel_pos - 1) & (DBG_NUM_HISTORY_ITEMS-1);
+    return dbg->history.pc[index];
+}
+
+/*== BREAKPOINTS =============================================================*/
+void dbg_bp_update(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    memset(dbg->exec_bits, 0, sizeof(dbg->exec_bits));
+    memset(dbg->mem_bits, 0, sizeof(dbg->mem_bits));
+    dbg->num_mem_bps = 0;
+    dbg->num_tick_bps = 0;
+    for (int i = 0; i < dbg->num_breakpoints; i++) {
+        const dbg_breakpoint_t* bp = &dbg->breakpoints[i];
+        if (!bp->enabled) {
+            continue;
+        }
+        switch (bp->type) {
+            case DBG_BREAKTYPE_EXEC:
+                _dbg_bit_set(dbg->exec_bits, bp->addr);
+                break;
+            case DBG_BREAKTYPE_WORD:
+                _dbg_bit_set(dbg->mem_bits, bp->addr + 1);
+                /* fallthrough */
+            case DBG_BREAKTYPE_BYTE:
+                _dbg_bit_set(dbg->mem_bits, bp->addr);
+                dbg->mem_bps[dbg->num_mem_bps++] = (uint16_t)i;
+                break;
+            case DBG_BREAKTYPE_IRQ:
+            case DBG_BREAKTYPE_NMI:
+            #if defined(DBG_USE_Z80)
+            case DBG_BREAKTYPE_OUT:
+            case DBG_BREAKTYPE_IN:
+            #endif
+                dbg->tick_bps[dbg->num_tick_bps++] = (uint16_t)i;
+                break;
+            default:
+                // user breakpoints are evaluated by the user callback
+                break;
+        }
+    }
+    // evaluate memory breakpoints once in case their condition is already true
+    dbg->mem_written = dbg->num_mem_bps > 0;
+}
+
+// record writes to memory locations watched by BYTE/WORD breakpoints
+static inline void _dbg_bp_record_tick(dbg_t* dbg, uint64_t pins) {
+    if (dbg->num_mem_bps > 0) {
+        #if defined(DBG_USE_Z80)
+            if ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR)) {
+                if (_dbg_bit_test(dbg->mem_bits, Z80_GET_ADDR(pins))) {
+                    dbg->mem_written = true;
+                }
+            }
+        #else
+            if (0 == (pins & M6502_RW)) {
+                if (_dbg_bit_test(dbg->mem_bits, M6502_GET_ADDR(pins))) {
+                    dbg->mem_written = true;
+                }
+            }
+        #endif
+    }
+}
+
+// evaluate per-opcode breakpoints, called at the start of a new instruction
+static int _dbg_eval_op_breakpoints(dbg_t* dbg, int trap_id, uint16_t pc) {
+    if (dbg->step_mode != DBG_STEPMODE_NONE) {
+        switch (dbg->step_mode) {
+            case DBG_STEPMODE_INTO:
+                trap_id = DBG_STEP_TRAPID;
+                break;
+            case DBG_STEPMODE_OVER:
+                if (pc == dbg->stepover_pc) {
+                    trap_id = DBG_STEP_TRAPID;
+                }
+                break;
+        }
+    } else {
+        // exec breakpoints, only search the breakpoint if the address is marked
+        if (_dbg_bit_test(dbg->exec_bits, pc)) {
+            for (int i = 0; (i < dbg->num_breakpoints) && (trap_id == 0); i++) {
+                const dbg_breakpoint_t* bp = &dbg->breakpoints[i];
+                if (bp->enabled && (bp->type == DBG_BREAKTYPE_EXEC) && (pc == bp->addr)) {
+                    trap_id = DBG_BP_BASE_TRAPID + i;
+                }
+            }
+        }
+        // memory breakpoints, only evaluated after a watched address was written
+        if ((trap_id == 0) && dbg->mem_written) {
+            dbg->mem_written = false;
+            for (int j = 0; (j < dbg->num_mem_bps) && (trap_id == 0); j++) {
+                const int i = dbg->mem_bps[j];
+                const dbg_breakpoint_t* bp = &dbg->breakpoints[i];
+                int val;
+                if (bp->type == DBG_BREAKTYPE_BYTE) {
+                    val = (int) _dbg_read_byte(dbg, bp->addr);
+                } else {
+                    val = (int) _dbg_read_word(dbg, bp->addr);
+                }
+                bool b = false;
+                switch (bp->cond) {
+                    case DBG_BREAKCOND_EQUAL:            b = val == bp->val; break;
+                    case DBG_BREAKCOND_NONEQUAL:         b = val != bp->val; break;
+                    case DBG_BREAKCOND_GREATER:          b = val > bp->val; break;
+                    case DBG_BREAKCOND_LESS:             b = val < bp->val; break;
+                    case DBG_BREAKCOND_GREATER_EQUAL:    b = val >= bp->val; break;
+                    case DBG_BREAKCOND_LESS_EQUAL:       b = val <= bp->val; break;
+                }
+                if (b) {
+                    trap_id = DBG_BP_BASE_TRAPID + i;
+                }
+            }
+        }
+    }
+    return trap_id;
+}
+
+// evaluate per-tick breakpoints, only call this if is step_mode is DBG_STEPMODE_NONE!
+static int _dbg_eval_tick_breakpoints(dbg_t* dbg, int trap_id, uint64_t pins) {
+    uint64_t rising_pins = pins & (pins ^ dbg->last_tick_pins);
+    for (int j = 0; (j < dbg->num_tick_bps) && (trap_id == 0); j++) {
+        const int i = dbg->tick_bps[j];
+        const dbg_breakpoint_t* bp = &dbg->breakpoints[i];
+        switch (bp->type) {
+            case DBG_BREAKTYPE_IRQ:
+                #if defined(DBG_USE_Z80)
+                    if (Z80_INT & rising_pins) {
+                        trap_id = DBG_BP_BASE_TRAPID + i;
+                    }
+                #else
+                    if (M6502_IRQ & rising_pins) {
+                        trap_id = DBG_BP_BASE_TRAPID + i;
+                    }
+                #endif
+                break;
+
+            case DBG_BREAKTYPE_NMI:
+                #if defined(DBG_USE_Z80)
+                    if (Z80_NMI & rising_pins) {
+                        trap_id = DBG_BP_BASE_TRAPID + i;
+                    }
+                #else
+                    if (M6502_NMI & rising_pins) {
+                        trap_id = DBG_BP_BASE_TRAPID + i;
+                    }
+                #endif
+                break;
+
+            #if defined(DBG_USE_Z80)
+            case DBG_BREAKTYPE_OUT:
+                if ((pins & Z80_CTRL_PIN_MASK) == (Z80_IORQ|Z80_WR)) {
+                    const uint16_t mask = bp->val;
+                    if ((Z80_GET_ADDR(pins) & mask) == (bp->addr & mask)) {
+                        trap_id = DBG_BP_BASE_TRAPID + i;
+                    }
+                }
+                break;
+
+            case DBG_BREAKTYPE_IN:
+                if ((pins & Z80_CTRL_PIN_MASK) == (Z80_IORQ|Z80_RD)) {
+                    const uint16_t mask = bp->val;
+                    if ((Z80_GET_ADDR(pins) & mask) == (bp->addr & mask)) {
+                        trap_id = DBG_BP_BASE_TRAPID + i;
+                    }
+                }
+                break;
+            #endif
+        }
+    }
+
+    // call optional user-breakpoint evaluation callback
+    if ((0 == trap_id) && dbg->break_cb) {
+        trap_id = dbg->break_cb(dbg, trap_id, pins, dbg->user_data);
+    }
+    return trap_id;
+}
+
+// add a breakpoint of a given type
+static bool _dbg_bp_add(dbg_t* dbg, int type, bool enabled, uint16_t addr, int val) {
+    if (dbg->num_breakpoints < DBG_MAX_BREAKPOINTS) {
+        dbg_breakpoint_t* bp = &dbg->breakpoints[dbg->num_breakpoints++];
+        bp->type = type;
+        bp->cond = DBG_BREAKCOND_EQUAL;
+        bp->addr = addr;
+        bp->val = val;
+        bp->enabled = enabled;
+        dbg_bp_update(dbg);
+        return true;
+    } else {
+        // no more breakpoint slots
+        return false;
+    }
+}
+
+bool dbg_bp_add_exec(dbg_t* dbg, bool enabled, uint16_t addr) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    return _dbg_bp_add(dbg, DBG_BREAKTYPE_EXEC, enabled, addr, 0);
+}
+
+bool dbg_bp_add_byte(dbg_t* dbg, bool enabled, uint16_t addr) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    return _dbg_bp_add(dbg, DBG_BREAKTYPE_BYTE, enabled, addr, _dbg_read_byte(dbg, addr));
+}
+
+bool dbg_bp_add_word(dbg_t* dbg, bool enabled, uint16_t addr) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    return _dbg_bp_add(dbg, DBG_BREAKTYPE_WORD, enabled, addr, _dbg_read_word(dbg, addr));
+}
+
+int dbg_bp_find(const dbg_t* dbg, int type, uint16_t addr) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    for (int i = 0; i < dbg->num_breakpoints; i++) {
+        const dbg_breakpoint_t* bp = &dbg->breakpoints[i];
+        if (bp->type == type && bp->addr == addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void dbg_bp_del(dbg_t* dbg, int index) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    if ((dbg->num_breakpoints > 0) && (index >= 0) && (index < dbg->num_breakpoints)) {
+        for (int i = index; i < (dbg->num_breakpoints - 1); i++) {
+            dbg->breakpoints[i] = dbg->breakpoints[i+1];
+        }
+        dbg->num_breakpoints--;
+        dbg_bp_update(dbg);
+    }
+}
+
+void dbg_bp_toggle_exec(dbg_t* dbg, uint16_t addr) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    int index = dbg_bp_find(dbg, DBG_BREAKTYPE_EXEC, addr);
+    if (index >= 0) {
+        // breakpoint already exists, remove
+        dbg_bp_del(dbg, index);
+    } else {
+        // breakpoint doesn't exist, add a new one
+        dbg_bp_add_exec(dbg, true, addr);
+    }
+}
+
+bool dbg_bp_enabled(const dbg_t* dbg, int index) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    if ((index >= 0) && (index < dbg->num_breakpoints)) {
+        return dbg->breakpoints[index].enabled;
+    }
+    return false;
+}
+
+void dbg_bp_enable_all(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    for (int i = 0; i < dbg->num_breakpoints; i++) {
+        dbg->breakpoints[i].enabled = true;
+    }
+    dbg_bp_update(dbg);
+}
+
+void dbg_bp_disable_all(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    for (int i = 0; i < dbg->num_breakpoints; i++) {
+        dbg->breakpoints[i].enabled = false;
+    }
+    dbg_bp_update(dbg);
+}
+
+void dbg_bp_delete_all(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    dbg->num_breakpoints = 0;
+    dbg_bp_update(dbg);
+}
+
+/*== HEATMAP =================================================================*/
+void dbg_heatmap_clear_all(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    memset(dbg->heatmap.items, 0, sizeof(dbg->heatmap.items));
+}
+
+void dbg_heatmap_clear_rw(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    for (int i = 0; i < (1<<16); i++) {
+        dbg->heatmap.items[i].state &= ~(DBG_HEATMAP_ITEM_READ|DBG_HEATMAP_ITEM_WRITE);
+    }
+}
+
+bool dbg_heatmap_is_opcode(const dbg_t* dbg, uint16_t addr) {
+    return 0 != (dbg->heatmap.items[addr].state & DBG_HEATMAP_ITEM_OPCODE);
+}
+
+bool dbg_heatmap_is_read(const dbg_t* dbg, uint16_t addr) {
+    return 0 != (dbg->heatmap.items[addr].state & DBG_HEATMAP_ITEM_READ);
+}
+
+bool dbg_heatmap_is_write(const dbg_t* dbg, uint16_t addr) {
+    return 0 != (dbg->heatmap.items[addr].state & DBG_HEATMAP_ITEM_WRITE);
+}
+
+static inline void _dbg_heatmap_record_op(dbg_t* dbg, uint16_t pc) {
+    // record per-op heatmap events
+    dbg->heatmap.items[pc].state |= DBG_HEATMAP_ITEM_OPCODE;
+    // update last instruction's ticks
+    dbg->heatmap.items[dbg->cur_op_pc].ticks = dbg->cur_op_ticks;
+}
+
+static inline void _dbg_heatmap_record_tick(dbg_t* dbg, uint64_t pins) {
+    #if defined(DBG_USE_Z80)
+        if ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_RD)) {
+            const uint16_t addr = Z80_GET_ADDR(pins);
+            dbg->heatmap.items[addr].state |= DBG_HEATMAP_ITEM_READ;
+        } else if ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR)) {
+            const uint16_t addr = Z80_GET_ADDR(pins);
+            dbg->heatmap.items[addr].state |= DBG_HEATMAP_ITEM_WRITE;
+        }
+    #else
+        const uint16_t addr = M6502_GET_ADDR(pins);
+        if (0 != (pins & M6502_RW)) {
+            dbg->heatmap.items[addr].state |= DBG_HEATMAP_ITEM_READ;
+        } else {
+            dbg->heatmap.items[addr].state |= DBG_HEATMAP_ITEM_WRITE;
+        }
+    #endif
+}
+
+/*== STOPWATCH ===============================================================*/
+void dbg_stopwatch_reset(dbg_t* dbg, int index) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    CHIPS_ASSERT((index >= 0) && (index < DBG_STOPWATCH_NUM));
+    dbg->stopwatch.start_ticks[index] = dbg->stopwatch.cur_ticks;
+}
+
+uint64_t dbg_stopwatch_ticks(const dbg_t* dbg, int index) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    CHIPS_ASSERT((index >= 0) && (index < DBG_STOPWATCH_NUM));
+    return dbg->stopwatch.cur_ticks - dbg->stopwatch.start_ticks[index];
+}
+
+/*== PUBLIC FUNCTIONS ========================================================*/
+void dbg_init(dbg_t* dbg, const dbg_desc_t* desc) {
+    CHIPS_ASSERT(dbg && desc);
+    CHIPS_ASSERT(desc->read_cb);
+    memset(dbg, 0, sizeof(dbg_t));
+    dbg->valid = true;
+    #if defined(DBG_USE_Z80)
+        CHIPS_ASSERT(desc->z80);
+        dbg->z80 = desc->z80;
+    #else
+        CHIPS_ASSERT(desc->m6502);
+        dbg->m6502 = desc->m6502;
+    #endif
+    dbg->read_cb = desc->read_cb;
+    dbg->break_cb = desc->break_cb;
+    dbg->stopped_cb = desc->stopped_cb;
+    dbg->continued_cb = desc->continued_cb;
+    dbg->user_data = desc->user_data;
+    dbg->stopwatch.freq_hz = desc->freq_hz;
+    dbg->stopwatch.scanline_ticks = desc->scanline_ticks;
+    dbg->stopwatch.frame_ticks = desc->frame_ticks;
+}
+
+void dbg_discard(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    dbg->valid = false;
+}
+
+void dbg_reset(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    dbg->stopped = false;
+    dbg->step_mode = DBG_STEPMODE_NONE;
+    dbg->cur_op_pc = 0;
+    dbg->last_trap_id = 0;
+    dbg_heatmap_clear_all(dbg);
+    _dbg_history_reset(dbg);
+    dbg->stopwatch.cur_ticks = 0;
+    for (int i = 0; i < DBG_STOPWATCH_NUM; i++) {
+        dbg->stopwatch.start_ticks[i] = 0;
+    }
+}
+
+void dbg_reboot(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    dbg->stopped = false;
+    dbg->step_mode = DBG_STEPMODE_NONE;
+    dbg->cur_op_pc = 0;
+    dbg->last_trap_id = 0;
+    dbg_heatmap_clear_all(dbg);
+    _dbg_history_reset(dbg);
+}
+
+chips_debug_t dbg_debug(dbg_t* dbg) {
+    CHIPS_ASSERT(dbg && dbg->valid);
+    chips_debug_t debug;
+    memset(&debug, 0, sizeof(debug));
+    debug.callback.func = (chips_debug_func_t)dbg_tick;
+    debug.callback.user_data = dbg;
+    debug.stopped = &dbg->stopped;
+    return debug;
+}
+
+void dbg_tick(dbg_t* dbg, uint64_t pins) {
+    int trap_id = 0;
+    if (dbg->step_mode == DBG_STEPMODE_TICK) {
+        trap_id = DBG_STEP_TRAPID;
+    }
+    // evaluate per-op breakpoints
+    #if defined(DBG_USE_Z80)
+        const bool new_op = z80_opdone(dbg->z80);
+    #else
+        const bool new_op = pins & M6502_SYNC;
+    #endif
+    if (new_op) {
+        const uint16_t pc = pins & 0xFFFF;
+        trap_id = _dbg_eval_op_breakpoints(dbg, trap_id, pc);
+        _dbg_heatmap_record_op(dbg, pc);
+        _dbg_history_push(dbg, pc);
+        dbg->cur_op_ticks = 0;
+        dbg->cur_op_pc = pc;
+    }
+    if (dbg->step_mode == DBG_STEPMODE_NONE) {
+        trap_id = _dbg_eval_tick_breakpoints(dbg, trap_id, pins);
+    }
+    _dbg_heatmap_record_tick(dbg, pins);
+    _dbg_bp_record_tick(dbg, pins);
+    dbg->stopwatch.cur_ticks++;
+    dbg->cur_op_ticks++;
+    dbg->last_tick_pins = pins;
+
+    if (trap_id >= DBG_STEP_TRAPID) {
+        dbg->stopped = true;
+        if (dbg->stopped_cb) {
+            int stop_reason = (dbg->step_mode == DBG_STEPMODE_NONE) ? DBG_STOP_REASON_BREAKPOINT : DBG_STOP_REASON_STEP;
+            dbg->stopped_cb(stop_reason, dbg->cur_op_pc, dbg->user_data);
+        }
+        dbg->step_mode = DBG_STEPMODE_NONE;
+    }
+    dbg->last_trap_id = trap_id;
+}
+
+#endif /* CHIPS_IMPL */
@@ -0,0 +1,267 @@
+#pragma once
+/*#
+    # evsched.h
+
+    A tiny discrete-event scheduler for system emulators.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C file to create the
+    implementation.
+
+    Optionally provide the following macros with your own implementation
+
+    ~~~C
+    CHIPS_ASSERT(c)
+    ~~~
+        your own assert macro (default: assert(c))
+
+    ## Overview
+
+    Instead of ticking each chip in every clock cycle, a system emulator
+    can register the points in time where a chip needs attention (a
+    timer reaching zero, a scanline boundary, an interrupt pin going
+    inactive, the next audio sample...) as events, and only tick the CPU
+    in between. Chips with internal state that's observable by the CPU
+    (e.g. a sound chip's registers) are then caught up lazily when the
+    CPU accesses them.
+
+    Events are identified by small integer ids (0..SCHED_MAX_EVENTS-1)
+    defined by the system emulator, each id can be scheduled at most
+    once. Time is measured in ticks of a clock chosen by the system
+    emulator (usually the CPU clock). Events which are due at the same
+    tick are dispatched in ascending id order, so that the dispatch order
+    is deterministic.
+
+    The scheduler state is a plain struct without pointers, so it can
+    be part of an emulator snapshot.
+
+    ## Functions
+
+    ~~~C
+    void sched_init(sched_t* sched)
+    ~~~
+        Initialize a scheduler with the current time 0 and no scheduled
+        events.
+
+    ~~~C
+    void sched_at(sched_t* sched, int id, uint64_t time)
+    ~~~
+        Schedule event 'id' at the absolute tick 'time', if the event is
+        already scheduled it is moved to the new time.
+
+    ~~~C
+    void sched_in(sched_t* sched, int id, uint64_t num_ticks)
+    ~~~
+        Schedule event 'id' num_ticks after the current time.
+
+    ~~~C
+    void sched_cancel(sched_t* sched, int id)
+    ~~~
+        Remove event 'id' from the schedule (does nothing if the event
+        isn't scheduled).
+
+    ~~~C
+    bool sched_scheduled(const sched_t* sched, int id)
+    ~~~
+        Return true if event 'id' is currently scheduled.
+
+    ~~~C
+    int sched_pop(sched_t* sched)
+    ~~~
+        Remove the earliest event which is due at the current time and
+        return its id, or return -1 if no event is due.
+
+    The current time is the 'now' member of sched_t, the system emulator
+    advances it directly, and compares it against the 'next' member (the
+    time of the earliest scheduled event) to find out if any event is due:
+
+    ~~~C
+    if (++sys->sched.now >= sys->sched.next) {
+        int event;
+        while ((event = sched_pop(&sys->sched)) >= 0) {
+            switch (event) {
+                ...
+            }
+        }
+    }
+    ~~~
+
+    ## zlib/libpng license
+
+    Copyright (c) 2018 Andre Weissflog
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+#*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCHED_MAX_EVENTS (8)
+#define SCHED_NEVER (UINT64_MAX)
+
+// scheduler state
+typedef struct {
+    uint64_t now;                       // current time in ticks
+    uint64_t next;                      // time of the earliest scheduled event, or SCHED_NEVER
+    uint64_t time[SCHED_MAX_EVENTS];    // due time by event id
+    int8_t pos[SCHED_MAX_EVENTS];       // heap position by event id, or -1 if not scheduled
+    uint8_t heap[SCHED_MAX_EVENTS];     // event ids as binary min-heap ordered by (time, id)
+    int num;                            // number of scheduled events
+} sched_t;
+
+// initialize a scheduler
+void sched_init(sched_t* sched);
+// schedule an event at an absolute time
+void sched_at(sched_t* sched, int id, uint64_t time);
+// schedule an event relative to the current time
+void sched_in(sched_t* sched, int id, uint64_t num_ticks);
+// remove an event from the schedule
+void sched_cancel(sched_t* sched, int id);
+// return true if an event is scheduled
+bool sched_scheduled(const sched_t* sched, int id);
+// remove and return the earliest due event, or -1
+int sched_pop(sched_t* sched);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+void sched_init(sched_t* s) {
+    CHIPS_ASSERT(s);
+    s->now = 0;
+    s->next = SCHED_NEVER;
+    s->num = 0;
+    for (int i = 0; i < SCHED_MAX_EVENTS; i++) {
+        s->time[i] = SCHED_NEVER;
+        s->pos[i] = -1;
+        s->heap[i] = 0;
+    }
+}
+
+// true if event a must be dispatched before event b
+static inline bool _sched_before(const sched_t* s, int a, int b) {
+    return (s->time[a] < s->time[b]) || ((s->time[a] == s->time[b]) && (a < b));
+}
+
+static inline void _sched_place(sched_t* s, int pos, int id) {
+    s->heap[pos] = (uint8_t)id;
+    s->pos[id] = (int8_t)pos;
+}
+
+static void _sched_sift_up(sched_t* s, int pos) {
+    const int id = s->heap[pos];
+    while (pos > 0) {
+        const int parent = (pos - 1) >> 1;
+        if (!_sched_before(s, id, s->heap[parent])) {
+            break;
+        }
+        _sched_place(s, pos, s->heap[parent]);
+        pos = parent;
+    }
+    _sched_place(s, pos, id);
+}
+
+static void _sched_sift_down(sched_t* s, int pos) {
+    const int id = s->heap[pos];
+    while (true) {
+        int child = 2 * pos + 1;
+        if (child >= s->num) {
+            break;
+        }
+        if (((child + 1) < s->num) && _sched_before(s, s->heap[child + 1], s->heap[child])) {
+            child++;
+        }
+        if (!_sched_before(s, s->heap[child], id)) {
+            break;
+        }
+        _sched_place(s, pos, s->heap[child]);
+        pos = child;
+    }
+    _sched_place(s, pos, id);
+}
+
+static inline void _sched_update_next(sched_t* s) {
+    s->next = (s->num > 0) ? s->time[s->heap[0]] : SCHED_NEVER;
+}
+
+void sched_at(sched_t* s, int id, uint64_t time) {
+    CHIPS_ASSERT(s && (id >= 0) && (id < SCHED_MAX_EVENTS));
+    CHIPS_ASSERT(time != SCHED_NEVER);
+    s->time[id] = time;
+    int pos = s->pos[id];
+    if (pos < 0) {
+        pos = s->num++;
+        _sched_place(s, pos, id);
+        _sched_sift_up(s, pos);
+    }
+    else {
+        _sched_sift_up(s, pos);
+        _sched_sift_down(s, s->pos[id]);
+    }
+    _sched_update_next(s);
+}
+
+void sched_in(sched_t* s, int id, uint64_t num_ticks) {
+    CHIPS_ASSERT(s);
+    sched_at(s, id, s->now + num_ticks);
+}
+
+void sched_cancel(sched_t* s, int id) {
+    CHIPS_ASSERT(s && (id >= 0) && (id < SCHED_MAX_EVENTS));
+    const int pos = s->pos[id];
+    if (pos < 0) {
+        return;
+    }
+    s->pos[id] = -1;
+    s->time[id] = SCHED_NEVER;
+    const int last = --s->num;
+    if (pos != last) {
+        const int moved = s->heap[last];
+        _sched_place(s, pos, moved);
+        _sched_sift_up(s, pos);
+        _sched_sift_down(s, s->pos[moved]);
+    }
+    _sched_update_next(s);
+}
+
+bool sched_scheduled(const sched_t* s, int id) {
+    CHIPS_ASSERT(s && (id >= 0) && (id < SCHED_MAX_EVENTS));
+    return s->pos[id] >= 0;
+}
+
+int sched_pop(sched_t* s) {
+    CHIPS_ASSERT(s);
+    if (s->next > s->now) {
+        return -1;
+    }
+    const int id = s->heap[0];
+    sched_cancel(s, id);
+    return id;
+}
+
+#endif /* CHIPS_IMPL */
@@ -20,6 +20,16 @@
 
     FIXME: DOCS
 
+    ## Disc Images and Written Sectors
+
+    The disc image data is copied into a writable buffer inside fdd_t
+    (up to FDD_MAX_DISC_SIZE bytes), sectors written by the emulated
+    system are modified in place. This means that writing to any sector
+    of a valid disc always succeeds, and snapshots of the system emulator
+    contain the complete current disc content.
+
+    Use fdd_sector_data() to get the current content of a sector.
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -118,6 +128,8 @@ bool fdd_insert_disc(fdd_t* fdd, const fdd_disc_t* disc, const uint8_t* data, in
 void fdd_eject_disc(fdd_t* fdd);
 // return true if a disc is currently inserted
 bool fdd_disc_inserted(fdd_t* fdd);
+// get pointer to current sector content (including written data), or 0
+const uint8_t* fdd_sector_data(fdd_t* fdd, int side, int track_index, int sector_index);
 
 // seek to physical track (happens instantly), returns FDD_RESULT_*
 int fdd_seek_track(fdd_t* fdd, int track);
@@ -159,6 +171,7 @@ void fdd_eject_disc(fdd_t* fdd) {
     fdd->has_disc = false;
     fdd->motor_on = false;
     memset(&fdd->disc, 0, sizeof(fdd->disc));
+    fdd->data_size = 0;
     memset(&fdd->data, 0, sizeof(fdd->data));
 }
 
@@ -167,7 +180,7 @@ bool fdd_disc_inserted(fdd_t* fdd) {
     return fdd->has_disc;
 }
 
-bool _fdd_validate_disc(const fdd_disc_t* disc) {
+bool _fdd_validate_disc(const fdd_disc_t* disc, int data_size) {
     CHIPS_ASSERT(disc);
     if ((disc->num_sides < 0) || (disc->num_sides > FDD_MAX_SIDES)) {
         return false;
@@ -184,7 +197,7 @@ bool _fdd_validate_disc(const fdd_disc_t* disc) {
             if ((track->data_size < 0) || (track->data_size > FDD_MAX_TRACK_SIZE)) {
                 return false;
             }
-            if ((track->data_offset + track->data_size) > FDD_MAX_DISC_SIZE) {
+            if ((track->data_offset + track->data_size) > data_size) {
                 return false;
             }
             if ((track->num_sectors < 0) || (track->num_sectors > FDD_MAX_SECTORS)) {
@@ -198,7 +211,7 @@ bool _fdd_validate_disc(const fdd_disc_t* disc) {
                 if ((sector->data_size < 0) || (sector->data_size > FDD_MAX_SECTOR_SIZE)) {
                     return false;
                 }
-                if ((sector->data_offset + sector->data_size) > FDD_MAX_DISC_SIZE) {
+                if ((sector->data_offset + sector->data_size) > data_size) {
                     return false;
                 }
             }
@@ -212,7 +225,7 @@ bool fdd_insert_disc(fdd_t* fdd, const fdd_disc_t* disc, const uint8_t* data, in
     if (fdd->has_disc) {
         fdd_eject_disc(fdd);
     }
-    if (_fdd_validate_disc(disc)) {
+    if (_fdd_validate_disc(disc, data ? data_size : FDD_MAX_DISC_SIZE)) {
         fdd->disc = *disc;
     }
     else {
@@ -315,4 +328,14 @@ int fdd_write(fdd_t* fdd, int side, uint8_t data) {
     return FDD_RESULT_NOT_READY;
 }
 
+const uint8_t* fdd_sector_data(fdd_t* fdd, int side, int track_index, int sector_index) {
+    CHIPS_ASSERT(fdd && (side >= 0) && (side < FDD_MAX_SIDES));
+    CHIPS_ASSERT((track_index >= 0) && (track_index < FDD_MAX_TRACKS));
+    CHIPS_ASSERT((sector_index >= 0) && (sector_index < FDD_MAX_SECTORS));
+    if (!fdd->has_disc || !fdd->disc.formatted) {
+        return 0;
+    }
+    return &fdd->data[fdd->disc.tracks[side][track_index].sectors[sector_index].data_offset];
+}
+
 #endif /* CHIPS_IMPL */
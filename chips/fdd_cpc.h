@@ -11,13 +11,13 @@
     ## Functions
 
     ~~~C
-    bool fdd_cpc_insert_dsk(fdd_t* fdd, const uint8_t* data, int data_size)
+    bool fdd_cpc_insert_dsk(fdd_t* fdd, chips_range_t data)
     ~~~
-        'Inserts' a CPC .dsk disk image into the floppy drive.
+        'Inserts' a CPC .dsk disk image into the floppy drive, the image
+        data will be copied.
 
         fdd         - pointer to an initialized fdd_t instance
-        data        - pointer to the .dsk image data in memory
-        data_size   - size in bytes of the image data
+        data        - pointer and size of the .dsk image data in memory
 
     ## zlib/libpng license
 
@@ -123,14 +123,17 @@ static bool _fdd_cpc_parse_dsk(fdd_t* fdd, bool ext, chips_range_t data) {
             }
             if (track_size > 0) {
                 const _fdd_cpc_dsk_track_info* track_info = (const _fdd_cpc_dsk_track_info*) &fdd->data[data_offset];
-                if (0 != memcmp("Track-Info", track_info->magic, 10)) {
+                if ((data_offset + track_size) > data.size) {
                     return false;
                 }
-                if ((data_offset + track_size) > data.size) {
+                if (0 != memcmp("Track-Info", track_info->magic, 10)) {
                     return false;
                 }
                 track->data_offset = data_offset;
                 track->data_size = track_size;
+                if (track_info->num_sectors > FDD_MAX_SECTORS) {
+                    return false;
+                }
                 track->num_sectors = track_info->num_sectors;
                 size_t sector_data_offset = data_offset + 0x100;
                 const _fdd_cpc_dsk_sector_info* sector_infos = (const _fdd_cpc_dsk_sector_info*) (track_info+1);
@@ -144,6 +147,9 @@ static bool _fdd_cpc_parse_dsk(fdd_t* fdd, bool ext, chips_range_t data) {
                     else {
                         sector_size = 0x80 << track_info->sector_size;
                     }
+                    if ((sector_data_offset + sector_size) > data.size) {
+                        return false;
+                    }
                     sector->info.upd765.c = sector_info->track;
                     sector->info.upd765.h = sector_info->side;
                     sector->info.upd765.r = sector_info->sector_id;
@@ -86,6 +86,35 @@
     m6522_reset(&sys->via);
     ~~~
 
+    ## Skipping ahead
+
+    Between register accesses and input pin changes the VIA mostly just
+    decrements its timers. A system emulator can skip over those cycles
+    and catch up the VIA lazily, right before the next register access
+    (so that reads of T1C and T2C return the exact counter values):
+
+    ~~~C
+    uint32_t m6522_next_event(const m6522_t* c, uint64_t pins)
+    ~~~
+        Returns the number of ticks until the next observable event (a timer
+        underflow, which may also toggle PB7 or request an interrupt, or a
+        pending delay-pipeline, control-line or IRQ pin change), assuming
+        that the input pins stay at 'pins'. Zero means that the next tick
+        must be performed with m6522_tick() or m6522_advance().
+
+    ~~~C
+    uint64_t m6522_advance(m6522_t* c, uint64_t pins, uint32_t num_ticks)
+    ~~~
+        Advance the VIA by num_ticks cycles without a register access,
+        with the input pins held at 'pins'. Steady stretches are skipped
+        in a single step, only the cycles around events are ticked
+        individually. The resulting state and the returned output pin mask
+        are identical to calling m6522_tick() num_ticks times with the
+        same pins (and CS1 inactive).
+
+    The shift register isn't emulated yet, so there are no shift-complete
+    events.
+
     ## LINKS
 
     On timer behaviour when hitting zero:
@@ -352,6 +381,10 @@ void m6522_init(m6522_t* m6522);
 void m6522_reset(m6522_t* m6522);
 // tick the m6522
 uint64_t m6522_tick(m6522_t* m6522, uint64_t pins);
+// number of ticks until the next observable event with unchanged input pins
+uint32_t m6522_next_event(const m6522_t* m6522, uint64_t pins);
+// advance the m6522 by num_ticks without register access
+uint64_t m6522_advance(m6522_t* m6522, uint64_t pins, uint32_t num_ticks);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -445,10 +478,10 @@ static inline void _m6522_read_port_pins(m6522_t* c, uint64_t pins) {
     bool new_cb2 = 0 != (pins & M6522_CB2);
     c->pa.c1_triggered = (c->pa.c1_in != new_ca1) && ((new_ca1 && M6522_PCR_CA1_LOW_TO_HIGH(c)) || (!new_ca1 && M6522_PCR_CA1_HIGH_TO_LOW(c)));
     c->pa.c2_triggered = (c->pa.c2_in != new_ca2) && ((new_ca2 && M6522_PCR_CA2_LOW_TO_HIGH(c)) || (!new_ca2 && M6522_PCR_CA2_HIGH_TO_LOW(c)));
-    c->pb.c1_triggered = (c->pb.c1_in != new_cb1) && ((new_cb1 && M6522_PCR_CB1_LOW_TO_HIGH(c)) || (!new_ca1 && M6522_PCR_CB1_HIGH_TO_LOW(c)));
-    c->pb.c2_triggered = (c->pb.c2_in != new_cb2) && ((new_cb2 && M6522_PCR_CB2_LOW_TO_HIGH(c)) || (!new_ca2 && M6522_PCR_CB2_HIGH_TO_LOW(c)));
+    c->pb.c1_triggered = (c->pb.c1_in != new_cb1) && ((new_cb1 && M6522_PCR_CB1_LOW_TO_HIGH(c)) || (!new_cb1 && M6522_PCR_CB1_HIGH_TO_LOW(c)));
+    c->pb.c2_triggered = (c->pb.c2_in != new_cb2) && ((new_cb2 && M6522_PCR_CB2_LOW_TO_HIGH(c)) || (!new_cb2 && M6522_PCR_CB2_HIGH_TO_LOW(c)));
     c->pa.c1_in = new_ca1;
-    c->pa.c2_in = new_cb2;
+    c->pa.c2_in = new_ca2;
     c->pb.c1_in = new_cb1;
     c->pb.c2_in = new_cb2;
 
@@ -471,7 +504,7 @@ static inline void _m6522_read_port_pins(m6522_t* c, uint64_t pins) {
     }
 }
 
-static inline uint8_t _m6522_merge_pb7(m6522_t* c, uint8_t data) {
+static inline uint8_t _m6522_merge_pb7(const m6522_t* c, uint8_t data) {
     if (M6522_ACR_T1_SET_PB7(c)) {
         data &= ~(1<<7);
         if (c->t1.t_bit) {
@@ -895,4 +928,102 @@ uint64_t m6522_tick(m6522_t* c, uint64_t pins) {
     return pins;
 }
 
+/* T2 decrements in each steady-state tick? */
+static bool _m6522_t2_counting(const m6522_t* c, uint64_t pins) {
+    if (M6522_ACR_T2_COUNT_PB6(c)) {
+        return 0 != (M6522_PB6 & (~pins & (pins ^ c->pins)));
+    }
+    else {
+        return _M6522_PIP_TEST(c->t2.pip, M6522_PIP_TIMER_COUNT, 0);
+    }
+}
+
+/* the output pins a tick would produce in steady state */
+static uint64_t _m6522_steady_pins(const m6522_t* c, uint64_t pins) {
+    const uint8_t pa = (c->pa.inpr & ~c->pa.ddr) | (c->pa.outr & c->pa.ddr);
+    const uint8_t pb = _m6522_merge_pb7(c, (c->pb.inpr & ~c->pb.ddr) | (c->pb.outr & c->pb.ddr));
+    M6522_SET_PAB(pins, pa, pb);
+    pins &= ~(M6522_CA1|M6522_CA2|M6522_CB1|M6522_CB2|M6522_IRQ);
+    if (c->pa.c1_out) { pins |= M6522_CA1; }
+    if (c->pa.c2_out) { pins |= M6522_CA2; }
+    if (c->pb.c1_out) { pins |= M6522_CB1; }
+    if (c->pb.c2_out) { pins |= M6522_CB2; }
+    if (c->intr.ifr & (1<<7)) { pins |= M6522_IRQ; }
+    return pins;
+}
+
+/*
+    A tick is 'steady' when the only thing it changes are the counters of
+    running timers: no edge on the control lines, the input registers already
+    hold the input pins, the delay pipelines are in their fed state, no timer
+    underflow is in flight, and the pins and interrupt flags are settled.
+*/
+static bool _m6522_steady(const m6522_t* c, uint64_t pins) {
+    if (c->pa.c1_triggered || c->pa.c2_triggered || c->pb.c1_triggered || c->pb.c2_triggered) {
+        return false;
+    }
+    if ((c->pa.c1_in != (0 != (pins & M6522_CA1))) ||
+        (c->pa.c2_in != (0 != (pins & M6522_CA2))) ||
+        (c->pb.c1_in != (0 != (pins & M6522_CB1))) ||
+        (c->pb.c2_in != (0 != (pins & M6522_CB2))))
+    {
+        return false;
+    }
+    if (!M6522_ACR_PA_LATCH_ENABLE(c) && (c->pa.inpr != M6522_GET_PA(pins))) {
+        return false;
+    }
+    if (!M6522_ACR_PB_LATCH_ENABLE(c) && (c->pb.inpr != M6522_GET_PB(pins))) {
+        return false;
+    }
+    if ((c->t1.pip != 3) || (c->t2.pip != 3) || c->t1.t_out || c->t2.t_out) {
+        return false;
+    }
+    const bool irq = 0 != (c->intr.ifr & c->intr.ier);
+    if (c->intr.pip != (irq ? 1 : 0)) {
+        return false;
+    }
+    if (irq && (0 == (c->intr.ifr & (1<<7)))) {
+        return false;
+    }
+    if ((c->pa.pins != M6522_GET_PA(c->pins)) || (c->pb.pins != M6522_GET_PB(c->pins))) {
+        return false;
+    }
+    return c->pins == _m6522_steady_pins(c, pins);
+}
+
+uint32_t m6522_next_event(const m6522_t* c, uint64_t pins) {
+    CHIPS_ASSERT(c);
+    if (!_m6522_steady(c, pins)) {
+        return 0;
+    }
+    /* a counter underflows in the tick after it reached zero */
+    uint32_t num_ticks = c->t1.counter;
+    if (_m6522_t2_counting(c, pins) && (c->t2.counter < num_ticks)) {
+        num_ticks = c->t2.counter;
+    }
+    return num_ticks;
+}
+
+uint64_t m6522_advance(m6522_t* c, uint64_t pins, uint32_t num_ticks) {
+    CHIPS_ASSERT(c);
+    while (num_ticks > 0) {
+        uint32_t skip = m6522_next_event(c, pins);
+        if (skip > 0) {
+            if (skip > num_ticks) {
+                skip = num_ticks;
+            }
+            c->t1.counter = (uint16_t)(c->t1.counter - skip);
+            if (_m6522_t2_counting(c, pins)) {
+                c->t2.counter = (uint16_t)(c->t2.counter - skip);
+            }
+            num_ticks -= skip;
+        }
+        else {
+            c->pins = _m6522_tick(c, pins);
+            num_ticks--;
+        }
+    }
+    return c->pins;
+}
+
 #endif /* CHIPS_IMPL */
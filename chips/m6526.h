@@ -48,6 +48,30 @@
     - https://ist.uwaterloo.ca/~schepers/MJK/cia6526.html
     - https://ist.uwaterloo.ca/~schepers/MJK/cia6526.html
 
+    ## Skipping ahead
+
+    Instead of calling m6526_tick() for every clock cycle, a system
+    emulator can skip over cycles where the CIA doesn't do anything
+    observable except decrementing running timers:
+
+    ~~~C
+    uint32_t m6526_next_event(const m6526_t* c)
+    ~~~
+        Returns the number of ticks until the next observable event (a timer
+        underflow, IRQ pin change or pending delay-pipeline state change). Zero
+        means the next tick must be performed with m6526_tick() or m6526_advance(),
+        and UINT32_MAX means that nothing will happen until the CIA is accessed.
+
+    ~~~C
+    void m6526_advance(m6526_t* c, uint32_t num_ticks)
+    ~~~
+        Advance the CIA by num_ticks cycles without a register access. The
+        input pins are assumed to be unchanged since the last call to
+        m6526_tick(). Steady stretches are skipped in a single step, only the
+        cycles around events are ticked individually. The resulting state is
+        identical to calling m6526_tick() num_ticks times with the last input
+        pins (and CS inactive).
+
     TODO: Documentation
 
     ## zlib/libpng license
@@ -272,6 +296,10 @@ void m6526_init(m6526_t* c);
 void m6526_reset(m6526_t* c);
 // tick the m6526_t instance
 uint64_t m6526_tick(m6526_t* c, uint64_t pins);
+// return number of ticks until next observable event (0: must tick, UINT32_MAX: no event pending)
+uint32_t m6526_next_event(const m6526_t* c);
+// advance the m6526_t instance by a number of ticks without register access and with unchanged input pins
+void m6526_advance(m6526_t* c, uint32_t num_ticks);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -559,8 +587,8 @@ static void _m6526_tick_pipeline(m6526_t* c) {
     c->intr.pip = (c->intr.pip >> 1) & 0x7F7F7F7F;
 }
 
-static uint64_t _m6526_tick(m6526_t* c, uint64_t pins) {
-    _m6526_read_port_pins(c, pins);
+/* tick the chip state, without latching the port input pins */
+static uint64_t _m6526_tick_state(m6526_t* c, uint64_t pins) {
     _m6526_tick_timer(&c->ta);
     _m6526_tick_timer(&c->tb);
     pins = _m6526_update_irq(c, pins);
@@ -569,6 +597,11 @@ static uint64_t _m6526_tick(m6526_t* c, uint64_t pins) {
     return pins;
 }
 
+static uint64_t _m6526_tick(m6526_t* c, uint64_t pins) {
+    _m6526_read_port_pins(c, pins);
+    return _m6526_tick_state(c, pins);
+}
+
 static inline void _m6526_write_cr(m6526_timer_t* t, uint8_t data) {
     /* if the start bit goes from 0 to 1, set the current toggle-bit-state to 1 */
     if (!M6526_TIMER_STARTED(t->cr) && M6526_TIMER_STARTED(data)) {
@@ -683,4 +716,92 @@ uint64_t m6526_tick(m6526_t* c, uint64_t pins) {
     return pins;
 }
 
+/*--- skip-ahead implementation ---*/
+
+/* timer A and B are decremented every tick when started in PHI2 input mode
+   (in the other input modes they only count on events)
+*/
+static inline bool _m6526_ta_counting(const m6526_t* c) {
+    return M6526_TIMER_STARTED(c->ta.cr) && M6526_TA_INMODE_PHI2(c->ta.cr);
+}
+
+static inline bool _m6526_tb_counting(const m6526_t* c) {
+    return M6526_TIMER_STARTED(c->tb.cr) && M6526_TB_INMODE_PHI2(c->tb.cr);
+}
+
+/* check if a timer's delay pipelines have settled, in a steady state
+   the 'counter active' pipeline is either completely filled or empty, the
+   'oneshot' pipeline only has the output bit set in oneshot mode, and
+   no reload is pending
+*/
+static bool _m6526_timer_steady(const m6526_timer_t* t, bool counting) {
+    const uint32_t pip_count = counting ? 3 : 0;
+    const uint32_t pip_oneshot = M6526_RUNMODE_ONESHOT(t->cr) ? 1 : 0;
+    const uint32_t pip = (pip_oneshot << M6526_PIP_TIMER_ONESHOT) | (pip_count << M6526_PIP_TIMER_COUNT);
+    return !t->t_out && !M6526_FORCE_LOAD(t->cr) && (t->pip == pip);
+}
+
+uint32_t m6526_next_event(const m6526_t* c) {
+    CHIPS_ASSERT(c);
+    const bool ta_counting = _m6526_ta_counting(c);
+    const bool tb_counting = _m6526_tb_counting(c);
+    if (!_m6526_timer_steady(&c->ta, ta_counting) || !_m6526_timer_steady(&c->tb, tb_counting)) {
+        return 0;
+    }
+    /* the interrupt state is steady if no mask update, FLAG edge or ICR read
+       is pending, and a pending interrupt condition has already reached the
+       main interrupt bit
+    */
+    const bool irq_pending = 0 != (c->intr.icr & c->intr.imr);
+    if ((c->intr.imr != c->intr.imr1) || (c->intr.flag != (0 != (c->pins & M6526_FLAG)))) {
+        return 0;
+    }
+    if (c->intr.pip != (irq_pending ? (1U << M6526_PIP_IRQ) : 0)) {
+        return 0;
+    }
+    if (irq_pending && (0 == (c->intr.icr & (1<<7)))) {
+        return 0;
+    }
+    /* a running timer underflows in the tick where the counter reaches zero */
+    uint32_t num_ticks = UINT32_MAX;
+    if (ta_counting) {
+        if (0 == c->ta.counter) {
+            return 0;
+        }
+        num_ticks = c->ta.counter - 1;
+    }
+    if (tb_counting) {
+        if (0 == c->tb.counter) {
+            return 0;
+        }
+        if ((uint32_t)(c->tb.counter - 1) < num_ticks) {
+            num_ticks = c->tb.counter - 1;
+        }
+    }
+    return num_ticks;
+}
+
+void m6526_advance(m6526_t* c, uint32_t num_ticks) {
+    CHIPS_ASSERT(c);
+    while (num_ticks > 0) {
+        uint32_t skip = m6526_next_event(c);
+        if (skip > 0) {
+            if (skip > num_ticks) {
+                skip = num_ticks;
+            }
+            if (_m6526_ta_counting(c)) {
+                c->ta.counter -= (uint16_t)skip;
+            }
+            if (_m6526_tb_counting(c)) {
+                c->tb.counter -= (uint16_t)skip;
+            }
+            num_ticks -= skip;
+        }
+        else {
+            c->pins = _m6526_tick_state(c, c->pins);
+            num_ticks--;
+        }
+    }
+}
+
 #endif /* CHIPS_IMPL */
@@ -208,13 +208,13 @@ typedef struct {
     uint8_t volume;
     int sample_period;
     int sample_counter;
-    float sample_accum;
-    float sample_accum_count;
-    float sample_mag;
-    float sample;
-    float dcadj_sum;
+    chips_audio_accum_t sample_accum;
+    chips_audio_accum_t sample_accum_count;
+    chips_audio_accum_t sample_mag;
+    chips_audio_sample_t sample;
+    chips_audio_accum_t dcadj_sum;
     uint32_t dcadj_pos;
-    float dcadj_buf[M6561_DCADJ_BUFLEN];
+    chips_audio_accum_t dcadj_buf[M6561_DCADJ_BUFLEN];
 } m6561_sound_t;
 
 // the m6561_t state struct
@@ -320,7 +320,7 @@ void m6561_init(m6561_t* vic, const m6561_desc_t* desc) {
     vic->user_data = desc->user_data;
     vic->sound.sample_period = (desc->tick_hz * _M6561_FIXEDPOINT_SCALE) / desc->sound_hz;
     vic->sound.sample_counter = vic->sound.sample_period;
-    vic->sound.sample_mag = desc->sound_magnitude;
+    vic->sound.sample_mag = CHIPS_AUDIO_VOLUME(desc->sound_magnitude);
     vic->sound.noise.shift = 0x7FFFFC;
 }
 
@@ -550,7 +550,13 @@ static void _m6561_tick_video(m6561_t* vic) {
 
 /*--- audio engine code ---*/
 #define _M6561_BIT(val,bitnr) ((val>>bitnr)&1)
-static inline float _m6561_noise_ampl(uint32_t noise_shift) {
+/* a voice at full amplitude, in fixed point mode 256 is 1.0 */
+#if defined(CHIPS_AUDIO_INT16)
+#define _M6561_AMPL_ONE (256)
+#else
+#define _M6561_AMPL_ONE (1.0f)
+#endif
+static inline chips_audio_accum_t _m6561_noise_ampl(uint32_t noise_shift) {
     uint32_t amp = (_M6561_BIT(noise_shift,22)<<7) |
                    (_M6561_BIT(noise_shift,20)<<6) |
                    (_M6561_BIT(noise_shift,16)<<5) |
@@ -559,11 +565,15 @@ static inline float _m6561_noise_ampl(uint32_t noise_shift) {
                    (_M6561_BIT(noise_shift,7)<<2) |
                    (_M6561_BIT(noise_shift,4)<<1) |
                    (_M6561_BIT(noise_shift,2)<<0);
-    return ((float)amp) / 256.0f;
+    #if defined(CHIPS_AUDIO_INT16)
+        return (chips_audio_accum_t)amp;
+    #else
+        return ((float)amp) / 256.0f;
+    #endif
 }
 
 /* center positive volume value around zero */
-static inline float _m6561_dcadjust(m6561_sound_t* snd, float s) {
+static inline chips_audio_accum_t _m6561_dcadjust(m6561_sound_t* snd, chips_audio_accum_t s) {
     snd->dcadj_sum -= snd->dcadj_buf[snd->dcadj_pos];
     snd->dcadj_sum += s;
     snd->dcadj_buf[snd->dcadj_pos] = s;
@@ -585,7 +595,7 @@ static uint64_t _m6561_tick_audio(m6561_t* vic, uint64_t pins) {
             voice->count--;
         }
         if (voice->bit && voice->enabled) {
-            snd->sample_accum += 1.0f;
+            snd->sample_accum += _M6561_AMPL_ONE;
         }
     }
     /* tick noice channel */
@@ -608,16 +618,21 @@ static uint64_t _m6561_tick_audio(m6561_t* vic, uint64_t pins) {
             snd->sample_accum += _m6561_noise_ampl(noise->shift);
         }
     }
-    snd->sample_accum_count += 1.0f;
+    snd->sample_accum_count += 1;
 
     /* output a new sample */
     snd->sample_counter -= _M6561_FIXEDPOINT_SCALE;
     if (snd->sample_counter <= 0) {
         snd->sample_counter += snd->sample_period;
-        float sm = (snd->sample_accum / snd->sample_accum_count) * (snd->volume / 15.0f);
-        snd->sample_accum = 0.0f;
-        snd->sample_accum_count = 0.0f;
-        snd->sample = _m6561_dcadjust(snd, sm) * snd->sample_mag;
+        #if defined(CHIPS_AUDIO_INT16)
+            // scale from 8-bit to 15-bit amplitude
+            chips_audio_accum_t sm = (((snd->sample_accum << 7) / snd->sample_accum_count) * snd->volume) / 15;
+        #else
+            float sm = (snd->sample_accum / snd->sample_accum_count) * (snd->volume / 15.0f);
+        #endif
+        snd->sample_accum = 0;
+        snd->sample_accum_count = 0;
+        snd->sample = chips_audio_clamp(chips_audio_scale(_m6561_dcadjust(snd, sm), snd->sample_mag));
         pins |= M6561_SAMPLE;
     }
     else {
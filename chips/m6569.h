@@ -298,6 +298,7 @@ typedef struct {
 // the m6569 state structure
 typedef struct {
     bool debug_vis;             // toggle this to switch debug visualization on/off
+    bool skip_decode;           // toggle this to skip decoding pixels into the framebuffer (e.g. in warp mode)
     m6569_registers_t reg;
     m6569_crt_t crt;
     m6569_border_unit_t brd;
@@ -1604,7 +1605,9 @@ static uint64_t _m6569_tick(m6569_t* vic, uint64_t pins) {
         _m6569_decode_pixels_debug(vic, g_data, 0 != (pins & M6569_BA), dst);
     }
     else if ((vic->crt.x >= vic->crt.vis_x0) && (vic->crt.x < vic->crt.vis_x1) &&
-             (vic->crt.y >= vic->crt.vis_y0) && (vic->crt.y < vic->crt.vis_y1))
+             (vic->crt.y >= vic->crt.vis_y0) && (vic->crt.y < vic->crt.vis_y1) &&
+             // sprite-data collisions are detected in the pixel decoder, so only skip when no sprites are visible
+             !(vic->skip_decode && (0 == vic->sunit.disp_enabled)))
     {
         const size_t x = vic->crt.x - vic->crt.vis_x0;
         const size_t y = vic->crt.y - vic->crt.vis_y0;
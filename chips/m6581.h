@@ -36,6 +36,9 @@
     The emulation has an additional "virtual pin" which is set to active
     whenever a new sample is ready (M6581_SAMPLE).
 
+    Include chips/chips_common.h before this header (for the audio
+    sample type, see CHIPS_AUDIO_INT16).
+
     ## Links
 
     - http://blog.kevtris.org/?p=13
@@ -170,6 +173,7 @@ typedef struct {
     int tick_hz;        // frequency at which m6581_tick() will be called in Hz
     int sound_hz;       // sound sample frequency
     float magnitude;    // output sample magnitude (0=silence to 1=max volume)
+    bool voice_samples; // if true, also output per-voice samples in m6581_t.voice_sample[]
 } m6581_desc_t;
 
 // envelope generator state
@@ -234,10 +238,14 @@ typedef struct {
     // sample generation state
     int sample_period;
     int sample_counter;
-    float sample_accum;
-    float sample_accum_count;
-    float sample_mag;
-    float sample;
+    chips_audio_accum_t sample_accum;
+    chips_audio_accum_t sample_accum_count;
+    chips_audio_accum_t sample_mag;
+    chips_audio_sample_t sample;
+    // optional per-voice output (pre-filter, see m6581_desc_t.voice_samples)
+    bool voice_samples;
+    chips_audio_accum_t voice_accum[3];
+    chips_audio_sample_t voice_sample[3];
     // debug inspection
     uint64_t pins;
 } m6581_t;
@@ -269,6 +277,13 @@ uint64_t m6581_tick(m6581_t* sid, uint64_t pins);
 #define M6581_GET_DATA(p) ((uint8_t)(((p)&0xFF0000ULL)>>16))
 /* merge 8-bit data bus value into 64-bit pins */
 #define M6581_SET_DATA(p,d) {p=(((p)&~0xFF0000ULL)|(((d)<<16)&0xFF0000ULL));}
+/* convert internal sample value (16384 == 1.0) to audio sample range */
+#if defined(CHIPS_AUDIO_INT16)
+#define _M6581_SAMPLE(s) ((s) * 2)
+#else
+#define _M6581_SAMPLE(s) ((s) / 16384.0f)
+#endif
+
 /* fixed point precision for sample period */
 #define M6581_FIXEDPOINT_SCALE (16)
 /* move bit into first position */
@@ -337,8 +352,9 @@ void m6581_init(m6581_t* sid, const m6581_desc_t* desc) {
     sid->sound_hz = desc->sound_hz;
     sid->sample_period = (desc->tick_hz * M6581_FIXEDPOINT_SCALE) / desc->sound_hz;
     sid->sample_counter = sid->sample_period;
-    sid->sample_mag = desc->magnitude;
-    sid->sample_accum_count = 1.0f;
+    sid->sample_mag = CHIPS_AUDIO_VOLUME(desc->magnitude);
+    sid->sample_accum_count = 1;
+    sid->voice_samples = desc->voice_samples;
     for (int i = 0; i < 3; i++) {
         _m6581_init_voice(&sid->voice[i]);
     }
@@ -355,9 +371,13 @@ void m6581_reset(m6581_t* sid) {
     }
     _m6581_init_filter(&sid->filter, sid->sound_hz);
     sid->sample_counter = sid->sample_period;
-    sid->sample = 0.0f;
-    sid->sample_accum = 0.0f;
-    sid->sample_accum_count = 1.0f;
+    sid->sample = 0;
+    sid->sample_accum = 0;
+    sid->sample_accum_count = 1;
+    for (int i = 0; i < 3; i++) {
+        sid->voice_accum[i] = 0.0f;
+        sid->voice_sample[i] = 0;
+    }
     sid->pins = 0;
 }
 
@@ -664,35 +684,52 @@ static uint64_t _m6581_tick(m6581_t* sid, uint64_t pins) {
     /* filter */
     int sum_filtered_outp = 0;
     int sum_outp = 0;
+    int voice_outp[3];
     for (int i = 0; i < 3; i++) {
         m6581_voice_t* v = &sid->voice[i];
         int wav_out = (int) v->wav_output;
         int env_out = (int) v->env_cur_level;
         if (sid->filter.voices & (1<<i)) {
-            sum_filtered_outp += (wav_out - M6581_DCWAVE) * env_out + M6581_DCVOICE;
+            voice_outp[i] = (wav_out - M6581_DCWAVE) * env_out + M6581_DCVOICE;
+            sum_filtered_outp += voice_outp[i];
         }
         else {
             if (v->muted) {
-                sum_outp += (0 - M6581_DCWAVE) * env_out + M6581_DCVOICE;
+                voice_outp[i] = (0 - M6581_DCWAVE) * env_out + M6581_DCVOICE;
             }
             else {
-                sum_outp += (wav_out - M6581_DCWAVE) * env_out + M6581_DCVOICE;
+                voice_outp[i] = (wav_out - M6581_DCWAVE) * env_out + M6581_DCVOICE;
             }
+            sum_outp += voice_outp[i];
+        }
+    }
+    /* per-voice outputs are tapped before the filter stage since
+       the filter is shared between all voices
+    */
+    if (sid->voice_samples) {
+        for (int i = 0; i < 3; i++) {
+            sid->voice_accum[i] += _M6581_SAMPLE((voice_outp[i] * sid->filter.volume) / (1<<12));
         }
     }
     int accu = (sum_outp + _m6581_filter_output(&sid->filter, sum_filtered_outp) + M6581_DCMIXER) * sid->filter.volume;
     int sample = accu / (1<<12);
-    sid->sample_accum += (sample / 16384.0f);
-    sid->sample_accum_count += 1.0f;
+    sid->sample_accum += _M6581_SAMPLE(sample);
+    sid->sample_accum_count += 1;
 
     /* new sample? */
     sid->sample_counter -= M6581_FIXEDPOINT_SCALE;
     if (sid->sample_counter <= 0) {
         sid->sample_counter += sid->sample_period;
-        float s = sid->sample_accum / sid->sample_accum_count;
-        sid->sample = sid->sample_mag * s;
-        sid->sample_accum = 0.0f;
-        sid->sample_accum_count = 0.0f;
+        chips_audio_accum_t s = sid->sample_accum / sid->sample_accum_count;
+        sid->sample = chips_audio_clamp(chips_audio_scale(s, sid->sample_mag));
+        if (sid->voice_samples) {
+            for (int i = 0; i < 3; i++) {
+                sid->voice_sample[i] = chips_audio_clamp(chips_audio_scale(sid->voice_accum[i] / sid->sample_accum_count, sid->sample_mag));
+                sid->voice_accum[i] = 0;
+            }
+        }
+        sid->sample_accum = 0;
+        sid->sample_accum_count = 0;
         pins |= M6581_SAMPLE;
     }
     else {
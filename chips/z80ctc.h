@@ -94,6 +94,29 @@
         - **Z80CTC_INT**: if the CTC wants to request an interrupt
         - **Z80CTC_ZCTO0..ZCTO2**: when the channels 0..2 are in counter mode and the countdown reaches 0
         - **Z80CTC_IEIO**: enable or disable interrupts for daisychain downstream chips
+
+    ~~~C
+    uint8_t z80ctc_down_counter(const z80ctc_t* ctc, int chn_id)
+    ~~~
+        Returns the current down counter value of a channel. Use this
+        instead of reading z80ctc_channel_t.down_counter directly (see below).
+
+    ## Event Scheduling
+
+    Running timers are not decremented in each tick. Instead each channel
+    computes the tick at which its down counter will reach zero (in
+    z80ctc_channel_t.zero_tick), and z80ctc_tick() only touches a
+    timer channel when this tick is reached, or when the CPU accesses
+    the channel. The prescaler and down counter of a channel are only
+    brought up to date on demand (this means the 'prescaler' and
+    'down_counter' struct items may be stale while a timer is running).
+
+    Likewise, the CLKTRG pins are only checked for channels in counter
+    mode or waiting for a trigger, and the interrupt daisychain is only
+    evaluated while a channel has an interrupt needed, requested or
+    being serviced.
+
+    The results are identical to decrementing the timers in each tick.
 #*/
 /*
     zlib/libpng license
@@ -204,6 +227,9 @@ typedef struct {
     bool ext_trigger;
     uint8_t prescaler_mask;
     uint8_t int_state;
+    // event scheduling
+    uint64_t sync_tick;     // tick at which prescaler and down_counter were last updated
+    uint64_t zero_tick;     // tick at which the running timer reaches zero (or UINT64_MAX)
 } z80ctc_channel_t;
 
 #define Z80CTC_NUM_CHANNELS (4)
@@ -212,6 +238,9 @@ typedef struct {
 typedef struct {
     z80ctc_channel_t chn[Z80CTC_NUM_CHANNELS];
     uint64_t pins;
+    uint64_t tick;          // number of ticks since z80ctc_init()
+    uint64_t next_zero;     // earliest zero_tick of all channels
+    uint8_t trg_mask;       // channels which watch their CLKTRG pin
 } z80ctc_t;
 
 // extract 8-bit data bus from 64-bit pins
@@ -225,6 +254,8 @@ void z80ctc_init(z80ctc_t* ctc);
 void z80ctc_reset(z80ctc_t* ctc);
 // tick the CTC instance
 uint64_t z80ctc_tick(z80ctc_t* ctc, uint64_t pins);
+// get the current down counter value of a channel
+uint8_t z80ctc_down_counter(const z80ctc_t* ctc, int chn_id);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -266,6 +297,60 @@ void z80ctc_reset(z80ctc_t* ctc) {
         chn->trigger_edge = false;
         chn->prescaler_mask = 0x0F;
         chn->int_state = 0;
+        chn->sync_tick = ctc->tick;
+        chn->zero_tick = UINT64_MAX;
+    }
+    ctc->next_zero = UINT64_MAX;
+    ctc->trg_mask = 0;
+}
+
+// true if the channel is in timer mode and counting down
+static inline bool _z80ctc_timer_running(const z80ctc_channel_t* chn) {
+    return !chn->waiting_for_trigger && ((chn->control & (Z80CTC_CTRL_MODE|Z80CTC_CTRL_RESET|Z80CTC_CTRL_CONST_FOLLOWS)) == Z80CTC_CTRL_MODE_TIMER);
+}
+
+// number of ticks until the prescaler next wraps to zero
+static inline uint32_t _z80ctc_prescaler_ticks(const z80ctc_channel_t* chn) {
+    const uint32_t p = chn->prescaler & chn->prescaler_mask;
+    return p ? p : (uint32_t)chn->prescaler_mask + 1;
+}
+
+/*
+    bring the prescaler and down counter of a running timer up to date,
+    this never crosses the channel's zero_tick
+*/
+static void _z80ctc_sync_channel(z80ctc_channel_t* chn, uint64_t tick) {
+    if (_z80ctc_timer_running(chn) && (tick > chn->sync_tick)) {
+        const uint64_t num_ticks = tick - chn->sync_tick;
+        const uint64_t first = _z80ctc_prescaler_ticks(chn);
+        if (num_ticks >= first) {
+            const uint64_t num_decs = 1 + (num_ticks - first) / ((uint64_t)chn->prescaler_mask + 1);
+            chn->down_counter = (uint8_t)(chn->down_counter - num_decs);
+        }
+        chn->prescaler = (uint8_t)(chn->prescaler - num_ticks);
+    }
+    chn->sync_tick = tick;
+}
+
+// recompute the zero tick of an up-to-date channel, and the CTC's event state
+static void _z80ctc_schedule(z80ctc_t* ctc, z80ctc_channel_t* chn) {
+    if (_z80ctc_timer_running(chn)) {
+        const uint64_t num_decs = chn->down_counter ? chn->down_counter : 256;
+        chn->zero_tick = chn->sync_tick + _z80ctc_prescaler_ticks(chn) + (num_decs - 1) * ((uint64_t)chn->prescaler_mask + 1);
+    }
+    else {
+        chn->zero_tick = UINT64_MAX;
+    }
+    ctc->next_zero = UINT64_MAX;
+    ctc->trg_mask = 0;
+    for (int i = 0; i < Z80CTC_NUM_CHANNELS; i++) {
+        const z80ctc_channel_t* c = &ctc->chn[i];
+        if (c->zero_tick < ctc->next_zero) {
+            ctc->next_zero = c->zero_tick;
+        }
+        if (c->waiting_for_trigger || (c->control & Z80CTC_CTRL_MODE) == Z80CTC_CTRL_MODE_COUNTER) {
+            ctc->trg_mask |= 1<<i;
+        }
     }
 }
 
@@ -367,13 +452,16 @@ uint64_t _z80ctc_write(z80ctc_t* ctc, uint64_t pins, int chn_id, uint8_t data) {
 // perform an CPU IO request on the CTC
 static uint64_t _z80ctc_iorq(z80ctc_t* ctc, uint64_t pins) {
     const int chn_id = (pins / Z80CTC_CS0) & 3;
+    z80ctc_channel_t* chn = &ctc->chn[chn_id];
+    _z80ctc_sync_channel(chn, ctc->tick);
     if (pins & Z80CTC_RD) {
-        const uint8_t data = ctc->chn[chn_id].down_counter;
+        const uint8_t data = chn->down_counter;
         Z80CTC_SET_DATA(pins, data);
     }
     else {
         const uint8_t data = Z80CTC_GET_DATA(pins);
         pins = _z80ctc_write(ctc, pins, chn_id, data);
+        _z80ctc_schedule(ctc, chn);
     }
     return pins;
 }
@@ -381,27 +469,40 @@ static uint64_t _z80ctc_iorq(z80ctc_t* ctc, uint64_t pins) {
 // internal tick function
 static uint64_t _z80ctc_tick(z80ctc_t* ctc, uint64_t pins) {
     pins &= ~(Z80CTC_ZCTO0|Z80CTC_ZCTO1|Z80CTC_ZCTO2);
-    for (int chn_id = 0; chn_id < Z80CTC_NUM_CHANNELS; chn_id++) {
-        z80ctc_channel_t* chn = &ctc->chn[chn_id];
-
-        // check if externally triggered
-        if (chn->waiting_for_trigger || (chn->control & Z80CTC_CTRL_MODE) == Z80CTC_CTRL_MODE_COUNTER) {
-            bool trg = 0 != (pins & (Z80CTC_CLKTRG0<<chn_id));
-            if (trg != chn->ext_trigger) {
-                chn->ext_trigger = trg;
-                /* rising/falling edge trigger */
-                if (chn->trigger_edge == trg) {
-                    pins = _z80ctc_active_edge(ctc, chn, pins, chn_id);
+    ctc->tick++;
+
+    // check channels in counter mode or waiting for a trigger for external triggers
+    if (ctc->trg_mask) {
+        for (int chn_id = 0; chn_id < Z80CTC_NUM_CHANNELS; chn_id++) {
+            if (ctc->trg_mask & (1<<chn_id)) {
+                z80ctc_channel_t* chn = &ctc->chn[chn_id];
+                bool trg = 0 != (pins & (Z80CTC_CLKTRG0<<chn_id));
+                if (trg != chn->ext_trigger) {
+                    chn->ext_trigger = trg;
+                    /* rising/falling edge trigger */
+                    if (chn->trigger_edge == trg) {
+                        chn->sync_tick = ctc->tick;
+                        const bool was_waiting = chn->waiting_for_trigger;
+                        pins = _z80ctc_active_edge(ctc, chn, pins, chn_id);
+                        if (was_waiting) {
+                            // the trigger may have started a timer
+                            _z80ctc_schedule(ctc, chn);
+                        }
+                    }
                 }
             }
         }
-        else if ((chn->control & (Z80CTC_CTRL_MODE|Z80CTC_CTRL_RESET|Z80CTC_CTRL_CONST_FOLLOWS)) == Z80CTC_CTRL_MODE_TIMER) {
-            // handle timer mode downcounting
-            if (0 == ((--chn->prescaler) & chn->prescaler_mask)) {
-                // prescaler has reached zero, tick the down counter
-                if (0 == --chn->down_counter) {
-                    pins = _z80ctc_counter_zero(ctc, chn, pins, chn_id);
-                }
+    }
+
+    // handle running timers reaching zero
+    if (ctc->tick == ctc->next_zero) {
+        for (int chn_id = 0; chn_id < Z80CTC_NUM_CHANNELS; chn_id++) {
+            z80ctc_channel_t* chn = &ctc->chn[chn_id];
+            if (chn->zero_tick == ctc->tick) {
+                _z80ctc_sync_channel(chn, ctc->tick);
+                CHIPS_ASSERT(0 == chn->down_counter);
+                pins = _z80ctc_counter_zero(ctc, chn, pins, chn_id);
+                _z80ctc_schedule(ctc, chn);
             }
         }
     }
@@ -473,9 +574,19 @@ uint64_t z80ctc_tick(z80ctc_t* ctc, uint64_t pins) {
         pins = _z80ctc_iorq(ctc, pins);
     }
     pins = _z80ctc_tick(ctc, pins);
-    pins = _z80ctc_int(ctc, pins);
+    // the daisychain only needs to be evaluated while an interrupt is in flight
+    if (ctc->chn[0].int_state | ctc->chn[1].int_state | ctc->chn[2].int_state | ctc->chn[3].int_state) {
+        pins = _z80ctc_int(ctc, pins);
+    }
     ctc->pins = pins;
     return pins;
 }
 
+uint8_t z80ctc_down_counter(const z80ctc_t* ctc, int chn_id) {
+    CHIPS_ASSERT(ctc && (chn_id >= 0) && (chn_id < Z80CTC_NUM_CHANNELS));
+    z80ctc_channel_t chn = ctc->chn[chn_id];
+    _z80ctc_sync_channel(&chn, ctc->tick);
+    return chn.down_counter;
+}
+
 #endif /* CHIPS_IMPL */
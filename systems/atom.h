@@ -67,12 +67,21 @@ extern "C" {
 #endif
 
 // bump snapshot version when memory layout of atom_t changes
-#define ATOM_SNAPSHOT_VERSION (1)
+#define ATOM_SNAPSHOT_VERSION (5)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    ATOM_PERF_CPU,    // 6502 CPU ticks
+    ATOM_PERF_VDG,    // MC6847 video ticks
+    ATOM_PERF_BEEPER, // beeper ticks and audio output
+    ATOM_PERF_PPI,    // i8255 PPI ticks
+    ATOM_PERF_VIA,    // VIA ticks
+    ATOM_PERF_NUM,
+};
 
 #define ATOM_FREQUENCY (1000000)
 #define ATOM_MAX_AUDIO_SAMPLES (1024)       // max number of audio samples in internal sample buffer
 #define ATOM_DEFAULT_AUDIO_SAMPLES (128)    // default number of samples in internal sample buffer
-#define ATOM_MAX_TAPE_SIZE (1<<16)          // max size of tape file in bytes
 
 // joystick emulation types
 typedef enum {
@@ -91,6 +100,7 @@ typedef enum {
 typedef struct {
     atom_joystick_type_t joystick_type;     // what joystick type to emulate, default is ATOM_JOYSTICK_NONE
     chips_debug_t debug;
+    chips_input_callback_t input;  // optional input recording callback (see util/movie.h)
     chips_audio_desc_t audio;
     struct {
         chips_range_t abasic;
@@ -107,8 +117,13 @@ typedef struct {
     m6522_t via;
     beeper_t beeper;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
     uint64_t pins;
     bool valid;
+    clk_t clk;
     int counter_2_4khz;
     int period_2_4khz;
     bool state_2_4khz;
@@ -123,7 +138,7 @@ typedef struct {
         chips_audio_callback_t callback;
         int num_samples;
         int sample_pos;
-        float sample_buffer[ATOM_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t sample_buffer[ATOM_MAX_AUDIO_SAMPLES];
     } audio;
     uint8_t ram[0xA000];
     uint8_t rom_abasic[0x2000];
@@ -132,9 +147,9 @@ typedef struct {
     alignas(64) uint8_t fb[MC6847_FRAMEBUFFER_SIZE_BYTES];
     // tape loading
     struct {
-        int size;  // tape_size is > 0 if a tape is inserted
-        int pos;
-        uint8_t buf[ATOM_MAX_TAPE_SIZE];
+        size_t size;  // tape_size is > 0 if a tape is inserted
+        size_t pos;
+        chips_tape_t data;  // the tape image (not part of snapshots)
     } tape;
 } atom_t;
 
@@ -148,6 +163,14 @@ void atom_reset(atom_t* sys);
 chips_display_info_t atom_display_info(atom_t* sys);
 // run Atom instance for a number of microseconds
 uint32_t atom_exec(atom_t* sys, uint32_t micro_seconds);
+// run Atom instance for an exact number of ticks, return number of ticks executed
+uint32_t atom_exec_ticks(atom_t* sys, uint32_t num_ticks);
+// run Atom instance until a number of audio samples has been generated, return number of ticks executed
+uint32_t atom_exec_samples(atom_t* sys, int num_samples);
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* atom_perf_counters(atom_t* sys);
+#endif
 // send a key down event
 void atom_key_down(atom_t* sys, int key_code);
 // send a key up event
@@ -158,14 +181,20 @@ void atom_set_joystick_type(atom_t* sys, atom_joystick_type_t type);
 atom_joystick_type_t atom_joystick_type(atom_t* sys);
 // set joystick mask (combination of ATOM_JOYSTICK_*)
 void atom_joystick(atom_t* sys, uint8_t mask);
-// insert a tape for loading (must be an Atom TAP file), data will be copied
-bool atom_insert_tape(atom_t* sys, chips_range_t data);
+// replay a recorded input event (see util/movie.h)
+void atom_input_event(atom_t* sys, const chips_input_event_t* event);
+// insert an Atom TAP file for loading from an external memory range or read callback (data is not copied)
+bool atom_insert_tape_source(atom_t* sys, const chips_tape_source_t* source);
 // remove tape
 void atom_remove_tape(atom_t* sys);
 // take snapshot, patches pointers to zero, returns snapshot version
 uint32_t atom_save_snapshot(atom_t* sys, atom_t* dst);
 // load snapshot, returns false if snapshot version doesn't match
 bool atom_load_snapshot(atom_t* sys, uint32_t version, atom_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks)
+uint64_t atom_state_hash(atom_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t atom_frame_hash(atom_t* sys);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -193,11 +222,17 @@ void atom_init(atom_t* sys, const atom_desc_t* desc) {
     if (desc->debug.callback.func) { CHIPS_ASSERT(desc->debug.stopped); }
     memset(sys, 0, sizeof(atom_t));
     sys->valid = true;
+    clk_init(&sys->clk, ATOM_FREQUENCY);
     sys->joystick_type = desc->joystick_type;
     sys->audio.callback = desc->audio.callback;
     sys->audio.num_samples = _ATOM_DEFAULT(desc->audio.num_samples, ATOM_DEFAULT_AUDIO_SAMPLES);
     CHIPS_ASSERT(sys->audio.num_samples <= ATOM_MAX_AUDIO_SAMPLES);
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[ATOM_PERF_NUM] = { "m6502", "mc6847", "beeper", "i8255", "m6522" };
+    chips_perf_init(&sys->perf, ATOM_PERF_NUM, perf_names);
+#endif
     sys->period_2_4khz = ATOM_FREQUENCY / 4800;
 
     // copy ROM fonts
@@ -250,7 +285,9 @@ void atom_reset(atom_t* sys) {
 
 uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
     // tick the CPU
+    CHIPS_PERF_BEGIN(&sys->perf, ATOM_PERF_CPU);
     cpu_pins = m6502_tick(&sys->cpu, cpu_pins);
+    CHIPS_PERF_END(&sys->perf, ATOM_PERF_CPU);
 
     // tick the 2.4khz counter
     sys->counter_2_4khz++;
@@ -260,6 +297,7 @@ uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
     }
 
     // update beeper
+    CHIPS_PERF_BEGIN(&sys->perf, ATOM_PERF_BEEPER);
     if (beeper_tick(&sys->beeper)) {
         // new audio sample ready
         sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->beeper.sample;
@@ -270,6 +308,7 @@ uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
             sys->audio.sample_pos = 0;
         }
     }
+    CHIPS_PERF_END(&sys->perf, ATOM_PERF_BEEPER);
 
     // address decoding
     const uint16_t addr = M6502_GET_ADDR(cpu_pins);
@@ -362,7 +401,9 @@ uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
         if (0 == (sys->vdg.pins & MC6847_FS)) {
             ppi_pins |= I8255_PC7;
         }
+        CHIPS_PERF_BEGIN(&sys->perf, ATOM_PERF_PPI);
         ppi_pins = i8255_tick(&sys->ppi, ppi_pins);
+        CHIPS_PERF_END(&sys->perf, ATOM_PERF_PPI);
         const uint16_t kbd_column = 1<<(I8255_GET_PA(ppi_pins) & 0x0F);
         kbd_set_active_columns(&sys->kbd, kbd_column);
         if (ppi_pins & I8255_PA4) { vdg_pins |= MC6847_AG; }
@@ -380,7 +421,9 @@ uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
 
     // tick the VIA
     {
+        CHIPS_PERF_BEGIN(&sys->perf, ATOM_PERF_VIA);
         via_pins = m6522_tick(&sys->via, via_pins);
+        CHIPS_PERF_END(&sys->perf, ATOM_PERF_VIA);
         if ((via_pins & (M6522_RW|M6522_CS1)) == (M6522_RW|M6522_CS1)) {
             cpu_pins = M6502_COPY_DATA(cpu_pins, via_pins);
         }
@@ -391,7 +434,9 @@ uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
        to the VIA, but we can get this directly from sys->vdg.pins,
        so no point in looking at the returned pin mask
     */
+    CHIPS_PERF_BEGIN(&sys->perf, ATOM_PERF_VDG);
     mc6847_tick(&sys->vdg, vdg_pins);
+    CHIPS_PERF_END(&sys->perf, ATOM_PERF_VDG);
 
     /* check if the trapped OSLoad function was hit to implement tape file loading
         http://ladybug.xs4all.nl/arlet/fpga/6502/kernel.dis
@@ -406,28 +451,68 @@ uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
     return cpu_pins;
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _atom_debug_event(atom_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && (0 != (pins & M6502_SYNC))) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && (0 == (pins & M6502_RW))) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (M6502_IRQ|M6502_NMI))));
+}
+
 uint32_t atom_exec(atom_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    uint32_t num_ticks = clk_us_to_ticks(ATOM_FREQUENCY, micro_seconds);
+    return atom_exec_ticks(sys, clk_advance_us(&sys->clk, micro_seconds));
+}
+
+// run for max_ticks, or until num_samples audio samples have been generated (-1 for no limit), return executed ticks
+static uint32_t _atom_exec(atom_t* sys, uint32_t max_ticks, int num_samples) {
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->audio.sample_pos;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug hook
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
+        while ((num_ticks < max_ticks) && (num_samples != 0)) {
             pins = _atom_tick(sys, pins);
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     else {
-        // run with debug hook]
-        for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
+        // run with debug hook in each tick, or only on requested events
+        while ((num_ticks < max_ticks) && (num_samples != 0) && !(*sys->debug.stopped)) {
             pins = _atom_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_atom_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     sys->pins = pins;
+    const uint32_t micro_seconds = clk_ticks_to_us(ATOM_FREQUENCY, num_ticks);
     kbd_update(&sys->kbd, micro_seconds);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, 0);
     return num_ticks;
 }
 
+uint32_t atom_exec_ticks(atom_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return _atom_exec(sys, num_ticks, -1);
+}
+
+uint32_t atom_exec_samples(atom_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->audio.num_samples > 1));
+    // the fractional tick remainder is carried across calls in the sound chip's sample counter
+    return _atom_exec(sys, UINT32_MAX, (num_samples > 0) ? num_samples : 0);
+}
+
 uint64_t _atom_vdg_fetch(uint64_t pins, void* user_data) {
     atom_t* sys = (atom_t*) user_data;
     const uint16_t addr = MC6847_GET_ADDR(pins);
@@ -449,6 +534,7 @@ uint64_t _atom_vdg_fetch(uint64_t pins, void* user_data) {
 
 void atom_key_down(atom_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_DOWN, (uint32_t)key_code, 0);
     switch (sys->joystick_type) {
         case ATOM_JOYSTICKTYPE_NONE:
             kbd_key_down(&sys->kbd, key_code);
@@ -468,6 +554,7 @@ void atom_key_down(atom_t* sys, int key_code) {
 
 void atom_key_up(atom_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_UP, (uint32_t)key_code, 0);
     switch (sys->joystick_type) {
         case ATOM_JOYSTICKTYPE_NONE:
             kbd_key_up(&sys->kbd, key_code);
@@ -487,6 +574,7 @@ void atom_key_up(atom_t* sys, int key_code) {
 
 void atom_set_joystick_type(atom_t* sys, atom_joystick_type_t type) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK_TYPE, (uint32_t)type, 0);
     sys->joystick_type = type;
 }
 
@@ -497,9 +585,22 @@ atom_joystick_type_t atom_joystick_type(atom_t* sys) {
 
 void atom_joystick(atom_t* sys, uint8_t mask) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK, mask, 0);
     sys->joy_joymask = mask;
 }
 
+void atom_input_event(atom_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: atom_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_KEY_DOWN: atom_key_down(sys, (int)event->a); break;
+        case CHIPS_INPUT_KEY_UP: atom_key_up(sys, (int)event->a); break;
+        case CHIPS_INPUT_JOYSTICK: atom_joystick(sys, (uint8_t)event->a); break;
+        case CHIPS_INPUT_JOYSTICK_TYPE: atom_set_joystick_type(sys, (atom_joystick_type_t)event->a); break;
+        default: break;
+    }
+}
+
 static void _atom_init_keymap(atom_t* sys) {
     /*  setup the keyboard matrix
         the Atom has a 10x8 keyboard matrix, where the
@@ -583,22 +684,25 @@ typedef struct {
     uint16_t length;
 } _atom_tap_header;
 
-bool atom_insert_tape(atom_t* sys, chips_range_t data) {
-    CHIPS_ASSERT(sys && sys->valid);
-    CHIPS_ASSERT(data.ptr);
+bool atom_insert_tape_source(atom_t* sys, const chips_tape_source_t* source) {
+    CHIPS_ASSERT(sys && sys->valid && source);
     atom_remove_tape(sys);
+    if (!chips_tape_insert(&sys->tape.data, source)) {
+        return false;
+    }
     // check for valid size
-    if ((data.size < sizeof(_atom_tap_header)) || (data.size > ATOM_MAX_TAPE_SIZE)) {
+    if (sys->tape.data.size < sizeof(_atom_tap_header)) {
+        chips_tape_remove(&sys->tape.data);
         return false;
     }
-    memcpy(sys->tape.buf, data.ptr, data.size);
     sys->tape.pos = 0;
-    sys->tape.size = data.size;
+    sys->tape.size = sys->tape.data.size;
     return true;
 }
 
 void atom_remove_tape(atom_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_tape_remove(&sys->tape.data);
     sys->tape.pos = 0;
     sys->tape.size = 0;
 }
@@ -649,18 +753,19 @@ uint64_t _atom_osload(atom_t* sys, uint64_t pins) {
     uint16_t exec_addr = 0;
     if ((sys->tape.size > 0) && (sys->tape.pos < sys->tape.size)) {
         /* read next tape chunk */
-        if ((int)(sys->tape.pos + sizeof(_atom_tap_header)) < sys->tape.size) {
-            const _atom_tap_header* hdr = (const _atom_tap_header*) &sys->tape.buf[sys->tape.pos];
+        if ((sys->tape.pos + sizeof(_atom_tap_header)) < sys->tape.size) {
+            _atom_tap_header hdr;
+            chips_tape_read(&sys->tape.data, sys->tape.pos, &hdr, sizeof(hdr));
             sys->tape.pos += sizeof(_atom_tap_header);
-            exec_addr = hdr->exec_addr;
-            uint16_t addr = hdr->load_addr;
+            exec_addr = hdr.exec_addr;
+            uint16_t addr = hdr.load_addr;
             /* override file load address? */
             if (mem_rd(&sys->mem, 0xCD) & 0x80) {
                 addr = mem_rd16(&sys->mem, 0xCB);
             }
-            if ((sys->tape.pos + hdr->length) <= sys->tape.size) {
-                for (int i = 0; i < hdr->length; i++) {
-                    mem_wr(&sys->mem, addr++, sys->tape.buf[sys->tape.pos++]);
+            if ((sys->tape.pos + hdr.length) <= sys->tape.size) {
+                for (int i = 0; i < hdr.length; i++) {
+                    mem_wr(&sys->mem, addr++, chips_tape_byte(&sys->tape.data, sys->tape.pos++));
                 }
                 success = true;
             }
@@ -697,6 +802,13 @@ uint64_t _atom_osload(atom_t* sys, uint64_t pins) {
     return pins;
 }
 
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* atom_perf_counters(atom_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t atom_display_info(atom_t* sys) {
     const chips_display_info_t res = {
         .frame = {
@@ -730,10 +842,15 @@ uint32_t atom_save_snapshot(atom_t* sys, atom_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     m6502_snapshot_onsave(&dst->cpu);
     mc6847_snapshot_onsave(&dst->vdg);
     mem_snapshot_onsave(&dst->mem, sys);
+    chips_tape_snapshot_onsave(&dst->tape.data);
     return ATOM_SNAPSHOT_VERSION;
 }
 
@@ -745,12 +862,62 @@ bool atom_load_snapshot(atom_t* sys, uint32_t version, atom_t* src) {
     static atom_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     m6502_snapshot_onload(&im.cpu, &sys->cpu);
     mc6847_snapshot_onload(&im.vdg, &sys->vdg);
     mem_snapshot_onload(&im.mem, sys);
+    chips_tape_snapshot_onload(&im.tape.data, &sys->tape.data);
+    // only the tape position is part of the snapshot, keep the current tape
+    im.tape.size = sys->tape.size;
     *sys = im;
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by atom_init())
+#define _ATOM_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t atom_state_hash(atom_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping host pointers, callbacks, the exec clock (which
+    // only tracks fractions of atom_exec() calls) and the fixed memory mapping
+    m6502_t cpu;
+    memcpy(&cpu, &sys->cpu, sizeof(cpu));
+    m6502_snapshot_onsave(&cpu);
+    uint64_t h = _ATOM_HASH(0, cpu);
+    mc6847_t vdg;
+    memcpy(&vdg, &sys->vdg, sizeof(vdg));
+    mc6847_snapshot_onsave(&vdg);
+    h = _ATOM_HASH(h, vdg);
+    h = _ATOM_HASH(h, sys->ppi);
+    h = _ATOM_HASH(h, sys->via);
+    h = _ATOM_HASH(h, sys->beeper);
+    h = _ATOM_HASH(h, sys->pins);
+    h = _ATOM_HASH(h, sys->counter_2_4khz);
+    h = _ATOM_HASH(h, sys->period_2_4khz);
+    h = _ATOM_HASH(h, sys->state_2_4khz);
+    h = _ATOM_HASH(h, sys->joystick_type);
+    h = _ATOM_HASH(h, sys->kbd_joymask);
+    h = _ATOM_HASH(h, sys->joy_joymask);
+    h = _ATOM_HASH(h, sys->mmc_cmd);
+    h = _ATOM_HASH(h, sys->mmc_latch);
+    h = _ATOM_HASH(h, sys->kbd);
+    h = _ATOM_HASH(h, sys->audio.sample_pos);
+    h = chips_hash(sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(chips_audio_sample_t), h);
+    h = _ATOM_HASH(h, sys->ram);
+    h = _ATOM_HASH(h, sys->rom_abasic);
+    h = _ATOM_HASH(h, sys->rom_afloat);
+    h = _ATOM_HASH(h, sys->rom_dosrom);
+    h = _ATOM_HASH(h, sys->tape.size);
+    return _ATOM_HASH(h, sys->tape.pos);
+}
+
+uint64_t atom_frame_hash(atom_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 #endif /* CHIPS_IMPL */
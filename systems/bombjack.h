@@ -33,6 +33,39 @@
         - https://floooh.github.io/2018/10/06/bombjack.html
         - https://github.com/floooh/emu-info/blob/master/misc/bombjack-schematics.pdf
 
+    ## Running the boards on separate threads
+
+    The main board and sound board only communicate through the sound
+    command latch. Latch writes from the main board are put into a small
+    queue together with the sound board tick at which they become visible,
+    and the sound board never runs ahead of the main board's progress. This
+    means the results are the same no matter how the two boards are
+    interleaved, and the two boards can also run concurrently on two
+    threads. This requires defining CHIPS_THREADS (see chips_common.h).
+    Instead of bombjack_exec(), call the following two functions
+    at the same time, one on each thread, and wait for both to return
+    before calling any other bombjack function (e.g. to take a snapshot
+    or feed input):
+
+    ~~~C
+    uint32_t bombjack_exec_mainboard(bombjack_t* sys, uint32_t micro_seconds)
+    ~~~
+        Run the main board for the given number of microseconds (or
+        bombjack_exec_mainboard_ticks() for an exact number of main board
+        ticks), and decode the video output.
+
+    ~~~C
+    uint32_t bombjack_exec_soundboard(bombjack_t* sys)
+    ~~~
+        Run the sound board behind the main board until the matching
+        bombjack_exec_mainboard() call has finished. The audio callbacks
+        are called on this thread.
+
+    Each call to bombjack_exec_soundboard() must be paired with exactly
+    one call to bombjack_exec_mainboard(). The two functions busy-wait
+    on each other, so this only makes sense with two free CPU cores.
+    Stopping a board in the debugger isn't supported in this mode.
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -61,15 +94,26 @@ extern "C" {
 #endif
 
 // increase when bombjack_t memory layout changes
-#define BOMBJACK_SNAPSHOT_VERSION (2)
+#define BOMBJACK_SNAPSHOT_VERSION (7)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    BOMBJACK_PERF_MAINBOARD_CPU,    // main board Z80 CPU ticks
+    BOMBJACK_PERF_SOUNDBOARD_CPU,   // sound board Z80 CPU ticks
+    BOMBJACK_PERF_PSG,              // sound board AY-3-8910 ticks and audio output
+    BOMBJACK_PERF_VIDEO,            // per-frame video decoding
+    BOMBJACK_PERF_NUM,
+};
 
 #define BOMBJACK_MAX_AUDIO_SAMPLES (1024)
 #define BOMBJACK_DEFAULT_AUDIO_SAMPLES (128)
+#define BOMBJACK_AUDIO_NUM_TRACKS (9)   // 3 channels for each of the 3 sound board PSGs
 #define BOMBJACK_FRAMEBUFFER_WIDTH (256)
 #define BOMBJACK_FRAMEBUFFER_HEIGHT (288) // save space for sprites
 #define BOMBJACK_FRAMEBUFFER_SIZE_BYTES (BOMBJACK_FRAMEBUFFER_WIDTH * BOMBJACK_FRAMEBUFFER_HEIGHT * 4)
 #define BOMBJACK_DISPLAY_WIDTH (256)
 #define BOMBJACK_DISPLAY_HEIGHT (256)
+#define BOMBJACK_LATCH_QUEUE_SIZE (16)    // max number of in-flight sound commands (must be 2^N)
 
 // joystick mask bits
 #define BOMBJACK_JOYSTICK_RIGHT (1<<0)
@@ -138,10 +182,17 @@ typedef struct {
     chips_debug_t soundboard;
 } bombjack_debug_t;
 
+// a sound command written by the main board
+typedef struct {
+    uint64_t tick;          // the sound board tick at which the command becomes visible
+    uint8_t data;
+} bombjack_latch_cmd_t;
+
 // configuration parameters for bombjack_init()
 typedef struct {
     bombjack_debug_t debug;
     chips_audio_desc_t audio;
+    chips_input_callback_t input;  // optional input recording callback (see util/movie.h)
     struct {
         chips_range_t main_0000_1FFF;    // main-board ROM 0x0000..0x1FFF
         chips_range_t main_2000_3FFF;    // main-board ROM 0x2000..0x3FFF
@@ -178,16 +229,29 @@ typedef struct {
         mem_t mem;
         uint32_t palette[128];
         uint64_t pins;
+        clk_t clk;
+        uint64_t tick;          // main board ticks since power-on or reset
+        bool parallel;          // true while running in bombjack_exec_mainboard()
     } mainboard;
     struct {
         z80_t cpu;
         ay38910_t psg[3];
-        uint32_t tick_count;
         int vsync_count;
         mem_t mem;
         uint64_t pins;
+        uint64_t tick;          // sound board ticks since power-on or reset
+        uint8_t latch;          // the sound latch as seen by the sound board
+        uint32_t latch_wr;      // the latch queue write position as last seen by the sound board
+        uint32_t epoch;         // number of bombjack_exec_soundboard() calls
     } soundboard;
-    uint8_t sound_latch;        // shared latch, written by main board, read by sound board
+    // queue of timestamped sound latch writes, from main board to sound board
+    struct {
+        bombjack_latch_cmd_t cmds[BOMBJACK_LATCH_QUEUE_SIZE];
+        uint32_t wr_pos;        // only written by main board
+        uint32_t mb_epoch;      // number of finished bombjack_exec_mainboard() calls
+        uint64_t mb_tick;       // main board progress published to the sound board
+        alignas(64) uint32_t rd_pos;    // only written by sound board
+    } latch;
 
     bool valid;
 
@@ -202,10 +266,12 @@ typedef struct {
 
     struct {
         chips_audio_callback_t callback;
+        chips_audio_tracks_callback_t tracks_callback;
         int num_samples;
         int sample_pos;
-        float volume;
-        float sample_buffer[BOMBJACK_MAX_AUDIO_SAMPLES];
+        chips_audio_accum_t volume;
+        chips_audio_sample_t sample_buffer[BOMBJACK_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t tracks_buffer[BOMBJACK_MAX_AUDIO_SAMPLES * BOMBJACK_AUDIO_NUM_TRACKS];
     } audio;
 
     struct {
@@ -215,6 +281,11 @@ typedef struct {
         bool draw_sprite_layer;
         bool clear_background_layer;
     } dbg;
+    // each counter slot is only updated by one board, so this also works with the boards on separate threads
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
 
     alignas(64) uint32_t fb[BOMBJACK_FRAMEBUFFER_WIDTH * BOMBJACK_FRAMEBUFFER_HEIGHT];
 } bombjack_t;
@@ -229,10 +300,38 @@ void bombjack_reset(bombjack_t* sys);
 chips_display_info_t bombjack_display_info(bombjack_t* sys);
 // run bombjack instance for given amount of microseconds
 uint32_t bombjack_exec(bombjack_t* sys, uint32_t micro_seconds);
+// run bombjack instance for an exact number of main board ticks, return number of ticks executed on both boards
+uint32_t bombjack_exec_ticks(bombjack_t* sys, uint32_t num_ticks);
+// run bombjack instance until a number of audio samples has been generated, return number of ticks executed
+uint32_t bombjack_exec_samples(bombjack_t* sys, int num_samples);
+#if defined(CHIPS_THREADS)
+// run only the main board for given amount of microseconds (concurrently with bombjack_exec_soundboard())
+uint32_t bombjack_exec_mainboard(bombjack_t* sys, uint32_t micro_seconds);
+// run only the main board for an exact number of ticks (concurrently with bombjack_exec_soundboard()), return number of ticks executed
+uint32_t bombjack_exec_mainboard_ticks(bombjack_t* sys, uint32_t num_ticks);
+// run only the sound board until the matching bombjack_exec_mainboard() call has finished, return number of sound board ticks executed
+uint32_t bombjack_exec_soundboard(bombjack_t* sys);
+#endif
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* bombjack_perf_counters(bombjack_t* sys);
+#endif
+// set the joystick state of player 1 and 2 (combination of BOMBJACK_JOYSTICK_*)
+void bombjack_joystick(bombjack_t* sys, uint8_t p1_mask, uint8_t p2_mask);
+// set coin and start button bits (combination of BOMBJACK_SYS_*)
+void bombjack_input_set(bombjack_t* sys, uint8_t mask);
+// clear coin and start button bits
+void bombjack_input_clear(bombjack_t* sys, uint8_t mask);
+// replay a recorded input event (see util/movie.h)
+void bombjack_input_event(bombjack_t* sys, const chips_input_event_t* event);
 // take a snapshot, patches any pointers to zero, returns a snapshot version
 uint32_t bombjack_save_snapshot(bombjack_t* sys, bombjack_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
 bool bombjack_load_snapshot(bombjack_t* sys, uint32_t version, bombjack_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks)
+uint64_t bombjack_state_hash(bombjack_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t bombjack_frame_hash(bombjack_t* sys);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -252,8 +351,22 @@ bool bombjack_load_snapshot(bombjack_t* sys, uint32_t version, bombjack_t* src);
 #define _BOMBJACK_VBLANK_DURATION_4MHZ (((4000000/60)/525)*(525-483))
 #define _BOMBJACK_VSYNC_PERIOD_3MHZ (3000000/60)
 
+#define _BOMBJACK_PUBLISH_TICKS (256)   // how often the main board publishes its progress to the sound board
+
 #define _bombjack_def(val, def) (val == 0 ? def : val)
 
+// convert a main board tick count to the number of sound board ticks in the same time
+static inline uint64_t _bombjack_soundboard_ticks(uint64_t mb_ticks) {
+    return (mb_ticks / _BOMBJACK_MAINBOARD_FREQUENCY) * _BOMBJACK_SOUNDBOARD_FREQUENCY +
+           ((mb_ticks % _BOMBJACK_MAINBOARD_FREQUENCY) * _BOMBJACK_SOUNDBOARD_FREQUENCY) / _BOMBJACK_MAINBOARD_FREQUENCY;
+}
+
+// convert a sound board tick count to the (rounded up) number of main board ticks in the same time
+static inline uint64_t _bombjack_mainboard_ticks(uint64_t sb_ticks) {
+    return (sb_ticks / _BOMBJACK_SOUNDBOARD_FREQUENCY) * _BOMBJACK_MAINBOARD_FREQUENCY +
+           ((sb_ticks % _BOMBJACK_SOUNDBOARD_FREQUENCY) * _BOMBJACK_MAINBOARD_FREQUENCY + _BOMBJACK_SOUNDBOARD_FREQUENCY - 1) / _BOMBJACK_SOUNDBOARD_FREQUENCY;
+}
+
 void bombjack_init(bombjack_t* sys, const bombjack_desc_t* desc) {
     CHIPS_ASSERT(sys && desc);
     if (desc->debug.mainboard.callback.func) { CHIPS_ASSERT(desc->debug.mainboard.stopped); }
@@ -261,11 +374,17 @@ void bombjack_init(bombjack_t* sys, const bombjack_desc_t* desc) {
 
     memset(sys, 0, sizeof(bombjack_t));
     sys->valid = true;
+    clk_init(&sys->mainboard.clk, _BOMBJACK_MAINBOARD_FREQUENCY);
     sys->dbg.debug = desc->debug;
+    sys->input = desc->input;
     sys->dbg.draw_background_layer = true;
     sys->dbg.draw_foreground_layer = true;
     sys->dbg.draw_sprite_layer = true;
     sys->dbg.clear_background_layer = true;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[BOMBJACK_PERF_NUM] = { "z80-main", "z80-sound", "ay38910", "video" };
+    chips_perf_init(&sys->perf, BOMBJACK_PERF_NUM, perf_names);
+#endif
 
     /* copy over ROM images */
     CHIPS_ASSERT(desc->roms.main_0000_1FFF.ptr && (desc->roms.main_0000_1FFF.size == sizeof(sys->rom_main[0])));
@@ -328,6 +447,7 @@ void bombjack_init(bombjack_t* sys, const bombjack_desc_t* desc) {
         .tick_hz = 1500000,
         .sound_hz = _bombjack_def(desc->audio.sample_rate, 44100),
         .magnitude = 0.2f,
+        .channel_samples = 0 != desc->audio.tracks_callback.func,
     };
     for (size_t i = 0; i < 3; i++) {
         ay38910_init(&sys->soundboard.psg[i], &psg_desc);
@@ -375,8 +495,9 @@ void bombjack_init(bombjack_t* sys, const bombjack_desc_t* desc) {
     // move over audio-output config
     CHIPS_ASSERT(desc->audio.num_samples <= BOMBJACK_MAX_AUDIO_SAMPLES);
     sys->audio.callback = desc->audio.callback;
+    sys->audio.tracks_callback = desc->audio.tracks_callback;
     sys->audio.num_samples = _bombjack_def(desc->audio.num_samples, BOMBJACK_DEFAULT_AUDIO_SAMPLES);
-    sys->audio.volume = _bombjack_def(desc->audio.volume, 1.0f);
+    sys->audio.volume = CHIPS_AUDIO_VOLUME(_bombjack_def(desc->audio.volume, 1.0f));
 }
 
 void bombjack_discard(bombjack_t* sys) {
@@ -391,6 +512,13 @@ void bombjack_reset(bombjack_t* sys) {
     for (size_t i = 0; i < 3; i++) {
         ay38910_reset(&sys->soundboard.psg[i]);
     }
+    // drop pending sound commands, and restart both boards in sync
+    memset(&sys->latch, 0, sizeof(sys->latch));
+    sys->mainboard.tick = 0;
+    sys->soundboard.tick = 0;
+    sys->soundboard.latch = 0;
+    sys->soundboard.latch_wr = 0;
+    sys->soundboard.epoch = 0;
 }
 
 /* Maintain a color palette cache with 32-bit colors, this is called for
@@ -418,6 +546,43 @@ static inline void _bombjack_update_palette_cache(bombjack_t* sys, uint16_t addr
     sys->mainboard.palette[pal_index] = c;
 }
 
+static uint32_t _bombjack_run_soundboard(bombjack_t* sys, uint64_t end_tick);
+static uint64_t _bombjack_soundboard_limit(bombjack_t* sys);
+
+/* Put a sound command into the latch queue, timestamped with the sound
+    board tick at which the command becomes visible to the sound board.
+    If the queue is full, the sound board needs to catch up first, either
+    by running it right here, or by waiting for the sound board thread.
+*/
+static void _bombjack_push_sound_latch(bombjack_t* sys, uint8_t data) {
+    const uint32_t wr_pos = sys->latch.wr_pos;
+    if ((wr_pos - _chips_load_acquire32(&sys->latch.rd_pos)) == BOMBJACK_LATCH_QUEUE_SIZE) {
+        // the sound board may safely run up to the end of the previous main board tick
+        _chips_store_release64(&sys->latch.mb_tick, sys->mainboard.tick - 1);
+        if (sys->mainboard.parallel) {
+            uint32_t spin_count = 0;
+            while ((wr_pos - _chips_load_acquire32(&sys->latch.rd_pos)) == BOMBJACK_LATCH_QUEUE_SIZE) {
+                // spin until the sound board thread has consumed a command
+                _chips_spin_wait(&spin_count);
+            }
+        }
+        else {
+            // run the sound board until the oldest command has been consumed
+            const uint64_t limit = _bombjack_soundboard_limit(sys);
+            const uint64_t cmd_tick = sys->latch.cmds[sys->latch.rd_pos & (BOMBJACK_LATCH_QUEUE_SIZE - 1)].tick + 1;
+            _bombjack_run_soundboard(sys, (cmd_tick < limit) ? cmd_tick : limit);
+            if ((wr_pos - sys->latch.rd_pos) == BOMBJACK_LATCH_QUEUE_SIZE) {
+                // sound board is stopped in the debugger, drop the oldest command
+                sys->latch.rd_pos++;
+            }
+        }
+    }
+    bombjack_latch_cmd_t* cmd = &sys->latch.cmds[wr_pos & (BOMBJACK_LATCH_QUEUE_SIZE - 1)];
+    cmd->tick = _bombjack_soundboard_ticks(sys->mainboard.tick);
+    cmd->data = data;
+    _chips_store_release32(&sys->latch.wr_pos, wr_pos + 1);
+}
+
 /* main board tick function
 
     Bomb Jack uses memory mapped IO (the Z80's IORQ pin isn't connected).
@@ -482,6 +647,8 @@ static inline void _bombjack_update_palette_cache(bombjack_t* sys, uint16_t addr
 
 */
 static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
+    sys->mainboard.tick++;
+
     // activate NMI pin during VBLANK
     sys->mainboard.vsync_count--;
     if (sys->mainboard.vsync_count < 0) {
@@ -502,7 +669,9 @@ static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
     }
 
     // tick the CPU
+    CHIPS_PERF_BEGIN(&sys->perf, BOMBJACK_PERF_MAINBOARD_CPU);
     pins = z80_tick(&sys->mainboard.cpu, pins);
+    CHIPS_PERF_END(&sys->perf, BOMBJACK_PERF_MAINBOARD_CPU);
 
     /* handle memory requests
 
@@ -534,7 +703,7 @@ static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
             // FIXME: 0xB004: flip screen
             else if (addr == 0xB800) {
                 // shared sound latch
-                sys->sound_latch = data;
+                _bombjack_push_sound_latch(sys, data);
             }
         }
         else if (pins & Z80_RD) {
@@ -575,6 +744,9 @@ static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
     latch and also clears the flip-flop connected to the soundboard's
     CPU NMI pin.
 
+    Latch writes from the main board arrive through the latch queue
+    and are applied at the sound board tick they're timestamped with.
+
     Communication with the 3 sound chips is done through IO requests
     (not memory mapped IO like on the main board).
 
@@ -591,6 +763,20 @@ static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
     80 .. 81:       3rd AY-3-8910
 */
 static uint64_t _bombjack_tick_soundboard(bombjack_t* sys, uint64_t pins) {
+    // apply sound latch writes from the main board which are due in this tick
+    const uint64_t tick = sys->soundboard.tick++;
+    uint32_t rd_pos = sys->latch.rd_pos;
+    if (rd_pos != sys->soundboard.latch_wr) {
+        const bombjack_latch_cmd_t* cmd;
+        while ((rd_pos != sys->soundboard.latch_wr) && ((cmd = &sys->latch.cmds[rd_pos & (BOMBJACK_LATCH_QUEUE_SIZE - 1)])->tick <= tick)) {
+            sys->soundboard.latch = cmd->data;
+            rd_pos++;
+        }
+        if (rd_pos != sys->latch.rd_pos) {
+            _chips_store_release32(&sys->latch.rd_pos, rd_pos);
+        }
+    }
+
     /* vsync triggers a flip-flop connected to the CPU's NMI, the flip-flop
        is reset on a read from address 0x6000 (this read happens in the
        interrupt service routine
@@ -602,7 +788,9 @@ static uint64_t _bombjack_tick_soundboard(bombjack_t* sys, uint64_t pins) {
     }
 
     // tick the CPU
+    CHIPS_PERF_BEGIN(&sys->perf, BOMBJACK_PERF_SOUNDBOARD_CPU);
     pins = z80_tick(&sys->soundboard.cpu, pins);
+    CHIPS_PERF_END(&sys->perf, BOMBJACK_PERF_SOUNDBOARD_CPU);
 
     // handle memory requests
     if (pins & Z80_MREQ) {
@@ -611,8 +799,8 @@ static uint64_t _bombjack_tick_soundboard(bombjack_t* sys, uint64_t pins) {
         if (pins & Z80_RD) {
             // special case: read and clear sound latch and NMI flip-flop
             if (addr == 0x6000) {
-                Z80_SET_DATA(pins, sys->sound_latch);
-                sys->sound_latch = 0;
+                Z80_SET_DATA(pins, sys->soundboard.latch);
+                sys->soundboard.latch = 0;
                 pins &= ~Z80_NMI;
             }
             else {
@@ -650,22 +838,35 @@ static uint64_t _bombjack_tick_soundboard(bombjack_t* sys, uint64_t pins) {
     }
 
     // tick the AY chips at half CPU frequency
-    if (sys->soundboard.tick_count++ & 1) {
+    CHIPS_PERF_BEGIN(&sys->perf, BOMBJACK_PERF_PSG);
+    if (tick & 1) {
         ay38910_tick(&sys->soundboard.psg[2]);
         ay38910_tick(&sys->soundboard.psg[1]);
         if (ay38910_tick(&sys->soundboard.psg[0])) {
-            float s = sys->soundboard.psg[0].sample +
-                      sys->soundboard.psg[1].sample +
-                      sys->soundboard.psg[2].sample;
-            sys->audio.sample_buffer[sys->audio.sample_pos++] = s * sys->audio.volume;
+            chips_audio_accum_t s = (chips_audio_accum_t)sys->soundboard.psg[0].sample +
+                                    sys->soundboard.psg[1].sample +
+                                    sys->soundboard.psg[2].sample;
+            if (sys->audio.tracks_callback.func) {
+                chips_audio_sample_t* dst = &sys->audio.tracks_buffer[sys->audio.sample_pos * BOMBJACK_AUDIO_NUM_TRACKS];
+                for (int psg = 0; psg < 3; psg++) {
+                    for (int chn = 0; chn < AY38910_NUM_CHANNELS; chn++) {
+                        *dst++ = chips_audio_clamp(chips_audio_scale(sys->soundboard.psg[psg].channel_sample[chn], sys->audio.volume));
+                    }
+                }
+            }
+            sys->audio.sample_buffer[sys->audio.sample_pos++] = chips_audio_clamp(chips_audio_scale(s, sys->audio.volume));
             if (sys->audio.sample_pos == sys->audio.num_samples) {
                 if (sys->audio.callback.func) {
                     sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
                 }
+                if (sys->audio.tracks_callback.func) {
+                    sys->audio.tracks_callback.func(sys->audio.tracks_buffer, sys->audio.num_samples, BOMBJACK_AUDIO_NUM_TRACKS, sys->audio.tracks_callback.user_data);
+                }
                 sys->audio.sample_pos = 0;
             }
         }
     }
+    CHIPS_PERF_END(&sys->perf, BOMBJACK_PERF_PSG);
     return pins;
 }
 
@@ -959,70 +1160,247 @@ static void _bombjack_decode_video(bombjack_t* sys) {
     }
 }
 
-uint32_t bombjack_exec(bombjack_t* sys, uint32_t micro_seconds) {
-    CHIPS_ASSERT(sys && sys->valid);
-    /* Run the main board and sound board interleaved for half a frame.
-       This simplifies the communication via the sound latch (the main CPU
-       writes a command byte to the sound latch, the sound board reads
-       the command latch in its interrupt service routine.
-
-       The main board issues at most one command per 60Hz frame, but since the
-       host machine is also running at roughly 60 Hz it may happen that the
-       main board writes 2 sound commands per host frame. For this reason
-       run the 2 boards interleaved for half a frame, so it is guaranteed
-       that at most one sound command can be written by the main board
-       before the sound board is ticked (that way we don't need to implement
-       a complicated command queue.
-
-       NOTE: with the new cycle-stepped Z80 we could just as well do
-       a much more finer grained interleaving (e.g. per tick), but this
-       turns out to be quite a bit slower.
-    */
-    const uint32_t slice_us = micro_seconds/2;
-    const uint32_t mb_num_ticks = clk_us_to_ticks(_BOMBJACK_MAINBOARD_FREQUENCY, slice_us);
-    const uint32_t sb_num_ticks = clk_us_to_ticks(_BOMBJACK_SOUNDBOARD_FREQUENCY, slice_us);
-    for (size_t i = 0; i < 2; i++) {
-        // tick the main board for one half frame
-        {
-            uint64_t pins = sys->mainboard.pins;
-            if (0 == sys->dbg.debug.mainboard.callback.func) {
-                // run without debug callback
-                for (uint32_t tick = 0; tick < mb_num_ticks; tick++) {
-                    pins = _bombjack_tick_mainboard(sys, pins);
-                }
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _bombjack_debug_event(const chips_debug_t* debug, z80_t* cpu, uint64_t pins) {
+    const uint32_t events = debug->events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && z80_opdone(cpu)) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR))) ||
+           ((events & CHIPS_DEBUG_EVENT_IO) && ((pins & (Z80_IORQ|Z80_M1)) == Z80_IORQ)) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (Z80_INT|Z80_NMI))));
+}
+
+// run the main board, and publish its progress to the sound board, return number of executed ticks
+static uint32_t _bombjack_run_mainboard(bombjack_t* sys, uint32_t num_ticks) {
+    uint64_t pins = sys->mainboard.pins;
+    uint32_t tick = 0;
+    if (0 == sys->dbg.debug.mainboard.callback.func) {
+        // run without debug callback
+        while (tick < num_ticks) {
+            const uint32_t end_tick = ((num_ticks - tick) > _BOMBJACK_PUBLISH_TICKS) ? (tick + _BOMBJACK_PUBLISH_TICKS) : num_ticks;
+            for (; tick < end_tick; tick++) {
+                pins = _bombjack_tick_mainboard(sys, pins);
             }
-            else {
-                // run with debug callback
-                for (uint32_t tick = 0; (tick < mb_num_ticks) && !(*sys->dbg.debug.mainboard.stopped); tick++) {
-                    pins = _bombjack_tick_mainboard(sys, pins);
-                    sys->dbg.debug.mainboard.callback.func(sys->dbg.debug.mainboard.callback.user_data, pins);
-                }
+            _chips_store_release64(&sys->latch.mb_tick, sys->mainboard.tick);
+        }
+    }
+    else {
+        // run with debug callback in each tick, or only on requested events
+        for (; (tick < num_ticks) && !(*sys->dbg.debug.mainboard.stopped); tick++) {
+            pins = _bombjack_tick_mainboard(sys, pins);
+            if (_bombjack_debug_event(&sys->dbg.debug.mainboard, &sys->mainboard.cpu, pins)) {
+                sys->dbg.debug.mainboard.callback.func(sys->dbg.debug.mainboard.callback.user_data, pins);
             }
-            sys->mainboard.pins = pins;
+            _chips_store_release64(&sys->latch.mb_tick, sys->mainboard.tick);
         }
-        // tick the sound board for one half frame
-        {
-            uint64_t pins = sys->soundboard.pins;
-            if (0 == sys->dbg.debug.soundboard.callback.func) {
-                // run without debug callback
-                for (uint32_t tick = 0; tick < sb_num_ticks; tick++) {
-                    pins = _bombjack_tick_soundboard(sys, pins);
-                }
+    }
+    sys->mainboard.pins = pins;
+    return tick;
+}
+
+// fetch the main board progress and new sound commands, return the sound board tick the sound board may run to
+static uint64_t _bombjack_soundboard_limit(bombjack_t* sys) {
+    const uint64_t mb_tick = _chips_load_acquire64(&sys->latch.mb_tick);
+    sys->soundboard.latch_wr = _chips_load_acquire32(&sys->latch.wr_pos);
+    return _bombjack_soundboard_ticks(mb_tick);
+}
+
+// run the sound board up to end_tick, return number of executed ticks
+static uint32_t _bombjack_run_soundboard(bombjack_t* sys, uint64_t end_tick) {
+    if (sys->soundboard.tick >= end_tick) {
+        return 0;
+    }
+    const uint32_t num_ticks = (uint32_t)(end_tick - sys->soundboard.tick);
+    uint64_t pins = sys->soundboard.pins;
+    uint32_t tick = 0;
+    if (0 == sys->dbg.debug.soundboard.callback.func) {
+        // run without debug callback
+        for (; tick < num_ticks; tick++) {
+            pins = _bombjack_tick_soundboard(sys, pins);
+        }
+    }
+    else {
+        // run with debug callback in each tick, or only on requested events
+        for (; (tick < num_ticks) && !(*sys->dbg.debug.soundboard.stopped); tick++) {
+            pins = _bombjack_tick_soundboard(sys, pins);
+            if (_bombjack_debug_event(&sys->dbg.debug.soundboard, &sys->soundboard.cpu, pins)) {
+                sys->dbg.debug.soundboard.callback.func(sys->dbg.debug.soundboard.callback.user_data, pins);
             }
-            else {
-                // run with debug callback
-                for (uint32_t tick = 0; (tick < sb_num_ticks) && !(*sys->dbg.debug.soundboard.stopped); tick++) {
-                    pins = _bombjack_tick_soundboard(sys, pins);
-                    sys->dbg.debug.soundboard.callback.func(sys->dbg.debug.soundboard.callback.user_data, pins);
-                }
+        }
+    }
+    sys->soundboard.pins = pins;
+    return tick;
+}
+
+// run the sound board up to end_tick or until num_samples have been generated, return executed ticks
+static uint32_t _bombjack_run_soundboard_samples(bombjack_t* sys, uint64_t end_tick, int* num_samples) {
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->audio.sample_pos;
+    uint64_t pins = sys->soundboard.pins;
+    if (0 == sys->dbg.debug.soundboard.callback.func) {
+        // run without debug callback
+        while ((*num_samples > 0) && (sys->soundboard.tick < end_tick)) {
+            pins = _bombjack_tick_soundboard(sys, pins);
+            num_ticks++;
+            if (sample_pos != sys->audio.sample_pos) {
+                sample_pos = sys->audio.sample_pos;
+                (*num_samples)--;
+            }
+        }
+    }
+    else {
+        // run with debug callback in each tick, or only on requested events
+        while ((*num_samples > 0) && (sys->soundboard.tick < end_tick) && !(*sys->dbg.debug.soundboard.stopped)) {
+            pins = _bombjack_tick_soundboard(sys, pins);
+            if (_bombjack_debug_event(&sys->dbg.debug.soundboard, &sys->soundboard.cpu, pins)) {
+                sys->dbg.debug.soundboard.callback.func(sys->dbg.debug.soundboard.callback.user_data, pins);
+            }
+            num_ticks++;
+            if (sample_pos != sys->audio.sample_pos) {
+                sample_pos = sys->audio.sample_pos;
+                (*num_samples)--;
             }
-            sys->soundboard.pins = pins;
         }
     }
+    sys->soundboard.pins = pins;
+    return num_ticks;
+}
+
+uint32_t bombjack_exec(bombjack_t* sys, uint32_t micro_seconds) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return bombjack_exec_ticks(sys, clk_advance_us(&sys->mainboard.clk, micro_seconds));
+}
+
+uint32_t bombjack_exec_ticks(bombjack_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    /* Run the main board first, and then let the sound board catch up.
+       Sound commands written by the main board are timestamped with the
+       sound board tick at which they become visible, so the sound board
+       sees them at the right time even though it runs behind the main board.
+    */
+    // the debugger may stop the main board before num_ticks have been executed
+    const uint32_t mb_num_ticks = _bombjack_run_mainboard(sys, num_ticks);
+    const uint32_t sb_num_ticks = _bombjack_run_soundboard(sys, _bombjack_soundboard_limit(sys));
+    CHIPS_PERF_BEGIN(&sys->perf, BOMBJACK_PERF_VIDEO);
+    _bombjack_decode_video(sys);
+    CHIPS_PERF_END(&sys->perf, BOMBJACK_PERF_VIDEO);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, mb_num_ticks, 0);
+    return mb_num_ticks + sb_num_ticks;
+}
+
+uint32_t bombjack_exec_samples(bombjack_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->audio.num_samples > 1));
+    /* Run the main board until it is one sample ahead of the sound board, and
+       then the sound board until it has generated the next sample. Keeping the
+       main board close to the sound board makes sure that the sound latch queue
+       doesn't fill up (which would have the sound board generate samples while
+       the main board is running). The sound board ticks the PSGs at half its
+       own frequency, so the duration of one sample in sound board ticks is derived
+       from the first PSG's sample period.
+    */
+    uint32_t num_ticks = 0;
+    uint32_t num_mb_ticks = 0;
+    const uint64_t sb_duration = 1 + ((uint64_t)sys->soundboard.psg[0].sample_period * 2) / AY38910_FIXEDPOINT_SCALE;
+    while (num_samples > 0) {
+        const uint64_t mb_end_tick = _bombjack_mainboard_ticks(sys->soundboard.tick + sb_duration);
+        const uint32_t mb_num_ticks = _bombjack_run_mainboard(sys, (mb_end_tick > sys->mainboard.tick) ? (uint32_t)(mb_end_tick - sys->mainboard.tick) : 1);
+        const uint32_t sb_num_ticks = _bombjack_run_soundboard_samples(sys, _bombjack_soundboard_limit(sys), &num_samples);
+        num_ticks += mb_num_ticks + sb_num_ticks;
+        num_mb_ticks += mb_num_ticks;
+        const bool sb_stopped = sys->dbg.debug.soundboard.callback.func && *sys->dbg.debug.soundboard.stopped;
+        if ((0 == mb_num_ticks) || sb_stopped) {
+            // one of the boards is stopped in the debugger
+            break;
+        }
+    }
+    CHIPS_PERF_BEGIN(&sys->perf, BOMBJACK_PERF_VIDEO);
     _bombjack_decode_video(sys);
-    return 2 * (mb_num_ticks + sb_num_ticks);
+    CHIPS_PERF_END(&sys->perf, BOMBJACK_PERF_VIDEO);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_mb_ticks, 0);
+    return num_ticks;
 }
 
+#if defined(CHIPS_THREADS)
+uint32_t bombjack_exec_mainboard(bombjack_t* sys, uint32_t micro_seconds) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return bombjack_exec_mainboard_ticks(sys, clk_advance_us(&sys->mainboard.clk, micro_seconds));
+}
+
+uint32_t bombjack_exec_mainboard_ticks(bombjack_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    sys->mainboard.parallel = true;
+    // the debugger may stop the main board before num_ticks have been executed
+    const uint32_t mb_num_ticks = _bombjack_run_mainboard(sys, num_ticks);
+    sys->mainboard.parallel = false;
+    CHIPS_PERF_BEGIN(&sys->perf, BOMBJACK_PERF_VIDEO);
+    _bombjack_decode_video(sys);
+    CHIPS_PERF_END(&sys->perf, BOMBJACK_PERF_VIDEO);
+    // signal the sound board thread that the main board is done
+    _chips_store_release32(&sys->latch.mb_epoch, sys->latch.mb_epoch + 1);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, mb_num_ticks, 0);
+    return mb_num_ticks;
+}
+
+uint32_t bombjack_exec_soundboard(bombjack_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    const uint32_t epoch = ++sys->soundboard.epoch;
+    uint32_t num_ticks = 0;
+    uint32_t spin_count = 0;
+    bool done;
+    do {
+        // check for done before fetching the main board progress, so that the final progress isn't missed
+        done = (int32_t)(_chips_load_acquire32(&sys->latch.mb_epoch) - epoch) >= 0;
+        const uint32_t sb_num_ticks = _bombjack_run_soundboard(sys, _bombjack_soundboard_limit(sys));
+        if (sb_num_ticks > 0) {
+            num_ticks += sb_num_ticks;
+            spin_count = 0;
+        }
+        else if (!done) {
+            // caught up with the main board, wait for more progress
+            _chips_spin_wait(&spin_count);
+        }
+    } while (!done);
+    return num_ticks;
+}
+#endif
+
+void bombjack_joystick(bombjack_t* sys, uint8_t p1_mask, uint8_t p2_mask) {
+    CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK, p1_mask, p2_mask);
+    sys->mainboard.p1 = p1_mask;
+    sys->mainboard.p2 = p2_mask;
+}
+
+void bombjack_input_set(bombjack_t* sys, uint8_t mask) {
+    CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_SET, mask, 0);
+    sys->mainboard.sys |= mask;
+}
+
+void bombjack_input_clear(bombjack_t* sys, uint8_t mask) {
+    CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_CLEAR, mask, 0);
+    sys->mainboard.sys &= ~mask;
+}
+
+void bombjack_input_event(bombjack_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: bombjack_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_JOYSTICK: bombjack_joystick(sys, (uint8_t)event->a, (uint8_t)event->b); break;
+        case CHIPS_INPUT_SET: bombjack_input_set(sys, (uint8_t)event->a); break;
+        case CHIPS_INPUT_CLEAR: bombjack_input_clear(sys, (uint8_t)event->a); break;
+        default: break;
+    }
+}
+
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* bombjack_perf_counters(bombjack_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t bombjack_display_info(bombjack_t* sys) {
     const chips_display_info_t res = {
         .frame = {
@@ -1053,7 +1431,12 @@ uint32_t bombjack_save_snapshot(bombjack_t* sys, bombjack_t* dst) {
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->dbg.debug.mainboard);
     chips_debug_snapshot_onsave(&dst->dbg.debug.soundboard);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
+    chips_audio_tracks_callback_snapshot_onsave(&dst->audio.tracks_callback);
     for (size_t i = 0; i < 3; i++) {
         ay38910_snapshot_onsave(&dst->soundboard.psg[i]);
     }
@@ -1071,7 +1454,12 @@ bool bombjack_load_snapshot(bombjack_t* sys, uint32_t version, bombjack_t* src)
     im = *src;
     chips_debug_snapshot_onload(&im.dbg.debug.mainboard, &sys->dbg.debug.mainboard);
     chips_debug_snapshot_onload(&im.dbg.debug.soundboard, &sys->dbg.debug.soundboard);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
+    chips_audio_tracks_callback_snapshot_onload(&im.audio.tracks_callback, &sys->audio.tracks_callback);
     for (size_t i = 0; i < 3; i++) {
         ay38910_snapshot_onload(&im.soundboard.psg[i], &sys->soundboard.psg[i]);
     }
@@ -1081,4 +1469,59 @@ bool bombjack_load_snapshot(bombjack_t* sys, uint32_t version, bombjack_t* src)
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by bombjack_init())
+#define _BOMBJACK_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t bombjack_state_hash(bombjack_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping callbacks, the fixed memory mappings, the exec
+    // clock (which only tracks fractions of bombjack_exec() calls) and the exec call
+    // counters (which are only used to synchronize the boards on separate threads)
+    uint64_t h = _BOMBJACK_HASH(0, sys->mainboard.cpu);
+    h = _BOMBJACK_HASH(h, sys->mainboard.p1);
+    h = _BOMBJACK_HASH(h, sys->mainboard.p2);
+    h = _BOMBJACK_HASH(h, sys->mainboard.sys);
+    h = _BOMBJACK_HASH(h, sys->mainboard.dsw1);
+    h = _BOMBJACK_HASH(h, sys->mainboard.dsw2);
+    h = _BOMBJACK_HASH(h, sys->mainboard.nmi_mask);
+    h = _BOMBJACK_HASH(h, sys->mainboard.bg_image);
+    h = _BOMBJACK_HASH(h, sys->mainboard.vsync_count);
+    h = _BOMBJACK_HASH(h, sys->mainboard.vblank_count);
+    h = _BOMBJACK_HASH(h, sys->mainboard.palette);
+    h = _BOMBJACK_HASH(h, sys->mainboard.pins);
+    h = _BOMBJACK_HASH(h, sys->mainboard.tick);
+    h = _BOMBJACK_HASH(h, sys->soundboard.cpu);
+    for (int i = 0; i < 3; i++) {
+        ay38910_t psg;
+        memcpy(&psg, &sys->soundboard.psg[i], sizeof(psg));
+        ay38910_snapshot_onsave(&psg);
+        h = _BOMBJACK_HASH(h, psg);
+    }
+    h = _BOMBJACK_HASH(h, sys->soundboard.vsync_count);
+    h = _BOMBJACK_HASH(h, sys->soundboard.pins);
+    h = _BOMBJACK_HASH(h, sys->soundboard.tick);
+    h = _BOMBJACK_HASH(h, sys->soundboard.latch);
+    h = _BOMBJACK_HASH(h, sys->soundboard.latch_wr);
+    h = _BOMBJACK_HASH(h, sys->latch.cmds);
+    h = _BOMBJACK_HASH(h, sys->latch.wr_pos);
+    h = _BOMBJACK_HASH(h, sys->latch.mb_tick);
+    h = _BOMBJACK_HASH(h, sys->latch.rd_pos);
+    h = _BOMBJACK_HASH(h, sys->main_ram);
+    h = _BOMBJACK_HASH(h, sys->sound_ram);
+    h = _BOMBJACK_HASH(h, sys->rom_main);
+    h = _BOMBJACK_HASH(h, sys->rom_sound);
+    h = _BOMBJACK_HASH(h, sys->rom_chars);
+    h = _BOMBJACK_HASH(h, sys->rom_tiles);
+    h = _BOMBJACK_HASH(h, sys->rom_sprites);
+    h = _BOMBJACK_HASH(h, sys->rom_maps);
+    h = _BOMBJACK_HASH(h, sys->audio.volume);
+    h = _BOMBJACK_HASH(h, sys->audio.sample_pos);
+    return chips_hash(sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(chips_audio_sample_t), h);
+}
+
+uint64_t bombjack_frame_hash(bombjack_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 #endif // CHIPS_IMPL
@@ -46,15 +46,27 @@
     }
     ~~~
 
-    Use the following functions to insert and remove a tape, with a .TAP
-    file loading into memory, or check if a tape is inserted:
+    Use the following functions to insert and remove a .TAP tape image, or
+    check if a tape is inserted:
 
     ~~~C
-    bool c1530_insert_tape(c1530_t* sys, const uint8_t* ptr, int num_bytes);
+    bool c1530_insert_tape_source(c1530_t* sys, const chips_tape_source_t* source);
     void c1530_remove_tape(c1530_t* sys);
     bool c1530_tape_inserted(c1530_t* sys);
     ~~~
 
+    The tape data is *not* copied, the tape source is either a memory range
+    which must remain valid until the tape is removed (this works well with
+    memory-mapped files), or a read callback which streams the tape data.
+    For instance to insert a .TAP file which has been loaded into memory:
+
+    ~~~C
+    c1530_insert_tape_source(&c1530, &(chips_tape_source_t){ .data = tap_file });
+    ~~~
+
+    Snapshots only contain the tape position, not the tape data, when a
+    snapshot is loaded the currently inserted tape continues to be used.
+
     Call the following functions to control the tape motor (press the Play
     or Stop buttons):
 
@@ -99,9 +111,6 @@ extern "C" {
 #define C1530_CASPORT_WRITE   (1<<2)
 #define C1530_CASPORT_SENSE   (1<<3)
 
-/* max size of a cassette tape image */
-#define C1530_MAX_TAPE_SIZE (512*1024)
-
 /* config params for c1530_init() */
 typedef struct {
     /* pointer to a the C64's cassette port byte */
@@ -115,7 +124,7 @@ typedef struct {
     uint32_t size;      /* tape_size > 0: a tape is inserted */
     uint32_t pos;
     uint32_t pulse_count;
-    uint8_t buf[C1530_MAX_TAPE_SIZE];
+    chips_tape_t tape;  /* the tape image (not part of snapshots) */
 } c1530_t;
 
 /* initialize a c1530_t instance */
@@ -126,8 +135,10 @@ void c1530_discard(c1530_t* sys);
 void c1530_reset(c1530_t* sys);
 /* tick the tape drive */
 void c1530_tick(c1530_t* sys);
-/* insert a tape file */
-bool c1530_insert_tape(c1530_t* sys, chips_range_t data);
+/* insert a tape file from an external memory range or read callback (data is not copied) */
+bool c1530_insert_tape_source(c1530_t* sys, const chips_tape_source_t* source);
+/* read a byte from the tape data (after the TAP header), 0 past the end */
+uint8_t c1530_tape_byte(c1530_t* sys, uint32_t pos);
 /* remove tape file */
 void c1530_remove_tape(c1530_t* sys);
 /* return true if a tape is currently inserted */
@@ -171,6 +182,7 @@ void c1530_discard(c1530_t* sys) {
 void c1530_reset(c1530_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     sys->cas_port = 0;
+    chips_tape_remove(&sys->tape);
     sys->size = 0;
     sys->pos = 0;
     sys->pulse_count = 0;
@@ -184,37 +196,41 @@ typedef struct {
     uint32_t size;          /* size of the following data */
 } _c1530_tap_header;
 
-bool c1530_insert_tape(c1530_t* sys, chips_range_t data) {
-    CHIPS_ASSERT(sys && sys->valid && data.ptr && (data.size > 0));
+bool c1530_insert_tape_source(c1530_t* sys, const chips_tape_source_t* source) {
+    CHIPS_ASSERT(sys && sys->valid && source);
     c1530_remove_tape(sys);
-    if (data.size <= sizeof(_c1530_tap_header)) {
+    if (!chips_tape_insert(&sys->tape, source)) {
         return false;
     }
-    const uint8_t* ptr = (uint8_t*) data.ptr;
-    const _c1530_tap_header* hdr = (const _c1530_tap_header*) ptr;
-    ptr += sizeof(_c1530_tap_header);
-    const uint8_t sig[12] = { 'C','6','4','-','T','A','P','E','-','R','A','W'};
-    for (size_t i = 0; i < 12; i++) {
-        if (sig[i] != hdr->signature[i]) {
-            return false;
-        }
-    }
-    if (1 != hdr->version) {
+    _c1530_tap_header hdr;
+    if (sys->tape.size <= sizeof(hdr)) {
+        chips_tape_remove(&sys->tape);
         return false;
     }
-    if (data.size < (hdr->size + sizeof(_c1530_tap_header))) {
-        return false;
+    chips_tape_read(&sys->tape, 0, &hdr, sizeof(hdr));
+    const uint8_t sig[12] = { 'C','6','4','-','T','A','P','E','-','R','A','W'};
+    bool valid = (0 == memcmp(sig, hdr.signature, sizeof(sig))) && (1 == hdr.version);
+    if (valid && ((sys->tape.size - sizeof(hdr)) < hdr.size)) {
+        valid = false;
     }
-    if (data.size > sizeof(sys->buf)) {
+    if (!valid) {
+        chips_tape_remove(&sys->tape);
         return false;
     }
-    memcpy(sys->buf, ptr, hdr->size);
-    sys->size = hdr->size;
+    sys->size = hdr.size;
     sys->pos = 0;
     sys->pulse_count = 0;
     return true;
 }
 
+uint8_t c1530_tape_byte(c1530_t* sys, uint32_t pos) {
+    CHIPS_ASSERT(sys && sys->valid);
+    if (pos >= sys->size) {
+        return 0;
+    }
+    return chips_tape_byte(&sys->tape, sizeof(_c1530_tap_header) + pos);
+}
+
 void c1530_play(c1530_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     /* motor on, play button down */
@@ -235,6 +251,7 @@ bool c1530_is_motor_on(c1530_t* sys) {
 void c1530_remove_tape(c1530_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     c1530_stop(sys);
+    chips_tape_remove(&sys->tape);
     sys->size = 0;
     sys->pos = 0;
     sys->pulse_count = 0;
@@ -250,11 +267,11 @@ void c1530_tick(c1530_t* sys) {
     *sys->cas_port &= ~C1530_CASPORT_READ;
     if (c1530_is_motor_on(sys) && (sys->size > 0) && (sys->pos <= sys->size)) {
         if (sys->pulse_count == 0) {
-            uint8_t val = sys->buf[sys->pos++];
+            uint8_t val = c1530_tape_byte(sys, sys->pos++);
             if (val == 0) {
                 uint8_t s[3];
                 for (int i = 0; i < 3; i++) {
-                    s[i] = sys->buf[sys->pos++];
+                    s[i] = c1530_tape_byte(sys, sys->pos++);
                 }
                 sys->pulse_count = (s[2]<<16) | (s[1]<<8) | s[0];
             }
@@ -272,11 +289,15 @@ void c1530_tick(c1530_t* sys) {
 void c1530_snapshot_onsave(c1530_t* snapshot) {
     CHIPS_ASSERT(snapshot);
     snapshot->cas_port = 0;
+    chips_tape_snapshot_onsave(&snapshot->tape);
 }
 
 void c1530_snapshot_onload(c1530_t* snapshot, c1530_t* sys) {
     CHIPS_ASSERT(snapshot && sys);
     snapshot->cas_port = sys->cas_port;
+    chips_tape_snapshot_onload(&snapshot->tape, &sys->tape);
+    /* the position is kept, but the tape data belongs to the current tape */
+    snapshot->size = sys->size;
 }
 
 #endif /* CHIPS_IMPL */
@@ -25,6 +25,129 @@
     - chips/m6522.h
     - chips/mem.h
 
+    ## Disc Images and Drive Mechanics
+
+    Disc images are inserted with c1541_insert_disc(), supported formats
+    are .d64 (35 or 40 tracks, with or without error info, the error info
+    is currently ignored) and .g64. Discs are read-only, the write protect
+    sensor always reports a protected disc.
+
+    The disc image data is not copied, it must remain valid and unchanged
+    until the disc is removed. Snapshots contain the disc geometry but not
+    the disc image, when a snapshot is loaded, the same disc image must be
+    inserted in the c1541_t instance the snapshot is loaded into, otherwise
+    the disc is removed.
+
+    The drive reads a GCR encoded bitstream per track, for .g64 images this
+    is read directly from the image's track data (only full tracks are used,
+    the read head doesn't see any data on half tracks). For .d64 images, the
+    track under the read head is encoded into the standard 1541 GCR track
+    layout in a single-track buffer, and encoded again when the head has
+    moved to another track.
+
+    The drive mechanics are connected to VIA-2:
+
+    - PB0..PB1: stepper motor phase (out)
+    - PB2:      spindle motor on (out)
+    - PB3:      drive LED (out)
+    - PB4:      write protect sense (in, 0: write protected)
+    - PB5..PB6: bit rate / speed zone (out)
+    - PB7:      SYNC (in, 0: SYNC mark under the read head)
+    - PA0..PA7: last byte read from the disc (in)
+    - CA1:      BYTE READY (in, active low)
+    - CA2:      BYTE READY enable (out)
+
+    When BYTE READY is enabled, each byte read from the disc also sets the
+    CPU's V flag, like the CPU's SO pin on the real hardware.
+
+    ## The IEC Serial Bus
+
+    The ATN, CLK and DATA lines of the IEC bus are open-collector lines,
+    a line is low when any device on the bus pulls it low. The host
+    computer and the drive each keep a bit mask of the lines they are
+    pulling low (C1541_IECPORT_* bits), the state of the bus is the
+    bitwise OR of both masks.
+
+    ## Running the drive on its own thread
+
+    By default the drive is ticked from the host computer's tick function
+    by calling c1541_tick(), the drive then reads the host's IEC lines
+    from the shared byte provided in c1541_desc_t.iec_port.
+
+    When c1541_desc_t.thread points to a c1541_thread_t, the drive runs
+    decoupled from the host on a separate thread (this requires defining
+    CHIPS_THREADS, see chips_common.h). The host and drive exchange their IEC
+    line changes through two single-producer/single-consumer queues, each
+    change is timestamped with the tick it happened in. The drive runs
+    ahead of the host's published progress by a bounded number of ticks,
+    assuming that the host's IEC lines don't change. If a host line change
+    arrives for a tick the drive has already executed, the drive rolls
+    back to a saved checkpoint and executes the ticks again. Drive line
+    changes are only made visible to the host once they can no longer
+    be rolled back, and the host only waits for the drive when it
+    actually reads the IEC lines. The results are the same as when
+    ticking the drive with c1541_tick() right before each host tick.
+
+    The lookahead adapts to the IEC bus traffic: it's reduced after each
+    rollback, and grows again while the drive runs without rollbacks.
+    This mode is useful when there is little IEC bus traffic (e.g. while
+    the drive is idle or reading from disc), during tight handshaking
+    the drive mostly runs in lockstep with the host.
+
+    The host side calls these functions from its own thread:
+
+    ~~~C
+    void c1541_iec_begin(c1541_t* sys, uint64_t end_tick)
+    ~~~
+        Call at the start of each host exec call with the host tick where
+        the call is expected to end.
+
+    ~~~C
+    void c1541_iec_write(c1541_t* sys, uint64_t tick, uint8_t lines)
+    ~~~
+        Publish a change of the IEC lines pulled low by the host in the
+        given host tick (ticks are counted from 1).
+
+    ~~~C
+    void c1541_iec_sync(c1541_t* sys, uint64_t tick)
+    ~~~
+        Publish the host's progress: all host line changes up to and
+        including the given tick have been published. Call this regularly
+        (e.g. every few dozen ticks) so that the drive can move forward.
+
+    ~~~C
+    uint8_t c1541_iec_read(c1541_t* sys, uint64_t tick)
+    ~~~
+        Return the IEC lines pulled low by the drive in the given host
+        tick, this waits for the drive thread to catch up. The host must
+        not change its own lines in the same tick.
+
+    ~~~C
+    void c1541_iec_end(c1541_t* sys, uint64_t tick)
+    ~~~
+        Call at the end of each host exec call with the last executed
+        host tick.
+
+    ...while the drive thread calls:
+
+    ~~~C
+    uint32_t c1541_exec_threaded(c1541_t* sys)
+    ~~~
+        Run the drive until the matching c1541_iec_end() call, the
+        drive ends at the same tick as the host. Returns the number
+        of executed ticks (including ticks executed again after a rollback).
+
+    Each c1541_exec_threaded() call must be paired with one host exec
+    call (from c1541_iec_begin() to c1541_iec_end()), wait for both
+    threads to finish before touching the drive or host state
+    from anywhere else (e.g. to take a snapshot or insert a disc).
+
+    The c1541_thread_t struct is owned by the caller and must outlive the
+    c1541_t. It only contains transient state for exchanging IEC line
+    changes (queues, checkpoints, progress counters), when both threads
+    are idle the drive state in c1541_t is complete. The thread state
+    isn't part of snapshots, it's reset when a snapshot is loaded.
+
     ## zlib/libpng license
 
     Copyright (c) 2019 Andre Weissflog
@@ -46,6 +169,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdalign.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -60,10 +184,101 @@ extern "C" {
 
 #define C1541_FREQUENCY (1000000)
 
+#define C1541_MAX_TRACKS (42)           // max number of full tracks on a disc
+#define C1541_MAX_TRACK_SIZE (7928)     // max number of GCR bytes per track
+
+#define C1541_IEC_QUEUE_SIZE (256)      // max number of in-flight IEC line changes per direction (must be 2^N)
+#define C1541_MAX_CHECKPOINTS (8)       // max number of saved drive states for rollback
+#define C1541_MIN_LOOKAHEAD (16)        // min number of ticks the drive thread runs ahead of the host
+#define C1541_MAX_LOOKAHEAD (1024)      // max number of ticks the drive thread runs ahead of the host
+
+// drive mechanics and read head state
+typedef struct {
+    uint8_t halftrack;          // head position in half tracks (0: track 1)
+    uint8_t stepper;            // last stepper motor phase (VIA-2 PB0..PB1)
+    uint8_t zone;               // current speed zone (VIA-2 PB5..PB6)
+    bool motor;                 // spindle motor on
+    bool sync;                  // SYNC mark under the read head
+    bool byte_ready;            // BYTE READY active
+    uint8_t bit_count;          // number of bits read since last byte or SYNC
+    uint8_t data;               // last byte read from disc
+    uint16_t shift;             // read shift register (last 10 bits)
+    uint16_t bit_clock;         // bit clock in 1/8 ticks
+    uint32_t bit_pos;           // read position in current track in bits
+} c1541_drive_t;
+
+// an inserted disc, the disc image is not copied
+typedef struct {
+    bool inserted;
+    bool g64;                                       // true if .g64 image, false if .d64 image
+    uint8_t num_tracks;                             // number of tracks in .d64 image (0 for .g64)
+    uint8_t id[2];                                  // disc id (from .d64 BAM)
+    const uint8_t* image;                           // disc image data (not part of snapshots)
+    uint32_t image_size;                            // disc image size in bytes
+    uint32_t track_offset[C1541_MAX_TRACKS];        // offset of track data in image (.d64 sectors or .g64 GCR bytes)
+    uint16_t track_size[C1541_MAX_TRACKS];          // GCR bytes per track (0: unformatted)
+    int gcr_track;                                  // track (0-based) encoded in gcr, or -1
+    uint8_t gcr[C1541_MAX_TRACK_SIZE];              // GCR data of the .d64 track under the read head
+} c1541_disc_t;
+
+// a timestamped change of the IEC lines pulled low by the host or drive
+typedef struct {
+    uint64_t tick;
+    uint8_t lines;
+} c1541_iec_event_t;
+
+// a single-producer/single-consumer queue of IEC line changes
+typedef struct {
+    c1541_iec_event_t events[C1541_IEC_QUEUE_SIZE];
+    uint32_t wr_pos;                // only written by producer
+    alignas(64) uint32_t rd_pos;    // only written by consumer
+} c1541_iec_queue_t;
+
+// a saved drive state to roll back to
+typedef struct {
+    uint64_t tick;
+    uint64_t pins;
+    m6502_t cpu;
+    m6522_t via_1;
+    m6522_t via_2;
+    uint8_t host_lines;
+    uint8_t iec_lines;
+    uint32_t host_pos;
+    c1541_drive_t drive;
+    uint8_t ram[0x0800];
+} c1541_checkpoint_t;
+
+// state for running the drive on its own thread (see c1541_exec_threaded())
+typedef struct {
+    c1541_iec_queue_t host_queue;   // host line changes, from host to drive
+    c1541_iec_queue_t drive_queue;  // committed drive line changes, from drive to host
+    uint64_t end_tick;              // expected end of current host exec call (written by host)
+    uint32_t begin_epoch;           // number of started host exec calls (written by host)
+    uint32_t end_epoch;             // number of finished host exec calls (written by host)
+    alignas(64) uint64_t host_tick; // host progress (written by host)
+    alignas(64) uint64_t commit_tick;   // drive progress which can't be rolled back (written by drive)
+    // private to host thread
+    uint8_t drive_lines;            // drive lines as seen by the host
+    // private to drive thread
+    uint32_t epoch;                 // number of c1541_exec_threaded() calls
+    uint32_t host_pos;              // next host line change to apply
+    uint32_t host_wr;               // host queue write position as last seen by drive
+    uint32_t lookahead;             // current number of ticks to run ahead of the host
+    uint32_t num_rollbacks;
+    int first_checkpoint;
+    int num_checkpoints;
+    uint32_t pending_rd;
+    uint32_t pending_wr;
+    c1541_iec_event_t pending[C1541_IEC_QUEUE_SIZE];    // drive line changes not yet committed
+    c1541_checkpoint_t checkpoints[C1541_MAX_CHECKPOINTS];
+} c1541_thread_t;
+
 // config params for c1541_init()
 typedef struct {
-    // pointer to a shared byte with IEC serial bus line state
+    // pointer to a shared byte with the IEC lines pulled low by the host
     uint8_t* iec_port;
+    // optional: run the drive on its own thread with this state (see c1541_exec_threaded())
+    c1541_thread_t* thread;
     // rom images
     struct {
         chips_range_t c000_dfff;
@@ -80,6 +295,12 @@ typedef struct {
     m6522_t via_2;
     bool valid;
     mem_t mem;
+    uint64_t tick;              // drive ticks since power-on
+    uint8_t host_lines;         // IEC lines pulled low by the host, as seen by the drive
+    uint8_t iec_lines;          // IEC lines pulled low by the drive
+    c1541_drive_t drive;        // drive mechanics
+    c1541_disc_t disc;          // inserted disc
+    c1541_thread_t* thread;     // optional state for running the drive on its own thread (not part of snapshots)
     uint8_t ram[0x0800];
     uint8_t rom[0x4000];
 } c1541_t;
@@ -92,10 +313,30 @@ void c1541_discard(c1541_t* sys);
 void c1541_reset(c1541_t* sys);
 // tick a c1541_t instance forward
 void c1541_tick(c1541_t* sys);
-// insert a disc image file (.d64)
-void c1541_insert_disc(c1541_t* sys, chips_range_t data);
+// threaded mode, host side: start of a host exec call which is expected to end at end_tick
+void c1541_iec_begin(c1541_t* sys, uint64_t end_tick);
+// threaded mode, host side: publish a change of the host's IEC lines in the given host tick
+void c1541_iec_write(c1541_t* sys, uint64_t tick, uint8_t lines);
+// threaded mode, host side: publish host progress, all host line changes up to tick have been written
+void c1541_iec_sync(c1541_t* sys, uint64_t tick);
+// threaded mode, host side: get the drive's IEC lines in the given host tick (waits for the drive)
+uint8_t c1541_iec_read(c1541_t* sys, uint64_t tick);
+// threaded mode, host side: end of a host exec call, tick is the last executed host tick
+void c1541_iec_end(c1541_t* sys, uint64_t tick);
+#if defined(CHIPS_THREADS)
+// threaded mode, drive side: run the drive until the matching c1541_iec_end(), return executed ticks
+uint32_t c1541_exec_threaded(c1541_t* sys);
+#endif
+// insert a disc image file (.d64 or .g64)
+bool c1541_insert_disc(c1541_t* sys, chips_range_t data);
 // remove current disc
 void c1541_remove_disc(c1541_t* sys);
+// return true if a disc is inserted
+bool c1541_disc_inserted(c1541_t* sys);
+// get a 256-byte sector of the inserted .d64 disc (1-based track), or 0 if not available
+const uint8_t* c1541_disc_sector(c1541_t* sys, int track, int sector);
+// find a PRG file in the directory of the inserted .d64 disc (supports * and ? wildcards)
+bool c1541_find_file(c1541_t* sys, const uint8_t* name, int name_len, int* out_track, int* out_sector);
 // prepare a c1541_t snapshot for saving
 void c1541_snapshot_onsave(c1541_t* snapshot, void* base);
 // prepare a c1541_t snapshot for loading
@@ -113,11 +354,32 @@ void c1541_snapshot_onload(c1541_t* snapshot, c1541_t* sys, void* base);
     #define CHIPS_ASSERT(c) assert(c)
 #endif
 
+#define _C1541_IEC_QUEUE_MASK (C1541_IEC_QUEUE_SIZE - 1)
+#define _C1541_GCR_SECTOR_SIZE (354)    // GCR bytes per sector without gap (2 SYNCs, header, header gap, data)
+
+// bring the thread state in sync with the drive state, both threads must be idle
+static void _c1541_thread_reset(c1541_t* sys) {
+    c1541_thread_t* th = sys->thread;
+    memset(th, 0, sizeof(c1541_thread_t));
+    th->host_tick = sys->tick;
+    th->commit_tick = sys->tick;
+    th->drive_lines = sys->iec_lines;
+    th->lookahead = C1541_MAX_LOOKAHEAD;
+}
+
 void c1541_init(c1541_t* sys, const c1541_desc_t* desc) {
     CHIPS_ASSERT(sys && desc);
+    CHIPS_ASSERT(desc->thread || desc->iec_port);
+#if !defined(CHIPS_THREADS)
+    CHIPS_ASSERT(0 == desc->thread);    // threaded mode requires CHIPS_THREADS
+#endif
 
     memset(sys, 0, sizeof(c1541_t));
     sys->valid = true;
+    sys->iec = desc->iec_port;
+    sys->thread = desc->thread;
+    sys->drive.halftrack = 34;  // track 18
+    sys->disc.gcr_track = -1;
 
     // copy ROM images
     CHIPS_ASSERT(desc->roms.c000_dfff.ptr && (0x2000 == desc->roms.c000_dfff.size));
@@ -136,6 +398,9 @@ void c1541_init(c1541_t* sys, const c1541_desc_t* desc) {
     mem_init(&sys->mem);
     mem_map_ram(&sys->mem, 0, 0x0000, 0x0800, sys->ram);
     mem_map_rom(&sys->mem, 0, 0xC000, 0x4000, sys->rom);
+    if (sys->thread) {
+        _c1541_thread_reset(sys);
+    }
 }
 
 void c1541_discard(c1541_t* sys) {
@@ -150,36 +415,723 @@ void c1541_reset(c1541_t* sys) {
     m6522_reset(&sys->via_2);
 }
 
-void c1541_tick(c1541_t* sys) {
-    uint64_t pins = sys->pins;
+/*=== DISC IMAGES AND DRIVE MECHANICS =======================================*/
+
+// number of sectors per track (1-based)
+static int _c1541_num_sectors(int track) {
+    if (track <= 17) {
+        return 21;
+    }
+    else if (track <= 24) {
+        return 19;
+    }
+    else if (track <= 30) {
+        return 18;
+    }
+    else {
+        return 17;
+    }
+}
+
+// GCR track size in bytes written by the DOS, by track (1-based)
+static int _c1541_track_capacity(int track) {
+    if (track <= 17) {
+        return 7692;
+    }
+    else if (track <= 24) {
+        return 7142;
+    }
+    else if (track <= 30) {
+        return 6666;
+    }
+    else {
+        return 6250;
+    }
+}
 
-    pins = m6502_tick(&sys->cpu, pins);
+// encode 4 bytes into 5 GCR bytes
+static void _c1541_gcr_encode(const uint8_t* src, uint8_t* dst) {
+    static const uint8_t gcr[16] = {
+        0x0A, 0x0B, 0x12, 0x13, 0x0E, 0x0F, 0x16, 0x17,
+        0x09, 0x19, 0x1A, 0x1B, 0x0D, 0x1D, 0x1E, 0x15,
+    };
+    uint64_t bits = 0;
+    for (int i = 0; i < 4; i++) {
+        bits = (bits << 10) | (uint64_t)(gcr[src[i] >> 4] << 5) | gcr[src[i] & 0x0F];
+    }
+    for (int i = 0; i < 5; i++) {
+        dst[i] = (uint8_t)(bits >> (32 - i * 8));
+    }
+}
+
+// encode a .d64 track (0-based) into the standard DOS track layout in the GCR track buffer
+static void _c1541_encode_d64_track(c1541_disc_t* disc, int track_index) {
+    CHIPS_ASSERT((track_index >= 0) && (track_index < disc->num_tracks));
+    disc->gcr_track = track_index;
+    const int track = track_index + 1;
+    const uint8_t* src = &disc->image[disc->track_offset[track_index]];
+    uint8_t* dst = disc->gcr;
+    const int num_sectors = _c1541_num_sectors(track);
+    const int size = _c1541_track_capacity(track);
+    const int gap = (size - num_sectors * _C1541_GCR_SECTOR_SIZE) / num_sectors;
+    int pos = 0;
+    for (int sector = 0; sector < num_sectors; sector++, src += 256) {
+        // SYNC, header block and header gap
+        memset(&dst[pos], 0xFF, 5);
+        pos += 5;
+        const uint8_t header[8] = {
+            0x08,
+            (uint8_t)(sector ^ track ^ disc->id[1] ^ disc->id[0]),
+            (uint8_t)sector,
+            (uint8_t)track,
+            disc->id[1],
+            disc->id[0],
+            0x0F,
+            0x0F,
+        };
+        _c1541_gcr_encode(&header[0], &dst[pos]);
+        _c1541_gcr_encode(&header[4], &dst[pos + 5]);
+        pos += 10;
+        memset(&dst[pos], 0x55, 9);
+        pos += 9;
+        // SYNC, data block and inter-sector gap
+        memset(&dst[pos], 0xFF, 5);
+        pos += 5;
+        uint8_t data[260];
+        data[0] = 0x07;
+        memcpy(&data[1], src, 256);
+        uint8_t chksum = 0;
+        for (int i = 0; i < 256; i++) {
+            chksum ^= src[i];
+        }
+        data[257] = chksum;
+        data[258] = data[259] = 0x00;
+        for (int i = 0; i < 260; i += 4) {
+            _c1541_gcr_encode(&data[i], &dst[pos]);
+            pos += 5;
+        }
+        memset(&dst[pos], 0x55, (size_t)gap);
+        pos += gap;
+    }
+    memset(&dst[pos], 0x55, (size_t)(size - pos));
+}
+
+static uint32_t _c1541_rd32(const uint8_t* ptr) {
+    return (uint32_t)ptr[0] | ((uint32_t)ptr[1]<<8) | ((uint32_t)ptr[2]<<16) | ((uint32_t)ptr[3]<<24);
+}
+
+// validate a .g64 image and locate its full tracks
+static bool _c1541_parse_g64(c1541_disc_t* disc, const uint8_t* ptr, size_t size) {
+    const int num_halftracks = ptr[9];
+    if (size < (12 + (size_t)num_halftracks * 4)) {
+        return false;
+    }
+    for (int i = 0; (i < num_halftracks) && (i < (C1541_MAX_TRACKS * 2)); i += 2) {
+        const int track_index = i / 2;
+        const uint32_t offset = _c1541_rd32(&ptr[12 + i * 4]);
+        if (0 == offset) {
+            continue;
+        }
+        if (((size_t)offset + 2) > size) {
+            return false;
+        }
+        const uint32_t len = (uint32_t)ptr[offset] | ((uint32_t)ptr[offset+1]<<8);
+        if ((len > C1541_MAX_TRACK_SIZE) || (((size_t)offset + 2 + len) > size)) {
+            return false;
+        }
+        disc->track_offset[track_index] = offset + 2;
+        disc->track_size[track_index] = (uint16_t)len;
+    }
+    return true;
+}
+
+// return the track (0-based) under the read head, or -1 if no data can be read
+static inline int _c1541_track_index(const c1541_t* sys) {
+    if (!sys->disc.inserted || (sys->drive.halftrack & 1)) {
+        return -1;
+    }
+    return sys->drive.halftrack >> 1;
+}
+
+// return the GCR data of a formatted track (0-based), encode .d64 tracks on demand
+static inline const uint8_t* _c1541_track_data(c1541_disc_t* disc, int track_index) {
+    if (disc->g64) {
+        return &disc->image[disc->track_offset[track_index]];
+    }
+    if (disc->gcr_track != track_index) {
+        _c1541_encode_d64_track(disc, track_index);
+    }
+    return disc->gcr;
+}
+
+// advance the drive mechanics by one tick, return true if a byte has been read
+static bool _c1541_tick_drive(c1541_t* sys, uint8_t pb) {
+    c1541_drive_t* drv = &sys->drive;
+    // stepper motor phase change moves the head by a half track in or out
+    const uint8_t stepper = pb & 3;
+    if (stepper != drv->stepper) {
+        if (stepper == ((drv->stepper + 1) & 3)) {
+            if (drv->halftrack < ((C1541_MAX_TRACKS * 2) - 1)) {
+                drv->halftrack++;
+            }
+        }
+        else if (stepper == ((drv->stepper - 1) & 3)) {
+            if (drv->halftrack > 0) {
+                drv->halftrack--;
+            }
+        }
+        drv->stepper = stepper;
+    }
+    drv->motor = 0 != (pb & (1<<2));
+    drv->zone = (pb >> 5) & 3;
+    if (!drv->motor) {
+        return false;
+    }
+    // one bit cell is 26/8 (zone 3) to 32/8 (zone 0) ticks
+    const uint16_t bit_cell = (uint16_t)(32 - 2 * drv->zone);
+    drv->bit_clock += 8;
+    if (drv->bit_clock < bit_cell) {
+        return false;
+    }
+    drv->bit_clock -= bit_cell;
+    drv->byte_ready = false;
+    uint8_t bit = 0;
+    const int track_index = _c1541_track_index(sys);
+    if (track_index >= 0) {
+        const uint32_t num_bits = (uint32_t)sys->disc.track_size[track_index] * 8;
+        if (num_bits > 0) {
+            if (drv->bit_pos >= num_bits) {
+                drv->bit_pos %= num_bits;
+            }
+            const uint8_t* gcr = _c1541_track_data(&sys->disc, track_index);
+            bit = (gcr[drv->bit_pos >> 3] >> (7 - (drv->bit_pos & 7))) & 1;
+            drv->bit_pos++;
+        }
+    }
+    // 10 or more 1-bits in a row are a SYNC mark, the first 0-bit after SYNC starts a new byte
+    drv->shift = ((drv->shift << 1) | bit) & 0x3FF;
+    drv->sync = (drv->shift == 0x3FF);
+    if (drv->sync) {
+        drv->bit_count = 0;
+    }
+    else if (++drv->bit_count == 8) {
+        drv->bit_count = 0;
+        drv->data = (uint8_t)drv->shift;
+        drv->byte_ready = true;
+        return true;
+    }
+    return false;
+}
+
+/* drive tick function, returns true if the IEC lines pulled low by the drive have changed
+
+    Memory map (partially decoded):
+
+    0000..07FF: RAM
+    1800..180F: VIA-1 (IEC serial bus)
+    1C00..1C0F: VIA-2 (drive mechanics)
+    C000..FFFF: ROM
+*/
+static bool _c1541_tick(c1541_t* sys) {
+    uint64_t pins = m6502_tick(&sys->cpu, sys->pins);
     const uint16_t addr = M6502_GET_ADDR(pins);
 
-    if (pins & M6502_RW) {
+    // the IRQ pin is set each tick by the VIAs
+    pins &= ~M6502_IRQ;
+
+    uint64_t via1_pins = pins & M6502_PIN_MASK;
+    uint64_t via2_pins = pins & M6502_PIN_MASK;
+    if ((addr & 0x9800) == 0x1800) {
+        if (addr & 0x0400) {
+            via2_pins |= M6522_CS1;
+        }
+        else {
+            via1_pins |= M6522_CS1;
+        }
+    }
+    else if (pins & M6502_RW) {
         M6502_SET_DATA(pins, mem_rd(&sys->mem, addr));
     }
     else {
         mem_wr(&sys->mem, addr, M6502_GET_DATA(pins));
     }
 
+    /* tick VIA-1
+
+        Port B:
+            PB0:    in:  DATA (1 = line is low)
+            PB1:    out: DATA (1 = pull line low)
+            PB2:    in:  CLK
+            PB3:    out: CLK
+            PB4:    out: ATN acknowledge
+            PB5,6:  in:  device address jumpers (open: device 8)
+            PB7:    in:  ATN
+        CA1:        in:  ATN
+
+        The DATA line is also pulled low by hardware when the ATN
+        input and the ATN acknowledge output differ. Unconnected
+        and input port pins read as high.
+    */
+    uint8_t pb;
+    {
+        const uint8_t bus = sys->host_lines | sys->iec_lines;
+        pb = (1<<1)|(1<<3)|(1<<4);
+        if (bus & C1541_IECPORT_DATA) {
+            pb |= (1<<0);
+        }
+        if (bus & C1541_IECPORT_CLK) {
+            pb |= (1<<2);
+        }
+        if (bus & C1541_IECPORT_ATN) {
+            pb |= (1<<7);
+            via1_pins |= M6522_CA1;
+        }
+        M6522_SET_PAB(via1_pins, 0xFF, pb);
+        via1_pins = m6522_tick(&sys->via_1, via1_pins);
+        pb = M6522_GET_PB(via1_pins);
+        if (via1_pins & M6522_IRQ) {
+            pins |= M6502_IRQ;
+        }
+        if ((via1_pins & (M6522_CS1|M6522_RW)) == (M6522_CS1|M6522_RW)) {
+            pins = M6502_COPY_DATA(pins, via1_pins);
+        }
+    }
+
+    // tick VIA-2 (drive mechanics, see header documentation)
+    {
+        uint8_t pb_in = 0xFF;
+        if (sys->drive.sync) {
+            pb_in &= ~(1<<7);
+        }
+        if (sys->disc.inserted) {
+            pb_in &= ~(1<<4);
+        }
+        M6522_SET_PAB(via2_pins, sys->drive.data, pb_in);
+        if (!sys->drive.byte_ready) {
+            via2_pins |= M6522_CA1;
+        }
+        via2_pins = m6522_tick(&sys->via_2, via2_pins);
+        if (via2_pins & M6522_IRQ) {
+            pins |= M6502_IRQ;
+        }
+        if ((via2_pins & (M6522_CS1|M6522_RW)) == (M6522_CS1|M6522_RW)) {
+            pins = M6502_COPY_DATA(pins, via2_pins);
+        }
+        // BYTE READY is also connected to the CPU's SO pin which sets the V flag
+        if (_c1541_tick_drive(sys, M6522_GET_PB(via2_pins)) && (via2_pins & M6522_CA2)) {
+            sys->cpu.P |= M6502_VF;
+        }
+    }
     sys->pins = pins;
+
+    // update IEC lines pulled low by the drive
+    uint8_t lines = 0;
+    if (pb & (1<<1)) {
+        lines |= C1541_IECPORT_DATA;
+    }
+    if (pb & (1<<3)) {
+        lines |= C1541_IECPORT_CLK;
+    }
+    if ((0 != (sys->host_lines & C1541_IECPORT_ATN)) != (0 != (pb & (1<<4)))) {
+        lines |= C1541_IECPORT_DATA;
+    }
+    const bool changed = lines != sys->iec_lines;
+    sys->iec_lines = lines;
+    return changed;
+}
+
+void c1541_tick(c1541_t* sys) {
+    CHIPS_ASSERT(!sys->thread);
+    sys->host_lines = *sys->iec;
+    sys->tick++;
+    _c1541_tick(sys);
+}
+
+/*=== THREADED MODE, HOST SIDE ===============================================*/
+void c1541_iec_begin(c1541_t* sys, uint64_t end_tick) {
+    CHIPS_ASSERT(sys && sys->valid && sys->thread);
+    sys->thread->end_tick = end_tick;
+    _chips_store_release32(&sys->thread->begin_epoch, sys->thread->begin_epoch + 1);
 }
 
-void c1541_insert_disc(c1541_t* sys, chips_range_t data) {
-    // FIXME
-    (void)sys;
-    (void)data;
+// apply committed drive line changes up to the host tick
+static void _c1541_iec_drain(c1541_t* sys, uint64_t tick) {
+    c1541_iec_queue_t* q = &sys->thread->drive_queue;
+    uint32_t rd_pos = q->rd_pos;
+    const uint32_t wr_pos = _chips_load_acquire32(&q->wr_pos);
+    while ((rd_pos != wr_pos) && (q->events[rd_pos & _C1541_IEC_QUEUE_MASK].tick <= tick)) {
+        sys->thread->drive_lines = q->events[rd_pos & _C1541_IEC_QUEUE_MASK].lines;
+        rd_pos++;
+    }
+    if (rd_pos != q->rd_pos) {
+        _chips_store_release32(&q->rd_pos, rd_pos);
+    }
+}
+
+void c1541_iec_sync(c1541_t* sys, uint64_t tick) {
+    CHIPS_ASSERT(sys && sys->valid && sys->thread);
+    _chips_store_release64(&sys->thread->host_tick, tick);
+    _c1541_iec_drain(sys, tick);
+}
+
+void c1541_iec_write(c1541_t* sys, uint64_t tick, uint8_t lines) {
+    CHIPS_ASSERT(sys && sys->valid && sys->thread && (tick > sys->thread->host_tick));
+    c1541_iec_queue_t* q = &sys->thread->host_queue;
+    const uint32_t wr_pos = q->wr_pos;
+    if ((wr_pos - _chips_load_acquire32(&q->rd_pos)) == C1541_IEC_QUEUE_SIZE) {
+        // queue is full, let the drive catch up to the previous tick
+        c1541_iec_sync(sys, tick - 1);
+        uint32_t spin_count = 0;
+        while ((wr_pos - _chips_load_acquire32(&q->rd_pos)) == C1541_IEC_QUEUE_SIZE) {
+            // spin until the drive thread has released an item, the drive may be waiting for the host in turn
+            _c1541_iec_drain(sys, tick - 1);
+            _chips_spin_wait(&spin_count);
+        }
+    }
+    c1541_iec_event_t* ev = &q->events[wr_pos & _C1541_IEC_QUEUE_MASK];
+    ev->tick = tick;
+    ev->lines = lines;
+    _chips_store_release32(&q->wr_pos, wr_pos + 1);
+}
+
+uint8_t c1541_iec_read(c1541_t* sys, uint64_t tick) {
+    CHIPS_ASSERT(sys && sys->valid && sys->thread);
+    // the host doesn't change its lines in this tick, so the drive may run up to and including this tick
+    c1541_iec_sync(sys, tick);
+    uint32_t spin_count = 0;
+    while (_chips_load_acquire64(&sys->thread->commit_tick) < tick) {
+        // spin until the drive thread has caught up
+        _c1541_iec_drain(sys, tick);
+        _chips_spin_wait(&spin_count);
+    }
+    _c1541_iec_drain(sys, tick);
+    return sys->thread->drive_lines;
+}
+
+void c1541_iec_end(c1541_t* sys, uint64_t tick) {
+    CHIPS_ASSERT(sys && sys->valid && sys->thread);
+    c1541_iec_sync(sys, tick);
+    _chips_store_release32(&sys->thread->end_epoch, sys->thread->end_epoch + 1);
+}
+
+/*=== THREADED MODE, DRIVE SIDE ==============================================*/
+static void _c1541_save_checkpoint(c1541_t* sys) {
+    if (sys->thread->num_checkpoints > 0) {
+        const int last = (sys->thread->first_checkpoint + sys->thread->num_checkpoints - 1) % C1541_MAX_CHECKPOINTS;
+        if (sys->thread->checkpoints[last].tick == sys->tick) {
+            return;
+        }
+    }
+    CHIPS_ASSERT(sys->thread->num_checkpoints < C1541_MAX_CHECKPOINTS);
+    const int index = (sys->thread->first_checkpoint + sys->thread->num_checkpoints++) % C1541_MAX_CHECKPOINTS;
+    c1541_checkpoint_t* cp = &sys->thread->checkpoints[index];
+    cp->tick = sys->tick;
+    cp->pins = sys->pins;
+    cp->cpu = sys->cpu;
+    cp->via_1 = sys->via_1;
+    cp->via_2 = sys->via_2;
+    cp->host_lines = sys->host_lines;
+    cp->iec_lines = sys->iec_lines;
+    cp->host_pos = sys->thread->host_pos;
+    cp->drive = sys->drive;
+    memcpy(cp->ram, sys->ram, sizeof(cp->ram));
+}
+
+// roll back to the latest checkpoint at or before tick, and discard the later checkpoints
+static void _c1541_rollback(c1541_t* sys, uint64_t tick) {
+    CHIPS_ASSERT(sys->thread->num_checkpoints > 0);
+    const c1541_checkpoint_t* cp = 0;
+    while (sys->thread->num_checkpoints > 0) {
+        const int index = (sys->thread->first_checkpoint + sys->thread->num_checkpoints - 1) % C1541_MAX_CHECKPOINTS;
+        cp = &sys->thread->checkpoints[index];
+        if (cp->tick <= tick) {
+            break;
+        }
+        sys->thread->num_checkpoints--;
+    }
+    CHIPS_ASSERT(cp && (cp->tick <= tick));
+    sys->tick = cp->tick;
+    sys->pins = cp->pins;
+    sys->cpu = cp->cpu;
+    sys->via_1 = cp->via_1;
+    sys->via_2 = cp->via_2;
+    sys->host_lines = cp->host_lines;
+    sys->iec_lines = cp->iec_lines;
+    sys->thread->host_pos = cp->host_pos;
+    sys->drive = cp->drive;
+    memcpy(sys->ram, cp->ram, sizeof(sys->ram));
+    // discard the drive line changes after the checkpoint
+    while ((sys->thread->pending_wr != sys->thread->pending_rd) &&
+           (sys->thread->pending[(sys->thread->pending_wr - 1) & _C1541_IEC_QUEUE_MASK].tick > cp->tick))
+    {
+        sys->thread->pending_wr--;
+    }
+    sys->thread->num_rollbacks++;
+}
+
+// fetch new host line changes, and roll back if the drive has already run past one of them
+static void _c1541_fetch_host_lines(c1541_t* sys) {
+    const uint32_t wr_pos = _chips_load_acquire32(&sys->thread->host_queue.wr_pos);
+    if (wr_pos != sys->thread->host_wr) {
+        // a host line change in tick t affects drive ticks after t
+        const uint64_t tick = sys->thread->host_queue.events[sys->thread->host_wr & _C1541_IEC_QUEUE_MASK].tick;
+        if (tick < sys->tick) {
+            _c1541_rollback(sys, tick);
+            sys->thread->lookahead = C1541_MIN_LOOKAHEAD;
+        }
+        sys->thread->host_wr = wr_pos;
+    }
+}
+
+// make the drive line changes up to tick visible to the host, and release state which is no longer needed for rollback
+static void _c1541_commit(c1541_t* sys, uint64_t tick) {
+    if (tick > sys->tick) {
+        tick = sys->tick;
+    }
+    c1541_iec_queue_t* q = &sys->thread->drive_queue;
+    while ((sys->thread->pending_rd != sys->thread->pending_wr) &&
+           (sys->thread->pending[sys->thread->pending_rd & _C1541_IEC_QUEUE_MASK].tick <= tick))
+    {
+        const uint32_t wr_pos = q->wr_pos;
+        uint32_t spin_count = 0;
+        while ((wr_pos - _chips_load_acquire32(&q->rd_pos)) == C1541_IEC_QUEUE_SIZE) {
+            // spin until the host has consumed an item
+            _chips_spin_wait(&spin_count);
+        }
+        q->events[wr_pos & _C1541_IEC_QUEUE_MASK] = sys->thread->pending[sys->thread->pending_rd++ & _C1541_IEC_QUEUE_MASK];
+        _chips_store_release32(&q->wr_pos, wr_pos + 1);
+    }
+    // keep the latest checkpoint at or before the committed tick, or none if the drive isn't ahead
+    const int num_checkpoints = sys->thread->num_checkpoints;
+    if (tick == sys->tick) {
+        sys->thread->num_checkpoints = 0;
+    }
+    else while ((sys->thread->num_checkpoints > 1) &&
+           (sys->thread->checkpoints[(sys->thread->first_checkpoint + 1) % C1541_MAX_CHECKPOINTS].tick <= tick))
+    {
+        sys->thread->first_checkpoint = (sys->thread->first_checkpoint + 1) % C1541_MAX_CHECKPOINTS;
+        sys->thread->num_checkpoints--;
+    }
+    // speculative ticks were committed without rollback, look further ahead
+    if ((num_checkpoints != sys->thread->num_checkpoints) && (sys->thread->lookahead < C1541_MAX_LOOKAHEAD)) {
+        sys->thread->lookahead *= 2;
+    }
+    // host line changes before the oldest checkpoint can be released
+    const uint32_t rd_pos = (sys->thread->num_checkpoints > 0) ?
+        sys->thread->checkpoints[sys->thread->first_checkpoint].host_pos :
+        sys->thread->host_pos;
+    if (rd_pos != sys->thread->host_queue.rd_pos) {
+        _chips_store_release32(&sys->thread->host_queue.rd_pos, rd_pos);
+    }
+    if (tick > sys->thread->commit_tick) {
+        _chips_store_release64(&sys->thread->commit_tick, tick);
+    }
+}
+
+// run the drive up to end_tick, return number of executed ticks
+static uint32_t _c1541_run(c1541_t* sys, uint64_t end_tick) {
+    uint32_t num_ticks = 0;
+    const c1541_iec_event_t* host_events = sys->thread->host_queue.events;
+    while (sys->tick < end_tick) {
+        // apply host line changes from before this tick
+        while ((sys->thread->host_pos != sys->thread->host_wr) &&
+               (host_events[sys->thread->host_pos & _C1541_IEC_QUEUE_MASK].tick <= sys->tick))
+        {
+            sys->host_lines = host_events[sys->thread->host_pos++ & _C1541_IEC_QUEUE_MASK].lines;
+        }
+        sys->tick++;
+        num_ticks++;
+        if (_c1541_tick(sys)) {
+            c1541_iec_event_t* ev = &sys->thread->pending[sys->thread->pending_wr++ & _C1541_IEC_QUEUE_MASK];
+            ev->tick = sys->tick;
+            ev->lines = sys->iec_lines;
+            if ((sys->thread->pending_wr - sys->thread->pending_rd) == C1541_IEC_QUEUE_SIZE) {
+                // pending queue is full, wait for the host to move forward
+                break;
+            }
+        }
+    }
+    return num_ticks;
+}
+
+#if defined(CHIPS_THREADS)
+uint32_t c1541_exec_threaded(c1541_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid && sys->thread);
+    const uint32_t epoch = ++sys->thread->epoch;
+    uint32_t spin_count = 0;
+    while ((int32_t)(_chips_load_acquire32(&sys->thread->begin_epoch) - epoch) < 0) {
+        // spin until the host exec call has started
+        _chips_spin_wait(&spin_count);
+    }
+    const uint64_t end_tick = sys->thread->end_tick;
+    uint32_t num_ticks = 0;
+    while (true) {
+        // check for end before fetching the host progress, so that the final progress isn't missed
+        const bool done = (int32_t)(_chips_load_acquire32(&sys->thread->end_epoch) - epoch) >= 0;
+        const uint64_t host_tick = _chips_load_acquire64(&sys->thread->host_tick);
+        _c1541_fetch_host_lines(sys);
+        if (done) {
+            // end at the same tick as the host, throw away any speculative ticks beyond
+            if (sys->tick > host_tick) {
+                _c1541_rollback(sys, host_tick);
+            }
+            while (sys->tick < host_tick) {
+                num_ticks += _c1541_run(sys, host_tick);
+                _c1541_commit(sys, host_tick);
+            }
+            // apply the host line changes of the last tick, so that the drive state is complete between exec calls
+            while (sys->thread->host_pos != sys->thread->host_wr) {
+                sys->host_lines = sys->thread->host_queue.events[sys->thread->host_pos++ & _C1541_IEC_QUEUE_MASK].lines;
+            }
+            _c1541_commit(sys, host_tick);
+            break;
+        }
+        _c1541_commit(sys, host_tick);
+        if (sys->tick < host_tick) {
+            // ticks which can't be affected by later host line changes
+            const uint64_t slice_end = sys->tick + C1541_MAX_LOOKAHEAD;
+            num_ticks += _c1541_run(sys, (slice_end < host_tick) ? slice_end : host_tick);
+        }
+        else {
+            // run ahead of the host, assuming that the host lines don't change
+            uint64_t spec_end = host_tick + sys->thread->lookahead;
+            if (spec_end > end_tick) {
+                spec_end = end_tick;
+            }
+            if ((sys->tick < spec_end) && (sys->thread->num_checkpoints < C1541_MAX_CHECKPOINTS)) {
+                const uint32_t slice = (sys->thread->lookahead / 4) > C1541_MIN_LOOKAHEAD ? (sys->thread->lookahead / 4) : C1541_MIN_LOOKAHEAD;
+                const uint64_t slice_end = (sys->tick + slice < spec_end) ? (sys->tick + slice) : spec_end;
+                _c1541_save_checkpoint(sys);
+                num_ticks += _c1541_run(sys, slice_end);
+            }
+        }
+    }
+    return num_ticks;
+}
+#endif
+
+bool c1541_insert_disc(c1541_t* sys, chips_range_t data) {
+    CHIPS_ASSERT(sys && sys->valid && data.ptr);
+    c1541_remove_disc(sys);
+    c1541_disc_t* disc = &sys->disc;
+    const uint8_t* ptr = (const uint8_t*) data.ptr;
+    if ((data.size > 12) && (0 == memcmp(ptr, "GCR-1541", 8))) {
+        if (!_c1541_parse_g64(disc, ptr, data.size)) {
+            c1541_remove_disc(sys);
+            return false;
+        }
+        disc->g64 = true;
+    }
+    else {
+        // .d64 image, 35 or 40 tracks with optional error info
+        switch (data.size) {
+            case 174848: case 175531: disc->num_tracks = 35; break;
+            case 196608: case 197376: disc->num_tracks = 40; break;
+            default: return false;
+        }
+        uint32_t offset = 0;
+        for (int i = 0; i < disc->num_tracks; i++) {
+            disc->track_offset[i] = offset;
+            disc->track_size[i] = (uint16_t)_c1541_track_capacity(i + 1);
+            offset += (uint32_t)_c1541_num_sectors(i + 1) * 256;
+        }
+        // disc id from the BAM in track 18, sector 0
+        const uint32_t bam = 357 * 256;
+        disc->id[0] = ptr[bam + 0xA2];
+        disc->id[1] = ptr[bam + 0xA3];
+    }
+    disc->image = ptr;
+    disc->image_size = (uint32_t)data.size;
+    disc->inserted = true;
+    return true;
 }
 
 void c1541_remove_disc(c1541_t* sys) {
-    // FIXME
-    (void)sys;
+    CHIPS_ASSERT(sys && sys->valid);
+    c1541_disc_t* disc = &sys->disc;
+    disc->inserted = false;
+    disc->g64 = false;
+    disc->num_tracks = 0;
+    disc->id[0] = disc->id[1] = 0;
+    disc->image = 0;
+    disc->image_size = 0;
+    memset(disc->track_offset, 0, sizeof(disc->track_offset));
+    memset(disc->track_size, 0, sizeof(disc->track_size));
+    disc->gcr_track = -1;
+}
+
+bool c1541_disc_inserted(c1541_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return sys->disc.inserted;
+}
+
+const uint8_t* c1541_disc_sector(c1541_t* sys, int track, int sector) {
+    CHIPS_ASSERT(sys && sys->valid);
+    if (!sys->disc.inserted || (track < 1) || (track > sys->disc.num_tracks) ||
+        (sector < 0) || (sector >= _c1541_num_sectors(track)))
+    {
+        return 0;
+    }
+    return &sys->disc.image[sys->disc.track_offset[track - 1] + (uint32_t)sector * 256];
+}
+
+// match a file name pattern against a 16-byte directory entry name padded with 0xA0
+static bool _c1541_match_name(const uint8_t* pattern, int len, const uint8_t* name) {
+    for (int i = 0; i < 16; i++) {
+        if (i >= len) {
+            return name[i] == 0xA0;
+        }
+        if (pattern[i] == '*') {
+            return true;
+        }
+        if ((name[i] == 0xA0) || ((pattern[i] != '?') && (pattern[i] != name[i]))) {
+            return false;
+        }
+    }
+    return (len == 16) || (pattern[16] == '*');
+}
+
+bool c1541_find_file(c1541_t* sys, const uint8_t* name, int name_len, int* out_track, int* out_sector) {
+    CHIPS_ASSERT(sys && sys->valid && name && out_track && out_sector);
+    // skip drive number prefix
+    if ((name_len >= 2) && (name[1] == ':')) {
+        name += 2;
+        name_len -= 2;
+    }
+    else if ((name_len >= 1) && (name[0] == ':')) {
+        name += 1;
+        name_len -= 1;
+    }
+    // follow the directory sector chain, starting at track 18, sector 1
+    int track = 18;
+    int sector = 1;
+    for (int i = 0; (i < 32) && (track != 0); i++) {
+        const uint8_t* dir = c1541_disc_sector(sys, track, sector);
+        if (!dir) {
+            return false;
+        }
+        for (int entry = 0; entry < 8; entry++) {
+            const uint8_t* e = &dir[entry * 32];
+            // closed PRG file
+            if ((e[2] & 0x87) == 0x82) {
+                if (_c1541_match_name(name, name_len, &e[5])) {
+                    *out_track = e[3];
+                    *out_sector = e[4];
+                    return true;
+                }
+            }
+        }
+        track = dir[0];
+        sector = dir[1];
+    }
+    return false;
 }
 
 void c1541_snapshot_onsave(c1541_t* snapshot, void* base) {
     CHIPS_ASSERT(snapshot && base);
     snapshot->iec = 0;
+    snapshot->thread = 0;
+    snapshot->disc.image = 0;
     m6502_snapshot_onsave(&snapshot->cpu);
     mem_snapshot_onsave(&snapshot->mem, base);
 }
@@ -187,8 +1139,22 @@ void c1541_snapshot_onsave(c1541_t* snapshot, void* base) {
 void c1541_snapshot_onload(c1541_t* snapshot, c1541_t* sys, void* base) {
     CHIPS_ASSERT(snapshot && sys && base);
     snapshot->iec = sys->iec;
+    snapshot->thread = sys->thread;
+    // keep the disc image inserted in sys if it matches the snapshot, the GCR track buffer is discarded
+    snapshot->disc.gcr_track = -1;
+    if (snapshot->disc.inserted) {
+        if (sys->disc.inserted && (sys->disc.image_size == snapshot->disc.image_size) && (sys->disc.g64 == snapshot->disc.g64)) {
+            snapshot->disc.image = sys->disc.image;
+        }
+        else {
+            c1541_remove_disc(snapshot);
+        }
+    }
     m6502_snapshot_onload(&snapshot->cpu, &sys->cpu);
     mem_snapshot_onload(&snapshot->mem, base);
+    if (snapshot->thread) {
+        _c1541_thread_reset(snapshot);
+    }
 }
 
 #endif // CHIPS_IMPL
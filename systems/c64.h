@@ -36,9 +36,33 @@
 
     TODO!
 
+    ## Fast Loading
+
+    When c64_desc_t.fast_load is true, the KERNAL LOAD routine is trapped,
+    and files are copied directly into memory instead of going through
+    the emulated tape or floppy hardware:
+
+    - device 1: the next PRG file with a matching name is decoded from the
+      pulses of the inserted .TAP file (starting at the current tape
+      position), the tape position is moved behind the loaded file
+    - device 8: the PRG file with a matching name is read from the
+      inserted .d64 disc image (the directory listing "$" and .g64
+      discs are still loaded through the emulated drive)
+
+    If a file isn't found, LOAD returns with a FILE NOT FOUND error.
+
+    When c64_desc_t.tape_warp is true, c64_exec() runs C64_TAPE_WARP_FACTOR
+    times faster while the tape motor is on, without audio output, and
+    without decoding the video output (unless sprites are visible).
+    Since no audio samples are generated in warp mode, the audio stream
+    stalls for as long as the tape motor is on. Hosts which drive the
+    emulation from the audio stream (or wait for a filled audio buffer)
+    should check c64_tape_warp_active() and run c64_exec() from their
+    frame timer instead while it returns true.
+
     ## TODO:
 
-    - floppy disc support
+    - writing to floppy discs
 
     ## Tests Status
 
@@ -252,11 +276,25 @@ extern "C" {
 #endif
 
 // bump snapshot version when c64_t memory layout changes
-#define C64_SNAPSHOT_VERSION (1)
+#define C64_SNAPSHOT_VERSION (11)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    C64_PERF_CPU,   // M6510 CPU ticks
+    C64_PERF_VIC,   // VIC-II ticks
+    C64_PERF_SID,   // SID ticks
+    C64_PERF_CIA1,  // CIA-1 ticks
+    C64_PERF_CIA2,  // CIA-2 ticks
+    C64_PERF_C1530, // datasette ticks
+    C64_PERF_C1541, // floppy drive ticks (not counted in threaded C1541 mode)
+    C64_PERF_NUM,
+};
 
 #define C64_FREQUENCY (985248)              // clock frequency in Hz
 #define C64_MAX_AUDIO_SAMPLES (1024)        // max number of audio samples in internal sample buffer
 #define C64_DEFAULT_AUDIO_SAMPLES (128)     // default number of samples in internal sample buffer
+#define C64_AUDIO_NUM_TRACKS (3)            // SID voice 1, 2, 3 (tapped before the filter)
+#define C64_TAPE_WARP_FACTOR (16)           // emulation speedup while tape motor is on in tape warp mode
 
 // C64 joystick types
 typedef enum {
@@ -323,8 +361,12 @@ typedef enum {
 typedef struct {
     bool c1530_enabled;     // true to enable the C1530 datassette emulation
     bool c1541_enabled;     // true to enable the C1541 floppy drive emulation
+    c1541_thread_t* c1541_thread;   // optional: run the C1541 on its own thread with this state (see c64_exec_c1541(), needs CHIPS_THREADS)
+    bool fast_load;         // true to trap the KERNAL LOAD routine and load files directly into memory
+    bool tape_warp;         // true to run c64_exec() in warp mode while the tape motor is on
     c64_joystick_type_t joystick_type;  // default is C64_JOYSTICK_NONE
     chips_debug_t debug;    // optional debugging hook
+    chips_input_callback_t input;// optional input recording callback (see util/movie.h)
     chips_audio_desc_t audio;   // audio output options
     // ROM images
     struct {
@@ -352,24 +394,36 @@ typedef struct {
     bool io_mapped;             // true when D000..DFFF has IO area mapped in
     uint8_t cas_port;           // cassette port, shared with c1530_t if datasette is connected
     uint8_t iec_port;           // IEC serial port, shared with c1541_t if connected
+    uint64_t iec_tick;          // tick counter for timestamping IEC line changes (same as the C1541's tick counter)
+    uint8_t iec_drive_lines;    // IEC lines pulled low by the C1541 at the last CIA-2 port A read in threaded mode
     uint8_t cpu_port;           // last state of CPU port (for memory mapping)
     uint8_t kbd_joy1_mask;      // current joystick-1 state from keyboard-joystick emulation
     uint8_t kbd_joy2_mask;      // current joystick-2 state from keyboard-joystick emulation
     uint8_t joy_joy1_mask;      // current joystick-1 state from c64_joystick()
     uint8_t joy_joy2_mask;      // current joystick-2 state from c64_joystick()
     uint16_t vic_bank_select;   // upper 4 address bits from CIA-2 port A
+    bool fast_load;             // KERNAL LOAD trap enabled
+    bool tape_warp;             // warp mode while tape motor is on enabled
+    bool warp;                  // currently running in warp mode (no audio output)
 
     kbd_t kbd;                  // keyboard matrix state
     mem_t mem_cpu;              // CPU-visible memory mapping
     mem_t mem_vic;              // VIC-visible memory mapping
     bool valid;
+    clk_t clk;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
 
     struct {
         chips_audio_callback_t callback;
+        chips_audio_tracks_callback_t tracks_callback;
         int num_samples;
         int sample_pos;
-        float sample_buffer[C64_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t sample_buffer[C64_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t tracks_buffer[C64_MAX_AUDIO_SAMPLES * C64_AUDIO_NUM_TRACKS];
     } audio;
 
     uint8_t color_ram[1024];        // special static color ram
@@ -393,6 +447,18 @@ void c64_reset(c64_t* sys);
 chips_display_info_t c64_display_info(c64_t* sys);
 // tick C64 instance for a given number of microseconds, return number of ticks executed
 uint32_t c64_exec(c64_t* sys, uint32_t micro_seconds);
+// run C64 instance for an exact number of ticks, return number of ticks executed
+uint32_t c64_exec_ticks(c64_t* sys, uint32_t num_ticks);
+// run C64 instance until a number of audio samples has been generated, return number of ticks executed
+uint32_t c64_exec_samples(c64_t* sys, int num_samples);
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* c64_perf_counters(c64_t* sys);
+#endif
+#if defined(CHIPS_THREADS)
+// run the C1541 on the calling thread alongside one c64_exec*() call (threaded C1541 mode only)
+uint32_t c64_exec_c1541(c64_t* sys);
+#endif
 // send a key-down event to the C64
 void c64_key_down(c64_t* sys, int key_code);
 // send a key-up event to the C64
@@ -403,10 +469,12 @@ void c64_set_joystick_type(c64_t* sys, c64_joystick_type_t type);
 c64_joystick_type_t c64_joystick_type(c64_t* sys);
 // set joystick mask (combination of C64_JOYSTICK_*)
 void c64_joystick(c64_t* sys, uint8_t joy1_mask, uint8_t joy2_mask);
+// replay a recorded input event (see util/movie.h)
+void c64_input_event(c64_t* sys, const chips_input_event_t* event);
 // quickload a .bin/.prg file
 bool c64_quickload(c64_t* sys, chips_range_t data);
-// insert tape as .TAP file (c1530 must be enabled)
-bool c64_insert_tape(c64_t* sys, chips_range_t data);
+// insert tape as .TAP file from an external memory range or read callback (c1530 must be enabled, data is not copied)
+bool c64_insert_tape_source(c64_t* sys, const chips_tape_source_t* source);
 // remove tape file
 void c64_remove_tape(c64_t* sys);
 // return true if a tape is currently inserted
@@ -417,10 +485,22 @@ void c64_tape_play(c64_t* sys);
 void c64_tape_stop(c64_t* sys);
 // return true if tape motor is on
 bool c64_is_tape_motor_on(c64_t* sys);
+// return true if c64_exec() currently runs in tape warp mode (no audio output)
+bool c64_tape_warp_active(c64_t* sys);
+// insert a .d64 or .g64 disc image (c1541 must be enabled, the data is not copied and must remain valid until the disc is removed)
+bool c64_insert_disc(c64_t* sys, chips_range_t data);
+// remove disc
+void c64_remove_disc(c64_t* sys);
+// return true if a disc is currently inserted
+bool c64_disc_inserted(c64_t* sys);
 // save a snapshot, patches pointers to zero and offsets, returns snapshot version
 uint32_t c64_save_snapshot(c64_t* sys, c64_t* dst);
 // load a snapshot, returns false if snapshot versions don't match
 bool c64_load_snapshot(c64_t* sys, uint32_t version, c64_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks, threaded C1541 must be idle)
+uint64_t c64_state_hash(c64_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t c64_frame_hash(c64_t* sys);
 // perform a RUN BASIC call
 void c64_basic_run(c64_t* sys);
 // perform a LOAD BASIC call
@@ -453,6 +533,7 @@ static uint16_t _c64_vic_fetch(uint16_t addr, void* user_data);
 static void _c64_update_memory_map(c64_t* sys);
 static void _c64_init_key_map(c64_t* sys);
 static void _c64_init_memory_map(c64_t* sys);
+static uint64_t _c64_kernal_load(c64_t* sys, uint64_t pins);
 
 #define _C64_DEFAULT(val,def) (((val) != 0) ? (val) : (def))
 
@@ -462,9 +543,18 @@ void c64_init(c64_t* sys, const c64_desc_t* desc) {
 
     memset(sys, 0, sizeof(c64_t));
     sys->valid = true;
+    clk_init(&sys->clk, C64_FREQUENCY);
     sys->joystick_type = desc->joystick_type;
+    sys->fast_load = desc->fast_load;
+    sys->tape_warp = desc->tape_warp;
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[C64_PERF_NUM] = { "m6510", "m6569", "m6581", "m6526-1", "m6526-2", "c1530", "c1541" };
+    chips_perf_init(&sys->perf, C64_PERF_NUM, perf_names);
+#endif
     sys->audio.callback = desc->audio.callback;
+    sys->audio.tracks_callback = desc->audio.tracks_callback;
     sys->audio.num_samples = _C64_DEFAULT(desc->audio.num_samples, C64_DEFAULT_AUDIO_SAMPLES);
     CHIPS_ASSERT(sys->audio.num_samples <= C64_MAX_AUDIO_SAMPLES);
     CHIPS_ASSERT(desc->roms.chars.ptr && (desc->roms.chars.size == sizeof(sys->rom_char)));
@@ -506,6 +596,7 @@ void c64_init(c64_t* sys, const c64_desc_t* desc) {
         .tick_hz = C64_FREQUENCY,
         .sound_hz = _C64_DEFAULT(desc->audio.sample_rate, 44100),
         .magnitude = _C64_DEFAULT(desc->audio.volume, 1.0f),
+        .voice_samples = 0 != desc->audio.tracks_callback.func,
     });
     _c64_init_key_map(sys);
     _c64_init_memory_map(sys);
@@ -517,6 +608,7 @@ void c64_init(c64_t* sys, const c64_desc_t* desc) {
     if (desc->c1541_enabled) {
         c1541_init(&sys->c1541, &(c1541_desc_t){
             .iec_port = &sys->iec_port,
+            .thread = desc->c1541_thread,
             .roms = {
                 .c000_dfff = desc->roms.c1541.c000_dfff,
                 .e000_ffff = desc->roms.c1541.e000_ffff
@@ -554,14 +646,23 @@ void c64_reset(c64_t* sys) {
 static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
     // FIXME: move datasette and floppy tick to end
     if (sys->c1530.valid) {
+        CHIPS_PERF_BEGIN(&sys->perf, C64_PERF_C1530);
         c1530_tick(&sys->c1530);
+        CHIPS_PERF_END(&sys->perf, C64_PERF_C1530);
     }
     if (sys->c1541.valid) {
-        c1541_tick(&sys->c1541);
+        sys->iec_tick++;
+        if (!sys->c1541.thread) {
+            CHIPS_PERF_BEGIN(&sys->perf, C64_PERF_C1541);
+            c1541_tick(&sys->c1541);
+            CHIPS_PERF_END(&sys->perf, C64_PERF_C1541);
+        }
     }
 
     // tick the CPU
+    CHIPS_PERF_BEGIN(&sys->perf, C64_PERF_CPU);
     pins = m6502_tick(&sys->cpu, pins);
+    CHIPS_PERF_END(&sys->perf, C64_PERF_CPU);
     const uint16_t addr = M6502_GET_ADDR(pins);
 
     // those pins are set each tick by the CIAs and VIC
@@ -614,14 +715,25 @@ static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
 
     // tick the SID
     {
+        CHIPS_PERF_BEGIN(&sys->perf, C64_PERF_SID);
         sid_pins = m6581_tick(&sys->sid, sid_pins);
-        if (sid_pins & M6581_SAMPLE) {
+        CHIPS_PERF_END(&sys->perf, C64_PERF_SID);
+        if ((sid_pins & M6581_SAMPLE) && !sys->warp) {
             // new audio sample ready
+            if (sys->audio.tracks_callback.func) {
+                chips_audio_sample_t* dst = &sys->audio.tracks_buffer[sys->audio.sample_pos * C64_AUDIO_NUM_TRACKS];
+                for (int i = 0; i < C64_AUDIO_NUM_TRACKS; i++) {
+                    dst[i] = sys->sid.voice_sample[i];
+                }
+            }
             sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->sid.sample;
             if (sys->audio.sample_pos == sys->audio.num_samples) {
                 if (sys->audio.callback.func) {
                     sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
                 }
+                if (sys->audio.tracks_callback.func) {
+                    sys->audio.tracks_callback.func(sys->audio.tracks_buffer, sys->audio.num_samples, C64_AUDIO_NUM_TRACKS, sys->audio.tracks_callback.user_data);
+                }
                 sys->audio.sample_pos = 0;
             }
         }
@@ -651,7 +763,9 @@ static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
         if (sys->cas_port & C64_CASPORT_READ) {
             cia1_pins |= M6526_FLAG;
         }
+        CHIPS_PERF_BEGIN(&sys->perf, C64_PERF_CIA1);
         cia1_pins = m6526_tick(&sys->cia_1, cia1_pins);
+        CHIPS_PERF_END(&sys->perf, C64_PERF_CIA1);
         const uint8_t kbd_lines = ~M6526_GET_PA(cia1_pins);
         kbd_set_active_lines(&sys->kbd, kbd_lines);
         if (cia1_pins & M6502_IRQ) {
@@ -665,7 +779,8 @@ static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
     /* tick CIA-2
         In Port A:
             bits 0..5: output (see cia2_out)
-            bits 6..7: serial bus input, not implemented
+            bit 6: serial bus CLK input (0: line is low)
+            bit 7: serial bus DATA input (0: line is low)
         In Port B:
             RS232 / user functionality (not implemented)
 
@@ -676,17 +791,64 @@ static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
                 10: bank 1 4000..7FFF
                 11: bank 0 0000..3FFF
             bit 2: RS-232 TXD Outout (not implemented)
-            bit 3..5: serial bus output (not implemented)
+            bit 3: serial bus ATN output (1: pull line low)
+            bit 4: serial bus CLK output (1: pull line low)
+            bit 5: serial bus DATA output (1: pull line low)
             bit 6..7: input (see cia2_in)
         Out Port B:
             RS232 / user functionality (not implemented)
 
         CIA-2 IRQ pin connected to CPU NMI pin
+
+        In threaded C1541 mode, the drive's IEC lines are only
+        fetched from the drive thread when the CPU reads port A,
+        in all other ticks the CIA sees the lines from the last read.
     */
     {
-        M6526_SET_PAB(cia2_pins, 0xFF, 0xFF);
+        uint8_t iec_lines = sys->iec_port;
+        if (sys->c1541.valid) {
+            if (sys->c1541.thread) {
+                if ((cia2_pins & (M6526_CS|M6526_RW|M6526_RS)) == (M6526_CS|M6526_RW)) {
+                    sys->iec_drive_lines = c1541_iec_read(&sys->c1541, sys->iec_tick);
+                }
+                iec_lines |= sys->iec_drive_lines;
+            }
+            else {
+                iec_lines |= sys->c1541.iec_lines;
+            }
+        }
+        uint8_t pa = 0x3F;
+        if (0 == (iec_lines & C64_IECPORT_CLK)) {
+            pa |= (1<<6);
+        }
+        if (0 == (iec_lines & C64_IECPORT_DATA)) {
+            pa |= (1<<7);
+        }
+        M6526_SET_PAB(cia2_pins, pa, 0xFF);
+        CHIPS_PERF_BEGIN(&sys->perf, C64_PERF_CIA2);
         cia2_pins = m6526_tick(&sys->cia_2, cia2_pins);
-        sys->vic_bank_select = ((~M6526_GET_PA(cia2_pins))&3)<<14;
+        CHIPS_PERF_END(&sys->perf, C64_PERF_CIA2);
+        const uint8_t cia2_pa = M6526_GET_PA(cia2_pins);
+        sys->vic_bank_select = ((~cia2_pa)&3)<<14;
+        uint8_t iec_port = sys->iec_port & ~(C64_IECPORT_ATN|C64_IECPORT_CLK|C64_IECPORT_DATA);
+        if (cia2_pa & (1<<3)) {
+            iec_port |= C64_IECPORT_ATN;
+        }
+        if (cia2_pa & (1<<4)) {
+            iec_port |= C64_IECPORT_CLK;
+        }
+        if (cia2_pa & (1<<5)) {
+            iec_port |= C64_IECPORT_DATA;
+        }
+        if (sys->c1541.thread) {
+            if (iec_port != sys->iec_port) {
+                c1541_iec_write(&sys->c1541, sys->iec_tick, iec_port);
+            }
+            if (0 == (sys->iec_tick & 63)) {
+                c1541_iec_sync(&sys->c1541, sys->iec_tick);
+            }
+        }
+        sys->iec_port = iec_port;
         if (cia2_pins & M6502_IRQ) {
             pins |= M6502_NMI;
         }
@@ -709,7 +871,9 @@ static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
         this goes active during a badline, but is not checked
     */
     {
+        CHIPS_PERF_BEGIN(&sys->perf, C64_PERF_VIC);
         vic_pins = m6569_tick(&sys->vic, vic_pins);
+        CHIPS_PERF_END(&sys->perf, C64_PERF_VIC);
         pins |= (vic_pins & (M6502_IRQ|M6502_RDY|M6510_AEC));
         if ((vic_pins & (M6569_CS|M6569_RW)) == (M6569_CS|M6569_RW)) {
             pins = M6502_COPY_DATA(pins, vic_pins);
@@ -741,6 +905,15 @@ static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
             mem_wr(&sys->mem_cpu, addr, M6502_GET_DATA(pins));
         }
     }
+
+    // check if the trapped KERNAL LOAD routine was hit to implement fast loading
+    if (sys->fast_load && (sys->cpu_port & C64_CPUPORT_HIRAM)) {
+        const uint64_t trap_mask = M6502_SYNC|0xFFFF;
+        const uint64_t trap_val  = M6502_SYNC|0xF4A5;
+        if ((pins & trap_mask) == trap_val) {
+            pins = _c64_kernal_load(sys, pins);
+        }
+    }
     return pins;
 }
 
@@ -950,30 +1123,104 @@ static void _c64_init_key_map(c64_t* sys) {
     kbd_register_key(&sys->kbd, C64_KEY_F8      , 3, 0, 1);    // F8
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _c64_debug_event(c64_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && (0 != (pins & M6502_SYNC))) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && (0 == (pins & M6502_RW))) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (M6502_IRQ|M6502_NMI))));
+}
+
+// run in warp mode: without audio output and video decoding, return executed ticks
+static uint32_t _c64_exec_warp(c64_t* sys, uint32_t num_ticks) {
+    sys->warp = true;
+    sys->vic.skip_decode = true;
+    const uint32_t warp_ticks = c64_exec_ticks(sys, num_ticks);
+    sys->warp = false;
+    sys->vic.skip_decode = false;
+    return warp_ticks;
+}
+
 uint32_t c64_exec(c64_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    uint32_t num_ticks = clk_us_to_ticks(C64_FREQUENCY, micro_seconds);
+    const uint32_t num_ticks = clk_advance_us(&sys->clk, micro_seconds);
+    if (c64_tape_warp_active(sys)) {
+        return _c64_exec_warp(sys, num_ticks * C64_TAPE_WARP_FACTOR);
+    }
+    return c64_exec_ticks(sys, num_ticks);
+}
+
+// run for max_ticks, or until num_samples audio samples have been generated (-1 for no limit), return executed ticks
+static uint32_t _c64_exec(c64_t* sys, uint32_t max_ticks, int num_samples) {
+    if (sys->c1541.thread) {
+        // tell the drive thread where this exec call is expected to end
+        uint64_t exp_ticks = max_ticks;
+        if (num_samples >= 0) {
+            const uint64_t ticks_per_sample = (uint64_t)(sys->sid.sample_period / M6581_FIXEDPOINT_SCALE) + 1;
+            exp_ticks = (uint64_t)num_samples * ticks_per_sample;
+        }
+        c1541_iec_begin(&sys->c1541, sys->iec_tick + exp_ticks);
+    }
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->audio.sample_pos;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug callback
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
+        while ((num_ticks < max_ticks) && (num_samples != 0)) {
             pins = _c64_tick(sys, pins);
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     else {
-        // run with debug callback
-        for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
+        // run with debug hook in each tick, or only on requested events
+        while ((num_ticks < max_ticks) && (num_samples != 0) && !(*sys->debug.stopped)) {
             pins = _c64_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_c64_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     sys->pins = pins;
+    if (sys->c1541.thread) {
+        c1541_iec_end(&sys->c1541, sys->iec_tick);
+    }
+    const uint32_t micro_seconds = clk_ticks_to_us(C64_FREQUENCY, num_ticks);
     kbd_update(&sys->kbd, micro_seconds);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, sys->warp ? CHIPS_INPUT_EXEC_WARP : 0);
     return num_ticks;
 }
 
+uint32_t c64_exec_ticks(c64_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return _c64_exec(sys, num_ticks, -1);
+}
+
+uint32_t c64_exec_samples(c64_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->audio.num_samples > 1));
+    // the fractional tick remainder is carried across calls in the sound chip's sample counter
+    return _c64_exec(sys, UINT32_MAX, (num_samples > 0) ? num_samples : 0);
+}
+
+#if defined(CHIPS_THREADS)
+uint32_t c64_exec_c1541(c64_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid && sys->c1541.valid && sys->c1541.thread);
+    return c1541_exec_threaded(&sys->c1541);
+}
+#endif
+
 void c64_key_down(c64_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_DOWN, (uint32_t)key_code, 0);
     if (sys->joystick_type == C64_JOYSTICKTYPE_NONE) {
         kbd_key_down(&sys->kbd, key_code);
     }
@@ -1007,6 +1254,7 @@ void c64_key_down(c64_t* sys, int key_code) {
 
 void c64_key_up(c64_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_UP, (uint32_t)key_code, 0);
     if (sys->joystick_type == C64_JOYSTICKTYPE_NONE) {
         kbd_key_up(&sys->kbd, key_code);
     }
@@ -1040,6 +1288,7 @@ void c64_key_up(c64_t* sys, int key_code) {
 
 void c64_set_joystick_type(c64_t* sys, c64_joystick_type_t type) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK_TYPE, (uint32_t)type, 0);
     sys->joystick_type = type;
 }
 
@@ -1050,10 +1299,30 @@ c64_joystick_type_t c64_joystick_type(c64_t* sys) {
 
 void c64_joystick(c64_t* sys, uint8_t joy1_mask, uint8_t joy2_mask) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK, joy1_mask, joy2_mask);
     sys->joy_joy1_mask = joy1_mask;
     sys->joy_joy2_mask = joy2_mask;
 }
 
+void c64_input_event(c64_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC:
+            if (event->b & CHIPS_INPUT_EXEC_WARP) {
+                _c64_exec_warp(sys, event->a);
+            }
+            else {
+                c64_exec_ticks(sys, event->a);
+            }
+            break;
+        case CHIPS_INPUT_KEY_DOWN: c64_key_down(sys, (int)event->a); break;
+        case CHIPS_INPUT_KEY_UP: c64_key_up(sys, (int)event->a); break;
+        case CHIPS_INPUT_JOYSTICK: c64_joystick(sys, (uint8_t)event->a, (uint8_t)event->b); break;
+        case CHIPS_INPUT_JOYSTICK_TYPE: c64_set_joystick_type(sys, (c64_joystick_type_t)event->a); break;
+        default: break;
+    }
+}
+
 bool c64_quickload(c64_t* sys, chips_range_t data) {
     CHIPS_ASSERT(sys && sys->valid && data.ptr);
     if (data.size < 2) {
@@ -1078,9 +1347,335 @@ bool c64_quickload(c64_t* sys, chips_range_t data) {
     return true;
 }
 
-bool c64_insert_tape(c64_t* sys, chips_range_t data) {
+/*
+    Fast loading from tape: decode CBM ROM loader blocks directly from the
+    pulses in a .TAP file.
+
+    Pulses are classified by length into short, medium and long pulses. A
+    byte starts with a long+medium pulse pair, followed by 8 data bits (LSB
+    first) and an odd-parity bit, each bit is a short+medium (0) or a
+    medium+short (1) pulse pair. A long+short pulse pair ends a block.
+
+    Each block starts with a 9-byte countdown ($89..$81 for the first copy
+    and $09..$01 for the repeated copy), and ends with an XOR checksum
+    byte. A file is a 192-byte header block (file type, start and end
+    address, 16-byte file name) followed by a data block.
+*/
+#define _C64_TAP_PULSE_NONE (0)
+#define _C64_TAP_PULSE_SHORT (1)
+#define _C64_TAP_PULSE_MEDIUM (2)
+#define _C64_TAP_PULSE_LONG (3)
+#define _C64_TAP_PULSE_END (4)
+#define _C64_TAP_HEADER_BLOCK_SIZE (202)     // countdown, header payload and checksum
+
+static int _c64_tap_pulse(c1530_t* tape, uint32_t* pos) {
+    if (*pos >= tape->size) {
+        return _C64_TAP_PULSE_END;
+    }
+    uint32_t cycles = c1530_tape_byte(tape, (*pos)++) * 8;
+    if (cycles == 0) {
+        if ((*pos + 3) > tape->size) {
+            *pos = tape->size;
+            return _C64_TAP_PULSE_END;
+        }
+        cycles = c1530_tape_byte(tape, *pos) | (c1530_tape_byte(tape, *pos + 1)<<8) | (c1530_tape_byte(tape, *pos + 2)<<16);
+        *pos += 3;
+    }
+    if (cycles < 256) {
+        return _C64_TAP_PULSE_NONE;
+    }
+    else if (cycles < 456) {
+        return _C64_TAP_PULSE_SHORT;
+    }
+    else if (cycles < 608) {
+        return _C64_TAP_PULSE_MEDIUM;
+    }
+    else if (cycles < 900) {
+        return _C64_TAP_PULSE_LONG;
+    }
+    else {
+        return _C64_TAP_PULSE_NONE;
+    }
+}
+
+// skip to the first byte marker of the next block, return false at end of tape
+static bool _c64_tap_find_block(c1530_t* tape, uint32_t* pos) {
+    int prev = _C64_TAP_PULSE_NONE;
+    while (true) {
+        const int p = _c64_tap_pulse(tape, pos);
+        if (p == _C64_TAP_PULSE_END) {
+            return false;
+        }
+        if ((prev == _C64_TAP_PULSE_LONG) && (p == _C64_TAP_PULSE_MEDIUM)) {
+            return true;
+        }
+        prev = p;
+    }
+}
+
+// read the next byte of a block, return -1 if no valid byte, set more to false at the end of the block
+static int _c64_tap_read_byte(c1530_t* tape, uint32_t* pos, bool* more) {
+    // 8 data bits and parity bit
+    uint16_t bits = 0;
+    for (int i = 0; i < 9; i++) {
+        const int p0 = _c64_tap_pulse(tape, pos);
+        const int p1 = _c64_tap_pulse(tape, pos);
+        if ((p0 == _C64_TAP_PULSE_SHORT) && (p1 == _C64_TAP_PULSE_MEDIUM)) {
+            // 0-bit
+        }
+        else if ((p0 == _C64_TAP_PULSE_MEDIUM) && (p1 == _C64_TAP_PULSE_SHORT)) {
+            bits |= (1<<i);
+        }
+        else {
+            *more = false;
+            return -1;
+        }
+    }
+    // next byte marker or end of block
+    const int p0 = _c64_tap_pulse(tape, pos);
+    const int p1 = _c64_tap_pulse(tape, pos);
+    *more = (p0 == _C64_TAP_PULSE_LONG) && (p1 == _C64_TAP_PULSE_MEDIUM);
+    return bits & 0xFF;
+}
+
+// read the next block from tape, keep the first max_bytes bytes in buf and check the
+// countdown and checksum, return the payload size, -1 for a broken block, or -2 at end of tape
+static int _c64_tap_read_block(c1530_t* tape, uint32_t* pos, uint8_t* buf, int max_bytes) {
+    CHIPS_ASSERT(max_bytes >= 9);
+    if (!_c64_tap_find_block(tape, pos)) {
+        return -2;
+    }
+    int num_bytes = 0;
+    uint8_t chksum = 0;
+    bool more = true;
+    buf[0] = 0;
+    while (more) {
+        const int val = _c64_tap_read_byte(tape, pos, &more);
+        if (val < 0) {
+            break;
+        }
+        if (num_bytes < max_bytes) {
+            buf[num_bytes] = (uint8_t)val;
+        }
+        if (num_bytes >= 9) {
+            // the last byte is the checksum of the payload, so the payload and checksum xor to 0
+            chksum ^= (uint8_t)val;
+        }
+        num_bytes++;
+    }
+    if (num_bytes < 11) {
+        return -1;
+    }
+    const uint8_t first = buf[0] & 0x7F;
+    if ((first != 0x09) || (buf[8] != (buf[0] - 8))) {
+        return -1;
+    }
+    return (chksum == 0) ? (num_bytes - 10) : -1;
+}
+
+// read the payload of the block at pos again and write it into memory, return the end address
+static uint16_t _c64_tap_copy_block(c64_t* sys, uint32_t pos, int size, uint16_t addr, uint16_t end_addr) {
+    bool more = _c64_tap_find_block(&sys->c1530, &pos);
+    for (int i = 0; more && (i < (9 + size)) && (addr != end_addr); i++) {
+        const int val = _c64_tap_read_byte(&sys->c1530, &pos, &more);
+        if (val < 0) {
+            break;
+        }
+        if (i >= 9) {
+            mem_wr(&sys->mem_cpu, addr++, (uint8_t)val);
+        }
+    }
+    return addr;
+}
+
+// load the next matching PRG file from tape, return false if not found
+static bool _c64_load_tape(c64_t* sys, const uint8_t* name, int name_len, uint8_t sec_addr, uint16_t* out_end) {
+    // only the header blocks are kept in buf, the data block is read a second time directly into memory
+    uint8_t buf[_C64_TAP_HEADER_BLOCK_SIZE];
+    uint32_t pos = sys->c1530.pos;
+    bool header_found = false;
+    bool data_found = false;
+    uint16_t start_addr = 0;
+    uint16_t end_addr = 0;
+    while (true) {
+        const uint32_t block_pos = pos;
+        const int size = _c64_tap_read_block(&sys->c1530, &pos, buf, sizeof(buf));
+        if (size == -2) {
+            break;
+        }
+        if (header_found && !data_found) {
+            // skip the repeated copy of the header block until the first copy of the data block
+            if (buf[0] == 0x89) {
+                data_found = true;
+            }
+            else {
+                continue;
+            }
+        }
+        if (size < 0) {
+            // skip broken blocks, use the repeated copy instead
+            continue;
+        }
+        const uint8_t* payload = &buf[9];
+        if (!header_found) {
+            if (size != 192) {
+                continue;
+            }
+            const uint8_t type = payload[0];
+            if (type == 5) {
+                // end-of-tape marker
+                break;
+            }
+            if ((type != 1) && (type != 3)) {
+                continue;
+            }
+            // match file name prefix
+            bool match = true;
+            for (int i = 0; (i < name_len) && (i < 16); i++) {
+                if ((name[i] != '?') && (name[i] != payload[5 + i])) {
+                    match = false;
+                    break;
+                }
+            }
+            if (match) {
+                header_found = true;
+                start_addr = payload[1] | (payload[2]<<8);
+                end_addr = payload[3] | (payload[4]<<8);
+                if ((type == 1) && (sec_addr == 0)) {
+                    // relocatable file, load at address provided by caller
+                    const uint16_t load_addr = mem_rd16(&sys->mem_cpu, 0xC3);
+                    end_addr = load_addr + (uint16_t)(end_addr - start_addr);
+                    start_addr = load_addr;
+                }
+            }
+        }
+        else {
+            *out_end = _c64_tap_copy_block(sys, block_pos, size, start_addr, end_addr);
+            // skip the repeated copy of the data block
+            uint32_t next_pos = pos;
+            if ((buf[0] & 0x80) && (_c64_tap_read_block(&sys->c1530, &next_pos, buf, sizeof(buf)) != -2)) {
+                if (buf[0] == 0x09) {
+                    pos = next_pos;
+                }
+            }
+            sys->c1530.pos = pos;
+            sys->c1530.pulse_count = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// load a PRG file from the inserted .d64 disc, return false if not found
+static bool _c64_load_disc(c64_t* sys, const uint8_t* name, int name_len, uint8_t sec_addr, uint16_t* out_end) {
+    int track, sector;
+    if (!c1541_find_file(&sys->c1541, name, name_len, &track, &sector)) {
+        return false;
+    }
+    uint16_t addr = 0;
+    bool first = true;
+    // limit the number of sectors to guard against loops in the sector chain
+    for (int i = 0; (i < 768) && (track != 0); i++) {
+        const uint8_t* data = c1541_disc_sector(&sys->c1541, track, sector);
+        if (!data) {
+            return false;
+        }
+        // last sector of a file: byte 1 is index of last used byte
+        const int last = (data[0] == 0) ? data[1] : 255;
+        int pos = 2;
+        if (first) {
+            if (last < 3) {
+                return false;
+            }
+            addr = data[2] | (data[3]<<8);
+            if (sec_addr == 0) {
+                addr = mem_rd16(&sys->mem_cpu, 0xC3);
+            }
+            pos = 4;
+            first = false;
+        }
+        for (; pos <= last; pos++) {
+            mem_wr(&sys->mem_cpu, addr++, data[pos]);
+        }
+        track = data[0];
+        sector = data[1];
+    }
+    *out_end = addr;
+    return !first;
+}
+
+/*
+    trapped KERNAL LOAD routine (at F4A5, after the load address in X/Y
+    has been stored at C3/C4):
+
+    - Entry:    A = 0: load, 1: verify
+                B7 = file name length
+                B9 = secondary address
+                BA = device number
+                BB/BC = file name address
+                C3/C4 = load address (if secondary address is 0)
+    - Exit:     carry clear on success, X/Y and AE/AF: end address + 1
+                carry set on error, A: error code (4: FILE NOT FOUND)
+                90 = status
+
+    The trap returns without doing anything (and the regular KERNAL code
+    runs) for verify, the directory listing, or unsupported devices and
+    media.
+*/
+static uint64_t _c64_kernal_load(c64_t* sys, uint64_t pins) {
+    if (sys->cpu.A != 0) {
+        return pins;
+    }
+    const uint8_t device = mem_rd(&sys->mem_cpu, 0xBA);
+    const uint8_t sec_addr = mem_rd(&sys->mem_cpu, 0xB9);
+    uint8_t name[16];
+    int name_len = mem_rd(&sys->mem_cpu, 0xB7);
+    if (name_len > 16) {
+        name_len = 16;
+    }
+    const uint16_t name_addr = mem_rd16(&sys->mem_cpu, 0xBB);
+    for (int i = 0; i < name_len; i++) {
+        name[i] = mem_rd(&sys->mem_cpu, name_addr + i);
+    }
+    bool success;
+    uint16_t end_addr = 0;
+    if ((device == 1) && sys->c1530.valid && c1530_tape_inserted(&sys->c1530)) {
+        success = _c64_load_tape(sys, name, name_len, sec_addr, &end_addr);
+    }
+    else if ((device == 8) && sys->c1541.valid && (sys->c1541.disc.num_tracks > 0) && ((name_len == 0) || (name[0] != '$'))) {
+        success = _c64_load_disc(sys, name, name_len, sec_addr, &end_addr);
+    }
+    else {
+        return pins;
+    }
+    uint8_t p = sys->cpu.P;
+    if (success) {
+        mem_wr(&sys->mem_cpu, 0x90, 0x00);
+        mem_wr16(&sys->mem_cpu, 0xAE, end_addr);
+        sys->cpu.X = end_addr & 0xFF;
+        sys->cpu.Y = end_addr >> 8;
+        p &= ~M6502_CF;
+    }
+    else {
+        // FILE NOT FOUND
+        sys->cpu.A = 4;
+        p |= M6502_CF;
+    }
+    sys->cpu.P = p;
+    // continue with an RTS to the caller of LOAD
+    const uint8_t s = sys->cpu.S;
+    const uint16_t ret_addr = (mem_rd(&sys->mem_cpu, 0x0100 | (uint8_t)(s + 1)) |
+                               (mem_rd(&sys->mem_cpu, 0x0100 | (uint8_t)(s + 2))<<8)) + 1;
+    sys->cpu.S = s + 2;
+    M6502_SET_ADDR(pins, ret_addr);
+    M6502_SET_DATA(pins, mem_rd(&sys->mem_cpu, ret_addr));
+    m6502_set_pc(&sys->cpu, ret_addr);
+    return pins;
+}
+
+bool c64_insert_tape_source(c64_t* sys, const chips_tape_source_t* source) {
     CHIPS_ASSERT(sys && sys->valid && sys->c1530.valid);
-    return c1530_insert_tape(&sys->c1530, data);
+    return c1530_insert_tape_source(&sys->c1530, source);
 }
 
 void c64_remove_tape(c64_t* sys) {
@@ -1108,6 +1703,33 @@ bool c64_is_tape_motor_on(c64_t* sys) {
     return c1530_is_motor_on(&sys->c1530);
 }
 
+bool c64_tape_warp_active(c64_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return sys->tape_warp && sys->c1530.valid && c1530_is_motor_on(&sys->c1530);
+}
+
+bool c64_insert_disc(c64_t* sys, chips_range_t data) {
+    CHIPS_ASSERT(sys && sys->valid && sys->c1541.valid);
+    return c1541_insert_disc(&sys->c1541, data);
+}
+
+void c64_remove_disc(c64_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid && sys->c1541.valid);
+    c1541_remove_disc(&sys->c1541);
+}
+
+bool c64_disc_inserted(c64_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid && sys->c1541.valid);
+    return c1541_disc_inserted(&sys->c1541);
+}
+
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* c64_perf_counters(c64_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t c64_display_info(c64_t* sys) {
     chips_display_info_t res = {
         .frame = {
@@ -1142,7 +1764,12 @@ uint32_t c64_save_snapshot(c64_t* sys, c64_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
+    chips_audio_tracks_callback_snapshot_onsave(&dst->audio.tracks_callback);
     m6502_snapshot_onsave(&dst->cpu);
     m6569_snapshot_onsave(&dst->vic);
     mem_snapshot_onsave(&dst->mem_cpu, sys);
@@ -1160,7 +1787,12 @@ bool c64_load_snapshot(c64_t* sys, uint32_t version, c64_t* src) {
     static c64_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
+    chips_audio_tracks_callback_snapshot_onload(&im.audio.tracks_callback, &sys->audio.tracks_callback);
     m6502_snapshot_onload(&im.cpu, &sys->cpu);
     m6569_snapshot_onload(&im.vic, &sys->vic);
     mem_snapshot_onload(&im.mem_cpu, sys);
@@ -1171,6 +1803,91 @@ bool c64_load_snapshot(c64_t* sys, uint32_t version, c64_t* src) {
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by c64_init())
+#define _C64_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+// hash a CPU without its callback pointers
+static uint64_t _c64_hash_cpu(const m6502_t* cpu, uint64_t h) {
+    m6502_t im;
+    memcpy(&im, cpu, sizeof(im));
+    m6502_snapshot_onsave(&im);
+    return _C64_HASH(h, im);
+}
+
+// hash the committed C1541 state, without host pointers, thread state and the GCR track buffer
+static uint64_t _c64_hash_c1541(const c1541_t* c1541, uint64_t h) {
+    h = _C64_HASH(h, c1541->pins);
+    h = _c64_hash_cpu(&c1541->cpu, h);
+    h = _C64_HASH(h, c1541->via_1);
+    h = _C64_HASH(h, c1541->via_2);
+    h = _C64_HASH(h, c1541->tick);
+    h = _C64_HASH(h, c1541->host_lines);
+    h = _C64_HASH(h, c1541->iec_lines);
+    h = _C64_HASH(h, c1541->drive);
+    const c1541_disc_t* disc = &c1541->disc;
+    h = _C64_HASH(h, disc->inserted);
+    h = _C64_HASH(h, disc->g64);
+    h = _C64_HASH(h, disc->num_tracks);
+    h = _C64_HASH(h, disc->id);
+    h = _C64_HASH(h, disc->image_size);
+    h = _C64_HASH(h, disc->track_offset);
+    h = _C64_HASH(h, disc->track_size);
+    h = _C64_HASH(h, c1541->ram);
+    return _C64_HASH(h, c1541->rom);
+}
+
+uint64_t c64_state_hash(c64_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // NOTE: in threaded C1541 mode, both threads must be idle (same as for snapshots), the drive
+    // has then discarded its speculative ticks and the C1541 state is the committed state, so
+    // that the hash is the same in threaded and non-threaded mode
+    uint64_t h = _c64_hash_cpu(&sys->cpu, 0);
+    h = _C64_HASH(h, sys->cia_1);
+    h = _C64_HASH(h, sys->cia_2);
+    m6569_t vic;
+    memcpy(&vic, &sys->vic, sizeof(vic));
+    m6569_snapshot_onsave(&vic);
+    h = _C64_HASH(h, vic);
+    h = _C64_HASH(h, sys->sid);
+    h = _C64_HASH(h, sys->pins);
+    h = _C64_HASH(h, sys->joystick_type);
+    h = _C64_HASH(h, sys->io_mapped);
+    h = _C64_HASH(h, sys->cas_port);
+    h = _C64_HASH(h, sys->iec_port);
+    // iec_drive_lines is skipped, it's only a cache for the CIA-2 reads in threaded C1541 mode
+    h = _C64_HASH(h, sys->iec_tick);
+    h = _C64_HASH(h, sys->cpu_port);
+    h = _C64_HASH(h, sys->kbd_joy1_mask);
+    h = _C64_HASH(h, sys->kbd_joy2_mask);
+    h = _C64_HASH(h, sys->joy_joy1_mask);
+    h = _C64_HASH(h, sys->joy_joy2_mask);
+    h = _C64_HASH(h, sys->vic_bank_select);
+    h = _C64_HASH(h, sys->fast_load);
+    h = _C64_HASH(h, sys->tape_warp);
+    h = _C64_HASH(h, sys->kbd);
+    h = _C64_HASH(h, sys->audio.sample_pos);
+    h = chips_hash(sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(chips_audio_sample_t), h);
+    h = _C64_HASH(h, sys->color_ram);
+    h = _C64_HASH(h, sys->ram);
+    h = _C64_HASH(h, sys->rom_char);
+    h = _C64_HASH(h, sys->rom_basic);
+    h = _C64_HASH(h, sys->rom_kernal);
+    if (sys->c1530.valid) {
+        h = _C64_HASH(h, sys->c1530.size);
+        h = _C64_HASH(h, sys->c1530.pos);
+        h = _C64_HASH(h, sys->c1530.pulse_count);
+    }
+    if (sys->c1541.valid) {
+        h = _c64_hash_c1541(&sys->c1541, h);
+    }
+    return h;
+}
+
+uint64_t c64_frame_hash(c64_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 void c64_basic_run(c64_t* sys) {
     CHIPS_ASSERT(sys);
     // write RUN into the keyboard buffer
@@ -32,6 +32,7 @@
     - chips/clk.h
     - chips/fdd.h
     - chips/fdd_cpc.h
+    - chips/evsched.h
 
     ## The Amstrad CPC 464
 
@@ -45,6 +46,16 @@
 
     FIXME!
 
+    ## Event Scheduling
+
+    By default the AY-3-8912 PSG isn't ticked in each 1 MHz CCLK cycle,
+    instead it's caught up right before the CPU accesses it through the
+    PPI, and when the next audio sample is due (which is an event in a
+    discrete-event scheduler running on the CCLK, see chips/evsched.h).
+    Set cpc_desc_t.per_tick to tick the PSG in each CCLK cycle instead
+    (slower, but useful for validating that both modes produce identical
+    results).
+
     ## TODO
 
     - improve CRTC emulation, some graphics demos don't work yet
@@ -78,10 +89,20 @@ extern "C" {
 #endif
 
 // bump when cpc_t memory layout changes
-#define CPC_SNAPSHOT_VERSION (0x0001)
+#define CPC_SNAPSHOT_VERSION (0x0006)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    CPC_PERF_CPU,  // Z80 ticks
+    CPC_PERF_GA,   // gate array ticks (including CRTC and PSG)
+    CPC_PERF_CRTC, // MC6845 CRTC ticks
+    CPC_PERF_PSG,  // AY-3-8912 ticks and audio output
+    CPC_PERF_NUM,
+};
 
 #define CPC_MAX_AUDIO_SAMPLES (1024)        // max number of audio samples in internal sample buffer
 #define CPC_DEFAULT_AUDIO_SAMPLES (128)     // default number of samples in internal sample buffer
+#define CPC_AUDIO_NUM_TRACKS (3)            // AY channel A, B, C
 #define CPC_MAX_TAPE_SIZE (128*1024)        // max size of tape file in bytes
 
 // CPC model types
@@ -111,6 +132,8 @@ typedef struct {
     cpc_type_t type;                // default is the CPC 6128
     cpc_joystick_type_t joystick_type;
     chips_debug_t debug;
+    chips_input_callback_t input;  // optional input recording callback (see util/movie.h)
+    bool per_tick;                  // tick all chips in each clock cycle instead of using the event scheduler
     chips_audio_desc_t audio;
 
     // ROM images
@@ -151,15 +174,26 @@ typedef struct {
     kbd_t kbd;
     mem_t mem;
 
+    bool per_tick;          // true: tick all chips in each clock cycle
+    sched_t sched;          // event scheduler, time is in CCLK ticks
+    uint64_t psg_tick;      // scheduler time up to which the PSG has been ticked
+
     uint64_t pins;
     bool valid;
+    clk_t clk;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
 
     struct {
         chips_audio_callback_t callback;
+        chips_audio_tracks_callback_t tracks_callback;
         int num_samples;
         int sample_pos;
-        float sample_buffer[CPC_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t sample_buffer[CPC_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t tracks_buffer[CPC_MAX_AUDIO_SAMPLES * CPC_AUDIO_NUM_TRACKS];
     } audio;
     uint8_t ram[8][0x4000];
     uint8_t rom_os[0x4000];
@@ -179,6 +213,14 @@ void cpc_reset(cpc_t* cpc);
 chips_display_info_t cpc_display_info(cpc_t* cpc);
 // run CPC instance for given amount of micro_seconds, returns number of ticks executed
 uint32_t cpc_exec(cpc_t* cpc, uint32_t micro_seconds);
+// run CPC instance for an exact number of ticks, return number of ticks executed
+uint32_t cpc_exec_ticks(cpc_t* cpc, uint32_t num_ticks);
+// run CPC instance until a number of audio samples has been generated, return number of ticks executed
+uint32_t cpc_exec_samples(cpc_t* cpc, int num_samples);
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* cpc_perf_counters(cpc_t* sys);
+#endif
 // send a key down event
 void cpc_key_down(cpc_t* cpc, int key_code);
 // send a key up event
@@ -189,6 +231,8 @@ void cpc_set_joystick_type(cpc_t* sys, cpc_joystick_type_t type);
 cpc_joystick_type_t cpc_joystick_type(cpc_t* sys);
 // set joystick mask (combination of CPC_JOYSTICK_*)
 void cpc_joystick(cpc_t* sys, uint8_t mask);
+// replay a recorded input event (see util/movie.h)
+void cpc_input_event(cpc_t* sys, const chips_input_event_t* event);
 // get current joystick bitmask state
 uint8_t cpc_joystick_mask(cpc_t* sys);
 // load a snapshot file (.sna or .bin) into the emulator
@@ -197,7 +241,7 @@ bool cpc_quickload(cpc_t* cpc, chips_range_t data, bool start);
 uint16_t cpc_quickload_exec_addr(chips_range_t data);
 // return the return-address for a quickloaded file
 uint16_t cpc_quickload_return_addr(cpc_t* cpc);
-// insert a disk image file (.dsk)
+// insert a disk image file (.dsk), data will be copied
 bool cpc_insert_disc(cpc_t* cpc, chips_range_t data);
 // remove current disc
 void cpc_remove_disc(cpc_t* cpc);
@@ -211,6 +255,10 @@ bool cpc_video_debugging_enabled(cpc_t* cpc);
 uint32_t cpc_save_snapshot(cpc_t* sys, cpc_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
 bool cpc_load_snapshot(cpc_t* sys, uint32_t version, cpc_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks)
+uint64_t cpc_state_hash(cpc_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t cpc_frame_hash(cpc_t* sys);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -226,6 +274,9 @@ bool cpc_load_snapshot(cpc_t* sys, uint32_t version, cpc_t* src);
 
 #define _CPC_FREQUENCY (4000000)
 
+// scheduler event ids
+#define _CPC_EVENT_SAMPLE (0)
+
 static uint64_t _cpc_cclk(void* user_data);
 static void _cpc_psg_out(int port_id, uint8_t data, void* user_data);
 static uint8_t _cpc_psg_in(int port_id, void* user_data);
@@ -237,6 +288,8 @@ static int _cpc_fdc_read(int drive, int side, void* user_data, uint8_t* out_data
 static int _cpc_fdc_write(int drive, int side, void* user_data, uint8_t data);
 static int _cpc_fdc_trackinfo(int drive, int side, void* user_data, upd765_sectorinfo_t* out_info);
 static void _cpc_fdc_driveinfo(int drive, void* user_data, upd765_driveinfo_t* out_info);
+static void _cpc_init_events(cpc_t* sys);
+static void _cpc_sync_psg(cpc_t* sys);
 
 #define _CPC_DEFAULT(val,def) (((val) != 0) ? (val) : (def))
 
@@ -246,10 +299,18 @@ void cpc_init(cpc_t* sys, const cpc_desc_t* desc) {
 
     memset(sys, 0, sizeof(cpc_t));
     sys->valid = true;
+    clk_init(&sys->clk, _CPC_FREQUENCY);
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[CPC_PERF_NUM] = { "z80", "am40010", "mc6845", "ay38910" };
+    chips_perf_init(&sys->perf, CPC_PERF_NUM, perf_names);
+#endif
     sys->type = desc->type;
     sys->joystick_type = desc->joystick_type;
+    sys->per_tick = desc->per_tick;
     sys->audio.callback = desc->audio.callback;
+    sys->audio.tracks_callback = desc->audio.tracks_callback;
     sys->audio.num_samples = _CPC_DEFAULT(desc->audio.num_samples, CPC_DEFAULT_AUDIO_SAMPLES);
     CHIPS_ASSERT(sys->audio.num_samples <= CPC_MAX_AUDIO_SAMPLES);
     if (CPC_TYPE_464 == desc->type) {
@@ -281,7 +342,8 @@ void cpc_init(cpc_t* sys, const cpc_desc_t* desc) {
         .tick_hz = _CPC_FREQUENCY / 4,
         .sound_hz = _CPC_DEFAULT(desc->audio.sample_rate, 44100),
         .magnitude = _CPC_DEFAULT(desc->audio.volume, 0.5f),
-        .user_data = sys
+        .user_data = sys,
+        .channel_samples = 0 != desc->audio.tracks_callback.func,
     });
     mc6845_init(&sys->crtc, MC6845_TYPE_UM6845R);
     mem_init(&sys->mem);
@@ -309,6 +371,8 @@ void cpc_init(cpc_t* sys, const cpc_desc_t* desc) {
         .user_data = sys,
     });
     fdd_init(&sys->fdd);
+    sched_init(&sys->sched);
+    _cpc_init_events(sys);
 
     _cpc_init_keymap(sys);
 }
@@ -322,16 +386,28 @@ void cpc_reset(cpc_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     mem_unmap_all(&sys->mem);
     mc6845_reset(&sys->crtc);
+    _cpc_sync_psg(sys);
     ay38910_reset(&sys->psg);
     i8255_reset(&sys->ppi);
     am40010_reset(&sys->ga);
     sys->pins = z80_reset(&sys->cpu);
     sys->kbd_joymask = 0;
     sys->joy_joymask = 0;
+    _cpc_init_events(sys);
+}
+
+// (re-)schedule the audio sample event after init or reset
+static void _cpc_init_events(cpc_t* sys) {
+    if (!sys->per_tick) {
+        sched_in(&sys->sched, _CPC_EVENT_SAMPLE, (uint64_t)(sys->psg.sample_counter + AY38910_FIXEDPOINT_SCALE - 1) / AY38910_FIXEDPOINT_SCALE);
+        sys->psg_tick = sys->sched.now;
+    }
 }
 
 static uint64_t _cpc_tick(cpc_t* sys, uint64_t cpu_pins) {
+    CHIPS_PERF_BEGIN(&sys->perf, CPC_PERF_CPU);
     cpu_pins = z80_tick(&sys->cpu, cpu_pins);
+    CHIPS_PERF_END(&sys->perf, CPC_PERF_CPU);
 
     // memory and IO requests
     if (cpu_pins & Z80_MREQ) {
@@ -382,7 +458,8 @@ static uint64_t _cpc_tick(cpc_t* sys, uint64_t cpu_pins) {
                 PC0..PC3: select keyboard matrix line
         */
         if ((cpu_pins & Z80_A11) == 0) {
-            // i8255 in/out
+            // i8255 in/out, the PSG is connected to the PPI
+            _cpc_sync_psg(sys);
             uint64_t ppi_pins = (cpu_pins & Z80_PIN_MASK & ~(I8255_PC_PINS|I8255_A1|I8255_A0)) | I8255_CS;
             if (cpu_pins & Z80_A9) { ppi_pins |= I8255_A1; }
             if (cpu_pins & Z80_A8) { ppi_pins |= I8255_A0; }
@@ -466,29 +543,71 @@ static uint64_t _cpc_tick(cpc_t* sys, uint64_t cpu_pins) {
        (see _cpc_cclk callback). The returned CPU pin mask
        will have the WAIT and INT pin set as needed.
     */
+    CHIPS_PERF_BEGIN(&sys->perf, CPC_PERF_GA);
     cpu_pins = am40010_tick(&sys->ga, cpu_pins) & Z80_PIN_MASK;
+    CHIPS_PERF_END(&sys->perf, CPC_PERF_GA);
     return cpu_pins;
 }
 
-/* handle a 1 MHz CCLK tick generated by the gate array, this ticks the
-   MC6845 CRTC and AY-3-8912 PSG, and must return the CRTC pins.
-*/
-static uint64_t _cpc_cclk(void* user_data) {
-    cpc_t* sys = (cpc_t*) user_data;
-    // tick the sound chip...
+// tick the PSG, and output a new audio sample when ready
+static void _cpc_tick_psg(cpc_t* sys) {
+    CHIPS_PERF_BEGIN(&sys->perf, CPC_PERF_PSG);
     if (ay38910_tick(&sys->psg)) {
         // new sound sample ready
+        if (sys->audio.tracks_callback.func) {
+            chips_audio_sample_t* dst = &sys->audio.tracks_buffer[sys->audio.sample_pos * CPC_AUDIO_NUM_TRACKS];
+            for (int i = 0; i < CPC_AUDIO_NUM_TRACKS; i++) {
+                dst[i] = sys->psg.channel_sample[i];
+            }
+        }
         sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->psg.sample;
         if (sys->audio.sample_pos == sys->audio.num_samples) {
             if (sys->audio.callback.func) {
                 // new sample packet is ready
                 sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
             }
+            if (sys->audio.tracks_callback.func) {
+                sys->audio.tracks_callback.func(sys->audio.tracks_buffer, sys->audio.num_samples, CPC_AUDIO_NUM_TRACKS, sys->audio.tracks_callback.user_data);
+            }
             sys->audio.sample_pos = 0;
         }
     }
+    CHIPS_PERF_END(&sys->perf, CPC_PERF_PSG);
+}
+
+// in event scheduling mode, catch up the PSG until the current CCLK tick
+static void _cpc_sync_psg(cpc_t* sys) {
+    if (!sys->per_tick) {
+        while (sys->psg_tick < sys->sched.now) {
+            sys->psg_tick++;
+            _cpc_tick_psg(sys);
+        }
+    }
+}
+
+/* handle a 1 MHz CCLK tick generated by the gate array, this ticks the
+   MC6845 CRTC and AY-3-8912 PSG, and must return the CRTC pins.
+*/
+static uint64_t _cpc_cclk(void* user_data) {
+    cpc_t* sys = (cpc_t*) user_data;
+    // tick the sound chip, or in event scheduling mode, only catch
+    // it up when the next audio sample is due
+    if (sys->per_tick) {
+        _cpc_tick_psg(sys);
+    }
+    else if (++sys->sched.now >= sys->sched.next) {
+        int event;
+        while ((event = sched_pop(&sys->sched)) >= 0) {
+            if (_CPC_EVENT_SAMPLE == event) {
+                _cpc_sync_psg(sys);
+                sched_in(&sys->sched, _CPC_EVENT_SAMPLE, (uint64_t)(sys->psg.sample_counter + AY38910_FIXEDPOINT_SCALE - 1) / AY38910_FIXEDPOINT_SCALE);
+            }
+        }
+    }
     // tick the CRTC and return its pin mask
+    CHIPS_PERF_BEGIN(&sys->perf, CPC_PERF_CRTC);
     uint64_t crtc_pins = mc6845_tick(&sys->crtc);
+    CHIPS_PERF_END(&sys->perf, CPC_PERF_CRTC);
     return crtc_pins;
 }
 
@@ -581,29 +700,72 @@ static void _cpc_bankswitch(uint8_t ram_config, uint8_t rom_enable, uint8_t rom_
     }
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _cpc_debug_event(cpc_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && z80_opdone(&sys->cpu)) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR))) ||
+           ((events & CHIPS_DEBUG_EVENT_IO) && ((pins & (Z80_IORQ|Z80_M1)) == Z80_IORQ)) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (Z80_INT|Z80_NMI))));
+}
+
 uint32_t cpc_exec(cpc_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    const uint32_t num_ticks = clk_us_to_ticks(_CPC_FREQUENCY, micro_seconds);
+    return cpc_exec_ticks(sys, clk_advance_us(&sys->clk, micro_seconds));
+}
+
+// run for max_ticks, or until num_samples audio samples have been generated (-1 for no limit), return executed ticks
+static uint32_t _cpc_exec(cpc_t* sys, uint32_t max_ticks, int num_samples) {
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->audio.sample_pos;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug hook
-        for (uint32_t tick = 0; tick < num_ticks; tick++) {
+        while ((num_ticks < max_ticks) && (num_samples != 0)) {
             pins = _cpc_tick(sys, pins);
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
-    } else {
-        // run with debug hook
-        for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->debug.stopped); tick++) {
+    }
+    else {
+        // run with debug hook in each tick, or only on requested events
+        while ((num_ticks < max_ticks) && (num_samples != 0) && !(*sys->debug.stopped)) {
             pins = _cpc_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_cpc_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     sys->pins = pins;
+    const uint32_t micro_seconds = clk_ticks_to_us(_CPC_FREQUENCY, num_ticks);
     kbd_update(&sys->kbd, micro_seconds);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, 0);
     return num_ticks;
 }
 
+uint32_t cpc_exec_ticks(cpc_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return _cpc_exec(sys, num_ticks, -1);
+}
+
+uint32_t cpc_exec_samples(cpc_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->audio.num_samples > 1));
+    // the fractional tick remainder is carried across calls in the sound chip's sample counter
+    return _cpc_exec(sys, UINT32_MAX, (num_samples > 0) ? num_samples : 0);
+}
+
 void cpc_key_down(cpc_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_DOWN, (uint32_t)key_code, 0);
     if (sys->joystick_type == CPC_JOYSTICK_DIGITAL) {
         switch (key_code) {
             case 0x20: sys->kbd_joymask |= CPC_JOYSTICK_BTN0; break;
@@ -620,6 +782,7 @@ void cpc_key_down(cpc_t* sys, int key_code) {
 
 void cpc_key_up(cpc_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_UP, (uint32_t)key_code, 0);
     if (sys->joystick_type == CPC_JOYSTICK_DIGITAL) {
         switch (key_code) {
             case 0x20: sys->kbd_joymask &= ~CPC_JOYSTICK_BTN0; break;
@@ -636,6 +799,7 @@ void cpc_key_up(cpc_t* sys, int key_code) {
 
 void cpc_set_joystick_type(cpc_t* sys, cpc_joystick_type_t type) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK_TYPE, (uint32_t)type, 0);
     sys->joystick_type = type;
 }
 
@@ -646,9 +810,22 @@ cpc_joystick_type_t cpc_joystick_type(cpc_t* sys) {
 
 void cpc_joystick(cpc_t* sys, uint8_t mask) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK, mask, 0);
     sys->joy_joymask = mask;
 }
 
+void cpc_input_event(cpc_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: cpc_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_KEY_DOWN: cpc_key_down(sys, (int)event->a); break;
+        case CHIPS_INPUT_KEY_UP: cpc_key_up(sys, (int)event->a); break;
+        case CHIPS_INPUT_JOYSTICK: cpc_joystick(sys, (uint8_t)event->a); break;
+        case CHIPS_INPUT_JOYSTICK_TYPE: cpc_set_joystick_type(sys, (cpc_joystick_type_t)event->a); break;
+        default: break;
+    }
+}
+
 uint8_t cpc_joystick_mask(cpc_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     return sys->kbd_joymask | sys->joy_joymask;
@@ -835,6 +1012,7 @@ static bool _cpc_load_sna(cpc_t* sys, chips_range_t data) {
     sys->ppi.pc.outp = hdr->ppi_c;
     sys->ppi.control = hdr->ppi_control;
 
+    _cpc_sync_psg(sys);
     for (int i = 0; i < 16; i++) {
         ay38910_set_register(&sys->psg, i, hdr->psg_regs[i]);
     }
@@ -1049,6 +1227,13 @@ bool cpc_disc_inserted(cpc_t* sys) {
     return fdd_disc_inserted(&sys->fdd);
 }
 
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* cpc_perf_counters(cpc_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t cpc_display_info(cpc_t* sys) {
     const chips_display_info_t res = {
         .frame = {
@@ -1082,7 +1267,12 @@ uint32_t cpc_save_snapshot(cpc_t* sys, cpc_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
+    chips_audio_tracks_callback_snapshot_onsave(&dst->audio.tracks_callback);
     ay38910_snapshot_onsave(&dst->psg);
     upd765_snapshot_onsave(&dst->fdc);
     am40010_snapshot_onsave(&dst->ga);
@@ -1098,7 +1288,12 @@ bool cpc_load_snapshot(cpc_t* sys, uint32_t version, cpc_t* src) {
     static cpc_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
+    chips_audio_tracks_callback_snapshot_onload(&im.audio.tracks_callback, &sys->audio.tracks_callback);
     ay38910_snapshot_onload(&im.psg, &sys->psg);
     upd765_snapshot_onload(&im.fdc, &sys->fdc);
     am40010_snapshot_onload(&im.ga, &sys->ga);
@@ -1107,4 +1302,54 @@ bool cpc_load_snapshot(cpc_t* sys, uint32_t version, cpc_t* src) {
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by cpc_init())
+#define _CPC_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t cpc_state_hash(cpc_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping callbacks and the exec clock (which only
+    // tracks fractions of cpc_exec() calls); chips with host pointers are hashed
+    // through a copy with the pointers cleared like in a snapshot
+    uint64_t h = _CPC_HASH(0, sys->cpu);
+    ay38910_t psg;
+    memcpy(&psg, &sys->psg, sizeof(psg));
+    ay38910_snapshot_onsave(&psg);
+    h = _CPC_HASH(h, psg);
+    h = _CPC_HASH(h, sys->crtc);
+    h = _CPC_HASH(h, sys->ppi);
+    upd765_t fdc;
+    memcpy(&fdc, &sys->fdc, sizeof(fdc));
+    upd765_snapshot_onsave(&fdc);
+    h = _CPC_HASH(h, fdc);
+    am40010_t ga;
+    memcpy(&ga, &sys->ga, sizeof(ga));
+    am40010_snapshot_onsave(&ga);
+    h = _CPC_HASH(h, ga);
+    h = _CPC_HASH(h, sys->type);
+    h = _CPC_HASH(h, sys->joystick_type);
+    h = _CPC_HASH(h, sys->kbd_joymask);
+    h = _CPC_HASH(h, sys->joy_joymask);
+    h = _CPC_HASH(h, sys->kbd);
+    mem_t mem;
+    memcpy(&mem, &sys->mem, sizeof(mem));
+    mem_snapshot_onsave(&mem, sys);
+    h = _CPC_HASH(h, mem);
+    h = _CPC_HASH(h, sys->per_tick);
+    h = _CPC_HASH(h, sys->sched);
+    h = _CPC_HASH(h, sys->psg_tick);
+    h = _CPC_HASH(h, sys->pins);
+    h = _CPC_HASH(h, sys->audio.sample_pos);
+    h = chips_hash(sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(chips_audio_sample_t), h);
+    h = _CPC_HASH(h, sys->ram);
+    h = _CPC_HASH(h, sys->rom_os);
+    h = _CPC_HASH(h, sys->rom_basic);
+    h = _CPC_HASH(h, sys->rom_amsdos);
+    return _CPC_HASH(h, sys->fdd);
+}
+
+uint64_t cpc_frame_hash(cpc_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 #endif /* CHIPS_IMPL */
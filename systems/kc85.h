@@ -285,7 +285,17 @@ extern "C" {
 #define KC85_IRM0_PAGE (4)
 
 // bump this whenever the kc85_t struct layout changes
-#define KC85_SNAPSHOT_VERSION (KC85_TYPE_ID | 0x0002)
+#define KC85_SNAPSHOT_VERSION (KC85_TYPE_ID | 0x0006)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    KC85_PERF_CPU,   // Z80 CPU ticks
+    KC85_PERF_VIDEO, // video decoding
+    KC85_PERF_CTC,   // CTC ticks
+    KC85_PERF_PIO,   // PIO ticks
+    KC85_PERF_AUDIO, // beeper ticks and audio output
+    KC85_PERF_NUM,
+};
 
 #define KC85_MAX_AUDIO_SAMPLES (1024U)      // max number of audio samples in internal sample buffer
 #define KC85_DEFAULT_AUDIO_SAMPLES (128)    // default number of samples in internal sample buffer
@@ -341,6 +351,7 @@ typedef struct {
 // config parameters for kc85_init()
 typedef struct {
     chips_debug_t debug;
+    chips_input_callback_t input;  // optional input recording callback (see util/movie.h)
     chips_audio_desc_t audio;
 
     // an optional callback to be invoked after a snapshot file is loaded to apply patches
@@ -426,13 +437,18 @@ typedef struct {
     kbd_t kbd;
 
     bool valid;
+    clk_t clk;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
 
     struct {
         chips_audio_callback_t callback;
         int num_samples;
         int sample_pos;
-        float sample_buffer[KC85_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t sample_buffer[KC85_MAX_AUDIO_SAMPLES];
     } audio;
     kc85_patch_callback_t patch_callback;
 
@@ -458,10 +474,20 @@ void kc85_reset(kc85_t* sys);
 chips_display_info_t kc85_display_info(kc85_t* sys);
 // run KC85 emulation for a given number of microseconds, returns number of ticks executed
 uint32_t kc85_exec(kc85_t* sys, uint32_t micro_seconds);
+// run KC85 instance for an exact number of ticks, return number of ticks executed
+uint32_t kc85_exec_ticks(kc85_t* sys, uint32_t num_ticks);
+// run KC85 instance until a number of audio samples has been generated, return number of ticks executed
+uint32_t kc85_exec_samples(kc85_t* sys, int num_samples);
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* kc85_perf_counters(kc85_t* sys);
+#endif
 // send a key-down event
 void kc85_key_down(kc85_t* sys, int key_code);
 // send a key-up event
 void kc85_key_up(kc85_t* sys, int key_code);
+// replay a recorded input event (see util/movie.h)
+void kc85_input_event(kc85_t* sys, const chips_input_event_t* event);
 // insert a RAM module (slot must be 0x08 or 0x0C)
 bool kc85_insert_ram_module(kc85_t* sys, uint8_t slot, kc85_module_type_t type);
 // insert a ROM module (slot must be 0x08 or 0x0C)
@@ -502,6 +528,10 @@ bool kc85_quickload(kc85_t* sys, chips_range_t data, bool start);
 uint32_t kc85_save_snapshot(kc85_t* sys, kc85_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
 bool kc85_load_snapshot(kc85_t* sys, uint32_t version, const kc85_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks)
+uint64_t kc85_state_hash(kc85_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t kc85_frame_hash(kc85_t* sys);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -588,8 +618,14 @@ void kc85_init(kc85_t* sys, const kc85_desc_t* desc) {
     memset(sys, 0, sizeof(kc85_t));
     sys->valid = true;
     sys->freq_hz = KC85_FREQUENCY;
+    clk_init(&sys->clk, sys->freq_hz);
     sys->patch_callback = desc->patch_callback;
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[KC85_PERF_NUM] = { "z80", "video", "z80ctc", "z80pio", "beeper" };
+    chips_perf_init(&sys->perf, KC85_PERF_NUM, perf_names);
+#endif
 
     // copy ROM images
     #if defined(CHIPS_KC85_TYPE_2)
@@ -920,7 +956,9 @@ static void _kc85_update_memory_map(kc85_t* sys) {
 
 static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
     // tick the CPU
+    CHIPS_PERF_BEGIN(&sys->perf, KC85_PERF_CPU);
     pins = z80_tick(&sys->cpu, pins) & Z80_PIN_MASK;
+    CHIPS_PERF_END(&sys->perf, KC85_PERF_CPU);
 
     // handle memory requests
     if (pins & Z80_MREQ) {
@@ -934,7 +972,9 @@ static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
     }
 
     // tick the video system, may set CLKTRG0..3
+    CHIPS_PERF_BEGIN(&sys->perf, KC85_PERF_VIDEO);
     pins = _kc85_tick_video(sys, pins);
+    CHIPS_PERF_END(&sys->perf, KC85_PERF_VIDEO);
 
     // tick the CTC
     {
@@ -945,7 +985,9 @@ static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
         }
         if (pins & Z80_A0) { pins |= Z80CTC_CS0; }
         if (pins & Z80_A1) { pins |= Z80CTC_CS1; }
+        CHIPS_PERF_BEGIN(&sys->perf, KC85_PERF_CTC);
         pins = z80ctc_tick(&sys->ctc, pins);
+        CHIPS_PERF_END(&sys->perf, KC85_PERF_CTC);
         // toggle audio and blink flip flops
         sys->flip_flops ^= pins;
         pins &= Z80_PIN_MASK;
@@ -960,7 +1002,9 @@ static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
         if (pins & Z80_A0) { pins |= Z80PIO_BASEL; }
         if (pins & Z80_A1) { pins |= Z80PIO_CDSEL; }
         Z80PIO_SET_PAB(pins, 0xFF, 0xFF);
+        CHIPS_PERF_BEGIN(&sys->perf, KC85_PERF_PIO);
         pins = z80pio_tick(&sys->pio, pins);
+        CHIPS_PERF_END(&sys->perf, KC85_PERF_PIO);
         #if defined(CHIPS_KC85_TYPE_4)
             // volume and symmetry-flip-flop control on KC85/4
             if (((pins ^ sys->pio_pins)>>Z80PIO_PIN_PB1) & 0x0F) {
@@ -984,12 +1028,13 @@ static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
     }
 
     // tick the audio beepers
+    CHIPS_PERF_BEGIN(&sys->perf, KC85_PERF_AUDIO);
     beeper_set(&sys->beeper_1, sys->flip_flops & KC85_FLIPFLOP_BEEPER_1);
     beeper_set(&sys->beeper_2, sys->flip_flops & KC85_FLIPFLOP_BEEPER_2);
     beeper_tick(&sys->beeper_1);
     if (beeper_tick(&sys->beeper_2)) {
         // new audio sample ready
-        sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->beeper_1.sample + sys->beeper_2.sample;
+        sys->audio.sample_buffer[sys->audio.sample_pos++] = chips_audio_clamp((chips_audio_accum_t)sys->beeper_1.sample + sys->beeper_2.sample);
         if (sys->audio.sample_pos == sys->audio.num_samples) {
             if (sys->audio.callback.func) {
                 sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
@@ -997,6 +1042,7 @@ static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
             sys->audio.sample_pos = 0;
         }
     }
+    CHIPS_PERF_END(&sys->perf, KC85_PERF_AUDIO);
 
     // IO port 0x80: expansion module control, high byte of
     // port address contains module slot address
@@ -1037,29 +1083,70 @@ static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
     return pins;
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _kc85_debug_event(kc85_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && z80_opdone(&sys->cpu)) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR))) ||
+           ((events & CHIPS_DEBUG_EVENT_IO) && ((pins & (Z80_IORQ|Z80_M1)) == Z80_IORQ)) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (Z80_INT|Z80_NMI))));
+}
+
 uint32_t kc85_exec(kc85_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    const uint32_t num_ticks = clk_us_to_ticks(sys->freq_hz, micro_seconds);
+    return kc85_exec_ticks(sys, clk_advance_us(&sys->clk, micro_seconds));
+}
+
+// run for max_ticks, or until num_samples audio samples have been generated (-1 for no limit), return executed ticks
+static uint32_t _kc85_exec(kc85_t* sys, uint32_t max_ticks, int num_samples) {
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->audio.sample_pos;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug hook
-        for (uint32_t tick = 0; tick < num_ticks; tick++) {
+        while ((num_ticks < max_ticks) && (num_samples != 0)) {
             pins = _kc85_tick(sys, pins);
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     else {
-        // run with debug hook
-        for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->debug.stopped); tick++) {
+        // run with debug hook in each tick, or only on requested events
+        while ((num_ticks < max_ticks) && (num_samples != 0) && !(*sys->debug.stopped)) {
             pins = _kc85_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_kc85_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     sys->pins = pins;
+    const uint32_t micro_seconds = clk_ticks_to_us(sys->freq_hz, num_ticks);
     kbd_update(&sys->kbd, micro_seconds);
     _kc85_handle_keyboard(sys);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, 0);
     return num_ticks;
 }
 
+uint32_t kc85_exec_ticks(kc85_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return _kc85_exec(sys, num_ticks, -1);
+}
+
+uint32_t kc85_exec_samples(kc85_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->audio.num_samples > 1));
+    // the fractional tick remainder is carried across calls in the sound chip's sample counter
+    return _kc85_exec(sys, UINT32_MAX, (num_samples > 0) ? num_samples : 0);
+}
+
 static void _kc85_init_memory_map(kc85_t* sys) {
     mem_init(&sys->mem);
     sys->pio_pins = KC85_PIO_RAM | KC85_PIO_RAM_RO | KC85_PIO_IRM | KC85_PIO_CAOS_ROM;
@@ -1664,14 +1751,33 @@ bool kc85_quickload(kc85_t* sys, chips_range_t data, bool start) {
 
 void kc85_key_down(kc85_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_DOWN, (uint32_t)key_code, 0);
     kbd_key_down(&sys->kbd, key_code);
 }
 
 void kc85_key_up(kc85_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_UP, (uint32_t)key_code, 0);
     kbd_key_up(&sys->kbd, key_code);
 }
 
+void kc85_input_event(kc85_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: kc85_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_KEY_DOWN: kc85_key_down(sys, (int)event->a); break;
+        case CHIPS_INPUT_KEY_UP: kc85_key_up(sys, (int)event->a); break;
+        default: break;
+    }
+}
+
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* kc85_perf_counters(kc85_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t kc85_display_info(kc85_t* sys) {
     static const uint32_t palette[36] = {
         // 16 foreground colors
@@ -1749,6 +1855,10 @@ uint32_t kc85_save_snapshot(kc85_t* sys, kc85_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     dst->patch_callback.func = 0;
     dst->patch_callback.user_data = 0;
@@ -1766,6 +1876,10 @@ bool kc85_load_snapshot(kc85_t* sys, uint32_t version, const kc85_t* src) {
     static kc85_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     im.patch_callback = sys->patch_callback;
     mem_snapshot_onload(&im.mem, sys);
@@ -1773,4 +1887,49 @@ bool kc85_load_snapshot(kc85_t* sys, uint32_t version, const kc85_t* src) {
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by kc85_init())
+#define _KC85_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t kc85_state_hash(kc85_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping host pointers, callbacks and the exec clock (which
+    // only tracks fractions of kc85_exec() calls)
+    uint64_t h = _KC85_HASH(0, sys->cpu);
+    // the memory mapping depends on PIO, IO84/IO86 and expansion module state
+    mem_t mem;
+    memcpy(&mem, &sys->mem, sizeof(mem));
+    mem_snapshot_onsave(&mem, sys);
+    h = _KC85_HASH(h, mem);
+    h = _KC85_HASH(h, sys->video);
+    h = _KC85_HASH(h, sys->pio_pins);
+    #if defined(CHIPS_KC85_TYPE_4)
+        h = _KC85_HASH(h, sys->io84);
+        h = _KC85_HASH(h, sys->io86);
+    #endif
+    h = _KC85_HASH(h, sys->ctc);
+    h = _KC85_HASH(h, sys->flip_flops);
+    h = _KC85_HASH(h, sys->beeper_1);
+    h = _KC85_HASH(h, sys->beeper_2);
+    h = _KC85_HASH(h, sys->pio);
+    h = _KC85_HASH(h, sys->exp);
+    h = _KC85_HASH(h, sys->pins);
+    h = _KC85_HASH(h, sys->kbd);
+    h = _KC85_HASH(h, sys->audio.sample_pos);
+    h = chips_hash(sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(chips_audio_sample_t), h);
+    h = _KC85_HASH(h, sys->ram);
+    #if defined(CHIPS_KC85_TYPE_3) || defined(CHIPS_KC85_TYPE_4)
+        h = _KC85_HASH(h, sys->rom_basic);
+    #endif
+    #if defined(CHIPS_KC85_TYPE_4)
+        h = _KC85_HASH(h, sys->rom_caos_c);
+    #endif
+    h = _KC85_HASH(h, sys->rom_caos_e);
+    return _KC85_HASH(h, sys->exp_buf);
+}
+
+uint64_t kc85_frame_hash(kc85_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 #endif /* CHIPS_IMPL */
@@ -77,7 +77,17 @@ extern "C" {
 #endif
 
 // bump this whenever the lc80_t struct layout changes
-#define LC80_SNAPSHOT_VERSION (0x0001)
+#define LC80_SNAPSHOT_VERSION (0x0005)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    LC80_PERF_CPU,     // Z80 CPU ticks
+    LC80_PERF_CTC,     // CTC ticks
+    LC80_PERF_PIO_USR, // user PIO ticks
+    LC80_PERF_PIO_SYS, // system PIO ticks and LED display update
+    LC80_PERF_BEEPER,  // beeper ticks and audio output
+    LC80_PERF_NUM,
+};
 
 // key codes (for lc80_key(), lc80_key_down(), lc80_key_up()
 #define LC80_KEY_0      ('0')
@@ -191,6 +201,7 @@ extern "C" {
 // config parameters for lc80_init()
 typedef struct {
     chips_debug_t debug;
+    chips_input_callback_t input;  // optional input recording callback (see util/movie.h)
     chips_audio_desc_t audio;
     chips_range_t rom;
 } lc80_desc_t;
@@ -211,8 +222,13 @@ typedef struct {
     bool nmi;
 
     bool valid;
+    clk_t clk;
     uint64_t pins;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
 
     kbd_t kbd;
     uint32_t freq_hz;
@@ -221,7 +237,7 @@ typedef struct {
         chips_audio_callback_t callback;
         int num_samples;
         int sample_pos;
-        float sample_buffer[LC80_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t sample_buffer[LC80_MAX_AUDIO_SAMPLES];
     } audio;
 
     uint8_t ram[0x0400];
@@ -232,11 +248,19 @@ void lc80_init(lc80_t* sys, const lc80_desc_t* desc);
 void lc80_discard(lc80_t* sys);
 void lc80_reset(lc80_t* sys);
 uint32_t lc80_exec(lc80_t* sys, uint32_t micro_seconds);
+uint32_t lc80_exec_ticks(lc80_t* sys, uint32_t num_ticks);
+uint32_t lc80_exec_samples(lc80_t* sys, int num_samples);
 void lc80_key_down(lc80_t* sys, int key_code);
 void lc80_key_up(lc80_t* sys, int key_code);
 void lc80_key(lc80_t* sys, int key_code);       // down + up
+void lc80_input_event(lc80_t* sys, const chips_input_event_t* event);   // replay a recorded input event (see util/movie.h)
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* lc80_perf_counters(lc80_t* sys);  // get per-chip performance counters (see CHIPS_PERF_COUNTERS)
+#endif
 uint32_t lc80_save_snapshot(lc80_t* sys, lc80_t* dst);  // capture snapshot, return snapshot layout version
 bool lc80_load_snapshot(lc80_t* sys, uint32_t version, lc80_t* src);    // load snapshot, return false if version didn't match
+uint64_t lc80_state_hash(lc80_t* sys);  // compute a 64-bit hash over the emulator state (without host pointers and callbacks)
+uint64_t lc80_frame_hash(lc80_t* sys);  // compute a 64-bit hash over the LED display state
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -259,11 +283,17 @@ void lc80_init(lc80_t* sys, const lc80_desc_t* desc) {
     memset(sys, 0, sizeof(lc80_t));
     sys->valid = true;
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[LC80_PERF_NUM] = { "z80", "z80ctc", "z80pio-usr", "z80pio-sys", "beeper" };
+    chips_perf_init(&sys->perf, LC80_PERF_NUM, perf_names);
+#endif
 
     CHIPS_ASSERT(desc->rom.ptr && (desc->rom.size == sizeof(sys->rom)));
     memcpy(sys->rom, desc->rom.ptr, sizeof(sys->rom));
 
     sys->freq_hz = 900000;
+    clk_init(&sys->clk, sys->freq_hz);
     z80_init(&sys->cpu);
     z80ctc_init(&sys->ctc);
     z80pio_init(&sys->pio_sys);
@@ -381,7 +411,9 @@ static uint32_t _lc80_vqe23_write(uint32_t vqe23, int digit, uint8_t data) {
 
 // LC80 CPU tick callback
 uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
+    CHIPS_PERF_BEGIN(&sys->perf, LC80_PERF_CPU);
     pins = z80_tick(&sys->cpu, pins);
+    CHIPS_PERF_END(&sys->perf, LC80_PERF_CPU);
 
     /* Address decoding via the two DS8205 3-to-8 decoders (LS138 clones)
 
@@ -460,7 +492,9 @@ uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
         if (0 == (pins & Z80_A4)) { pins |= Z80CTC_CE; };
         if (pins & Z80_A0) { pins |= Z80CTC_CS0; }
         if (pins & Z80_A1) { pins |= Z80CTC_CS1; }
+        CHIPS_PERF_BEGIN(&sys->perf, LC80_PERF_CTC);
         pins = z80ctc_tick(&sys->ctc, pins) & Z80_PIN_MASK;
+        CHIPS_PERF_END(&sys->perf, LC80_PERF_CTC);
     }
 
     // tick user PIO (next in daisychain priority)
@@ -471,7 +505,9 @@ uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
         // bits 4..7 of port B are keyboard matrix lines
         const uint8_t kbd_lines = ~(kbd_scan_lines(&sys->kbd)<<4);
         Z80PIO_SET_PAB(pins, 0xFF, kbd_lines);
+        CHIPS_PERF_BEGIN(&sys->perf, LC80_PERF_PIO_USR);
         pins = z80pio_tick(&sys->pio_usr, pins);
+        CHIPS_PERF_END(&sys->perf, LC80_PERF_PIO_USR);
         pins &= Z80_PIN_MASK;
     }
 
@@ -481,6 +517,7 @@ uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
         if (pins & Z80_A0) { pins |= Z80PIO_BASEL; }
         if (pins & Z80_A1) { pins |= Z80PIO_CDSEL; }
         Z80PIO_SET_PAB(pins, 0xFF, 0xFF);
+        CHIPS_PERF_BEGIN(&sys->perf, LC80_PERF_PIO_SYS);
         pins = z80pio_tick(&sys->pio_sys, pins);
         const uint8_t pio_a = Z80PIO_GET_PA(pins);
         const uint8_t pio_b = Z80PIO_GET_PB(pins);
@@ -543,11 +580,13 @@ uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
         /* bits 2..7 of port B also double as input to the keyboard matrix */
         uint8_t kbd_columns = ~(pio_b >> 2) & 0x3F;
         kbd_set_active_columns(&sys->kbd, kbd_columns);
+        CHIPS_PERF_END(&sys->perf, LC80_PERF_PIO_SYS);
 
         pins &= Z80_PIN_MASK;
     }
 
     // tick beeper
+    CHIPS_PERF_BEGIN(&sys->perf, LC80_PERF_BEEPER);
     if (beeper_tick(&sys->beeper)) {
         /* new audio sample ready */
         sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->beeper.sample;
@@ -558,6 +597,7 @@ uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
             sys->audio.sample_pos = 0;
         }
     }
+    CHIPS_PERF_END(&sys->perf, LC80_PERF_BEEPER);
     if (sys->nmi) {
         pins |= Z80_NMI;
     }
@@ -567,24 +607,53 @@ uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
     return pins;
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _lc80_debug_event(lc80_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && z80_opdone(&sys->cpu)) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR))) ||
+           ((events & CHIPS_DEBUG_EVENT_IO) && ((pins & (Z80_IORQ|Z80_M1)) == Z80_IORQ)) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (Z80_INT|Z80_NMI))));
+}
+
 uint32_t lc80_exec(lc80_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    const uint32_t num_ticks = clk_us_to_ticks(sys->freq_hz, micro_seconds);
+    return lc80_exec_ticks(sys, clk_advance_us(&sys->clk, micro_seconds));
+}
+
+// run for max_ticks, or until num_samples audio samples have been generated (-1 for no limit), return executed ticks
+static uint32_t _lc80_exec(lc80_t* sys, uint32_t max_ticks, int num_samples) {
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->audio.sample_pos;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debugger hook
-        for (uint32_t tick = 0; tick < num_ticks; tick++) {
+        while ((num_ticks < max_ticks) && (num_samples != 0)) {
             pins = _lc80_tick(sys, pins);
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     else {
-        // run with debugger hook
-        for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->debug.stopped); tick++) {
+        // run with debug hook in each tick, or only on requested events
+        while ((num_ticks < max_ticks) && (num_samples != 0) && !(*sys->debug.stopped)) {
             pins = _lc80_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_lc80_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     sys->pins = pins;
+    const uint32_t micro_seconds = clk_ticks_to_us(sys->freq_hz, num_ticks);
     if (sys->nmi) {
         sys->nmi = false;
     }
@@ -592,11 +661,24 @@ uint32_t lc80_exec(lc80_t* sys, uint32_t micro_seconds) {
         lc80_reset(sys);
     }
     kbd_update(&sys->kbd, micro_seconds);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, 0);
     return num_ticks;
 }
 
+uint32_t lc80_exec_ticks(lc80_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return _lc80_exec(sys, num_ticks, -1);
+}
+
+uint32_t lc80_exec_samples(lc80_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->audio.num_samples > 1));
+    // the fractional tick remainder is carried across calls in the sound chip's sample counter
+    return _lc80_exec(sys, UINT32_MAX, (num_samples > 0) ? num_samples : 0);
+}
+
 void lc80_key_down(lc80_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_DOWN, (uint32_t)key_code, 0);
     switch (key_code) {
         case LC80_KEY_RES: sys->reset = true; break;
         case LC80_KEY_NMI: sys->nmi = true; break;
@@ -606,6 +688,7 @@ void lc80_key_down(lc80_t* sys, int key_code) {
 
 void lc80_key_up(lc80_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_UP, (uint32_t)key_code, 0);
     switch (key_code) {
         case LC80_KEY_RES:
         case LC80_KEY_NMI:
@@ -623,10 +706,31 @@ void lc80_key(lc80_t* sys, int key_code) {
     lc80_key_up(sys, key_code);
 }
 
+void lc80_input_event(lc80_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: lc80_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_KEY_DOWN: lc80_key_down(sys, (int)event->a); break;
+        case CHIPS_INPUT_KEY_UP: lc80_key_up(sys, (int)event->a); break;
+        default: break;
+    }
+}
+
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* lc80_perf_counters(lc80_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 uint32_t lc80_save_snapshot(lc80_t* sys, lc80_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     return LC80_SNAPSHOT_VERSION;
 }
@@ -639,9 +743,45 @@ bool lc80_load_snapshot(lc80_t* sys, uint32_t version, lc80_t* src) {
     static lc80_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     *sys = im;
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by lc80_init())
+#define _LC80_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t lc80_state_hash(lc80_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping callbacks and the exec clock (which
+    // only tracks fractions of lc80_exec() calls)
+    uint64_t h = _LC80_HASH(0, sys->cpu);
+    h = _LC80_HASH(h, sys->ctc);
+    h = _LC80_HASH(h, sys->pio_sys);
+    h = _LC80_HASH(h, sys->pio_usr);
+    h = _LC80_HASH(h, sys->vqe23);
+    h = _LC80_HASH(h, sys->u505);
+    h = _LC80_HASH(h, sys->u214);
+    h = _LC80_HASH(h, sys->ds8205);
+    h = _LC80_HASH(h, sys->pio_b);
+    h = _LC80_HASH(h, sys->beeper);
+    h = _LC80_HASH(h, sys->reset);
+    h = _LC80_HASH(h, sys->nmi);
+    h = _LC80_HASH(h, sys->pins);
+    h = _LC80_HASH(h, sys->kbd);
+    h = _LC80_HASH(h, sys->audio.sample_pos);
+    h = chips_hash(sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(chips_audio_sample_t), h);
+    h = _LC80_HASH(h, sys->ram);
+    return _LC80_HASH(h, sys->rom);
+}
+
+uint64_t lc80_frame_hash(lc80_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->vqe23, sizeof(sys->vqe23), 0);
+}
+
 #endif /* CHIPS_IMPL */
@@ -68,10 +68,19 @@ extern "C" {
 #endif
 
 // increase when namco_t memory layout changes
-#define NAMCO_SNAPSHOT_VERSION (1)
+#define NAMCO_SNAPSHOT_VERSION (6)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    NAMCO_PERF_CPU,   // Z80 CPU ticks
+    NAMCO_PERF_SOUND, // sound generator ticks and sampling
+    NAMCO_PERF_VIDEO, // per-frame video decoding
+    NAMCO_PERF_NUM,
+};
 
 #define NAMCO_MAX_AUDIO_SAMPLES (1024)
 #define NAMCO_DEFAULT_AUDIO_SAMPLES (128)
+#define NAMCO_AUDIO_NUM_TRACKS (3)      // one audio track per WSG voice
 #define NAMCO_FRAMEBUFFER_WIDTH (512)
 #define NAMCO_FRAMEBUFFER_HEIGHT (224)
 #define NAMCO_FRAMEBUFFER_SIZE_BYTES (NAMCO_FRAMEBUFFER_WIDTH * NAMCO_FRAMEBUFFER_HEIGHT)
@@ -97,6 +106,7 @@ extern "C" {
 // configuration parameters for namco_init()
 typedef struct {
     chips_debug_t debug;
+    chips_input_callback_t input;  // optional input recording callback (see util/movie.h)
     chips_audio_desc_t audio;
     struct {
         // common ROM areas for Pacman and Pengo
@@ -133,20 +143,24 @@ typedef struct {
     int tick_counter;
     int sample_period;
     int sample_counter;
-    float volume;
+    int sync_counter;       // value of sample_counter at last sound generator update
+    chips_audio_accum_t volume;
     struct {
         uint32_t frequency; // 20-bit frequency
         uint32_t counter;   // 20-bit counter (top 5 bits are index into 32-byte wave table)
         uint8_t waveform;   // 3-bit waveform
         uint8_t volume;     // 4-bit volume
-        float sample;       // accumulated sample value
-        float sample_div  ; // oversampling divider
+        int32_t sample;     // accumulated sample value
+        int32_t sample_div; // oversampling divider
+        chips_audio_sample_t out;       // last output sample of this voice (already scaled for mixing)
     } voice[3];
     uint8_t rom[2][0x0100]; // wave table ROM
     int num_samples;
     int sample_pos;
     chips_audio_callback_t callback;
-    float sample_buffer[NAMCO_MAX_AUDIO_SAMPLES];
+    chips_audio_tracks_callback_t tracks_callback;
+    chips_audio_sample_t sample_buffer[NAMCO_MAX_AUDIO_SAMPLES];
+    chips_audio_sample_t tracks_buffer[NAMCO_MAX_AUDIO_SAMPLES * NAMCO_AUDIO_NUM_TRACKS];
 } namco_sound_t;
 
 // the Namco arcade machine state
@@ -169,7 +183,12 @@ typedef struct {
     uint8_t sprite_coords[16];      // 8 sprites, uint8_t x, uint8_t y
 
     bool valid;
+    clk_t clk;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
 
     namco_sound_t sound;
     uint8_t video_ram[0x0400];
@@ -193,14 +212,28 @@ void namco_reset(namco_t* sys);
 chips_display_info_t namco_display_info(namco_t* sys);
 // run namco_t instance for given amount of microseconds, return number of ticks executed
 uint32_t namco_exec(namco_t* sys, uint32_t micro_seconds);
+// run namco_t instance for an exact number of ticks, return number of ticks executed
+uint32_t namco_exec_ticks(namco_t* sys, uint32_t num_ticks);
+// run namco_t instance until a number of audio samples has been generated, return number of ticks executed
+uint32_t namco_exec_samples(namco_t* sys, int num_samples);
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* namco_perf_counters(namco_t* sys);
+#endif
 // set input bits
 void namco_input_set(namco_t* sys, uint32_t mask);
 // clear input bits
 void namco_input_clear(namco_t* sys, uint32_t mask);
+// replay a recorded input event (see util/movie.h)
+void namco_input_event(namco_t* sys, const chips_input_event_t* event);
 // take a snapshot, patches any pointers to zero, returns a snapshot version
 uint32_t namco_save_snapshot(namco_t* sys, namco_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
 bool namco_load_snapshot(namco_t* sys, uint32_t version, namco_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks)
+uint64_t namco_state_hash(namco_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t namco_frame_hash(namco_t* sys);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -383,7 +416,20 @@ bool namco_load_snapshot(namco_t* sys, uint32_t version, namco_t* src);
 
 static void _namco_sound_init(namco_t* sys, const namco_desc_t* desc);
 static void _namco_sound_wr(namco_t* sys, uint16_t addr, uint8_t data);
-static void _namco_sound_tick(namco_t* sys);
+static void _namco_sound_sync(namco_t* sys);
+static void _namco_sound_sample(namco_t* sys);
+
+/* The sound generator only runs when a sample is due, or when the CPU
+   writes a sound register, it then catches up with the CPU ticks elapsed
+   since the last update. The elapsed ticks are derived from the sample
+   counter, which is decremented by NAMCO_SAMPLE_SCALE each CPU tick.
+*/
+static inline void _namco_sound_tick(namco_t* sys) {
+    sys->sound.sample_counter -= NAMCO_SAMPLE_SCALE;
+    if (sys->sound.sample_counter < 0) {
+        _namco_sound_sample(sys);
+    }
+}
 
 #define _namco_def(val, def) (val == 0 ? def : val)
 
@@ -393,7 +439,13 @@ void namco_init(namco_t* sys, const namco_desc_t* desc) {
 
     memset(sys, 0, sizeof(namco_t));
     sys->valid = true;
+    clk_init(&sys->clk, NAMCO_CPU_CLOCK);
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[NAMCO_PERF_NUM] = { "z80", "wsg", "video" };
+    chips_perf_init(&sys->perf, NAMCO_PERF_NUM, perf_names);
+#endif
     sys->vsync_count = NAMCO_VSYNC_PERIOD;
     _namco_sound_init(sys, desc);
     sys->pins = z80_init(&sys->cpu);
@@ -544,10 +596,14 @@ static uint64_t _namco_tick(namco_t* sys, uint64_t pins) {
     }
 
     // tick the sound chip
+    CHIPS_PERF_BEGIN(&sys->perf, NAMCO_PERF_SOUND);
     _namco_sound_tick(sys);
+    CHIPS_PERF_END(&sys->perf, NAMCO_PERF_SOUND);
 
     // tick the cpu
+    CHIPS_PERF_BEGIN(&sys->perf, NAMCO_PERF_CPU);
     pins = z80_tick(&sys->cpu, pins);
+    CHIPS_PERF_END(&sys->perf, NAMCO_PERF_CPU);
 
     // memory requests
     uint16_t addr = Z80_GET_ADDR(pins) & NAMCO_ADDR_MASK;
@@ -564,6 +620,7 @@ static uint64_t _namco_tick(namco_t* sys, uint64_t pins) {
                     sys->int_enable = data & 1;
                 }
                 else if (addr == NAMCO_ADDR_SOUND_ENABLE) {
+                    _namco_sound_sync(sys);
                     sys->sound_enable = data & 1;
                 }
                 else if (addr == NAMCO_ADDR_FLIP_SCREEN) {
@@ -749,30 +806,73 @@ void _namco_decode_video(namco_t* sys) {
     _namco_decode_sprites(sys);
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _namco_debug_event(namco_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && z80_opdone(&sys->cpu)) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR))) ||
+           ((events & CHIPS_DEBUG_EVENT_IO) && ((pins & (Z80_IORQ|Z80_M1)) == Z80_IORQ)) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (Z80_INT|Z80_NMI))));
+}
+
 uint32_t namco_exec(namco_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    const uint32_t num_ticks = clk_us_to_ticks(NAMCO_CPU_CLOCK, micro_seconds);
+    return namco_exec_ticks(sys, clk_advance_us(&sys->clk, micro_seconds));
+}
+
+// run for max_ticks, or until num_samples audio samples have been generated (-1 for no limit), return executed ticks
+static uint32_t _namco_exec(namco_t* sys, uint32_t max_ticks, int num_samples) {
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->sound.sample_pos;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug hook
-        for (uint32_t tick = 0; tick < num_ticks; tick++) {
+        while ((num_ticks < max_ticks) && (num_samples != 0)) {
             pins = _namco_tick(sys, pins);
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->sound.sample_pos)) {
+                sample_pos = sys->sound.sample_pos;
+                num_samples--;
+            }
         }
     }
     else {
-        // run with debug hook
-        for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->debug.stopped); tick++) {
+        // run with debug hook in each tick, or only on requested events
+        while ((num_ticks < max_ticks) && (num_samples != 0) && !(*sys->debug.stopped)) {
             pins = _namco_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_namco_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->sound.sample_pos)) {
+                sample_pos = sys->sound.sample_pos;
+                num_samples--;
+            }
         }
     }
     sys->pins = pins;
+    CHIPS_PERF_BEGIN(&sys->perf, NAMCO_PERF_VIDEO);
     _namco_decode_video(sys);
+    CHIPS_PERF_END(&sys->perf, NAMCO_PERF_VIDEO);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, 0);
     return num_ticks;
 }
 
+uint32_t namco_exec_ticks(namco_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return _namco_exec(sys, num_ticks, -1);
+}
+
+uint32_t namco_exec_samples(namco_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->sound.num_samples > 1));
+    // the fractional tick remainder is carried across calls in the sound chip's sample counter
+    return _namco_exec(sys, UINT32_MAX, (num_samples > 0) ? num_samples : 0);
+}
+
 void namco_input_set(namco_t* sys, uint32_t mask) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_SET, mask, 0);
     if (mask & NAMCO_INPUT_P1_UP) {
         sys->in0 |= NAMCO_IN0_UP;
     }
@@ -823,6 +923,7 @@ void namco_input_set(namco_t* sys, uint32_t mask) {
 
 void namco_input_clear(namco_t* sys, uint32_t mask) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_CLEAR, mask, 0);
     if (mask & NAMCO_INPUT_P1_UP) {
         sys->in0 &= ~NAMCO_IN0_UP;
     }
@@ -871,6 +972,16 @@ void namco_input_clear(namco_t* sys, uint32_t mask) {
     }
 }
 
+void namco_input_event(namco_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: namco_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_SET: namco_input_set(sys, event->a); break;
+        case CHIPS_INPUT_CLEAR: namco_input_clear(sys, event->a); break;
+        default: break;
+    }
+}
+
 static void _namco_sound_init(namco_t* sys, const namco_desc_t* desc) {
     CHIPS_ASSERT(desc->audio.num_samples <= NAMCO_MAX_AUDIO_SAMPLES);
     // assume zero-initialized
@@ -878,9 +989,11 @@ static void _namco_sound_init(namco_t* sys, const namco_desc_t* desc) {
     snd->tick_counter = NAMCO_SOUND_PERIOD;
     snd->sample_period = (NAMCO_CPU_CLOCK * NAMCO_SAMPLE_SCALE) / _namco_def(desc->audio.sample_rate, 44100);
     snd->sample_counter = sys->sound.sample_period;
-    snd->volume = _namco_def(desc->audio.volume, 1.0f);
+    snd->sync_counter = snd->sample_counter;
+    snd->volume = CHIPS_AUDIO_VOLUME(_namco_def(desc->audio.volume, 1.0f));
     snd->num_samples = _namco_def(desc->audio.num_samples, NAMCO_DEFAULT_AUDIO_SAMPLES);
     snd->callback = desc->audio.callback;
+    snd->tracks_callback = desc->audio.tracks_callback;
 }
 
 #define _NAMCO_SET_NIBBLE_0(val, data) (val=(val&~0x0000F)|((data&0xF)<<0))
@@ -891,6 +1004,7 @@ static void _namco_sound_init(namco_t* sys, const namco_desc_t* desc) {
 
 static void _namco_sound_wr(namco_t* sys, uint16_t addr, uint8_t data) {
     namco_sound_t* snd = &sys->sound;
+    _namco_sound_sync(sys);
     switch (addr) {
         case NAMCO_ADDR_SOUND_V1_FC0:       _NAMCO_SET_NIBBLE_0(snd->voice[0].counter, data); break;
         case NAMCO_ADDR_SOUND_V1_FC1:       _NAMCO_SET_NIBBLE_1(snd->voice[0].counter, data); break;
@@ -927,11 +1041,12 @@ static void _namco_sound_wr(namco_t* sys, uint16_t addr, uint8_t data) {
     }
 }
 
-static void _namco_sound_tick(namco_t* sys) {
+// run the sound generator for the CPU ticks elapsed since the last update
+static void _namco_sound_sync(namco_t* sys) {
     namco_sound_t* snd = &sys->sound;
-    // tick the sound chip?
-    snd->tick_counter--;
-    if (snd->tick_counter < 0) {
+    snd->tick_counter -= (snd->sync_counter - snd->sample_counter) / NAMCO_SAMPLE_SCALE;
+    snd->sync_counter = snd->sample_counter;
+    while (snd->tick_counter < 0) {
         // handle 96KHz tick
         snd->tick_counter += NAMCO_SOUND_PERIOD / NAMCO_SOUND_OVERSAMPLE;
         for (int i = 0; i < 3; i++) {
@@ -943,35 +1058,61 @@ static void _namco_sound_tick(namco_t* sys) {
                 uint32_t smp_index = ((snd->voice[i].waveform<<5) | ((snd->voice[i].counter>>15) & 0x1F)) & 0xFF;
                 // integer sample value now 7-bits plus sign bit
                 int val = (((int)(snd->rom[0][smp_index] & 0xF)) - 8) * snd->voice[i].volume;
-                snd->voice[i].sample += (float)val;
+                snd->voice[i].sample += val;
             }
-            snd->voice[i].sample_div += 128.0f;
+            snd->voice[i].sample_div += 128;
         }
     }
+}
 
-    // generate a new sample?
-    snd->sample_counter -= NAMCO_SAMPLE_SCALE;
-    if (snd->sample_counter < 0) {
-        snd->sample_counter += snd->sample_period;
-        float sm = 0.0f;
+// generate a new sample, called from _namco_sound_tick() when a sample is due
+static void _namco_sound_sample(namco_t* sys) {
+    namco_sound_t* snd = &sys->sound;
+    _namco_sound_sync(sys);
+    snd->sample_counter += snd->sample_period;
+    snd->sync_counter = snd->sample_counter;
+    chips_audio_accum_t sm = 0;
+    for (int i = 0; i < 3; i++) {
+        if (snd->voice[i].sample_div > 0) {
+            #if defined(CHIPS_AUDIO_INT16)
+                chips_audio_accum_t avg = (snd->voice[i].sample * 32768) / snd->voice[i].sample_div;
+                snd->voice[i].out = chips_audio_clamp(chips_audio_scale(avg, snd->volume) / 3);
+            #else
+                snd->voice[i].out = ((float)snd->voice[i].sample / (float)snd->voice[i].sample_div) * snd->volume * 0.33333f;
+            #endif
+            snd->voice[i].sample = 0;
+            snd->voice[i].sample_div = 0;
+        }
+        else {
+            snd->voice[i].out = 0;
+        }
+        sm += snd->voice[i].out;
+    }
+    if (snd->tracks_callback.func) {
+        chips_audio_sample_t* dst = &snd->tracks_buffer[snd->sample_pos * NAMCO_AUDIO_NUM_TRACKS];
         for (int i = 0; i < 3; i++) {
-            if (snd->voice[i].sample_div > 0.0f) {
-                sm += snd->voice[i].sample / snd->voice[i].sample_div;
-                snd->voice[i].sample = 0.0f;
-                snd->voice[i].sample_div = 0.0f;
-            }
+            dst[i] = snd->voice[i].out;
         }
-        sm *= snd->volume * 0.33333f;
-        snd->sample_buffer[snd->sample_pos++] = sm;
-        if (snd->sample_pos == snd->num_samples) {
-            if (snd->callback.func) {
-                snd->callback.func(snd->sample_buffer, snd->num_samples, snd->callback.user_data);
-            }
-            snd->sample_pos = 0;
+    }
+    snd->sample_buffer[snd->sample_pos++] = chips_audio_clamp(sm);
+    if (snd->sample_pos == snd->num_samples) {
+        if (snd->callback.func) {
+            snd->callback.func(snd->sample_buffer, snd->num_samples, snd->callback.user_data);
+        }
+        if (snd->tracks_callback.func) {
+            snd->tracks_callback.func(snd->tracks_buffer, snd->num_samples, NAMCO_AUDIO_NUM_TRACKS, snd->tracks_callback.user_data);
         }
+        snd->sample_pos = 0;
     }
 }
 
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* namco_perf_counters(namco_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t namco_display_info(namco_t* sys) {
     const chips_display_info_t res = {
         .frame = {
@@ -1006,7 +1147,12 @@ uint32_t namco_save_snapshot(namco_t* sys, namco_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->sound.callback);
+    chips_audio_tracks_callback_snapshot_onsave(&dst->sound.tracks_callback);
     mem_snapshot_onsave(&dst->mem, sys);
     return NAMCO_SNAPSHOT_VERSION;
 }
@@ -1019,10 +1165,62 @@ bool namco_load_snapshot(namco_t* sys, uint32_t version, namco_t* src) {
     static namco_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.sound.callback, &sys->sound.callback);
+    chips_audio_tracks_callback_snapshot_onload(&im.sound.tracks_callback, &sys->sound.tracks_callback);
     mem_snapshot_onload(&im.mem, sys);
     *sys = im;
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by namco_init())
+#define _NAMCO_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t namco_state_hash(namco_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping callbacks, the exec clock (which only
+    // tracks fractions of namco_exec() calls) and the fixed memory mapping
+    uint64_t h = _NAMCO_HASH(0, sys->cpu);
+    h = _NAMCO_HASH(h, sys->in0);
+    h = _NAMCO_HASH(h, sys->in1);
+    h = _NAMCO_HASH(h, sys->dsw1);
+    h = _NAMCO_HASH(h, sys->dsw2);
+    h = _NAMCO_HASH(h, sys->pins);
+    h = _NAMCO_HASH(h, sys->vsync_count);
+    h = _NAMCO_HASH(h, sys->int_vector);
+    h = _NAMCO_HASH(h, sys->int_enable);
+    h = _NAMCO_HASH(h, sys->sound_enable);
+    h = _NAMCO_HASH(h, sys->flip_screen);
+    h = _NAMCO_HASH(h, sys->pal_select);
+    h = _NAMCO_HASH(h, sys->clut_select);
+    h = _NAMCO_HASH(h, sys->tile_select);
+    h = _NAMCO_HASH(h, sys->sprite_coords);
+    const namco_sound_t* snd = &sys->sound;
+    h = _NAMCO_HASH(h, snd->tick_counter);
+    h = _NAMCO_HASH(h, snd->sample_period);
+    h = _NAMCO_HASH(h, snd->sample_counter);
+    h = _NAMCO_HASH(h, snd->sync_counter);
+    h = _NAMCO_HASH(h, snd->volume);
+    h = _NAMCO_HASH(h, snd->voice);
+    h = _NAMCO_HASH(h, snd->rom);
+    h = _NAMCO_HASH(h, snd->sample_pos);
+    h = chips_hash(snd->sample_buffer, (size_t)snd->sample_pos * sizeof(chips_audio_sample_t), h);
+    h = _NAMCO_HASH(h, sys->video_ram);
+    h = _NAMCO_HASH(h, sys->color_ram);
+    h = _NAMCO_HASH(h, sys->main_ram);
+    h = _NAMCO_HASH(h, sys->rom_cpu);
+    h = _NAMCO_HASH(h, sys->rom_gfx);
+    h = _NAMCO_HASH(h, sys->rom_prom);
+    h = _NAMCO_HASH(h, sys->hw_colors);
+    return _NAMCO_HASH(h, sys->palette_cache);
+}
+
+uint64_t namco_frame_hash(namco_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 #endif // CHIPS_IMPL
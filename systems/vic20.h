@@ -65,7 +65,17 @@ extern "C" {
 #endif
 
 // bump snapshot version when vic20_t memory layout changes
-#define VIC20_SNAPSHOT_VERSION (1)
+#define VIC20_SNAPSHOT_VERSION (5)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    VIC20_PERF_CPU,   // 6502 CPU ticks
+    VIC20_PERF_VIC,   // VIC video and audio ticks
+    VIC20_PERF_VIA1,  // VIA-1 ticks
+    VIC20_PERF_VIA2,  // VIA-2 ticks
+    VIC20_PERF_C1530, // datasette ticks
+    VIC20_PERF_NUM,
+};
 
 #define VIC20_FREQUENCY (1108404)
 #define VIC20_MAX_AUDIO_SAMPLES (1024)        // max number of audio samples in internal sample buffer
@@ -113,6 +123,7 @@ typedef struct {
     vic20_joystick_type_t joystick_type;    // default is VIC20_JOYSTICK_NONE
     vic20_memory_config_t mem_config;       // default is VIC20_MEMCONFIG_STANDARD
     chips_debug_t debug;            // optional debugging hook
+    chips_input_callback_t input;   // optional input recording callback (see util/movie.h)
     chips_audio_desc_t audio;
     struct {
         chips_range_t chars;    // 4 KByte character ROM dump
@@ -142,13 +153,18 @@ typedef struct {
     mem_t mem_cpu;              // CPU-visible memory mapping
     mem_t mem_vic;              // VIC-visible memory mapping
     bool valid;
+    clk_t clk;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
 
     struct {
         chips_audio_callback_t callback;
         int num_samples;
         int sample_pos;
-        float sample_buffer[VIC20_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t sample_buffer[VIC20_MAX_AUDIO_SAMPLES];
     } audio;
 
     uint8_t color_ram[0x0400];      // special color RAM
@@ -176,6 +192,14 @@ void vic20_reset(vic20_t* sys);
 chips_display_info_t vic20_display_info(vic20_t* sys);
 // tick VIC-20 instance for a given number of microseconds, return number of executed ticks
 uint32_t vic20_exec(vic20_t* sys, uint32_t micro_seconds);
+// run VIC-20 instance for an exact number of ticks, return number of ticks executed
+uint32_t vic20_exec_ticks(vic20_t* sys, uint32_t num_ticks);
+// run VIC-20 instance until a number of audio samples has been generated, return number of ticks executed
+uint32_t vic20_exec_samples(vic20_t* sys, int num_samples);
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* vic20_perf_counters(vic20_t* sys);
+#endif
 // send a key-down event to the VIC-20
 void vic20_key_down(vic20_t* sys, int key_code);
 // send a key-up event to the VIC-20
@@ -186,14 +210,16 @@ void vic20_set_joystick_type(vic20_t* sys, vic20_joystick_type_t type);
 vic20_joystick_type_t vic20_joystick_type(vic20_t* sys);
 // set joystick mask (combination of VIC20_JOYSTICK_*)
 void vic20_joystick(vic20_t* sys, uint8_t joy_mask);
+// replay a recorded input event (see util/movie.h)
+void vic20_input_event(vic20_t* sys, const chips_input_event_t* event);
 // quickload a .prg/.bin file
 bool vic20_quickload(vic20_t* sys, chips_range_t data);
 // load a .prg/.bin file as ROM cartridge
 bool vic20_insert_rom_cartridge(vic20_t* sys, chips_range_t data);
 // remove current ROM cartridge
 void vic20_remove_rom_cartridge(vic20_t* sys);
-// insert tape as .TAP file (c1530 must be enabled)
-bool vic20_insert_tape(vic20_t* sys, chips_range_t data);
+// insert tape as .TAP file from an external memory range or read callback (c1530 must be enabled, data is not copied)
+bool vic20_insert_tape_source(vic20_t* sys, const chips_tape_source_t* source);
 // remove tape file
 void vic20_remove_tape(vic20_t* sys);
 // return true if a tape is currently inserted
@@ -208,6 +234,10 @@ bool vic20_is_tape_motor_on(vic20_t* sys);
 uint32_t vic20_save_snapshot(vic20_t* sys, vic20_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
 bool vic20_load_snapshot(vic20_t* sys, uint32_t version, vic20_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks)
+uint64_t vic20_state_hash(vic20_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t vic20_frame_hash(vic20_t* sys);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -237,11 +267,17 @@ void vic20_init(vic20_t* sys, const vic20_desc_t* desc) {
 
     memset(sys, 0, sizeof(vic20_t));
     sys->valid = true;
+    clk_init(&sys->clk, VIC20_FREQUENCY);
     sys->joystick_type = desc->joystick_type;
     sys->mem_config = desc->mem_config;
     sys->via1_joy_mask = M6522_PA2|M6522_PA3|M6522_PA4|M6522_PA5;
     sys->via2_joy_mask = M6522_PB7;
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[VIC20_PERF_NUM] = { "m6502", "m6561", "m6522-1", "m6522-2", "c1530" };
+    chips_perf_init(&sys->perf, VIC20_PERF_NUM, perf_names);
+#endif
     sys->audio.callback = desc->audio.callback;
     sys->audio.num_samples = _VIC20_DEFAULT(desc->audio.num_samples, VIC20_DEFAULT_AUDIO_SAMPLES);
     CHIPS_ASSERT(sys->audio.num_samples <= VIC20_MAX_AUDIO_SAMPLES);
@@ -388,7 +424,9 @@ void vic20_reset(vic20_t* sys) {
 static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
 
     // tick the CPU
+    CHIPS_PERF_BEGIN(&sys->perf, VIC20_PERF_CPU);
     pins = m6502_tick(&sys->cpu, pins);
+    CHIPS_PERF_END(&sys->perf, VIC20_PERF_CPU);
 
     // the IRQ and NMI pins will be set by the VIAs each tick
     pins &= ~(M6502_IRQ|M6502_NMI);
@@ -464,7 +502,9 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
         if (sys->cas_port & VIC20_CASPORT_SENSE) {
             via1_pins |= M6522_PA6;
         }
+        CHIPS_PERF_BEGIN(&sys->perf, VIC20_PERF_VIA1);
         via1_pins = m6522_tick(&sys->via_1, via1_pins);
+        CHIPS_PERF_END(&sys->perf, VIC20_PERF_VIA1);
         if (via1_pins & M6522_CA2) {
             sys->cas_port |= VIC20_CASPORT_MOTOR;
         }
@@ -505,7 +545,9 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
         if (sys->cas_port & VIC20_CASPORT_READ) {
             via2_pins |= M6522_CA1;
         }
+        CHIPS_PERF_BEGIN(&sys->perf, VIC20_PERF_VIA2);
         via2_pins = m6522_tick(&sys->via_2, via2_pins);
+        CHIPS_PERF_END(&sys->perf, VIC20_PERF_VIA2);
         uint8_t kbd_cols = ~M6522_GET_PB(via2_pins);
         kbd_set_active_columns(&sys->kbd, kbd_cols);
         if (via2_pins & M6522_IRQ) {
@@ -518,7 +560,9 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
 
     // tick the VIC
     {
+        CHIPS_PERF_BEGIN(&sys->perf, VIC20_PERF_VIC);
         vic_pins = m6561_tick(&sys->vic, vic_pins);
+        CHIPS_PERF_END(&sys->perf, VIC20_PERF_VIC);
         if ((vic_pins & (M6561_CS|M6561_RW)) == (M6561_CS|M6561_RW)) {
             pins = M6502_COPY_DATA(pins, vic_pins);
         }
@@ -535,33 +579,75 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
 
     // optionally tick the C1530 datassette
     if (sys->c1530.valid) {
+        CHIPS_PERF_BEGIN(&sys->perf, VIC20_PERF_C1530);
         c1530_tick(&sys->c1530);
+        CHIPS_PERF_END(&sys->perf, VIC20_PERF_C1530);
     }
     return pins;
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _vic20_debug_event(vic20_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && (0 != (pins & M6502_SYNC))) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && (0 == (pins & M6502_RW))) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (M6502_IRQ|M6502_NMI))));
+}
+
 uint32_t vic20_exec(vic20_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    uint32_t num_ticks = clk_us_to_ticks(VIC20_FREQUENCY, micro_seconds);
+    return vic20_exec_ticks(sys, clk_advance_us(&sys->clk, micro_seconds));
+}
+
+// run for max_ticks, or until num_samples audio samples have been generated (-1 for no limit), return executed ticks
+static uint32_t _vic20_exec(vic20_t* sys, uint32_t max_ticks, int num_samples) {
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->audio.sample_pos;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug callback
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
+        while ((num_ticks < max_ticks) && (num_samples != 0)) {
             pins = _vic20_tick(sys, pins);
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     else {
-        // run with debug callback
-        for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
+        // run with debug hook in each tick, or only on requested events
+        while ((num_ticks < max_ticks) && (num_samples != 0) && !(*sys->debug.stopped)) {
             pins = _vic20_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_vic20_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     sys->pins = pins;
+    const uint32_t micro_seconds = clk_ticks_to_us(VIC20_FREQUENCY, num_ticks);
     kbd_update(&sys->kbd, micro_seconds);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, 0);
     return num_ticks;
 }
 
+uint32_t vic20_exec_ticks(vic20_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return _vic20_exec(sys, num_ticks, -1);
+}
+
+uint32_t vic20_exec_samples(vic20_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->audio.num_samples > 1));
+    // the fractional tick remainder is carried across calls in the sound chip's sample counter
+    return _vic20_exec(sys, UINT32_MAX, (num_samples > 0) ? num_samples : 0);
+}
+
 static uint16_t _vic20_vic_fetch(uint16_t addr, void* user_data) {
     vic20_t* sys = (vic20_t*) user_data;
     uint16_t data = (sys->color_ram[addr & 0x03FF]<<8) | mem_rd(&sys->mem_vic, addr);
@@ -707,6 +793,7 @@ static void _vic20_update_joymasks(vic20_t* sys) {
 
 void vic20_key_down(vic20_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_DOWN, (uint32_t)key_code, 0);
     if (sys->joystick_type == VIC20_JOYSTICKTYPE_NONE) {
         kbd_key_down(&sys->kbd, key_code);
     }
@@ -731,6 +818,7 @@ void vic20_key_down(vic20_t* sys, int key_code) {
 
 void vic20_key_up(vic20_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_UP, (uint32_t)key_code, 0);
     if (sys->joystick_type == VIC20_JOYSTICKTYPE_NONE) {
         kbd_key_up(&sys->kbd, key_code);
     }
@@ -755,6 +843,7 @@ void vic20_key_up(vic20_t* sys, int key_code) {
 
 void vic20_set_joystick_type(vic20_t* sys, vic20_joystick_type_t type) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK_TYPE, (uint32_t)type, 0);
     sys->joystick_type = type;
 }
 
@@ -765,13 +854,26 @@ vic20_joystick_type_t vic20_joystick_type(vic20_t* sys) {
 
 void vic20_joystick(vic20_t* sys, uint8_t joy_mask) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK, joy_mask, 0);
     sys->joy_joy_mask = joy_mask;
     _vic20_update_joymasks(sys);
 }
 
-bool vic20_insert_tape(vic20_t* sys, chips_range_t data) {
+void vic20_input_event(vic20_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: vic20_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_KEY_DOWN: vic20_key_down(sys, (int)event->a); break;
+        case CHIPS_INPUT_KEY_UP: vic20_key_up(sys, (int)event->a); break;
+        case CHIPS_INPUT_JOYSTICK: vic20_joystick(sys, (uint8_t)event->a); break;
+        case CHIPS_INPUT_JOYSTICK_TYPE: vic20_set_joystick_type(sys, (vic20_joystick_type_t)event->a); break;
+        default: break;
+    }
+}
+
+bool vic20_insert_tape_source(vic20_t* sys, const chips_tape_source_t* source) {
     CHIPS_ASSERT(sys && sys->valid && sys->c1530.valid);
-    return c1530_insert_tape(&sys->c1530, data);
+    return c1530_insert_tape_source(&sys->c1530, source);
 }
 
 void vic20_remove_tape(vic20_t* sys) {
@@ -799,6 +901,13 @@ bool vic20_is_tape_motor_on(vic20_t* sys) {
     return c1530_is_motor_on(&sys->c1530);
 }
 
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* vic20_perf_counters(vic20_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t vic20_display_info(vic20_t* sys) {
     chips_display_info_t res = {
         .frame = {
@@ -833,6 +942,10 @@ uint32_t vic20_save_snapshot(vic20_t* sys, vic20_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     m6502_snapshot_onsave(&dst->cpu);
     m6561_snapshot_onsave(&dst->vic);
@@ -851,6 +964,10 @@ bool vic20_load_snapshot(vic20_t* sys, uint32_t version, vic20_t* src) {
     static vic20_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     m6502_snapshot_onload(&im.cpu, &sys->cpu);
     m6561_snapshot_onload(&im.vic, &sys->vic);
@@ -862,4 +979,59 @@ bool vic20_load_snapshot(vic20_t* sys, uint32_t version, vic20_t* src) {
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by vic20_init())
+#define _VIC20_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t vic20_state_hash(vic20_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping host pointers, callbacks, the exec clock (which
+    // only tracks fractions of vic20_exec() calls) and the fixed VIC and cartridge memory mappings
+    m6502_t cpu;
+    memcpy(&cpu, &sys->cpu, sizeof(cpu));
+    m6502_snapshot_onsave(&cpu);
+    uint64_t h = _VIC20_HASH(0, cpu);
+    h = _VIC20_HASH(h, sys->via_1);
+    h = _VIC20_HASH(h, sys->via_2);
+    m6561_t vic;
+    memcpy(&vic, &sys->vic, sizeof(vic));
+    m6561_snapshot_onsave(&vic);
+    h = _VIC20_HASH(h, vic);
+    h = _VIC20_HASH(h, sys->pins);
+    h = _VIC20_HASH(h, sys->joystick_type);
+    h = _VIC20_HASH(h, sys->mem_config);
+    h = _VIC20_HASH(h, sys->cas_port);
+    h = _VIC20_HASH(h, sys->iec_port);
+    h = _VIC20_HASH(h, sys->kbd_joy_mask);
+    h = _VIC20_HASH(h, sys->joy_joy_mask);
+    h = _VIC20_HASH(h, sys->via1_joy_mask);
+    h = _VIC20_HASH(h, sys->via2_joy_mask);
+    h = _VIC20_HASH(h, sys->kbd);
+    // the CPU memory mapping changes when a ROM cartridge is inserted or removed
+    mem_t mem_cpu;
+    memcpy(&mem_cpu, &sys->mem_cpu, sizeof(mem_cpu));
+    mem_snapshot_onsave(&mem_cpu, sys);
+    h = _VIC20_HASH(h, mem_cpu);
+    h = _VIC20_HASH(h, sys->audio.sample_pos);
+    h = chips_hash(sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(chips_audio_sample_t), h);
+    h = _VIC20_HASH(h, sys->color_ram);
+    h = _VIC20_HASH(h, sys->ram0);
+    h = _VIC20_HASH(h, sys->ram_3k);
+    h = _VIC20_HASH(h, sys->ram1);
+    h = _VIC20_HASH(h, sys->rom_char);
+    h = _VIC20_HASH(h, sys->rom_basic);
+    h = _VIC20_HASH(h, sys->rom_kernal);
+    h = _VIC20_HASH(h, sys->ram_exp);
+    if (sys->c1530.valid) {
+        h = _VIC20_HASH(h, sys->c1530.size);
+        h = _VIC20_HASH(h, sys->c1530.pos);
+        h = _VIC20_HASH(h, sys->c1530.pulse_count);
+    }
+    return h;
+}
+
+uint64_t vic20_frame_hash(vic20_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 #endif // CHIPS_IMPL
@@ -73,7 +73,15 @@ extern "C" {
 #endif
 
 // bump this whenever the z1013_t struct layout changes
-#define Z1013_SNAPSHOT_VERSION (0x0001)
+#define Z1013_SNAPSHOT_VERSION (0x0004)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    Z1013_PERF_CPU,   // Z80 CPU ticks
+    Z1013_PERF_PIO,   // PIO ticks
+    Z1013_PERF_VIDEO, // per-frame video memory decoding
+    Z1013_PERF_NUM,
+};
 
 #define Z1013_FRAMEBUFFER_WIDTH (256)
 #define Z1013_FRAMEBUFFER_HEIGHT (256)
@@ -92,6 +100,7 @@ typedef enum {
 typedef struct {
     z1013_type_t type;          // default is Z1013_TYPE_64
     chips_debug_t debug;        // optional debug callback and userdata ptr
+    chips_input_callback_t input;// optional input recording callback (see util/movie.h)
 
     // ROM images
     struct {
@@ -107,9 +116,14 @@ typedef struct {
     mem_t mem;
     z80pio_t pio;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
     uint64_t pins;
     z1013_type_t type;
     bool valid;
+    clk_t clk;
     uint16_t kbd_request_line_mask;
     int kbd_request_line_hilo_shift;
     kbd_t kbd;
@@ -130,16 +144,28 @@ void z1013_reset(z1013_t* sys);
 chips_display_info_t z1013_display_info(z1013_t* sys);
 // run the Z1013 instance for a given number of microseconds, returns number of executed ticks
 uint32_t z1013_exec(z1013_t* sys, uint32_t micro_seconds);
+// run Z1013 instance for an exact number of ticks, return number of ticks executed
+uint32_t z1013_exec_ticks(z1013_t* sys, uint32_t num_ticks);
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* z1013_perf_counters(z1013_t* sys);
+#endif
 // send a key-down event
 void z1013_key_down(z1013_t* sys, int key_code);
 // send a key-up event
 void z1013_key_up(z1013_t* sys, int key_code);
+// replay a recorded input event (see util/movie.h)
+void z1013_input_event(z1013_t* sys, const chips_input_event_t* event);
 // load a "KC .z80" file into the emulator
 bool z1013_quickload(z1013_t* sys, chips_range_t data);
 // take snapshot, patches any pointers to zero, returns a snapshot version
 uint32_t z1013_save_snapshot(z1013_t* sys, z1013_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
 bool z1013_load_snapshot(z1013_t* sys, uint32_t version, const z1013_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks)
+uint64_t z1013_state_hash(z1013_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t z1013_frame_hash(z1013_t* sys);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -196,7 +222,13 @@ void z1013_init(z1013_t* sys, const z1013_desc_t* desc) {
     sys->type = desc->type;
     sys->valid = true;
     sys->freq_hz = (Z1013_TYPE_01 == desc->type) ? 1000000 : 2000000;
+    clk_init(&sys->clk, sys->freq_hz);
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[Z1013_PERF_NUM] = { "z80", "z80pio", "video" };
+    chips_perf_init(&sys->perf, Z1013_PERF_NUM, perf_names);
+#endif
 
     // copy ROM dumps
     CHIPS_ASSERT(desc->roms.font.ptr && (desc->roms.font.size == sizeof(sys->rom_font)));
@@ -321,7 +353,9 @@ void z1013_reset(z1013_t* sys) {
 }
 
 static uint64_t _z1013_tick(z1013_t* sys, uint64_t pins) {
+    CHIPS_PERF_BEGIN(&sys->perf, Z1013_PERF_CPU);
     pins = z80_tick(&sys->cpu, pins) & Z80_PIN_MASK;
+    CHIPS_PERF_END(&sys->perf, Z1013_PERF_CPU);
 
     // handle memory requests
     if (pins & Z80_MREQ) {
@@ -343,7 +377,9 @@ static uint64_t _z1013_tick(z1013_t* sys, uint64_t pins) {
         if (pins & Z80_A1) { pins |= Z80PIO_BASEL; }
         uint8_t pb = sys->kbd_request_line_mask >> sys->kbd_request_line_hilo_shift;
         Z80PIO_SET_PAB(pins, 0xFF, pb);
+        CHIPS_PERF_BEGIN(&sys->perf, Z1013_PERF_PIO);
         pins = z80pio_tick(&sys->pio, pins);
+        CHIPS_PERF_END(&sys->perf, Z1013_PERF_PIO);
         // bit 4 for 8x8 keyboard selects upper or lower 4 kbd matrix line bits
         if (Z1013_TYPE_01 != sys->type) {
             // kbd_request_line_hilo_shift will be 0 or 4
@@ -388,39 +424,74 @@ static void _z1013_decode_vidmem(z1013_t* sys) {
     }
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _z1013_debug_event(z1013_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && z80_opdone(&sys->cpu)) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR))) ||
+           ((events & CHIPS_DEBUG_EVENT_IO) && ((pins & (Z80_IORQ|Z80_M1)) == Z80_IORQ)) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (Z80_INT|Z80_NMI))));
+}
+
 uint32_t z1013_exec(z1013_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    const uint32_t num_ticks = clk_us_to_ticks(sys->freq_hz, micro_seconds);
+    return z1013_exec_ticks(sys, clk_advance_us(&sys->clk, micro_seconds));
+}
+
+uint32_t z1013_exec_ticks(z1013_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
     uint64_t pins = sys->pins;
+    uint32_t ticks = 0;
     if (0 == sys->debug.callback.func) {
         // run without debug hook
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
+        for (; ticks < num_ticks; ticks++) {
             pins = _z1013_tick(sys, pins);
         }
     }
     else {
-        // run with debug hook
-        for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
+        // run with debug hook in each tick, or only on requested events
+        for (; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
             pins = _z1013_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_z1013_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
         }
     }
     sys->pins = pins;
+    // the debugger may have stopped before num_ticks have been executed
+    num_ticks = ticks;
+    const uint32_t micro_seconds = clk_ticks_to_us(sys->freq_hz, num_ticks);
     kbd_update(&sys->kbd, micro_seconds);
+    CHIPS_PERF_BEGIN(&sys->perf, Z1013_PERF_VIDEO);
     _z1013_decode_vidmem(sys);
+    CHIPS_PERF_END(&sys->perf, Z1013_PERF_VIDEO);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, 0);
     return num_ticks;
 }
 
 void z1013_key_down(z1013_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_DOWN, (uint32_t)key_code, 0);
     kbd_key_down(&sys->kbd, key_code);
 }
 
 void z1013_key_up(z1013_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_UP, (uint32_t)key_code, 0);
     kbd_key_up(&sys->kbd, key_code);
 }
 
+void z1013_input_event(z1013_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: z1013_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_KEY_DOWN: z1013_key_down(sys, (int)event->a); break;
+        case CHIPS_INPUT_KEY_UP: z1013_key_up(sys, (int)event->a); break;
+        default: break;
+    }
+}
+
 typedef struct {
     uint8_t load_addr_l;
     uint8_t load_addr_h;
@@ -465,6 +536,13 @@ bool z1013_quickload(z1013_t* sys, chips_range_t data) {
     return true;
 }
 
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* z1013_perf_counters(z1013_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t z1013_display_info(z1013_t* sys) {
     static const uint32_t palette[2] = {
         0xFF000000, // black
@@ -501,6 +579,10 @@ uint32_t z1013_save_snapshot(z1013_t* sys, z1013_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     mem_snapshot_onsave(&dst->mem, sys);
     return Z1013_SNAPSHOT_VERSION;
 }
@@ -514,9 +596,37 @@ bool z1013_load_snapshot(z1013_t* sys, uint32_t version, const z1013_t* src) {
     static z1013_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     mem_snapshot_onload(&im.mem, sys);
     *sys = im;
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by z1013_init())
+#define _Z1013_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t z1013_state_hash(z1013_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping callbacks, the exec clock (which only
+    // tracks fractions of z1013_exec() calls) and the fixed memory mapping
+    uint64_t h = _Z1013_HASH(0, sys->cpu);
+    h = _Z1013_HASH(h, sys->pio);
+    h = _Z1013_HASH(h, sys->pins);
+    h = _Z1013_HASH(h, sys->type);
+    h = _Z1013_HASH(h, sys->kbd_request_line_mask);
+    h = _Z1013_HASH(h, sys->kbd_request_line_hilo_shift);
+    h = _Z1013_HASH(h, sys->kbd);
+    h = _Z1013_HASH(h, sys->ram);
+    h = _Z1013_HASH(h, sys->rom_os);
+    return _Z1013_HASH(h, sys->rom_font);
+}
+
+uint64_t z1013_frame_hash(z1013_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 #endif // CHIPS_IMPL
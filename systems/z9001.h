@@ -88,7 +88,18 @@ extern "C" {
 #endif
 
 // bump this whenever the z9001_t struct layout changes
-#define Z9001_SNAPSHOT_VERSION (0x0001)
+#define Z9001_SNAPSHOT_VERSION (0x0005)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    Z9001_PERF_CPU,    // Z80 CPU ticks
+    Z9001_PERF_PIO1,   // PIO-1 ticks
+    Z9001_PERF_PIO2,   // PIO-2 ticks
+    Z9001_PERF_CTC,    // CTC ticks
+    Z9001_PERF_BEEPER, // beeper ticks and audio output
+    Z9001_PERF_VIDEO,  // per-frame video memory decoding
+    Z9001_PERF_NUM,
+};
 
 #define Z9001_MAX_AUDIO_SAMPLES (1024)      // max number of audio samples in internal sample buffer
 #define Z9001_DEFAULT_AUDIO_SAMPLES (128)   // default number of samples in internal sample buffer
@@ -108,6 +119,7 @@ typedef enum {
 typedef struct {
     z9001_type_t type;                  // default is Z9001_TYPE_Z9001
     chips_debug_t debug;                // optional debug hook
+    chips_input_callback_t input;       // optional input recording callback (see util/movie.h)
     chips_audio_desc_t audio;
     struct {
         // Z9001 ROM images
@@ -144,14 +156,19 @@ typedef struct {
     kbd_t kbd;
 
     bool valid;
+    clk_t clk;
     bool z9001_has_basic_rom;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
 
     struct {
         chips_audio_callback_t callback;
         int num_samples;
         int sample_pos;
-        float sample_buffer[Z9001_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t sample_buffer[Z9001_MAX_AUDIO_SAMPLES];
     } audio;
     uint8_t ram[1<<16];
     uint8_t rom[0x4000];
@@ -169,16 +186,30 @@ void z9001_reset(z9001_t* sys);
 chips_display_info_t z9001_display_info(z9001_t* sys);
 // run Z9001 instance for a given number of microseconds, return number of executed ticks
 uint32_t z9001_exec(z9001_t* sys, uint32_t micro_seconds);
+// run Z9001 instance for an exact number of ticks, return number of ticks executed
+uint32_t z9001_exec_ticks(z9001_t* sys, uint32_t num_ticks);
+// run Z9001 instance until a number of audio samples has been generated, return number of ticks executed
+uint32_t z9001_exec_samples(z9001_t* sys, int num_samples);
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* z9001_perf_counters(z9001_t* sys);
+#endif
 // send a key-down event
 void z9001_key_down(z9001_t* sys, int key_code);
 // send a key-up event
 void z9001_key_up(z9001_t* sys, int key_code);
+// replay a recorded input event (see util/movie.h)
+void z9001_input_event(z9001_t* sys, const chips_input_event_t* event);
 // load a KC TAP or KCC file into the emulator
 bool z9001_quickload(z9001_t* sys, chips_range_t data);
 // save a snapshot, patches any pointers to zero, returns a snapshot version
 uint32_t z9001_save_snapshot(z9001_t* sys, z9001_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
 bool z9001_load_snapshot(z9001_t* sys, uint32_t version, const z9001_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks)
+uint64_t z9001_state_hash(z9001_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t z9001_frame_hash(z9001_t* sys);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -222,8 +253,14 @@ void z9001_init(z9001_t* sys, const z9001_desc_t* desc) {
 
     memset(sys, 0, sizeof(z9001_t));
     sys->valid = true;
+    clk_init(&sys->clk, _Z9001_FREQUENCY);
     sys->type = desc->type;
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[Z9001_PERF_NUM] = { "z80", "z80pio-1", "z80pio-2", "z80ctc", "beeper", "video" };
+    chips_perf_init(&sys->perf, Z9001_PERF_NUM, perf_names);
+#endif
     if (desc->type == Z9001_TYPE_Z9001) {
         CHIPS_ASSERT(desc->roms.z9001.font.ptr && (desc->roms.z9001.font.size == sizeof(sys->rom_font)));
         memcpy(sys->rom_font, desc->roms.z9001.font.ptr, sizeof(sys->rom_font));
@@ -374,7 +411,9 @@ void z9001_reset(z9001_t* sys) {
 }
 
 static uint64_t _z9001_tick(z9001_t* sys, uint64_t pins) {
+    CHIPS_PERF_BEGIN(&sys->perf, Z9001_PERF_CPU);
     pins = z80_tick(&sys->cpu, pins);
+    CHIPS_PERF_END(&sys->perf, Z9001_PERF_CPU);
 
     // handle memory requests
     if (pins & Z80_MREQ) {
@@ -397,7 +436,9 @@ static uint64_t _z9001_tick(z9001_t* sys, uint64_t pins) {
         if (pins & Z80_A0) { pins |= Z80PIO_BASEL; }
         if (pins & Z80_A1) { pins |= Z80PIO_CDSEL; }
         // no port A/B inputs
+        CHIPS_PERF_BEGIN(&sys->perf, Z9001_PERF_PIO1);
         pins = z80pio_tick(&sys->pio1, pins);
+        CHIPS_PERF_END(&sys->perf, Z9001_PERF_PIO1);
         /*
             FIXME:
             PIO1-A bits:
@@ -425,7 +466,9 @@ static uint64_t _z9001_tick(z9001_t* sys, uint64_t pins) {
         const uint8_t pa_in = ~kbd_scan_columns(&sys->kbd);
         const uint8_t pb_in = ~kbd_scan_lines(&sys->kbd);
         Z80PIO_SET_PAB(pins, pa_in, pb_in);
+        CHIPS_PERF_BEGIN(&sys->perf, Z9001_PERF_PIO2);
         pins = z80pio_tick(&sys->pio2, pins);
+        CHIPS_PERF_END(&sys->perf, Z9001_PERF_PIO2);
         const uint8_t pa_out = ~Z80PIO_GET_PA(pins);
         const uint8_t pb_out = ~Z80PIO_GET_PB(pins);
         kbd_set_active_columns(&sys->kbd, pa_out);
@@ -448,7 +491,9 @@ static uint64_t _z9001_tick(z9001_t* sys, uint64_t pins) {
         if (pins & Z80_A0) { pins |= Z80CTC_CS0; };
         if (pins & Z80_A1) { pins |= Z80CTC_CS1; };
         if (pins & Z80CTC_ZCTO2) { pins |= Z80CTC_CLKTRG3; }
+        CHIPS_PERF_BEGIN(&sys->perf, Z9001_PERF_CTC);
         pins = z80ctc_tick(&sys->ctc, pins);
+        CHIPS_PERF_END(&sys->perf, Z9001_PERF_CTC);
         if (pins & Z80CTC_ZCTO0) {
             // CTC channel 0 controls the beeper frequency
             beeper_toggle(&sys->beeper);
@@ -458,6 +503,7 @@ static uint64_t _z9001_tick(z9001_t* sys, uint64_t pins) {
     }
 
     // tick the beeper
+    CHIPS_PERF_BEGIN(&sys->perf, Z9001_PERF_BEEPER);
     if (beeper_tick(&sys->beeper)) {
         // new audio sample ready
         sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->beeper.sample;
@@ -468,6 +514,7 @@ static uint64_t _z9001_tick(z9001_t* sys, uint64_t pins) {
             sys->audio.sample_pos = 0;
         }
     }
+    CHIPS_PERF_END(&sys->perf, Z9001_PERF_BEEPER);
 
     /* the blink flip flop is controlled by a 'bisync' video signal
         (I guess that means it triggers at half PAL frequency: 25Hz),
@@ -540,31 +587,75 @@ static void _z9001_decode_vidmem(z9001_t* sys) {
     }
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _z9001_debug_event(z9001_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && z80_opdone(&sys->cpu)) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR))) ||
+           ((events & CHIPS_DEBUG_EVENT_IO) && ((pins & (Z80_IORQ|Z80_M1)) == Z80_IORQ)) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (Z80_INT|Z80_NMI))));
+}
+
 uint32_t z9001_exec(z9001_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    const uint32_t num_ticks = clk_us_to_ticks(_Z9001_FREQUENCY, micro_seconds);
+    return z9001_exec_ticks(sys, clk_advance_us(&sys->clk, micro_seconds));
+}
+
+// run for max_ticks, or until num_samples audio samples have been generated (-1 for no limit), return executed ticks
+static uint32_t _z9001_exec(z9001_t* sys, uint32_t max_ticks, int num_samples) {
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->audio.sample_pos;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug hook
-        for (uint32_t tick = 0; tick < num_ticks; tick++) {
+        while ((num_ticks < max_ticks) && (num_samples != 0)) {
             pins = _z9001_tick(sys, pins);
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     else {
-        // run with debug hook
-        for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->debug.stopped); tick++) {
+        // run with debug hook in each tick, or only on requested events
+        while ((num_ticks < max_ticks) && (num_samples != 0) && !(*sys->debug.stopped)) {
             pins = _z9001_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_z9001_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     sys->pins = pins;
+    const uint32_t micro_seconds = clk_ticks_to_us(_Z9001_FREQUENCY, num_ticks);
     kbd_update(&sys->kbd, micro_seconds);
+    CHIPS_PERF_BEGIN(&sys->perf, Z9001_PERF_VIDEO);
     _z9001_decode_vidmem(sys);
+    CHIPS_PERF_END(&sys->perf, Z9001_PERF_VIDEO);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, 0);
     return num_ticks;
 }
 
+uint32_t z9001_exec_ticks(z9001_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return _z9001_exec(sys, num_ticks, -1);
+}
+
+uint32_t z9001_exec_samples(z9001_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->audio.num_samples > 1));
+    // the fractional tick remainder is carried across calls in the sound chip's sample counter
+    return _z9001_exec(sys, UINT32_MAX, (num_samples > 0) ? num_samples : 0);
+}
+
 void z9001_key_down(z9001_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_DOWN, (uint32_t)key_code, 0);
     kbd_key_down(&sys->kbd, key_code);
     /* FIXME FIXME FIXME keyboard matrix lines are directly connected to the PIO2's Port B */
     //z80pio_write_port(&sys->pio2, Z80PIO_PORT_B, ~kbd_scan_lines(&sys->kbd));
@@ -572,11 +663,22 @@ void z9001_key_down(z9001_t* sys, int key_code) {
 
 void z9001_key_up(z9001_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_UP, (uint32_t)key_code, 0);
     kbd_key_up(&sys->kbd, key_code);
     /* FIXME FIXME FIXME keyboard matrix lines are directly connected to the PIO2's Port B */
     //z80pio_write_port(&sys->pio2, Z80PIO_PORT_B, ~kbd_scan_lines(&sys->kbd));
 }
 
+void z9001_input_event(z9001_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: z9001_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_KEY_DOWN: z9001_key_down(sys, (int)event->a); break;
+        case CHIPS_INPUT_KEY_UP: z9001_key_up(sys, (int)event->a); break;
+        default: break;
+    }
+}
+
 // common start function for file loading routines
 static void _z9001_load_start(z9001_t* sys, uint16_t exec_addr) {
     sys->cpu.a = 0x00; sys->cpu.f = 0x10;
@@ -721,6 +823,13 @@ bool z9001_quickload(z9001_t* sys, chips_range_t data) {
     }
 }
 
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* z9001_perf_counters(z9001_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t z9001_display_info(z9001_t* sys) {
     static const uint32_t palette[8] = {
         0xFF000000,     // black
@@ -763,6 +872,10 @@ uint32_t z9001_save_snapshot(z9001_t* sys, z9001_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     mem_snapshot_onsave(&dst->mem, sys);
     return Z9001_SNAPSHOT_VERSION;
@@ -776,10 +889,45 @@ bool z9001_load_snapshot(z9001_t* sys, uint32_t version, const z9001_t* src) {
     static z9001_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     mem_snapshot_onload(&im.mem, sys);
     *sys = im;
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by z9001_init())
+#define _Z9001_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t z9001_state_hash(z9001_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping callbacks, the exec clock (which only
+    // tracks fractions of z9001_exec() calls) and the fixed memory mapping
+    uint64_t h = _Z9001_HASH(0, sys->cpu);
+    h = _Z9001_HASH(h, sys->pio1);
+    h = _Z9001_HASH(h, sys->pio2);
+    h = _Z9001_HASH(h, sys->ctc);
+    h = _Z9001_HASH(h, sys->beeper);
+    h = _Z9001_HASH(h, sys->blink_flip_flop);
+    h = _Z9001_HASH(h, sys->type);
+    h = _Z9001_HASH(h, sys->pins);
+    h = _Z9001_HASH(h, sys->ctc_zcto2);
+    h = _Z9001_HASH(h, sys->blink_counter);
+    h = _Z9001_HASH(h, sys->kbd);
+    h = _Z9001_HASH(h, sys->z9001_has_basic_rom);
+    h = _Z9001_HASH(h, sys->audio.sample_pos);
+    h = chips_hash(sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(chips_audio_sample_t), h);
+    h = _Z9001_HASH(h, sys->ram);
+    h = _Z9001_HASH(h, sys->rom);
+    return _Z9001_HASH(h, sys->rom_font);
+}
+
+uint64_t z9001_frame_hash(z9001_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 #endif // CHIPS_IMPL
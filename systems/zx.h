@@ -27,6 +27,7 @@
     - chips/mem.h
     - chips/kbd.h
     - chips/clk.h
+    - chips/evsched.h
 
     ## The ZX Spectrum 48K
 
@@ -41,6 +42,16 @@
     - reads from port 0xFF must return 'current VRAM bytes
     - video decoding only has scanline accuracy, not pixel accuracy
 
+    ## Event Scheduling
+
+    By default only the CPU is ticked in each clock cycle, the scanline
+    decoder, the end of the vblank interrupt and the audio sample output
+    are events in a discrete-event scheduler (see chips/evsched.h), and the
+    beeper and AY-3-8912 are caught up right before the CPU writes to them,
+    and when an audio sample is due. Set zx_desc_t.per_tick to tick all
+    chips in each clock cycle instead (slower, but useful for validating
+    that both modes produce identical results).
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -69,13 +80,22 @@ extern "C" {
 #endif
 
 // bump this whenever the zx_t struct layout changes
-#define ZX_SNAPSHOT_VERSION (0x0001)
+#define ZX_SNAPSHOT_VERSION (0x0006)
 
 #define ZX_MAX_AUDIO_SAMPLES (1024)      // max number of audio samples in internal sample buffer
 #define ZX_DEFAULT_AUDIO_SAMPLES (128)   // default number of samples in internal sample buffer
+#define ZX_AUDIO_NUM_TRACKS (4)          // beeper, AY channel A, B, C (AY tracks are silent on 48K)
 #define ZX_FRAMEBUFFER_WIDTH (512)
 #define ZX_FRAMEBUFFER_HEIGHT (256)
 #define ZX_FRAMEBUFFER_SIZE_BYTES (ZX_FRAMEBUFFER_WIDTH * ZX_FRAMEBUFFER_HEIGHT)
+
+// performance counter slots (see CHIPS_PERF_COUNTERS in chips_common.h)
+enum {
+    ZX_PERF_CPU,        // Z80 ticks
+    ZX_PERF_VIDEO,      // video scanline decoding
+    ZX_PERF_AUDIO,      // beeper and AY-3-8912 ticks
+    ZX_PERF_NUM,
+};
 #define ZX_DISPLAY_WIDTH (320)
 #define ZX_DISPLAY_HEIGHT (256)
 
@@ -105,8 +125,11 @@ typedef struct {
     zx_type_t type;                     // default is ZX_TYPE_48K
     zx_joystick_type_t joystick_type;   // what joystick to emulate, default is ZX_JOYSTICK_NONE
     chips_debug_t debug;                // optional debugger hook
+    chips_input_callback_t input;       // optional input recording callback (see util/movie.h)
+    bool per_tick;                      // tick all chips in each clock cycle instead of using the event scheduler
     struct {
         chips_audio_callback_t callback;
+        chips_audio_tracks_callback_t tracks_callback;  // optional per-voice output
         int num_samples;
         int sample_rate;
         float beeper_volume;
@@ -144,17 +167,27 @@ typedef struct {
     int scanline_y;
     int int_counter;
     uint32_t display_ram_bank;
+    bool per_tick;              // true: tick all chips in each clock cycle
+    sched_t sched;              // event scheduler, time is in CPU ticks
+    uint64_t audio_tick;        // scheduler time up to which beeper and AY have been ticked
     kbd_t kbd;
     mem_t mem;
     uint64_t pins;
     uint64_t freq_hz;
     bool valid;
+    clk_t clk;
     chips_debug_t debug;
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_counters_t perf;
+#endif
+    chips_input_callback_t input;
     struct {
         chips_audio_callback_t callback;
+        chips_audio_tracks_callback_t tracks_callback;
         int num_samples;
         int sample_pos;
-        float sample_buffer[ZX_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t sample_buffer[ZX_MAX_AUDIO_SAMPLES];
+        chips_audio_sample_t tracks_buffer[ZX_MAX_AUDIO_SAMPLES * ZX_AUDIO_NUM_TRACKS];
     } audio;
     uint8_t ram[8][0x4000];
     uint8_t rom[2][0x4000];
@@ -172,6 +205,14 @@ void zx_reset(zx_t* sys);
 chips_display_info_t zx_display_info(zx_t* sys);
 // run ZX Spectrum instance for a given number of microseconds, return number of ticks
 uint32_t zx_exec(zx_t* sys, uint32_t micro_seconds);
+// run ZX Spectrum instance for an exact number of ticks, return number of ticks executed
+uint32_t zx_exec_ticks(zx_t* sys, uint32_t num_ticks);
+// run ZX Spectrum instance until a number of audio samples has been generated, return number of ticks executed
+uint32_t zx_exec_samples(zx_t* sys, int num_samples);
+#if defined(CHIPS_PERF_COUNTERS)
+// get per-chip performance counters (only with CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* zx_perf_counters(zx_t* sys);
+#endif
 // send a key-down event
 void zx_key_down(zx_t* sys, int key_code);
 // send a key-up event
@@ -182,12 +223,18 @@ void zx_set_joystick_type(zx_t* sys, zx_joystick_type_t type);
 zx_joystick_type_t zx_joystick_type(zx_t* sys);
 // set joystick mask (combination of ZX_JOYSTICK_*)
 void zx_joystick(zx_t* sys, uint8_t mask);
+// replay a recorded input event (see util/movie.h)
+void zx_input_event(zx_t* sys, const chips_input_event_t* event);
 // load a ZX Z80 file into the emulator
 bool zx_quickload(zx_t* sys, chips_range_t data);
 // save a snapshot, patches any pointers to zero, returns a snapshot version
 uint32_t zx_save_snapshot(zx_t* sys, zx_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
 bool zx_load_snapshot(zx_t* sys, uint32_t version, zx_t* src);
+// compute a 64-bit hash over the emulator state (without framebuffer, host pointers and callbacks)
+uint64_t zx_state_hash(zx_t* sys);
+// compute a 64-bit hash over the framebuffer content
+uint64_t zx_frame_hash(zx_t* sys);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -209,6 +256,14 @@ static void _zx_init_keyboard_matrix(zx_t* sys);
 #define _ZX_48K_FREQUENCY (3500000)
 #define _ZX_128_FREQUENCY (3546894)
 
+// scheduler event ids, in per-tick dispatch order
+#define _ZX_EVENT_SCANLINE (0)
+#define _ZX_EVENT_INT_OFF (1)
+#define _ZX_EVENT_SAMPLE (2)
+
+static void _zx_init_events(zx_t* sys);
+static void _zx_sync_audio(zx_t* sys, uint64_t tick);
+
 void zx_init(zx_t* sys, const zx_desc_t* desc) {
     CHIPS_ASSERT(sys && desc);
     if (desc->debug.callback.func) { CHIPS_ASSERT(desc->debug.stopped); }
@@ -217,11 +272,19 @@ void zx_init(zx_t* sys, const zx_desc_t* desc) {
     sys->valid = true;
     sys->type = desc->type;
     sys->joystick_type = desc->joystick_type;
+    sys->per_tick = desc->per_tick;
     sys->freq_hz = (sys->type == ZX_TYPE_48K) ? _ZX_48K_FREQUENCY : _ZX_128_FREQUENCY;
+    clk_init(&sys->clk, sys->freq_hz);
     sys->audio.callback = desc->audio.callback;
+    sys->audio.tracks_callback = desc->audio.tracks_callback;
     sys->audio.num_samples = _ZX_DEFAULT(desc->audio.num_samples, ZX_DEFAULT_AUDIO_SAMPLES);
     CHIPS_ASSERT(sys->audio.num_samples <= ZX_MAX_AUDIO_SAMPLES);
     sys->debug = desc->debug;
+    sys->input = desc->input;
+#if defined(CHIPS_PERF_COUNTERS)
+    static const char* perf_names[ZX_PERF_NUM] = { "z80", "video", "audio" };
+    chips_perf_init(&sys->perf, ZX_PERF_NUM, perf_names);
+#endif
 
     // initalize the hardware
     sys->border_color = 0;
@@ -258,11 +321,14 @@ void zx_init(zx_t* sys, const zx_desc_t* desc) {
             .type = AY38910_TYPE_8912,
             .tick_hz = (int)sys->freq_hz / 2,
             .sound_hz = audio_hz,
-            .magnitude = _ZX_DEFAULT(desc->audio.ay_volume, 0.5f)
+            .magnitude = _ZX_DEFAULT(desc->audio.ay_volume, 0.5f),
+            .channel_samples = 0 != desc->audio.tracks_callback.func,
         });
     }
     _zx_init_memory_map(sys);
     _zx_init_keyboard_matrix(sys);
+    sched_init(&sys->sched);
+    _zx_init_events(sys);
 }
 
 void zx_discard(zx_t* sys) {
@@ -272,6 +338,7 @@ void zx_discard(zx_t* sys) {
 
 void zx_reset(zx_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
+    _zx_sync_audio(sys, sys->sched.now);
     sys->pins = z80_reset(&sys->cpu);
     beeper_reset(&sys->beeper);
     if (sys->type == ZX_TYPE_128) {
@@ -291,6 +358,16 @@ void zx_reset(zx_t* sys) {
         sys->display_ram_bank = 5;
     }
     _zx_init_memory_map(sys);
+    _zx_init_events(sys);
+}
+
+// (re-)schedule the scanline and audio events after init or reset
+static void _zx_init_events(zx_t* sys) {
+    if (!sys->per_tick) {
+        sched_in(&sys->sched, _ZX_EVENT_SCANLINE, (uint64_t)sys->scanline_counter);
+        sched_in(&sys->sched, _ZX_EVENT_SAMPLE, (uint64_t)(sys->beeper.counter + BEEPER_FIXEDPOINT_SCALE - 1) / BEEPER_FIXEDPOINT_SCALE);
+        sys->audio_tick = sys->sched.now;
+    }
 }
 
 static bool _zx_decode_scanline(zx_t* sys) {
@@ -312,6 +389,7 @@ static bool _zx_decode_scanline(zx_t* sys) {
         56 border lines bottom border
         48 pixels on each side horizontal border
     */
+    CHIPS_PERF_BEGIN(&sys->perf, ZX_PERF_VIDEO);
     const int top_decode_line = sys->top_border_scanlines - 32;
     const int btm_decode_line = sys->top_border_scanlines + 192 + 32;
     if ((sys->scanline_y >= top_decode_line) && (sys->scanline_y < btm_decode_line)) {
@@ -373,6 +451,7 @@ static bool _zx_decode_scanline(zx_t* sys) {
             }
         }
     }
+    CHIPS_PERF_END(&sys->perf, ZX_PERF_VIDEO);
 
     if (sys->scanline_y++ >= sys->frame_scan_lines) {
         // start new frame, request vblank interrupt
@@ -413,25 +492,96 @@ static void _zx_update_memory_map_zx128(zx_t* sys, uint8_t data) {
     }
 }
 
+// tick the AY and beeper, and output a new audio sample when ready
+static void _zx_tick_audio(zx_t* sys) {
+    CHIPS_PERF_BEGIN(&sys->perf, ZX_PERF_AUDIO);
+    // tick the AY at half frequency
+    if (++sys->tick_count & 1) {
+        ay38910_tick(&sys->ay);
+    }
+
+    // tick the beeper
+    if (beeper_tick(&sys->beeper)) {
+        // new sample ready (if this is not a ZX128, sys->ay.sample will be 0)
+        const chips_audio_sample_t sample = chips_audio_clamp((chips_audio_accum_t)sys->beeper.sample + sys->ay.sample);
+        if (sys->audio.tracks_callback.func) {
+            chips_audio_sample_t* dst = &sys->audio.tracks_buffer[sys->audio.sample_pos * ZX_AUDIO_NUM_TRACKS];
+            dst[0] = sys->beeper.sample;
+            dst[1] = sys->ay.channel_sample[0];
+            dst[2] = sys->ay.channel_sample[1];
+            dst[3] = sys->ay.channel_sample[2];
+        }
+        sys->audio.sample_buffer[sys->audio.sample_pos++] = sample;
+        if (sys->audio.sample_pos == sys->audio.num_samples) {
+            if (sys->audio.callback.func) {
+                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
+            }
+            if (sys->audio.tracks_callback.func) {
+                sys->audio.tracks_callback.func(sys->audio.tracks_buffer, sys->audio.num_samples, ZX_AUDIO_NUM_TRACKS, sys->audio.tracks_callback.user_data);
+            }
+            sys->audio.sample_pos = 0;
+        }
+    }
+    CHIPS_PERF_END(&sys->perf, ZX_PERF_AUDIO);
+}
+
+// in event scheduling mode, catch up the beeper and AY until (and including) a tick
+static void _zx_sync_audio(zx_t* sys, uint64_t tick) {
+    if (!sys->per_tick) {
+        while (sys->audio_tick < tick) {
+            sys->audio_tick++;
+            _zx_tick_audio(sys);
+        }
+    }
+}
+
 static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
+    CHIPS_PERF_BEGIN(&sys->perf, ZX_PERF_CPU);
     pins = z80_tick(&sys->cpu, pins);
+    CHIPS_PERF_END(&sys->perf, ZX_PERF_CPU);
+
+    bool sample_due = false;
+    if (sys->per_tick) {
+        // video decoding and vblank interrupt
+        if (--sys->scanline_counter <= 0) {
+            sys->scanline_counter += sys->scanline_period;
+            // decode next video scanline
+            if (_zx_decode_scanline(sys)) {
+                // request vblank interrupt
+                pins |= Z80_INT;
+                // hold the INT pin for 32 ticks
+                sys->int_counter = 32;
+            }
+        }
 
-    // video decoding and vblank interrupt
-    if (--sys->scanline_counter <= 0) {
-        sys->scanline_counter += sys->scanline_period;
-        // decode next video scanline
-        if (_zx_decode_scanline(sys)) {
-            // request vblank interrupt
-            pins |= Z80_INT;
-            // hold the INT pin for 32 ticks
-            sys->int_counter = 32;
+        // clear INT pin after 32 ticks
+        if (pins & Z80_INT) {
+            if (--sys->int_counter < 0) {
+                pins &= ~Z80_INT;
+            }
         }
     }
-
-    // clear INT pin after 32 ticks
-    if (pins & Z80_INT) {
-        if (--sys->int_counter < 0) {
-            pins &= ~Z80_INT;
+    else if (++sys->sched.now >= sys->sched.next) {
+        int event;
+        while ((event = sched_pop(&sys->sched)) >= 0) {
+            switch (event) {
+                case _ZX_EVENT_SCANLINE:
+                    // decode next video scanline, and request vblank interrupt
+                    sched_in(&sys->sched, _ZX_EVENT_SCANLINE, (uint64_t)sys->scanline_period);
+                    if (_zx_decode_scanline(sys)) {
+                        pins |= Z80_INT;
+                        // the INT pin is cleared 32 ticks later
+                        sched_in(&sys->sched, _ZX_EVENT_INT_OFF, 32);
+                    }
+                    break;
+                case _ZX_EVENT_INT_OFF:
+                    pins &= ~Z80_INT;
+                    break;
+                case _ZX_EVENT_SAMPLE:
+                    // audio must be ticked after IO requests
+                    sample_due = true;
+                    break;
+            }
         }
     }
 
@@ -467,6 +617,7 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
             else if (pins & Z80_WR) {
                 // write to ULA
                 // FIXME: bit 3: MIC output (CAS SAVE, 0=On, 1=Off)
+                _zx_sync_audio(sys, sys->sched.now - 1);
                 const uint8_t data = Z80_GET_DATA(pins);
                 sys->border_color = data & 7;
                 sys->last_fe_out = data;
@@ -481,6 +632,7 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
         }
         else if (((pins & (Z80_A15|Z80_A1)) == Z80_A15) && (sys->type == ZX_TYPE_128)) {
             // AY-3-8912 access (1*............0.)
+            _zx_sync_audio(sys, sys->sched.now - 1);
             if (pins & Z80_A14) { pins |= AY38910_BC1; }
             if (pins & Z80_WR) { pins |= AY38910_BDIR; }
             pins = ay38910_iorq(&sys->ay, pins) & Z80_PIN_MASK;
@@ -491,51 +643,83 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
         }
     }
 
-    // tick the AY at half frequency, use the buffered chip select
-    // pin mask so that the AY doesn't miss any IO requests
-    if (++sys->tick_count & 1) {
-        ay38910_tick(&sys->ay);
+    if (sys->per_tick) {
+        _zx_tick_audio(sys);
     }
-
-    // tick the beeper
-    if (beeper_tick(&sys->beeper)) {
-        // new sample ready (if this is not a ZX128, sys->ay.sample will be 0)
-        const float sample = sys->beeper.sample + sys->ay.sample;
-        sys->audio.sample_buffer[sys->audio.sample_pos++] = sample;
-        if (sys->audio.sample_pos == sys->audio.num_samples) {
-            if (sys->audio.callback.func) {
-                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
-            }
-            sys->audio.sample_pos = 0;
-        }
+    else if (sample_due) {
+        // catch up beeper and AY, this outputs the next sample
+        _zx_sync_audio(sys, sys->sched.now);
+        sched_in(&sys->sched, _ZX_EVENT_SAMPLE, (uint64_t)(sys->beeper.counter + BEEPER_FIXEDPOINT_SCALE - 1) / BEEPER_FIXEDPOINT_SCALE);
     }
     return pins;
 }
 
+// check if the debug hook must be called in the current tick (in each tick, or only on requested events)
+static inline bool _zx_debug_event(zx_t* sys, uint64_t pins) {
+    const uint32_t events = sys->debug.events;
+    return (0 == events) ||
+           ((events & CHIPS_DEBUG_EVENT_OPCODE) && z80_opdone(&sys->cpu)) ||
+           ((events & CHIPS_DEBUG_EVENT_MEM_WRITE) && ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR))) ||
+           ((events & CHIPS_DEBUG_EVENT_IO) && ((pins & (Z80_IORQ|Z80_M1)) == Z80_IORQ)) ||
+           ((events & CHIPS_DEBUG_EVENT_INT) && (0 != (pins & (Z80_INT|Z80_NMI))));
+}
+
 uint32_t zx_exec(zx_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    const uint32_t num_ticks = clk_us_to_ticks(sys->freq_hz, micro_seconds);
+    return zx_exec_ticks(sys, clk_advance_us(&sys->clk, micro_seconds));
+}
+
+// run for max_ticks, or until num_samples audio samples have been generated (-1 for no limit), return executed ticks
+static uint32_t _zx_exec(zx_t* sys, uint32_t max_ticks, int num_samples) {
+    uint32_t num_ticks = 0;
+    int sample_pos = sys->audio.sample_pos;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug hook
-        for (uint32_t tick = 0; tick < num_ticks; tick++) {
+        while ((num_ticks < max_ticks) && (num_samples != 0)) {
             pins = _zx_tick(sys, pins);
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     else {
-        // run with debug hook
-        for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->debug.stopped); tick++) {
+        // run with debug hook in each tick, or only on requested events
+        while ((num_ticks < max_ticks) && (num_samples != 0) && !(*sys->debug.stopped)) {
             pins = _zx_tick(sys, pins);
-            sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            if (_zx_debug_event(sys, pins)) {
+                sys->debug.callback.func(sys->debug.callback.user_data, pins);
+            }
+            num_ticks++;
+            if ((num_samples > 0) && (sample_pos != sys->audio.sample_pos)) {
+                sample_pos = sys->audio.sample_pos;
+                num_samples--;
+            }
         }
     }
     sys->pins = pins;
+    const uint32_t micro_seconds = clk_ticks_to_us(sys->freq_hz, num_ticks);
     kbd_update(&sys->kbd, micro_seconds);
+    chips_input_record(&sys->input, CHIPS_INPUT_EXEC, num_ticks, 0);
     return num_ticks;
 }
 
+uint32_t zx_exec_ticks(zx_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return _zx_exec(sys, num_ticks, -1);
+}
+
+uint32_t zx_exec_samples(zx_t* sys, int num_samples) {
+    CHIPS_ASSERT(sys && sys->valid && (sys->audio.num_samples > 1));
+    // the fractional tick remainder is carried across calls in the sound chip's sample counter
+    return _zx_exec(sys, UINT32_MAX, (num_samples > 0) ? num_samples : 0);
+}
+
 void zx_key_down(zx_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_DOWN, (uint32_t)key_code, 0);
     switch (sys->joystick_type) {
         case ZX_JOYSTICKTYPE_NONE:
             kbd_key_down(&sys->kbd, key_code);
@@ -578,6 +762,7 @@ void zx_key_down(zx_t* sys, int key_code) {
 
 void zx_key_up(zx_t* sys, int key_code) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_KEY_UP, (uint32_t)key_code, 0);
     switch (sys->joystick_type) {
         case ZX_JOYSTICKTYPE_NONE:
             kbd_key_up(&sys->kbd, key_code);
@@ -620,6 +805,7 @@ void zx_key_up(zx_t* sys, int key_code) {
 
 void zx_set_joystick_type(zx_t* sys, zx_joystick_type_t type) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK_TYPE, (uint32_t)type, 0);
     sys->joystick_type = type;
 }
 
@@ -630,6 +816,7 @@ zx_joystick_type_t zx_joystick_type(zx_t* sys) {
 
 void zx_joystick(zx_t* sys, uint8_t mask) {
     CHIPS_ASSERT(sys && sys->valid);
+    chips_input_record(&sys->input, CHIPS_INPUT_JOYSTICK, mask, 0);
     if (sys->joystick_type == ZX_JOYSTICKTYPE_SINCLAIR_1) {
         if (mask & ZX_JOYSTICK_BTN)   { kbd_key_down(&sys->kbd, '5'); }
         else                          { kbd_key_up(&sys->kbd, '5'); }
@@ -659,6 +846,18 @@ void zx_joystick(zx_t* sys, uint8_t mask) {
     }
 }
 
+void zx_input_event(zx_t* sys, const chips_input_event_t* event) {
+    CHIPS_ASSERT(sys && sys->valid && event);
+    switch (event->type) {
+        case CHIPS_INPUT_EXEC: zx_exec_ticks(sys, event->a); break;
+        case CHIPS_INPUT_KEY_DOWN: zx_key_down(sys, (int)event->a); break;
+        case CHIPS_INPUT_KEY_UP: zx_key_up(sys, (int)event->a); break;
+        case CHIPS_INPUT_JOYSTICK: zx_joystick(sys, (uint8_t)event->a); break;
+        case CHIPS_INPUT_JOYSTICK_TYPE: zx_set_joystick_type(sys, (zx_joystick_type_t)event->a); break;
+        default: break;
+    }
+}
+
 static void _zx_init_memory_map(zx_t* sys) {
     mem_init(&sys->mem);
     if (sys->type == ZX_TYPE_128) {
@@ -935,6 +1134,7 @@ bool zx_quickload(zx_t* sys, chips_range_t data) {
     if (ext_hdr) {
         sys->pins = z80_prefetch(&sys->cpu, (ext_hdr->PC_h<<8)|ext_hdr->PC_l);
         if (sys->type == ZX_TYPE_128) {
+            _zx_sync_audio(sys, sys->sched.now);
             ay38910_reset(&sys->ay);
             for (uint8_t i = 0; i < AY38910_NUM_REGISTERS; i++) {
                 ay38910_set_register(&sys->ay, i, ext_hdr->audio[i]);
@@ -950,6 +1150,13 @@ bool zx_quickload(zx_t* sys, chips_range_t data) {
     return true;
 }
 
+#if defined(CHIPS_PERF_COUNTERS)
+chips_perf_counters_t* zx_perf_counters(zx_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return &sys->perf;
+}
+#endif
+
 chips_display_info_t zx_display_info(zx_t* sys) {
     static const uint32_t palette[16] = {
         0xFF000000,     // std black
@@ -1000,7 +1207,12 @@ uint32_t zx_save_snapshot(zx_t* sys, zx_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onsave(&dst->perf);
+#endif
+    chips_input_callback_snapshot_onsave(&dst->input);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
+    chips_audio_tracks_callback_snapshot_onsave(&dst->audio.tracks_callback);
     ay38910_snapshot_onsave(&dst->ay);
     mem_snapshot_onsave(&dst->mem, sys);
     return ZX_SNAPSHOT_VERSION;
@@ -1014,11 +1226,63 @@ bool zx_load_snapshot(zx_t* sys, uint32_t version, zx_t* src) {
     static zx_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
+#if defined(CHIPS_PERF_COUNTERS)
+    chips_perf_snapshot_onload(&im.perf, &sys->perf);
+#endif
+    chips_input_callback_snapshot_onload(&im.input, &sys->input);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
+    chips_audio_tracks_callback_snapshot_onload(&im.audio.tracks_callback, &sys->audio.tracks_callback);
     ay38910_snapshot_onload(&im.ay, &sys->ay);
     mem_snapshot_onload(&im.mem, sys);
     *sys = im;
     return true;
 }
 
+// hash a member, including padding bytes (which are zero-initialized by zx_init())
+#define _ZX_HASH(h, member) chips_hash(&(member), sizeof(member), h)
+
+uint64_t zx_state_hash(zx_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    // hash the members directly, skipping host pointers, callbacks, the exec clock (which
+    // only tracks fractions of zx_exec() calls) and the memory mapping (which follows from
+    // type and last_mem_config)
+    uint64_t h = _ZX_HASH(0, sys->cpu);
+    h = _ZX_HASH(h, sys->beeper);
+    ay38910_t ay;
+    memcpy(&ay, &sys->ay, sizeof(ay));
+    ay38910_snapshot_onsave(&ay);
+    h = _ZX_HASH(h, ay);
+    h = _ZX_HASH(h, sys->type);
+    h = _ZX_HASH(h, sys->joystick_type);
+    h = _ZX_HASH(h, sys->memory_paging_disabled);
+    h = _ZX_HASH(h, sys->kbd_joymask);
+    h = _ZX_HASH(h, sys->joy_joymask);
+    h = _ZX_HASH(h, sys->tick_count);
+    h = _ZX_HASH(h, sys->last_mem_config);
+    h = _ZX_HASH(h, sys->last_fe_out);
+    h = _ZX_HASH(h, sys->blink_counter);
+    h = _ZX_HASH(h, sys->border_color);
+    h = _ZX_HASH(h, sys->frame_scan_lines);
+    h = _ZX_HASH(h, sys->top_border_scanlines);
+    h = _ZX_HASH(h, sys->scanline_period);
+    h = _ZX_HASH(h, sys->scanline_counter);
+    h = _ZX_HASH(h, sys->scanline_y);
+    h = _ZX_HASH(h, sys->int_counter);
+    h = _ZX_HASH(h, sys->display_ram_bank);
+    h = _ZX_HASH(h, sys->per_tick);
+    h = _ZX_HASH(h, sys->sched);
+    h = _ZX_HASH(h, sys->audio_tick);
+    h = _ZX_HASH(h, sys->kbd);
+    h = _ZX_HASH(h, sys->pins);
+    h = _ZX_HASH(h, sys->audio.sample_pos);
+    h = chips_hash(sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(chips_audio_sample_t), h);
+    h = _ZX_HASH(h, sys->ram);
+    return _ZX_HASH(h, sys->rom);
+}
+
+uint64_t zx_frame_hash(zx_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return chips_hash(sys->fb, sizeof(sys->fb), 0);
+}
+
 #endif // CHIPS_IMPL
@@ -32,6 +32,7 @@
     - ui_audio.h
     - ui_display.h
     - ui_dasm.h
+    - dbg.h
     - ui_dbg.h
     - ui_memedit.h
     - ui_memmap.h
@@ -18,6 +18,9 @@
     ~~~
         your own assert macro (default: assert(c))
 
+    Include chips/chips_common.h before this header (for the
+    audio sample type).
+
     Include the following headers before including the *implementation*:
         - imgui.h
         - ui_settings.h
@@ -55,7 +58,7 @@ extern "C" {
 */
 typedef struct {
     const char* title;          /* window title */
-    const float* sample_buffer; /* pointer to audio sample buffer */
+    const chips_audio_sample_t* sample_buffer; /* pointer to audio sample buffer */
     int num_samples;            /* max number of samples in sample buffer */
     int x, y;                   /* initial window position */
     int w, h;                   /* initial window size or zero for default size */
@@ -64,7 +67,7 @@ typedef struct {
 
 typedef struct {
     const char* title;
-    const float* sample_buffer;
+    const chips_audio_sample_t* sample_buffer;
     int num_samples;
     float init_x, init_y;
     float init_w, init_h;
@@ -95,6 +98,12 @@ void ui_audio_load_settings(ui_audio_t* ui, const ui_settings_t* settings);
     #define CHIPS_ASSERT(c) assert(c)
 #endif
 
+#if defined(CHIPS_AUDIO_INT16)
+static float _ui_audio_sample_getter(void* data, int idx) {
+    return ((const chips_audio_sample_t*)data)[idx] / 32768.0f;
+}
+#endif
+
 void ui_audio_init(ui_audio_t* win, const ui_audio_desc_t* desc) {
     CHIPS_ASSERT(win && desc);
     CHIPS_ASSERT(desc->title);
@@ -129,7 +138,11 @@ void ui_audio_draw(ui_audio_t* win, int sample_pos) {
     if (ImGui::Begin(win->title, &win->open)) {
         ImVec2 pos = ImGui::GetCursorScreenPos();
         ImVec2 area = ImGui::GetContentRegionAvail();
-        ImGui::PlotLines("##samples", win->sample_buffer, win->num_samples, 0, 0, -1.0f, +1.0f, area);
+        #if defined(CHIPS_AUDIO_INT16)
+            ImGui::PlotLines("##samples", _ui_audio_sample_getter, (void*)win->sample_buffer, win->num_samples, 0, 0, -1.0f, +1.0f, area);
+        #else
+            ImGui::PlotLines("##samples", win->sample_buffer, win->num_samples, 0, 0, -1.0f, +1.0f, area);
+        #endif
         const ImGuiStyle& style = ImGui::GetStyle();
         float x0 = pos.x + style.FramePadding.x;
         float x1 = pos.x + area.x - style.FramePadding.x;
@@ -4,6 +4,10 @@
 
     CPU debugger UI.
 
+    This is a Dear ImGui view on top of the UI-independent debugger
+    core in chips/dbg.h (breakpoints, stepping, history, heatmap and
+    stopwatch state live in ui_dbg_t.dbg, a dbg_t).
+
     Do this:
     ~~~C
     #define CHIPS_UI_IMPL
@@ -24,8 +28,12 @@
     ~~~
         your own assert macro (default: assert(c))
 
-    You need to include the following headers before including the
-    *implementation*:
+    You need to include the following headers before including ui_dbg.h:
+
+        - dbg.h         (the dbg.h implementation must be compiled
+                        into the CHIPS_IMPL source file)
+
+    ...and the following headers before including the *implementation*:
 
         - imgui.h
         - ui_util.h
@@ -68,62 +76,56 @@ extern "C" {
 #endif
 
 /* NOTE: keep all MAX and NUM values 2^N */
-#define UI_DBG_MAX_BREAKPOINTS (32)
+#define UI_DBG_MAX_BREAKPOINTS DBG_MAX_BREAKPOINTS
 #define UI_DBG_MAX_USER_BREAKTYPES (8)  /* max number of user breakpoint types */
-#define UI_DBG_STEP_TRAPID (128)        /* special trap id when step-mode active */
-#define UI_DBG_BP_BASE_TRAPID (UI_DBG_STEP_TRAPID+1)   /* first CPU trap-id used for breakpoints */
+#define UI_DBG_STEP_TRAPID DBG_STEP_TRAPID
+#define UI_DBG_BP_BASE_TRAPID DBG_BP_BASE_TRAPID
 #define UI_DBG_NUM_LINES (256)
 #define UI_DBG_NUM_BACKTRACE_LINES (UI_DBG_NUM_LINES/2)
-#define UI_DBG_NUM_HISTORY_ITEMS (256)
+#define UI_DBG_NUM_HISTORY_ITEMS DBG_NUM_HISTORY_ITEMS
 
-/* breakpoint types */
+/* breakpoint types (see dbg.h) */
 enum {
-    UI_DBG_BREAKTYPE_EXEC,      /* break on executed address */
-    UI_DBG_BREAKTYPE_BYTE,      /* break on a specific 8-bit value at address */
-    UI_DBG_BREAKTYPE_WORD,      /* break on a specific 16-bit value at address */
-    UI_DBG_BREAKTYPE_IRQ,       /* break on maskable interrupt */
-    UI_DBG_BREAKTYPE_NMI,       /* break on non-maskable interrupt */
+    UI_DBG_BREAKTYPE_EXEC = DBG_BREAKTYPE_EXEC,
+    UI_DBG_BREAKTYPE_BYTE = DBG_BREAKTYPE_BYTE,
+    UI_DBG_BREAKTYPE_WORD = DBG_BREAKTYPE_WORD,
+    UI_DBG_BREAKTYPE_IRQ = DBG_BREAKTYPE_IRQ,
+    UI_DBG_BREAKTYPE_NMI = DBG_BREAKTYPE_NMI,
     #if defined(UI_DBG_USE_Z80)
-        UI_DBG_BREAKTYPE_OUT,   /* break on a Z80 out operation */
-        UI_DBG_BREAKTYPE_IN,    /* break on a Z80 in operation */
+        UI_DBG_BREAKTYPE_OUT = DBG_BREAKTYPE_OUT,
+        UI_DBG_BREAKTYPE_IN = DBG_BREAKTYPE_IN,
     #endif
-    UI_DBG_BREAKTYPE_USER,      /* user breakpoint types start here */
+    UI_DBG_BREAKTYPE_USER = DBG_BREAKTYPE_USER,
 };
 #define UI_DBG_MAX_BREAKTYPES (UI_DBG_BREAKTYPE_USER + UI_DBG_MAX_USER_BREAKTYPES)
 
 /* breakpoint conditions */
 enum {
-    UI_DBG_BREAKCOND_EQUAL = 0,
-    UI_DBG_BREAKCOND_NONEQUAL,
-    UI_DBG_BREAKCOND_GREATER,
-    UI_DBG_BREAKCOND_LESS,
-    UI_DBG_BREAKCOND_GREATER_EQUAL,
-    UI_DBG_BREAKCOND_LESS_EQUAL,
+    UI_DBG_BREAKCOND_EQUAL = DBG_BREAKCOND_EQUAL,
+    UI_DBG_BREAKCOND_NONEQUAL = DBG_BREAKCOND_NONEQUAL,
+    UI_DBG_BREAKCOND_GREATER = DBG_BREAKCOND_GREATER,
+    UI_DBG_BREAKCOND_LESS = DBG_BREAKCOND_LESS,
+    UI_DBG_BREAKCOND_GREATER_EQUAL = DBG_BREAKCOND_GREATER_EQUAL,
+    UI_DBG_BREAKCOND_LESS_EQUAL = DBG_BREAKCOND_LESS_EQUAL,
 };
 
 /* current step mode */
 enum {
-    UI_DBG_STEPMODE_NONE = 0,
-    UI_DBG_STEPMODE_INTO,
-    UI_DBG_STEPMODE_OVER,
-    UI_DBG_STEPMODE_TICK,
+    UI_DBG_STEPMODE_NONE = DBG_STEPMODE_NONE,
+    UI_DBG_STEPMODE_INTO = DBG_STEPMODE_INTO,
+    UI_DBG_STEPMODE_OVER = DBG_STEPMODE_OVER,
+    UI_DBG_STEPMODE_TICK = DBG_STEPMODE_TICK,
 };
 
 enum {
-    UI_DBG_STOP_REASON_UNKNOWN = 0,
-    UI_DBG_STOP_REASON_BREAK = 1,
-    UI_DBG_STOP_REASON_BREAKPOINT = 2,
-    UI_DBG_STOP_REASON_STEP = 3,
+    UI_DBG_STOP_REASON_UNKNOWN = DBG_STOP_REASON_UNKNOWN,
+    UI_DBG_STOP_REASON_BREAK = DBG_STOP_REASON_BREAK,
+    UI_DBG_STOP_REASON_BREAKPOINT = DBG_STOP_REASON_BREAKPOINT,
+    UI_DBG_STOP_REASON_STEP = DBG_STOP_REASON_STEP,
 };
 
 /* a breakpoint description */
-typedef struct ui_dbg_breakpoint_t {
-    int type;           /* UI_DBG_BREAKTYPE_* */
-    int cond;           /* UI_DBG_BREAKCOND_* */
-    bool enabled;
-    uint16_t addr;
-    int val;
-} ui_dbg_breakpoint_t;
+typedef dbg_breakpoint_t ui_dbg_breakpoint_t;
 
 /* breakpoint type description */
 typedef struct ui_dbg_user_breaktype_t {
@@ -207,27 +209,6 @@ typedef struct ui_dbg_desc_t {
     ui_dbg_breaktype_t user_breaktypes[UI_DBG_MAX_USER_BREAKTYPES];  /* user-defined breakpoint types */
 } ui_dbg_desc_t;
 
-/* debugger state */
-typedef struct ui_dbg_state_t {
-    #if defined(UI_DBG_USE_Z80)
-    z80_t* z80;
-    #elif defined(UI_DBG_USE_M6502)
-    m6502_t* m6502;
-    #endif
-    bool stopped;
-    bool external_debugger_connected;
-    int step_mode;
-    uint64_t last_tick_pins;    // cpu pins in last tick
-    uint32_t frame_id;          // used in trap callback to detect when a new frame has started
-    uint32_t cur_op_ticks;
-    uint16_t cur_op_pc;         // PC of current instruction
-    uint16_t stepover_pc;
-    int last_trap_id;           // can be used to identify breakpoint which caused trap
-    int delete_breakpoint_index;
-    int num_breakpoints;
-    ui_dbg_breakpoint_t breakpoints[UI_DBG_MAX_BREAKPOINTS];
-} ui_dbg_state_t;
-
 /* a displayed line */
 typedef struct ui_dbg_line_t {
     uint16_t addr;
@@ -246,6 +227,8 @@ typedef struct ui_dbg_uistate_t {
     bool show_bytes;
     bool show_ticks;
     bool request_scroll;
+    uint32_t frame_id;          // used for heatmap autoclear
+    int delete_breakpoint_index;
     struct {
         const char* title;
         bool open;
@@ -273,17 +256,6 @@ typedef struct ui_dbg_uistate_t {
     const char* breaktype_combo_labels[UI_DBG_MAX_BREAKTYPES];
 } ui_dbg_uistate_t;
 
-enum {
-    UI_DBG_HEATMAP_ITEM_OPCODE = (1<<0),
-    UI_DBG_HEATMAP_ITEM_WRITE  = (1<<1),
-    UI_DBG_HEATMAP_ITEM_READ   = (1<<2),
-};
-
-typedef struct ui_dbg_heatmapitem_t {
-    uint8_t state;  // UI_DBG_HEATMAP_ITEM_xxx
-    uint8_t ticks;  // instruction tick count
-} ui_dbg_heatmapitem_t;
-
 typedef struct ui_dbg_heatmap_t {
     int tex_width, tex_height;
     int tex_width_uicombo_state;
@@ -295,15 +267,9 @@ typedef struct ui_dbg_heatmap_t {
     int cur_y;
     bool popup_addr_valid;
     uint16_t popup_addr;
-    ui_dbg_heatmapitem_t items[1<<16];     /* execution counter map */
-    uint32_t pixels[1<<16];    /* execution counters converted to pixel data */
+    uint32_t pixels[1<<16];    /* heatmap state (in dbg_t) converted to pixel data */
 } ui_dbg_heatmap_t;
 
-typedef struct ui_dbg_history_t {
-    uint16_t pc[UI_DBG_NUM_HISTORY_ITEMS];
-    uint16_t pos;
-} ui_dbg_history_t;
-
 enum {
     UI_DBG_DASM_LINE_MAX_BYTES = 8,
     UI_DBG_DASM_LINE_MAX_CHARS = 32,
@@ -324,16 +290,7 @@ typedef struct ui_dbg_dasm_request_t {
     ui_dbg_dasm_line_t* out_lines;  // pointer to output ops, must have at least num_ops entries
 } ui_dbg_dasm_request_t;
 
-enum {
-    UI_DBG_STOPWATCH_NUM = 8,
-};
-typedef struct ui_dbg_stopwatch_t {
-    uint32_t freq_hz;
-    uint32_t scanline_ticks;
-    uint32_t frame_ticks;
-    uint64_t cur_ticks;
-    uint64_t start_ticks[UI_DBG_STOPWATCH_NUM];
-} ui_dbg_stopwatch_t;
+#define UI_DBG_STOPWATCH_NUM DBG_STOPWATCH_NUM
 
 typedef struct ui_dbg_t {
     bool valid;
@@ -344,11 +301,9 @@ typedef struct ui_dbg_t {
     ui_dbg_debug_callbacks_t debug_cbs;
     void* user_data;
     ui_dbg_dasm_line_t dasm_line;
-    ui_dbg_state_t dbg;
+    dbg_t dbg;
     ui_dbg_uistate_t ui;
     ui_dbg_heatmap_t heatmap;
-    ui_dbg_history_t history;
-    ui_dbg_stopwatch_t stopwatch;
 } ui_dbg_t;
 
 // initialize a new ui_dbg_t instance
@@ -423,59 +378,49 @@ static inline uint16_t _ui_dbg_get_pc(ui_dbg_t* win) {
     return win->dbg.cur_op_pc;
 }
 
-/* disassembler callback to fetch the next instruction byte */
-static uint8_t _ui_dbg_dasm_in_cb(void* user_data) {
-    ui_dbg_t* win = (ui_dbg_t*) user_data;
-    uint8_t val = _ui_dbg_read_byte(win, win->dasm_line.addr++);
-    if (win->dasm_line.num_bytes < UI_DBG_DASM_LINE_MAX_BYTES) {
-        win->dasm_line.bytes[win->dasm_line.num_bytes++] = val;
-    }
-    return val;
-}
+#if defined(UI_DBG_USE_Z80)
+typedef z80dasm_inst_t _ui_dbg_dasm_inst_t;
+#define _UI_DBG_DASM_MAX_BYTES (Z80DASM_MAX_BYTES)
+#else
+typedef m6502dasm_inst_t _ui_dbg_dasm_inst_t;
+#define _UI_DBG_DASM_MAX_BYTES (M6502DASM_MAX_BYTES)
+#endif
 
-/* disassembler callback to output a character */
-static void _ui_dbg_dasm_out_cb(char c, void* user_data) {
-    ui_dbg_t* win = (ui_dbg_t*) user_data;
-    if ((win->dasm_line.num_chars + 1) < UI_DBG_DASM_LINE_MAX_CHARS) {
-        win->dasm_line.chars[win->dasm_line.num_chars++] = c;
-        win->dasm_line.chars[win->dasm_line.num_chars] = 0;
+// decode instruction at address into win->dasm_line without building the text
+// (used by the line array and backscan code which only needs instruction lengths)
+static inline uint16_t _ui_dbg_disasm_decode(ui_dbg_t* win, uint16_t addr, _ui_dbg_dasm_inst_t* out_inst) {
+    uint8_t bytes[_UI_DBG_DASM_MAX_BYTES];
+    for (int i = 0; i < _UI_DBG_DASM_MAX_BYTES; i++) {
+        bytes[i] = _ui_dbg_read_byte(win, (uint16_t)(addr + i));
     }
-}
-
-// disassemble instruction at address
-static inline uint16_t _ui_dbg_disasm(ui_dbg_t* win, uint16_t addr) {
-    memset(&win->dasm_line, 0, sizeof(win->dasm_line));
-    win->dasm_line.addr = addr;
     #if defined(UI_DBG_USE_Z80)
-        z80dasm_op(addr, _ui_dbg_dasm_in_cb, _ui_dbg_dasm_out_cb, win);
+        int len = z80dasm_decode(addr, bytes, sizeof(bytes), out_inst);
     #elif defined(UI_DBG_USE_M6502)
-        m6502dasm_op(addr, _ui_dbg_dasm_in_cb, _ui_dbg_dasm_out_cb, win);
+        int len = m6502dasm_decode(addr, bytes, sizeof(bytes), out_inst);
     #endif
-    uint16_t next_addr = win->dasm_line.addr;
+    CHIPS_ASSERT((len > 0) && (len <= UI_DBG_DASM_LINE_MAX_BYTES));
     win->dasm_line.addr = addr;
-    return next_addr;
+    win->dasm_line.num_bytes = (uint8_t)len;
+    for (int i = 0; i < len; i++) {
+        win->dasm_line.bytes[i] = bytes[i];
+    }
+    win->dasm_line.num_chars = 0;
+    win->dasm_line.chars[0] = 0;
+    return (uint16_t)(addr + len);
 }
 
-/* disassemble the an instruction, but only return the length of the instruction */
-/* check if the an instruction is a 'step over' op */
-static bool _ui_dbg_is_stepover_op(uint8_t opcode) {
+// disassemble instruction at address
+static inline uint16_t _ui_dbg_disasm(ui_dbg_t* win, uint16_t addr) {
+    memset(&win->dasm_line, 0, sizeof(win->dasm_line));
+    _ui_dbg_dasm_inst_t inst;
+    uint16_t next_addr = _ui_dbg_disasm_decode(win, addr, &inst);
     #if defined(UI_DBG_USE_Z80)
-        switch (opcode) {
-            /* CALL nnnn */
-            case 0xCD:
-            /* CALL cc,nnnn */
-            case 0xDC: case 0xFC: case 0xD4: case 0xC4:
-            case 0xF4: case 0xEC: case 0xE4: case 0xCC:
-            /* DJNZ d */
-            case 0x10:
-                return true;
-            default:
-                return false;
-        }
+        int num_chars = z80dasm_format(&inst, win->dasm_line.chars, UI_DBG_DASM_LINE_MAX_CHARS);
     #elif defined(UI_DBG_USE_M6502)
-        /* on 6502, only JSR qualifies */
-        return opcode == 0x20;
+        int num_chars = m6502dasm_format(&inst, win->dasm_line.chars, UI_DBG_DASM_LINE_MAX_CHARS);
     #endif
+    win->dasm_line.num_chars = (uint8_t)num_chars;
+    return next_addr;
 }
 
 /* check if an instruction is a control-flow op */
@@ -552,65 +497,30 @@ static bool _ui_dbg_is_controlflow_op(uint8_t opcode0, uint8_t opcode1) {
 }
 
 static void _ui_dbg_break(ui_dbg_t* win) {
-    win->dbg.stopped = true;
-    win->dbg.step_mode = UI_DBG_STEPMODE_NONE;
     win->ui.request_scroll = true;
-    if (win->debug_cbs.stopped_cb) {
-        win->debug_cbs.stopped_cb(UI_DBG_STOP_REASON_BREAK, win->dbg.cur_op_pc);
-    }
+    dbg_break(&win->dbg);
 }
 
 static void _ui_dbg_continue(ui_dbg_t* win, bool invoke_continue_cb) {
-    win->dbg.stopped = false;
-    win->dbg.step_mode = UI_DBG_STEPMODE_NONE;
-    if (invoke_continue_cb && win->debug_cbs.continued_cb) {
-        win->debug_cbs.continued_cb();
-    }
+    dbg_continue(&win->dbg, invoke_continue_cb);
 }
 
 static void _ui_dbg_step_into(ui_dbg_t* win) {
-    win->dbg.stopped = false;
-    win->dbg.step_mode = UI_DBG_STEPMODE_INTO;
+    dbg_step_into(&win->dbg);
     win->ui.request_scroll = true;
 }
 
 static void _ui_dbg_step_over(ui_dbg_t* win) {
-    win->dbg.stopped = false;
+    dbg_step_over(&win->dbg);
     win->ui.request_scroll = true;
-    uint16_t next_pc = _ui_dbg_disasm(win, _ui_dbg_get_pc(win));
-    if (_ui_dbg_is_stepover_op(win->dasm_line.bytes[0])) {
-        win->dbg.step_mode = UI_DBG_STEPMODE_OVER;
-        win->dbg.stepover_pc = next_pc;
-    } else {
-        win->dbg.step_mode = UI_DBG_STEPMODE_INTO;
-    }
 }
 
 static void _ui_dbg_step_tick(ui_dbg_t* win) {
-    win->dbg.stopped = false;
-    win->dbg.step_mode = UI_DBG_STEPMODE_TICK;
+    dbg_step_tick(&win->dbg);
     win->ui.request_scroll = true;
 }
 
 /*== HISTORY =================================================================*/
-static void _ui_dbg_history_reset(ui_dbg_t* win) {
-    memset(&win->history, 0, sizeof(win->history));
-}
-
-static void _ui_dbg_history_reboot(ui_dbg_t* win) {
-    _ui_dbg_history_reset(win);
-}
-
-static void _ui_dbg_history_push(ui_dbg_t* win, uint16_t pc) {
-    win->history.pc[win->history.pos] = pc;
-    win->history.pos = (win->history.pos + 1) & (UI_DBG_NUM_HISTORY_ITEMS-1);
-}
-
-static uint16_t _ui_dbg_history_get(ui_dbg_t* win, uint16_t rel_pos) {
-    uint16_t index = (win->history.pos - rel_pos - 1) & (UI_DBG_NUM_HISTORY_ITEMS-1);
-    return win->history.pc[index];
-}
-
 static void _ui_dbg_history_draw(ui_dbg_t* win) {
     ui_util_handle_window_open_dirty(&win->ui.history.open, &win->ui.history.last_open);
     if (!win->ui.history.open) {
@@ -639,7 +549,7 @@ static void _ui_dbg_history_draw(ui_dbg_t* win) {
             }
 
             /* get history PC */
-            uint16_t pc = _ui_dbg_history_get(win, line_i);
+            uint16_t pc = dbg_history_get(&win->dbg, line_i);
             uint16_t addr = _ui_dbg_disasm(win, pc);
             const int num_bytes = addr - pc;
 
@@ -670,7 +580,7 @@ static void _ui_dbg_history_draw(ui_dbg_t* win) {
             /* tick count */
             x += glyph_width * 17;
             if (win->ui.show_ticks) {
-                int ticks = win->heatmap.items[pc].ticks;
+                int ticks = win->dbg.heatmap.items[pc].ticks;
                 ImGui::SameLine(x);
                 ImGui::Text("%d", ticks);
             }
@@ -684,279 +594,57 @@ static void _ui_dbg_history_draw(ui_dbg_t* win) {
 
 
 /*== DEBUGGER STATE ==========================================================*/
-static void _ui_dbg_dbgstate_init(ui_dbg_t* win, ui_dbg_desc_t* desc) {
-    ui_dbg_state_t* dbg = &win->dbg;
-    #if defined(UI_DBG_USE_Z80)
-        CHIPS_ASSERT(desc->z80);
-        dbg->z80 = desc->z80;
-    #elif defined(UI_DBG_USE_M6502)
-        CHIPS_ASSERT(desc->m6502);
-        dbg->m6502 = desc->m6502;
-    #endif
-    dbg->delete_breakpoint_index = -1;
-}
-
-static void _ui_dbg_dbgstate_reset(ui_dbg_t* win) {
-    ui_dbg_state_t* dbg = &win->dbg;
-    dbg->stopped = false;
-    dbg->step_mode = UI_DBG_STEPMODE_NONE;
-    dbg->cur_op_pc = 0;
-    dbg->last_trap_id = 0;
-}
-
-static void _ui_dbg_dbgstate_reboot(ui_dbg_t* win) {
-    _ui_dbg_dbgstate_reset(win);
-}
-
-// evaluate per-opcode breakpoints, called at the start of a new instrucion
-static int _ui_dbg_eval_op_breakpoints(ui_dbg_t* win, int trap_id, uint16_t pc) {
-    if (win->dbg.step_mode != UI_DBG_STEPMODE_NONE) {
-        switch (win->dbg.step_mode) {
-            case UI_DBG_STEPMODE_INTO:
-                trap_id = UI_DBG_STEP_TRAPID;
-                break;
-            case UI_DBG_STEPMODE_OVER:
-                #if defined(UI_DBG_USE_Z80)
-                if (pc == win->dbg.stepover_pc) {
-                    trap_id = UI_DBG_STEP_TRAPID;
-                }
-                #elif defined(UI_DBG_USE_M6502)
-                if (pc == win->dbg.stepover_pc) {
-                    trap_id = UI_DBG_STEP_TRAPID;
-                }
-                #endif
-                break;
-        }
-    } else {
-        for (int i = 0; (i < win->dbg.num_breakpoints) && (trap_id == 0); i++) {
-            const ui_dbg_breakpoint_t* bp = &win->dbg.breakpoints[i];
-            if (bp->enabled) {
-                switch (bp->type) {
-                    case UI_DBG_BREAKTYPE_EXEC:
-                        if (pc == bp->addr) {
-                            trap_id = UI_DBG_BP_BASE_TRAPID + i;
-                        }
-                        break;
-
-                    case UI_DBG_BREAKTYPE_BYTE:
-                        {
-                            int val = (int) _ui_dbg_read_byte(win, bp->addr);
-                            bool b = false;
-                            switch (bp->cond) {
-                                case UI_DBG_BREAKCOND_EQUAL:            b = val == bp->val; break;
-                                case UI_DBG_BREAKCOND_NONEQUAL:         b = val != bp->val; break;
-                                case UI_DBG_BREAKCOND_GREATER:          b = val > bp->val; break;
-                                case UI_DBG_BREAKCOND_LESS:             b = val < bp->val; break;
-                                case UI_DBG_BREAKCOND_GREATER_EQUAL:    b = val >= bp->val; break;
-                                case UI_DBG_BREAKCOND_LESS_EQUAL:       b = val <= bp->val; break;
-                            }
-                            if (b) {
-                                trap_id = UI_DBG_BP_BASE_TRAPID + i;
-                            }
-                        }
-                        break;
-
-                    case UI_DBG_BREAKTYPE_WORD:
-                        {
-                            uint16_t val = (int) _ui_dbg_read_word(win, bp->addr);
-                            bool b = false;
-                            switch (bp->cond) {
-                                case UI_DBG_BREAKCOND_EQUAL:            b = val == bp->val; break;
-                                case UI_DBG_BREAKCOND_NONEQUAL:         b = val != bp->val; break;
-                                case UI_DBG_BREAKCOND_GREATER:          b = val > bp->val; break;
-                                case UI_DBG_BREAKCOND_LESS:             b = val < bp->val; break;
-                                case UI_DBG_BREAKCOND_GREATER_EQUAL:    b = val >= bp->val; break;
-                                case UI_DBG_BREAKCOND_LESS_EQUAL:       b = val <= bp->val; break;
-                            }
-                            if (b) {
-                                trap_id = UI_DBG_BP_BASE_TRAPID + i;
-                            }
-                        }
-                        break;
-                }
-            }
-        }
-    }
-    return trap_id;
-}
-
-//  evaluate per-tick breakpoints, only call this if is dbg.step_mode is UI_DBG_STEPMODE_NONE!
-static int _ui_dbg_eval_tick_breakpoints(ui_dbg_t* win, int trap_id, uint64_t pins) {
-    uint64_t rising_pins = pins & (pins ^ win->dbg.last_tick_pins);
-    for (int i = 0; (i < win->dbg.num_breakpoints) && (trap_id == 0); i++) {
-        const ui_dbg_breakpoint_t* bp = &win->dbg.breakpoints[i];
-        if (bp->enabled) {
-            switch (bp->type) {
-                case UI_DBG_BREAKTYPE_IRQ:
-                    #if defined(UI_DBG_USE_Z80)
-                        if (Z80_INT & rising_pins) {
-                            trap_id = UI_DBG_BP_BASE_TRAPID + i;
-                        }
-                    #elif defined(UI_DBG_USE_M6502)
-                        if (M6502_IRQ & rising_pins) {
-                            trap_id = UI_DBG_BP_BASE_TRAPID + i;
-                        }
-                    #endif
-                    break;
-
-                case UI_DBG_BREAKTYPE_NMI:
-                    #if defined(UI_DBG_USE_Z80)
-                        if (Z80_NMI & rising_pins) {
-                            trap_id = UI_DBG_BP_BASE_TRAPID + i;
-                        }
-                    #elif defined(UI_DBG_USE_M6502)
-                        if (M6502_NMI & rising_pins) {
-                            trap_id = UI_DBG_BP_BASE_TRAPID + i;
-                        }
-                    #endif
-                    break;
-
-                #if defined(UI_DBG_USE_Z80)
-                case UI_DBG_BREAKTYPE_OUT:
-                    if ((pins & Z80_CTRL_PIN_MASK) == (Z80_IORQ|Z80_WR)) {
-                        const uint16_t mask = bp->val;
-                        if ((Z80_GET_ADDR(pins) & mask) == (bp->addr & mask)) {
-                            trap_id = UI_DBG_BP_BASE_TRAPID + i;
-                        }
-                    }
-                    break;
-
-                case UI_DBG_BREAKTYPE_IN:
-                    if ((pins & Z80_CTRL_PIN_MASK) == (Z80_IORQ|Z80_RD)) {
-                        const uint16_t mask = bp->val;
-                        if ((Z80_GET_ADDR(pins) & mask) == (bp->addr & mask)) {
-                            trap_id = UI_DBG_BP_BASE_TRAPID + i;
-                        }
-                    }
-                    break;
-                #endif
-            }
-        }
-    }
-
-    // call optional user-breakpoint evaluation callback
-    if ((0 == trap_id) && win->break_cb) {
-        trap_id = win->break_cb(win, trap_id, pins, win->user_data);
-    }
-    return trap_id;
-}
-
-/* add an execution breakpoint */
-static bool _ui_dbg_bp_add_exec(ui_dbg_t* win, bool enabled, uint16_t addr) {
-    if (win->dbg.num_breakpoints < UI_DBG_MAX_BREAKPOINTS) {
-        ui_dbg_breakpoint_t* bp = &win->dbg.breakpoints[win->dbg.num_breakpoints++];
-        bp->type = UI_DBG_BREAKTYPE_EXEC;
-        bp->cond = UI_DBG_BREAKCOND_EQUAL;
-        bp->addr = addr;
-        bp->val = 0;
-        bp->enabled = enabled;
-        return true;
-    } else {
-        /* no more breakpoint slots */
-        return false;
-    }
-}
-
-/* add a memory breakpoint (bytes) */
-static bool _ui_dbg_bp_add_byte(ui_dbg_t* win, bool enabled, uint16_t addr) {
-    if (win->dbg.num_breakpoints < UI_DBG_MAX_BREAKPOINTS) {
-        ui_dbg_breakpoint_t* bp = &win->dbg.breakpoints[win->dbg.num_breakpoints++];
-        bp->type = UI_DBG_BREAKTYPE_BYTE;
-        bp->cond = UI_DBG_BREAKCOND_EQUAL;
-        bp->addr = addr;
-        bp->val = _ui_dbg_read_byte(win, addr);
-        bp->enabled = enabled;
-        return true;
-    } else {
-        /* no more breakpoint slots */
-        return false;
-    }
-}
-
-/* add a memory breakpoint (word) */
-static bool _ui_dbg_bp_add_word(ui_dbg_t* win, bool enabled, uint16_t addr) {
-    if (win->dbg.num_breakpoints < UI_DBG_MAX_BREAKPOINTS) {
-        ui_dbg_breakpoint_t* bp = &win->dbg.breakpoints[win->dbg.num_breakpoints++];
-        bp->type = UI_DBG_BREAKTYPE_WORD;
-        bp->cond = UI_DBG_BREAKCOND_EQUAL;
-        bp->addr = addr;
-        bp->val = _ui_dbg_read_word(win, addr);
-        bp->enabled = enabled;
-        return true;
-    } else {
-        /* no more breakpoint slots */
-        return false;
-    }
-}
-
-/* find breakpoint index by type and address, return -1 if not found */
-static int _ui_dbg_bp_find(ui_dbg_t* win, int type, uint16_t addr) {
-    for (int i = 0; i < win->dbg.num_breakpoints; i++) {
-        const ui_dbg_breakpoint_t* bp = &win->dbg.breakpoints[i];
-        if (bp->type == type && bp->addr == addr) {
-            return i;
-        }
-    }
-    return -1;
-}
-
-/* delete breakpoint by index */
-static void _ui_dbg_bp_del(ui_dbg_t* win, int index) {
-    if ((win->dbg.num_breakpoints > 0) && (index >= 0) && (index < win->dbg.num_breakpoints)) {
-        for (int i = index; i < (win->dbg.num_breakpoints - 1); i++) {
-            win->dbg.breakpoints[i] = win->dbg.breakpoints[i+1];
-        }
-        win->dbg.num_breakpoints--;
-    }
-}
-
-/* add a new breakpoint, or remove existing one */
-static void _ui_dbg_bp_toggle_exec(ui_dbg_t* win, uint16_t addr) {
-    int index = _ui_dbg_bp_find(win, UI_DBG_BREAKTYPE_EXEC, addr);
-    if (index >= 0) {
-        /* breakpoint already exists, remove */
-        _ui_dbg_bp_del(win, index);
-    } else {
-        /* breakpoint doesn't exist, add a new one */
-        _ui_dbg_bp_add_exec(win, true, addr);
-    }
+// the dbg_t callbacks get the ui_dbg_t as user data and forward to the UI callbacks
+static uint8_t _ui_dbg_core_read(uint16_t addr, void* user_data) {
+    ui_dbg_t* win = (ui_dbg_t*) user_data;
+    return _ui_dbg_read_byte(win, addr);
 }
 
-/* return true if breakpoint is enabled, false is disabled, or index out of bounds */
-static bool _ui_dbg_bp_enabled(ui_dbg_t* win, int index) {
-    if ((index >= 0) && (index < win->dbg.num_breakpoints)) {
-        const ui_dbg_breakpoint_t* bp = &win->dbg.breakpoints[index];
-        return bp->enabled;
-    }
-    return false;
+static int _ui_dbg_core_break(dbg_t* dbg, int trap_id, uint64_t pins, void* user_data) {
+    (void)dbg;
+    ui_dbg_t* win = (ui_dbg_t*) user_data;
+    return win->break_cb(win, trap_id, pins, win->user_data);
 }
 
-/* disable all breakpoints */
-static void _ui_dbg_bp_disable_all(ui_dbg_t* win) {
-    for (int i = 0; i < win->dbg.num_breakpoints; i++) {
-        win->dbg.breakpoints[i].enabled = false;
+static void _ui_dbg_core_stopped(int stop_reason, uint16_t addr, void* user_data) {
+    ui_dbg_t* win = (ui_dbg_t*) user_data;
+    if (win->debug_cbs.stopped_cb) {
+        win->debug_cbs.stopped_cb(stop_reason, addr);
     }
 }
 
-/* enable all breakpoints */
-static void _ui_dbg_bp_enable_all(ui_dbg_t* win) {
-    for (int i = 0; i < win->dbg.num_breakpoints; i++) {
-        win->dbg.breakpoints[i].enabled = true;
+static void _ui_dbg_core_continued(void* user_data) {
+    ui_dbg_t* win = (ui_dbg_t*) user_data;
+    if (win->debug_cbs.continued_cb) {
+        win->debug_cbs.continued_cb();
     }
 }
 
-/* delete all breakpoints */
-static void _ui_dbg_bp_delete_all(ui_dbg_t* win) {
-    win->dbg.num_breakpoints = 0;
+static void _ui_dbg_dbgstate_init(ui_dbg_t* win, ui_dbg_desc_t* desc) {
+    dbg_desc_t dbg_desc;
+    memset(&dbg_desc, 0, sizeof(dbg_desc));
+    #if defined(UI_DBG_USE_Z80)
+        dbg_desc.z80 = desc->z80;
+    #elif defined(UI_DBG_USE_M6502)
+        dbg_desc.m6502 = desc->m6502;
+    #endif
+    dbg_desc.freq_hz = desc->freq_hz;
+    dbg_desc.scanline_ticks = desc->scanline_ticks;
+    dbg_desc.frame_ticks = desc->frame_ticks;
+    dbg_desc.read_cb = _ui_dbg_core_read;
+    dbg_desc.break_cb = desc->break_cb ? _ui_dbg_core_break : 0;
+    dbg_desc.stopped_cb = _ui_dbg_core_stopped;
+    dbg_desc.continued_cb = _ui_dbg_core_continued;
+    dbg_desc.user_data = win;
+    dbg_init(&win->dbg, &dbg_desc);
 }
 
-/* draw the "Delete all breakpoints" popup modal */
 static void _ui_dbg_bp_draw_delete_all_modal(ui_dbg_t* win, const char* title) {
     if (ImGui::BeginPopupModal(title, 0, ImGuiWindowFlags_AlwaysAutoResize)) {
         ImGui::Text("Delete all breakpoints?");
         ImGui::Separator();
         if (ImGui::Button("Ok", ImVec2(120, 0))) {
-            _ui_dbg_bp_delete_all(win);
+            dbg_bp_delete_all(&win->dbg);
             ImGui::CloseCurrentPopup();
         }
         ImGui::SameLine();
@@ -978,16 +666,16 @@ static void _ui_dbg_bp_draw(ui_dbg_t* win) {
     if (ImGui::Begin(win->ui.breakpoints.title, &win->ui.breakpoints.open)) {
         bool scroll_down = false;
         if (ImGui::Button("Add..")) {
-            _ui_dbg_bp_add_exec(win, false, _ui_dbg_get_pc(win));
+            dbg_bp_add_exec(&win->dbg, false, _ui_dbg_get_pc(win));
             scroll_down = true;
         }
         ImGui::SameLine();
         if (ImGui::Button("Disable All")) {
-            _ui_dbg_bp_disable_all(win);
+            dbg_bp_disable_all(&win->dbg);
         }
         ImGui::SameLine();
         if (ImGui::Button("Enable All")) {
-            _ui_dbg_bp_enable_all(win);
+            dbg_bp_enable_all(&win->dbg);
         }
         ImGui::SameLine();
         if (ImGui::Button("Delete All")) {
@@ -997,10 +685,12 @@ static void _ui_dbg_bp_draw(ui_dbg_t* win) {
         int del_bp_index = -1;
         ImGui::Separator();
         ImGui::BeginChild("##bp_list", ImVec2(0, 0), false);
+        bool bp_changed = false;
         for (int i = 0; i < win->dbg.num_breakpoints; i++) {
             ImGui::PushID(i);
             ui_dbg_breakpoint_t* bp = &win->dbg.breakpoints[i];
             CHIPS_ASSERT((bp->type >= 0) && (bp->type < UI_DBG_MAX_BREAKTYPES));
+            const ui_dbg_breakpoint_t old_bp = *bp;
             /* visualize the current breakpoint */
             bool bp_active = (win->dbg.last_trap_id >= UI_DBG_BP_BASE_TRAPID) &&
                              ((win->dbg.last_trap_id - UI_DBG_BP_BASE_TRAPID) == i);
@@ -1078,24 +768,32 @@ static void _ui_dbg_bp_draw(ui_dbg_t* win) {
             if (ImGui::IsItemHovered()) {
                 ImGui::SetTooltip("Delete");
             }
+            if ((old_bp.type != bp->type) || (old_bp.cond != bp->cond) || (old_bp.enabled != bp->enabled) ||
+                (old_bp.addr != bp->addr) || (old_bp.val != bp->val))
+            {
+                bp_changed = true;
+            }
             ImGui::PopID();
         }
+        if (bp_changed) {
+            dbg_bp_update(&win->dbg);
+        }
         if (del_bp_index != -1) {
             ImGui::OpenPopup("Delete?");
-            win->dbg.delete_breakpoint_index = del_bp_index;
+            win->ui.delete_breakpoint_index = del_bp_index;
         }
-        if ((win->dbg.delete_breakpoint_index >= 0) && ImGui::BeginPopupModal("Delete?", 0, ImGuiWindowFlags_AlwaysAutoResize)) {
-            ImGui::Text("Delete breakpoint at %04X?", win->dbg.breakpoints[win->dbg.delete_breakpoint_index].addr);
+        if ((win->ui.delete_breakpoint_index >= 0) && ImGui::BeginPopupModal("Delete?", 0, ImGuiWindowFlags_AlwaysAutoResize)) {
+            ImGui::Text("Delete breakpoint at %04X?", win->dbg.breakpoints[win->ui.delete_breakpoint_index].addr);
             ImGui::Separator();
             if (ImGui::Button("Ok", ImVec2(120, 0))) {
-                _ui_dbg_bp_del(win, win->dbg.delete_breakpoint_index);
+                dbg_bp_del(&win->dbg, win->ui.delete_breakpoint_index);
                 ImGui::CloseCurrentPopup();
-                win->dbg.delete_breakpoint_index = -1;
+                win->ui.delete_breakpoint_index = -1;
             }
             ImGui::SameLine();
             if (ImGui::Button("Cancel", ImVec2(120, 0))) {
                 ImGui::CloseCurrentPopup();
-                win->dbg.delete_breakpoint_index = -1;
+                win->ui.delete_breakpoint_index = -1;
             }
             ImGui::EndPopup();
         }
@@ -1136,61 +834,12 @@ static void _ui_dbg_heatmap_update_texture_size(ui_dbg_t* win, int new_width) {
 static void _ui_dbg_heatmap_reset(ui_dbg_t* win) {
     win->heatmap.popup_addr_valid = false;
     win->heatmap.popup_addr = 0;
-    memset(win->heatmap.items, 0, sizeof(win->heatmap.items));
 }
 
 static void _ui_dbg_heatmap_reboot(ui_dbg_t* win) {
     _ui_dbg_heatmap_reset(win);
 }
 
-static void _ui_dbg_heatmap_clear_all(ui_dbg_t* win) {
-    memset(win->heatmap.items, 0, sizeof(win->heatmap.items));
-}
-
-static void _ui_dbg_heatmap_clear_rw(ui_dbg_t* win) {
-    for (int i = 0; i < (1<<16); i++) {
-        win->heatmap.items[i].state &= ~(UI_DBG_HEATMAP_ITEM_READ|UI_DBG_HEATMAP_ITEM_WRITE);
-    }
-}
-
-static void _ui_dbg_heatmap_record_op(ui_dbg_t* win, uint16_t pc) {
-    // record per-op heatmap events
-    win->heatmap.items[pc].state |= UI_DBG_HEATMAP_ITEM_OPCODE;
-    // update last instruction's ticks
-    win->heatmap.items[win->dbg.cur_op_pc].ticks = win->dbg.cur_op_ticks;
-}
-
-static void _ui_dbg_heatmap_record_tick(ui_dbg_t* win, uint64_t pins) {
-    #if defined(UI_DBG_USE_Z80)
-        if ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_RD)) {
-            const uint16_t addr = Z80_GET_ADDR(pins);
-            win->heatmap.items[addr].state |= UI_DBG_HEATMAP_ITEM_READ;
-        } else if ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR)) {
-            const uint16_t addr = Z80_GET_ADDR(pins);
-            win->heatmap.items[addr].state |= UI_DBG_HEATMAP_ITEM_WRITE;
-        }
-    #elif defined(UI_DBG_USE_M6502)
-        const uint16_t addr = M6502_GET_ADDR(pins);
-        if (0 != (pins & M6502_RW)) {
-            win->heatmap.items[addr].state |= UI_DBG_HEATMAP_ITEM_READ;
-        } else {
-            win->heatmap.items[addr].state |= UI_DBG_HEATMAP_ITEM_WRITE;
-        }
-    #endif
-}
-
-static inline bool _ui_dbg_heatmap_is_opcode(ui_dbg_t* win, uint16_t addr) {
-    return 0 != (win->heatmap.items[addr].state & UI_DBG_HEATMAP_ITEM_OPCODE);
-}
-
-static inline bool _ui_dbg_heatmap_is_read(ui_dbg_t* win, uint16_t addr) {
-    return 0 != (win->heatmap.items[addr].state & UI_DBG_HEATMAP_ITEM_READ);
-}
-
-static inline bool _ui_dbg_heatmap_is_write(ui_dbg_t* win, uint16_t addr) {
-    return 0 != (win->heatmap.items[addr].state & UI_DBG_HEATMAP_ITEM_WRITE);
-}
-
 static void _ui_dbg_heatmap_update(ui_dbg_t* win) {
     const int frame_chunk_height = 64;
     const int y0 = win->heatmap.cur_y;
@@ -1203,13 +852,13 @@ static void _ui_dbg_heatmap_update(ui_dbg_t* win) {
             if (_ui_dbg_get_pc(win) == i) {
                 p |= 0xFF00FFFF;
             }
-            if (win->heatmap.show_ops && _ui_dbg_heatmap_is_opcode(win, (uint16_t)i)) {
+            if (win->heatmap.show_ops && dbg_heatmap_is_opcode(&win->dbg, (uint16_t)i)) {
                 p |= 0xFF0000FF;
             }
-            if (win->heatmap.show_writes && _ui_dbg_heatmap_is_write(win, (uint16_t)i)) {
+            if (win->heatmap.show_writes && dbg_heatmap_is_write(&win->dbg, (uint16_t)i)) {
                 p |= 0xFF008800;
             }
-            if (win->heatmap.show_reads && _ui_dbg_heatmap_is_read(win, (uint16_t)i)) {
+            if (win->heatmap.show_reads && dbg_heatmap_is_read(&win->dbg, (uint16_t)i)) {
                 p |= 0xFF880000;
             }
             win->heatmap.pixels[i] = p;
@@ -1229,8 +878,8 @@ static void _ui_dbg_heatmap_draw(ui_dbg_t* win) {
         _ui_dbg_heatmap_update_texture_size(win, hm->next_tex_width);
     }
     if (hm->autoclear_interval > 0) {
-        if ((win->dbg.frame_id % hm->autoclear_interval) == 0) {
-            _ui_dbg_heatmap_clear_all(win);
+        if ((win->ui.frame_id % hm->autoclear_interval) == 0) {
+            dbg_heatmap_clear_all(&win->dbg);
         }
     }
     _ui_dbg_heatmap_update(win);
@@ -1238,11 +887,11 @@ static void _ui_dbg_heatmap_draw(ui_dbg_t* win) {
     ImGui::SetNextWindowSize(ImVec2(292, 400), ImGuiCond_FirstUseEver);
     if (ImGui::Begin(win->ui.heatmap.title, &win->ui.heatmap.open)) {
         if (ImGui::Button("Clear All")) {
-            _ui_dbg_heatmap_clear_all(win);
+            dbg_heatmap_clear_all(&win->dbg);
         }
         ImGui::SameLine();
         if (ImGui::Button("Clear R/W")) {
-            _ui_dbg_heatmap_clear_rw(win);
+            dbg_heatmap_clear_rw(&win->dbg);
         }
         ImGui::SameLine();
         ImGui::PushStyleColor(ImGuiCol_Text, 0xFF0000FF);
@@ -1277,10 +926,10 @@ static void _ui_dbg_heatmap_draw(ui_dbg_t* win) {
         int y = (int)((mouse_pos.y - screen_pos.y) / hm->scale);
         uint16_t addr = y * hm->tex_width + x;
         if (ImGui::IsItemHovered()) {
-            if (_ui_dbg_heatmap_is_opcode(win, addr)) {
+            if (dbg_heatmap_is_opcode(&win->dbg, addr)) {
                 _ui_dbg_disasm(win, addr);
                 ImGui::SetTooltip("%04X: %s (ticks: %d)\n(right-click for options)",
-                    addr, win->dasm_line.chars, hm->items[addr].ticks);
+                    addr, win->dasm_line.chars, win->dbg.heatmap.items[addr].ticks);
             } else {
                 ImGui::SetTooltip("%04X: %02X %02X %02X %02X\n(right-click for options)", addr,
                     _ui_dbg_read_byte(win, addr),
@@ -1297,20 +946,20 @@ static void _ui_dbg_heatmap_draw(ui_dbg_t* win) {
             ImGui::Text("Address: %04X", hm->popup_addr);
             ImGui::Separator();
             if (ImGui::Selectable("Add Exec Breakpoint")) {
-                if (-1 == _ui_dbg_bp_find(win, UI_DBG_BREAKTYPE_EXEC, hm->popup_addr)) {
-                    _ui_dbg_bp_add_exec(win, true, hm->popup_addr);
+                if (-1 == dbg_bp_find(&win->dbg, UI_DBG_BREAKTYPE_EXEC, hm->popup_addr)) {
+                    dbg_bp_add_exec(&win->dbg, true, hm->popup_addr);
                 }
             }
             if (ImGui::Selectable("Add Byte Breakpoint")) {
-                if (-1 == _ui_dbg_bp_find(win, UI_DBG_BREAKTYPE_BYTE, hm->popup_addr)) {
-                    _ui_dbg_bp_add_byte(win, false, hm->popup_addr);
+                if (-1 == dbg_bp_find(&win->dbg, UI_DBG_BREAKTYPE_BYTE, hm->popup_addr)) {
+                    dbg_bp_add_byte(&win->dbg, false, hm->popup_addr);
                     win->ui.breakpoints.open = true;
                     ImGui::SetWindowFocus("Breakpoints");
                 }
             }
             if (ImGui::Selectable("Add Word Breakpoint")) {
-                if (-1 == _ui_dbg_bp_find(win, UI_DBG_BREAKTYPE_WORD, hm->popup_addr)) {
-                    _ui_dbg_bp_add_word(win, false, hm->popup_addr);
+                if (-1 == dbg_bp_find(&win->dbg, UI_DBG_BREAKTYPE_WORD, hm->popup_addr)) {
+                    dbg_bp_add_word(&win->dbg, false, hm->popup_addr);
                     win->ui.breakpoints.open = true;
                     ImGui::SetWindowFocus("Breakpoints");
                 }
@@ -1325,20 +974,6 @@ static void _ui_dbg_heatmap_draw(ui_dbg_t* win) {
 }
 
 /*== STOPWATCH WINDOW ========================================================*/
-static void _ui_dbg_stopwatch_init(ui_dbg_t* win, ui_dbg_desc_t* desc) {
-    memset(&win->stopwatch, 0, sizeof(win->stopwatch));
-    win->stopwatch.freq_hz = desc->freq_hz;
-    win->stopwatch.scanline_ticks = desc->scanline_ticks;
-    win->stopwatch.frame_ticks = desc->frame_ticks;
-}
-
-static void _ui_dbg_stopwatch_reset(ui_dbg_t* win) {
-    win->stopwatch.cur_ticks = 0;
-    for (int i = 0; i < UI_DBG_STOPWATCH_NUM; i++) {
-        win->stopwatch.start_ticks[i] = 0;
-    }
-}
-
 static void _ui_dbg_stopwatch_draw(ui_dbg_t* win) {
     ui_util_handle_window_open_dirty(&win->ui.stopwatch.open, &win->ui.stopwatch.last_open);
     if (!win->ui.stopwatch.open) {
@@ -1350,21 +985,21 @@ static void _ui_dbg_stopwatch_draw(ui_dbg_t* win) {
         for (int i = 0; i < UI_DBG_STOPWATCH_NUM; i++) {
             ImGui::PushID(i);
             if (ImGui::Button("Reset")) {
-                win->stopwatch.start_ticks[i] = win->stopwatch.cur_ticks;
+                dbg_stopwatch_reset(&win->dbg, i);
             }
             ImGui::SameLine();
-            uint64_t cycle_count = win->stopwatch.cur_ticks - win->stopwatch.start_ticks[i];
+            uint64_t cycle_count = dbg_stopwatch_ticks(&win->dbg, i);
             double ms = -1.0;
             double raster_lines = -1.0;
             double frames = -1.0;
-            if (win->stopwatch.freq_hz > 0) {
-                ms = ((double)cycle_count / (double)win->stopwatch.freq_hz) * 1000.0;
+            if (win->dbg.stopwatch.freq_hz > 0) {
+                ms = ((double)cycle_count / (double)win->dbg.stopwatch.freq_hz) * 1000.0;
             }
-            if (win->stopwatch.scanline_ticks > 0) {
-                raster_lines = (double)cycle_count / (double)win->stopwatch.scanline_ticks;
+            if (win->dbg.stopwatch.scanline_ticks > 0) {
+                raster_lines = (double)cycle_count / (double)win->dbg.stopwatch.scanline_ticks;
             }
-            if (win->stopwatch.frame_ticks > 0) {
-                frames = (double)cycle_count / (double)win->stopwatch.frame_ticks;
+            if (win->dbg.stopwatch.frame_ticks > 0) {
+                frames = (double)cycle_count / (double)win->dbg.stopwatch.frame_ticks;
             }
             ImGui::Text("%llu ticks", cycle_count);
             if (ImGui::IsItemHovered()) {
@@ -1380,6 +1015,7 @@ static void _ui_dbg_stopwatch_draw(ui_dbg_t* win) {
 static void _ui_dbg_uistate_init(ui_dbg_t* win, ui_dbg_desc_t* desc) {
     ui_dbg_uistate_t* ui = &win->ui;
     ui->title = desc->title;
+    ui->delete_breakpoint_index = -1;
     ui->open = ui->last_open = desc->open;
     ui->heatmap.title = "Memory Heatmap";
     ui->heatmap.open = ui->heatmap.last_open = false;
@@ -1479,18 +1115,18 @@ static void _ui_dbg_draw_menu(ui_dbg_t* win) {
         if (ImGui::BeginMenu("Breakpoints")) {
             ImGui::MenuItem("Breakpoint Window", 0, &win->ui.breakpoints.open);
             if (ImGui::MenuItem("Toggle Breakpoint", "F9")) {
-                _ui_dbg_bp_toggle_exec(win, _ui_dbg_get_pc(win));
+                dbg_bp_toggle_exec(&win->dbg, _ui_dbg_get_pc(win));
             }
             if (ImGui::MenuItem("Add Breakpoint..")) {
-                _ui_dbg_bp_add_exec(win, false, _ui_dbg_get_pc(win));
+                dbg_bp_add_exec(&win->dbg, false, _ui_dbg_get_pc(win));
                 win->ui.breakpoints.open = true;
                 ImGui::SetWindowFocus("Breakpoints");
             }
             if (ImGui::MenuItem("Enable All")) {
-                _ui_dbg_bp_enable_all(win);
+                dbg_bp_enable_all(&win->dbg);
             }
             if (ImGui::MenuItem("Disable All")) {
-                _ui_dbg_bp_disable_all(win);
+                dbg_bp_disable_all(&win->dbg);
             }
             if (ImGui::MenuItem("Delete All")) {
                 delete_all_bp = true;
@@ -1633,7 +1269,7 @@ static void _ui_dbg_handle_input(ui_dbg_t* win) {
         }
     }
     if (ImGui::IsKeyPressed((ImGuiKey)win->ui.keys.toggle_breakpoint.keycode)) {
-        _ui_dbg_bp_toggle_exec(win, _ui_dbg_get_pc(win));
+        dbg_bp_toggle_exec(&win->dbg, _ui_dbg_get_pc(win));
     }
 }
 
@@ -1686,11 +1322,11 @@ static _ui_dbg_disasm_backscan_result_t _ui_dbg_disasm_backscan(ui_dbg_t* win, u
     uint16_t bs_addr = addr - 1;
     uint16_t scan_addr = bs_addr;
     for (int i = 0; i < 4; i++, scan_addr--) {
-        if (_ui_dbg_heatmap_is_opcode(win, scan_addr)) {
+        if (dbg_heatmap_is_opcode(&win->dbg, scan_addr)) {
             // Z80: prefixed instruction?
             #if defined(UI_DBG_USE_Z80)
                 uint16_t prev_addr = scan_addr - 1;
-                if (_ui_dbg_heatmap_is_opcode(win, prev_addr)) {
+                if (dbg_heatmap_is_opcode(&win->dbg, prev_addr)) {
                     uint8_t maybe_prefix = _ui_dbg_read_byte(win, prev_addr);
                     if ((maybe_prefix == 0xCB) || (maybe_prefix == 0xDD) || (maybe_prefix == 0xED) || (maybe_prefix == 0xFD)) {
                         scan_addr = prev_addr;
@@ -1702,7 +1338,8 @@ static _ui_dbg_disasm_backscan_result_t _ui_dbg_disasm_backscan(ui_dbg_t* win, u
             #endif
             // found an op start, if any unknown bytes had been skipped, ignore the op
             // (it will be found again in the next iteration)
-            _ui_dbg_disasm(win, scan_addr);
+            _ui_dbg_dasm_inst_t inst;
+            _ui_dbg_disasm_decode(win, scan_addr, &inst);
             if ((int)(win->dasm_line.num_bytes - 1) == i) {
                 // ok, no gap bytes, break with 'found_op' status
                 bs_addr = scan_addr;
@@ -1733,7 +1370,8 @@ static void _ui_dbg_update_line_array(ui_dbg_t* win, uint16_t addr) {
     }
     for (; line_idx < UI_DBG_NUM_LINES; line_idx++) {
         win->ui.line_array[line_idx].addr = addr;
-        addr = _ui_dbg_disasm(win, addr);
+        _ui_dbg_dasm_inst_t inst;
+        addr = _ui_dbg_disasm_decode(win, addr, &inst);
         win->ui.line_array[line_idx].val = win->dasm_line.bytes[0];
     }
 }
@@ -1829,7 +1467,7 @@ static void _ui_dbg_draw_main(ui_dbg_t* win) {
         bool visible_line = (line_i >= clipper.DisplayStart) && (line_i < clipper.DisplayEnd);
         uint16_t addr = win->ui.line_array[line_i].addr;
         bool is_pc_line = (addr == pc);
-        bool show_dasm = (line_i >= UI_DBG_NUM_BACKTRACE_LINES) || _ui_dbg_heatmap_is_opcode(win, addr);
+        bool show_dasm = (line_i >= UI_DBG_NUM_BACKTRACE_LINES) || dbg_heatmap_is_opcode(&win->dbg, addr);
         const uint16_t start_addr = addr;
         if (show_dasm) {
             addr = _ui_dbg_disasm(win, addr);
@@ -1844,7 +1482,7 @@ static void _ui_dbg_draw_main(ui_dbg_t* win) {
         }
 
         /* show data bytes or potential but not verified instructions as dimmed */
-        if (_ui_dbg_heatmap_is_opcode(win, start_addr) || (start_addr == pc)) {
+        if (dbg_heatmap_is_opcode(&win->dbg, start_addr) || (start_addr == pc)) {
             ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyle().Colors[ImGuiCol_Text]);
         } else {
             ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyle().Colors[ImGuiCol_TextDisabled]);
@@ -1857,15 +1495,15 @@ static void _ui_dbg_draw_main(ui_dbg_t* win) {
         ImGui::PushID(line_i);
         if (ImGui::InvisibleButton("##bp", ImVec2(16, line_height))) {
             /* add or remove execution breakpoint */
-            _ui_dbg_bp_toggle_exec(win, start_addr);
+            dbg_bp_toggle_exec(&win->dbg, start_addr);
         }
         ImGui::PopID();
         ImDrawList* dl = ImGui::GetWindowDrawList();
         const ImVec2 mid(pos.x + 7, pos.y + lh2);
-        const int bp_index = _ui_dbg_bp_find(win, UI_DBG_BREAKTYPE_EXEC, start_addr);
+        const int bp_index = dbg_bp_find(&win->dbg, UI_DBG_BREAKTYPE_EXEC, start_addr);
         if (bp_index >= 0) {
             /* an execution breakpoint exists for this address */
-            ImU32 bp_color = _ui_dbg_bp_enabled(win, bp_index) ? bp_enabled_color : bp_disabled_color;
+            ImU32 bp_color = dbg_bp_enabled(&win->dbg, bp_index) ? bp_enabled_color : bp_disabled_color;
             dl->AddCircleFilled(mid, 7, bp_color);
             dl->AddCircle(mid, 7, brd_color);
         } else if (ImGui::IsItemHovered()) {
@@ -1921,7 +1559,7 @@ static void _ui_dbg_draw_main(ui_dbg_t* win) {
         /* tick count */
         x += glyph_width * (is_pc_line ? 18:20);
         if (win->ui.show_ticks) {
-            int ticks = win->heatmap.items[start_addr].ticks;
+            int ticks = win->dbg.heatmap.items[start_addr].ticks;
             ImGui::SameLine(x);
             if (ticks > 0) {
                 if (is_pc_line) {
@@ -1984,12 +1622,12 @@ void ui_dbg_init(ui_dbg_t* win, ui_dbg_desc_t* desc) {
     _ui_dbg_dbgstate_init(win, desc);
     _ui_dbg_uistate_init(win, desc);
     _ui_dbg_heatmap_init(win);
-    _ui_dbg_stopwatch_init(win, desc);
 }
 
 void ui_dbg_discard(ui_dbg_t* win) {
     CHIPS_ASSERT(win && win->valid);
     _ui_dbg_heatmap_discard(win);
+    dbg_discard(&win->dbg);
     win->valid = false;
 }
 
@@ -2011,11 +1649,9 @@ void ui_dbg_load_settings(ui_dbg_t* win, const ui_settings_t* settings) {
 
 void ui_dbg_reset(ui_dbg_t* win) {
     CHIPS_ASSERT(win && win->valid);
-    _ui_dbg_dbgstate_reset(win);
+    dbg_reset(&win->dbg);
     _ui_dbg_uistate_reset(win);
     _ui_dbg_heatmap_reset(win);
-    _ui_dbg_history_reset(win);
-    _ui_dbg_stopwatch_reset(win);
     if (win->debug_cbs.reset_cb) {
         win->debug_cbs.reset_cb();
     }
@@ -2023,60 +1659,25 @@ void ui_dbg_reset(ui_dbg_t* win) {
 
 void ui_dbg_reboot(ui_dbg_t* win) {
     CHIPS_ASSERT(win && win->valid);
-    _ui_dbg_dbgstate_reboot(win);
+    dbg_reboot(&win->dbg);
     _ui_dbg_uistate_reboot(win);
     _ui_dbg_heatmap_reboot(win);
-    _ui_dbg_history_reboot(win);
     if (win->debug_cbs.reboot_cb) {
         win->debug_cbs.reboot_cb();
     }
 }
 
 void ui_dbg_tick(ui_dbg_t* win, uint64_t pins) {
-    int trap_id = 0;
-    if (win->dbg.step_mode == UI_DBG_STEPMODE_TICK) {
-        trap_id = UI_DBG_STEP_TRAPID;
-    }
-    // evaluate per-op breakpoints
-    #if defined(UI_DBG_USE_M6502)
-        const bool new_op = pins & M6502_SYNC;
-    #elif defined(UI_DBG_USE_Z80)
-        const bool new_op = z80_opdone(win->dbg.z80);
-    #endif
-    if (new_op) {
-        const uint16_t pc = pins & 0xFFFF;
-        trap_id = _ui_dbg_eval_op_breakpoints(win, trap_id, pc);
-        _ui_dbg_heatmap_record_op(win, pc);
-        _ui_dbg_history_push(win, pc);
-        win->dbg.cur_op_ticks = 0;
-        win->dbg.cur_op_pc = pc;
-    }
-    if (win->dbg.step_mode == UI_DBG_STEPMODE_NONE) {
-        trap_id = _ui_dbg_eval_tick_breakpoints(win, trap_id, pins);
-    }
-    _ui_dbg_heatmap_record_tick(win, pins);
-    win->stopwatch.cur_ticks++;
-    win->dbg.cur_op_ticks++;
-    win->dbg.last_tick_pins = pins;
-
-    if (trap_id >= UI_DBG_STEP_TRAPID) {
-        win->dbg.stopped = true;
-        if (win->debug_cbs.stopped_cb) {
-            int stop_reason = (win->dbg.step_mode == UI_DBG_STEPMODE_NONE) ? UI_DBG_STOP_REASON_BREAKPOINT : UI_DBG_STOP_REASON_STEP;
-            win->debug_cbs.stopped_cb(stop_reason, win->dbg.cur_op_pc);
-        }
-        win->dbg.step_mode = UI_DBG_STEPMODE_NONE;
-        if (!win->dbg.external_debugger_connected) {
-            ImGui::SetWindowFocus(win->ui.title);
-            win->ui.open = true;
-        }
+    dbg_tick(&win->dbg, pins);
+    if ((win->dbg.last_trap_id >= DBG_STEP_TRAPID) && !win->dbg.external_debugger_connected) {
+        ImGui::SetWindowFocus(win->ui.title);
+        win->ui.open = true;
     }
-    win->dbg.last_trap_id = trap_id;
 }
 
 void ui_dbg_draw(ui_dbg_t* win) {
     CHIPS_ASSERT(win && win->valid && win->ui.title);
-    win->dbg.frame_id++;
+    win->ui.frame_id++;
     if (!(win->ui.open || win->ui.heatmap.open || win->ui.breakpoints.open || win->ui.history.open || win->ui.stopwatch.open)) {
         return;
     }
@@ -2096,23 +1697,23 @@ void ui_dbg_external_debugger_disconnected(ui_dbg_t* win) {
     CHIPS_ASSERT(win && win->valid);
     win->dbg.external_debugger_connected = false;
     // delete all breakpoints and continue execution (in case of stopped)
-    _ui_dbg_bp_delete_all(win);
+    dbg_bp_delete_all(&win->dbg);
     _ui_dbg_continue(win, false);
 }
 
 void ui_dbg_add_breakpoint(ui_dbg_t* win, uint16_t addr) {
     CHIPS_ASSERT(win && win->valid && win->ui.title);
-    int index = _ui_dbg_bp_find(win, UI_DBG_BREAKTYPE_EXEC, addr);
+    int index = dbg_bp_find(&win->dbg, UI_DBG_BREAKTYPE_EXEC, addr);
     if (index < 0) {
-        _ui_dbg_bp_add_exec(win, true, addr);
+        dbg_bp_add_exec(&win->dbg, true, addr);
     }
 }
 
 void ui_dbg_remove_breakpoint(ui_dbg_t* win, uint16_t addr) {
     CHIPS_ASSERT(win && win->valid && win->ui.title);
-    int index = _ui_dbg_bp_find(win, UI_DBG_BREAKTYPE_EXEC, addr);
+    int index = dbg_bp_find(&win->dbg, UI_DBG_BREAKTYPE_EXEC, addr);
     if (index >= 0) {
-        _ui_dbg_bp_del(win, index);
+        dbg_bp_del(&win->dbg, index);
     }
 }
 
@@ -2182,7 +1783,8 @@ void ui_dbg_disassemble(ui_dbg_t* win, const ui_dbg_dasm_request_t* request) {
     // if the offset is > 0, skip disassembled instructions
     if (request->offset_lines > 0) {
         for (int i = 0; i < request->offset_lines; i++) {
-            fwd_addr = _ui_dbg_disasm(win, fwd_addr);
+            _ui_dbg_dasm_inst_t inst;
+            fwd_addr = _ui_dbg_disasm_decode(win, fwd_addr, &inst);
         }
     }
     for (; line_idx < request->num_lines; line_idx++) {
@@ -158,7 +158,8 @@ void ui_fdd_draw(ui_fdd_t* win) {
                                     fdd_sector_t* sec = &track->sectors[sector_index];
                                     ImGui::Text("  "); ImGui::SameLine();
                                     snprintf(buf, sizeof(buf), "Track %d / Sector %d", track_index, sector_index);
-                                    if (ImGui::CollapsingHeader(buf)) {
+                                    const uint8_t* data = fdd_sector_data(win->fdd, side, track_index, sector_index);
+                                    if (data && ImGui::CollapsingHeader(buf)) {
                                         ImGui::Text("C:%02X H:%02X R:%02X N:%02X ST1:%02X ST2:%02X",
                                             sec->info.upd765.c,
                                             sec->info.upd765.h,
@@ -171,7 +172,7 @@ void ui_fdd_draw(ui_fdd_t* win) {
                                             int j = 0;
                                             ImGui::Text("%04X:", i); ImGui::SameLine();
                                             for (; (j < bytes_per_line) && (i < sec->data_size); j++, i++) {
-                                                uint8_t val = win->fdd->data[i+sec->data_offset];
+                                                uint8_t val = data[i];
                                                 if (isalnum((int)val)) {
                                                     buf[j] = val;
                                                 }
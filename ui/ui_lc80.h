@@ -30,6 +30,7 @@
     - ui_z80ctc.h
     - ui_audio.h
     - ui_kbd.h
+    - dbg.h
     - ui_dbg.h
     - ui_dasm.h
     - ui_memedit.h
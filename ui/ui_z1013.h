@@ -28,6 +28,7 @@
     - ui_settings.h
     - ui_z80.h
     - ui_z80pio.h
+    - dbg.h
     - ui_dbg.h
     - ui_dasm.h
     - ui_memedit.h
@@ -138,7 +138,7 @@ static void _ui_z80ctc_channels(ui_z80ctc_t* win) {
         }
         ImGui::Text("Counter"); ImGui::TableNextColumn();
         for (int i = 0; i < 4; i++) {
-            ImGui::Text("%02X", ctc->chn[i].down_counter); ImGui::TableNextColumn();
+            ImGui::Text("%02X", z80ctc_down_counter(ctc, i)); ImGui::TableNextColumn();
         }
         ImGui::Text("INT Vec"); ImGui::TableNextColumn();
         for (int i = 0; i < 4; i++) {
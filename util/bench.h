@@ -0,0 +1,314 @@
+#pragma once
+/*#
+    # bench.h
+
+    Headless benchmark runner for the system emulators: runs a system for
+    a fixed number of emulated frames, measures the host time, and writes
+    the results (ticks per second, nanoseconds per frame, ...) as JSON for
+    tracking performance regressions.
+
+    Do this:
+    ~~~C
+    #define CHIPS_UTIL_IMPL
+    ~~~
+    before you include this file in *one* C or C++ file to create the
+    implementation.
+
+    Optionally provide the following macros with your own implementation
+
+    ~~~C
+    CHIPS_ASSERT(c)
+    ~~~
+        your own assert macro (default: assert(c))
+
+    You need to include the following headers before including bench.h:
+
+        - chips_common.h
+
+    The host time is measured with chips_perf_now_ns() from chips_common.h
+    (so the CHIPS_IMPL implementation must be linked), see chips_common.h
+    for the host timer requirements with a strict C standard.
+
+    ## Usage
+
+    Initialize the system emulator as usual (without audio callback and
+    debug hook, since those would be included in the measurement), and
+    wrap the system's exec function in a function with a void pointer:
+
+    ~~~C
+    static uint32_t exec_zx(void* sys, uint32_t micro_seconds) {
+        return zx_exec((zx_t*)sys, micro_seconds);
+    }
+
+    bench_result_t res = bench_run(&(bench_desc_t){
+        .name = "zx128",
+        .sys = &zx,
+        .exec = exec_zx,
+        .frame_us = 20000,
+        .num_frames = 500,
+    });
+    ~~~
+
+    The system is first run for a number of warmup frames (to fill caches
+    and let the emulated system boot, set warmup_frames to BENCH_NO_WARMUP
+    to start measuring immediately), then each frame is measured
+    individually. For repeatable results, the emulated system should run
+    a deterministic workload (e.g. the boot sequence of a stub ROM image,
+    or a test program loaded via the system's quickload function).
+
+    The results of multiple benchmarks are written as JSON with:
+
+    ~~~C
+    size_t bench_write_json(const bench_result_t* results, int num_results, char* buf, size_t buf_size)
+    ~~~
+
+    This works like snprintf(): the output is truncated to fit into buf and
+    always zero-terminated, and the return value is the length of the
+    complete output. The JSON output looks like this:
+
+    ~~~json
+    {"benchmarks":[
+      {"name":"zx128","frames":500,"frame_us":20000,"ticks":35469000,"host_ns":...,
+       "ticks_per_sec":...,"ns_per_frame":...,"min_ns_per_frame":...,
+       "max_ns_per_frame":...,"speed":...}
+    ]}
+    ~~~
+
+    "speed" is the emulated time divided by the host time (so 1.0 means
+    the emulator runs exactly in realtime).
+
+    When compiled with CHIPS_PERF_COUNTERS, pass the system's per-chip
+    performance counters in the bench_desc_t to also get the number of
+    calls and the estimated host time of each emulated chip during the
+    measured frames (the counters are reset after the warmup frames):
+
+    ~~~C
+    bench_result_t res = bench_run(&(bench_desc_t){
+        .name = "zx128",
+        .sys = &zx,
+        .exec = exec_zx,
+        .perf = zx_perf_counters(&zx),
+    });
+    ~~~
+
+    ...this adds a "chips" array to the benchmark's JSON object:
+
+    ~~~json
+    "chips":[{"name":"z80","calls":...,"estimated_ns":...},...]
+    ~~~
+
+    ## zlib/libpng license
+
+    Copyright (c) 2018 Andre Weissflog
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+#*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_DEFAULT_FRAME_US (16667)      // default emulated time per frame
+#define BENCH_DEFAULT_NUM_FRAMES (600)      // default number of measured frames
+#define BENCH_DEFAULT_WARMUP_FRAMES (60)    // default number of unmeasured warmup frames
+#define BENCH_NO_WARMUP (-1)                // use as warmup_frames to disable warmup
+
+// callback to run the system emulator, returns number of executed ticks
+typedef uint32_t (*bench_exec_t)(void* sys, uint32_t micro_seconds);
+
+// benchmark setup parameters
+typedef struct {
+    const char* name;           // benchmark name (must remain alive until results are written)
+    void* sys;                  // pointer to the system emulator instance
+    bench_exec_t exec;          // callback which calls the system's exec function
+    uint32_t frame_us;          // emulated time per frame in microseconds (default: 16667)
+    int num_frames;             // number of measured frames (default: 600)
+    int warmup_frames;          // number of frames before measurement starts (default: 60, BENCH_NO_WARMUP for none)
+    chips_perf_counters_t* perf;    // optional: the system's per-chip performance counters (see CHIPS_PERF_COUNTERS)
+} bench_desc_t;
+
+// benchmark results
+typedef struct {
+    const char* name;
+    int num_frames;
+    uint32_t frame_us;
+    uint64_t ticks;             // number of emulated ticks in measured frames
+    uint64_t host_ns;           // host time for measured frames in nanoseconds
+    uint64_t min_frame_ns;      // fastest frame in nanoseconds
+    uint64_t max_frame_ns;      // slowest frame in nanoseconds
+    double ticks_per_sec;       // emulated ticks per host second
+    double ns_per_frame;        // average host nanoseconds per frame
+    double speed;               // emulated time / host time
+    chips_perf_counters_t perf; // per-chip performance counters of measured frames (num_chips is 0 without desc.perf)
+} bench_result_t;
+
+// run a benchmark
+bench_result_t bench_run(const bench_desc_t* desc);
+// write benchmark results as JSON, returns length of complete output
+size_t bench_write_json(const bench_result_t* results, int num_results, char* buf, size_t buf_size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_UTIL_IMPL
+#include <string.h>
+#include <stdio.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+#define _BENCH_DEF(val, def) (((val) == 0) ? (def) : (val))
+
+bench_result_t bench_run(const bench_desc_t* desc) {
+    CHIPS_ASSERT(desc && desc->sys && desc->exec);
+    CHIPS_ASSERT((desc->num_frames >= 0) && (desc->warmup_frames >= BENCH_NO_WARMUP));
+    bench_result_t res;
+    memset(&res, 0, sizeof(res));
+    res.name = desc->name ? desc->name : "unnamed";
+    res.num_frames = _BENCH_DEF(desc->num_frames, BENCH_DEFAULT_NUM_FRAMES);
+    res.frame_us = _BENCH_DEF(desc->frame_us, BENCH_DEFAULT_FRAME_US);
+    const int warmup_frames = (desc->warmup_frames == BENCH_NO_WARMUP) ? 0 : _BENCH_DEF(desc->warmup_frames, BENCH_DEFAULT_WARMUP_FRAMES);
+
+    for (int i = 0; i < warmup_frames; i++) {
+        desc->exec(desc->sys, res.frame_us);
+    }
+    if (desc->perf) {
+        chips_perf_reset(desc->perf);
+    }
+    res.min_frame_ns = UINT64_MAX;
+    for (int i = 0; i < res.num_frames; i++) {
+        const uint64_t t0 = chips_perf_now_ns();
+        res.ticks += desc->exec(desc->sys, res.frame_us);
+        const uint64_t frame_ns = chips_perf_now_ns() - t0;
+        res.host_ns += frame_ns;
+        if (frame_ns < res.min_frame_ns) {
+            res.min_frame_ns = frame_ns;
+        }
+        if (frame_ns > res.max_frame_ns) {
+            res.max_frame_ns = frame_ns;
+        }
+    }
+    if (res.host_ns > 0) {
+        const double host_sec = (double)res.host_ns / 1.0e9;
+        const double emu_sec = ((double)res.frame_us * (double)res.num_frames) / 1.0e6;
+        res.ticks_per_sec = (double)res.ticks / host_sec;
+        res.ns_per_frame = (double)res.host_ns / (double)res.num_frames;
+        res.speed = emu_sec / host_sec;
+    }
+    if (desc->perf) {
+        res.perf = *desc->perf;
+    }
+    return res;
+}
+
+// helper to write into a truncating output buffer
+typedef struct {
+    char* buf;
+    size_t size;
+    size_t pos;
+} _bench_out_t;
+
+static void _bench_out_chr(_bench_out_t* out, char c) {
+    if ((out->pos + 1) < out->size) {
+        out->buf[out->pos] = c;
+    }
+    out->pos++;
+}
+
+static void _bench_out_str(_bench_out_t* out, const char* str) {
+    while (*str) {
+        _bench_out_chr(out, *str++);
+    }
+}
+
+// write a JSON string with escaping of quotes, backslashes and control characters
+static void _bench_out_json_str(_bench_out_t* out, const char* str) {
+    _bench_out_chr(out, '"');
+    for (; *str; str++) {
+        const char c = *str;
+        if ((c == '"') || (c == '\\')) {
+            _bench_out_chr(out, '\\');
+            _bench_out_chr(out, c);
+        }
+        else if ((unsigned char)c < 0x20) {
+            char tmp[8];
+            snprintf(tmp, sizeof(tmp), "\\u%04x", (unsigned char)c);
+            _bench_out_str(out, tmp);
+        }
+        else {
+            _bench_out_chr(out, c);
+        }
+    }
+    _bench_out_chr(out, '"');
+}
+
+static void _bench_out_u64(_bench_out_t* out, const char* key, uint64_t val) {
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), ",\"%s\":%llu", key, (unsigned long long)val);
+    _bench_out_str(out, tmp);
+}
+
+static void _bench_out_f64(_bench_out_t* out, const char* key, double val) {
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), ",\"%s\":%.3f", key, val);
+    _bench_out_str(out, tmp);
+}
+
+size_t bench_write_json(const bench_result_t* results, int num_results, char* buf, size_t buf_size) {
+    CHIPS_ASSERT(results || (num_results == 0));
+    CHIPS_ASSERT(buf || (buf_size == 0));
+    _bench_out_t out = { buf, buf_size, 0 };
+    _bench_out_str(&out, "{\"benchmarks\":[\n");
+    for (int i = 0; i < num_results; i++) {
+        const bench_result_t* res = &results[i];
+        _bench_out_str(&out, "  {\"name\":");
+        _bench_out_json_str(&out, res->name ? res->name : "unnamed");
+        _bench_out_u64(&out, "frames", (uint64_t)res->num_frames);
+        _bench_out_u64(&out, "frame_us", res->frame_us);
+        _bench_out_u64(&out, "ticks", res->ticks);
+        _bench_out_u64(&out, "host_ns", res->host_ns);
+        _bench_out_f64(&out, "ticks_per_sec", res->ticks_per_sec);
+        _bench_out_f64(&out, "ns_per_frame", res->ns_per_frame);
+        _bench_out_u64(&out, "min_ns_per_frame", (res->num_frames > 0) ? res->min_frame_ns : 0);
+        _bench_out_u64(&out, "max_ns_per_frame", res->max_frame_ns);
+        _bench_out_f64(&out, "speed", res->speed);
+        if (res->perf.num_chips > 0) {
+            _bench_out_str(&out, ",\"chips\":[");
+            for (int chip_index = 0; chip_index < res->perf.num_chips; chip_index++) {
+                const chips_perf_chip_t* chip = &res->perf.chips[chip_index];
+                _bench_out_str(&out, (chip_index > 0) ? ",{\"name\":" : "{\"name\":");
+                _bench_out_json_str(&out, chip->name ? chip->name : "unnamed");
+                _bench_out_u64(&out, "calls", chip->calls);
+                _bench_out_u64(&out, "estimated_ns", chips_perf_estimated_ns(chip));
+                _bench_out_chr(&out, '}');
+            }
+            _bench_out_chr(&out, ']');
+        }
+        _bench_out_str(&out, (i < (num_results - 1)) ? "},\n" : "}\n");
+    }
+    _bench_out_str(&out, "]}\n");
+    if (buf_size > 0) {
+        buf[(out.pos < buf_size) ? out.pos : (buf_size - 1)] = 0;
+    }
+    return out.pos;
+}
+
+#endif // CHIPS_UTIL_IMPL
@@ -20,7 +20,7 @@
 
     ## Usage
 
-    There's only one function to call which consumes a stream of instruction bytes
+    The original callback-driven function consumes a stream of instruction bytes
     and produces a stream of ASCII characters for exactly one instruction:
 
     ~~~C
@@ -43,6 +43,43 @@
 
     Undocumented instructions are supported and are marked with a '*'.
 
+    ## Buffer-based API
+
+    When disassembling many instructions (for instance a debugger listing,
+    or a backward scan which only needs instruction lengths), it is
+    much faster to decode directly from a byte buffer into a
+    m6502dasm_inst_t struct, and only build the text when needed:
+
+    ~~~C
+    int m6502dasm_decode(uint16_t pc, const uint8_t* ptr, size_t num_bytes, m6502dasm_inst_t* out_inst)
+    ~~~
+
+    Decodes one instruction from the bytes at ptr (which is located at
+    address pc), and returns the instruction length in bytes, or 0 if
+    num_bytes is too short to hold the complete instruction (at most
+    M6502DASM_MAX_BYTES bytes are needed). The decoded instruction contains
+    the mnemonic id (M6502DASM_MN_*), the operands, a control-flow
+    class (M6502DASM_FLOW_*) and the absolute target address for
+    direct jumps and calls.
+
+    ~~~C
+    int m6502dasm_format(const m6502dasm_inst_t* inst, char* buf, int buf_size)
+    ~~~
+
+    Writes the zero-terminated text of a decoded instruction into buf, and
+    returns the number of characters written (not including the terminating
+    zero). The output is identical with the output of m6502dasm_op(). The text
+    is truncated if buf_size is smaller than M6502DASM_MAX_CHARS.
+
+    ~~~C
+    size_t m6502dasm_range(const m6502dasm_range_t* range)
+    ~~~
+
+    Decodes (and optionally formats) up to range->max_insts instructions
+    from a byte buffer in one go, stops at the first instruction
+    which doesn't completely fit into the buffer, and returns the
+    number of decoded instructions.
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -63,18 +100,104 @@
 #*/
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define M6502DASM_MAX_BYTES (3)     /* max length of an instruction */
+#define M6502DASM_MAX_CHARS (16)    /* max length of a formatted instruction, including terminating zero */
+
+/* mnemonics */
+enum {
+    M6502DASM_MN_ADC, M6502DASM_MN_AND, M6502DASM_MN_ASL, M6502DASM_MN_BCC, M6502DASM_MN_BCS, M6502DASM_MN_BEQ,
+    M6502DASM_MN_BIT, M6502DASM_MN_BMI, M6502DASM_MN_BNE, M6502DASM_MN_BPL, M6502DASM_MN_BRK, M6502DASM_MN_BVC,
+    M6502DASM_MN_BVS, M6502DASM_MN_CLC, M6502DASM_MN_CLD, M6502DASM_MN_CLI, M6502DASM_MN_CLV, M6502DASM_MN_CMP,
+    M6502DASM_MN_CPX, M6502DASM_MN_CPY, M6502DASM_MN_DEC, M6502DASM_MN_DEX, M6502DASM_MN_DEY, M6502DASM_MN_EOR,
+    M6502DASM_MN_INC, M6502DASM_MN_INX, M6502DASM_MN_INY, M6502DASM_MN_JMP, M6502DASM_MN_JSR, M6502DASM_MN_LDA,
+    M6502DASM_MN_LDX, M6502DASM_MN_LDY, M6502DASM_MN_LSR, M6502DASM_MN_NOP, M6502DASM_MN_ORA, M6502DASM_MN_PHA,
+    M6502DASM_MN_PHP, M6502DASM_MN_PLA, M6502DASM_MN_PLP, M6502DASM_MN_ROL, M6502DASM_MN_ROR, M6502DASM_MN_RTI,
+    M6502DASM_MN_RTS, M6502DASM_MN_SBC, M6502DASM_MN_SEC, M6502DASM_MN_SED, M6502DASM_MN_SEI, M6502DASM_MN_STA,
+    M6502DASM_MN_STX, M6502DASM_MN_STY, M6502DASM_MN_TAX, M6502DASM_MN_TAY, M6502DASM_MN_TSX, M6502DASM_MN_TXA,
+    M6502DASM_MN_TXS, M6502DASM_MN_TYA,
+    /* undocumented instructions */
+    M6502DASM_MN_SLO, M6502DASM_MN_RLA, M6502DASM_MN_SRE, M6502DASM_MN_RRA, M6502DASM_MN_SAX, M6502DASM_MN_LAX,
+    M6502DASM_MN_DCP, M6502DASM_MN_ISB,
+    M6502DASM_MN_NUM,
+};
+
+/* addressing modes */
+enum {
+    M6502DASM_MODE_IMP,     /* implied or accumulator, no operand */
+    M6502DASM_MODE_IMM,     /* #$XX */
+    M6502DASM_MODE_ZP,      /* $XX */
+    M6502DASM_MODE_ZPX,     /* $XX,X */
+    M6502DASM_MODE_ZPY,     /* $XX,Y */
+    M6502DASM_MODE_ABS,     /* $XXXX */
+    M6502DASM_MODE_ABX,     /* $XXXX,X */
+    M6502DASM_MODE_ABY,     /* $XXXX,Y */
+    M6502DASM_MODE_IDX,     /* ($XX,X) */
+    M6502DASM_MODE_IDY,     /* ($XX),Y */
+    M6502DASM_MODE_IND,     /* ($XXXX), only JMP */
+    M6502DASM_MODE_REL,     /* relative branch, the operand is the absolute target address */
+    M6502DASM_MODE_INV,     /* unsupported undocumented instruction, decoded as single byte without operand */
+};
+
+/* control-flow classes */
+enum {
+    M6502DASM_FLOW_NONE,        /* not a control-flow instruction */
+    M6502DASM_FLOW_JUMP,        /* unconditional jump: JMP abs */
+    M6502DASM_FLOW_JUMP_COND,   /* conditional branch: BPL, BMI, BVC, BVS, BCC, BCS, BNE, BEQ */
+    M6502DASM_FLOW_JUMP_IND,    /* indirect jump without known target: JMP (abs) */
+    M6502DASM_FLOW_CALL,        /* subroutine call: JSR */
+    M6502DASM_FLOW_RET,         /* return: RTS, RTI */
+    M6502DASM_FLOW_BRK,         /* software interrupt: BRK */
+};
+
 /* the input callback type */
 typedef uint8_t (*m6502dasm_input_t)(void* user_data);
 /* the output callback type */
 typedef void (*m6502dasm_output_t)(char c, void* user_data);
 
+/* a decoded instruction */
+typedef struct {
+    uint16_t addr;          /* address of the first instruction byte */
+    uint16_t operand;       /* 8- or 16-bit operand value, or branch target address */
+    uint16_t target;        /* target address (only valid for JUMP, JUMP_COND and CALL flow) */
+    uint8_t len;            /* instruction length in bytes */
+    uint8_t opcode;         /* the opcode byte */
+    uint8_t mnemonic;       /* M6502DASM_MN_* */
+    uint8_t mode;           /* M6502DASM_MODE_* */
+    uint8_t flow;           /* M6502DASM_FLOW_* */
+    bool undoc;             /* true if this is an undocumented instruction */
+} m6502dasm_inst_t;
+
+/* text output item for m6502dasm_range() */
+typedef struct {
+    char chars[M6502DASM_MAX_CHARS];
+} m6502dasm_text_t;
+
+/* parameters for m6502dasm_range() */
+typedef struct {
+    uint16_t pc;                    /* address of the first byte at ptr */
+    const uint8_t* ptr;             /* pointer to instruction bytes */
+    size_t num_bytes;               /* number of bytes at ptr */
+    m6502dasm_inst_t* out_insts;    /* decoded instructions, must have room for max_insts items */
+    m6502dasm_text_t* out_text;     /* optional formatted instructions, must have room for max_insts items */
+    size_t max_insts;               /* max number of instructions to decode */
+} m6502dasm_range_t;
+
 /* disassemble a single 6502 instruction into a stream of ASCII characters */
 uint16_t m6502dasm_op(uint16_t pc, m6502dasm_input_t in_cb, m6502dasm_output_t out_cb, void* user_data);
+/* decode a single instruction from a byte buffer, returns instruction length, or 0 if the buffer is too short */
+int m6502dasm_decode(uint16_t pc, const uint8_t* ptr, size_t num_bytes, m6502dasm_inst_t* out_inst);
+/* format a decoded instruction into a zero-terminated string, returns string length */
+int m6502dasm_format(const m6502dasm_inst_t* inst, char* buf, int buf_size);
+/* decode (and optionally format) consecutive instructions, returns number of decoded instructions */
+size_t m6502dasm_range(const m6502dasm_range_t* range);
+/* return the name of a mnemonic (without the '*' marker for undocumented instructions) */
+const char* m6502dasm_mnemonic_name(int mnemonic);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -458,6 +581,207 @@ uint16_t m6502dasm_op(uint16_t pc, m6502dasm_input_t in_cb, m6502dasm_output_t o
     return pc;
 }
 
+/*-- buffer-based decoder ----------------------------------------------------*/
+
+/* an instruction description in the opcode table */
+typedef struct {
+    uint8_t mn;
+    uint8_t mode;
+    uint8_t undoc;
+} _m6502dasm_desc_t;
+
+#define _MI(mn,mode) { M6502DASM_MN_##mn, M6502DASM_MODE_##mode, 0 }
+#define _MU(mn,mode) { M6502DASM_MN_##mn, M6502DASM_MODE_##mode, 1 }
+
+/* opcode table, same decoding as m6502dasm_op() */
+static const _m6502dasm_desc_t _m6502dasm_desc[256] = {
+    /* 00 */ _MI(BRK,IMP),  _MI(ORA,IDX),  _MI(ASL,INV),  _MU(SLO,IDX),  _MU(NOP,ZP),   _MI(ORA,ZP),   _MI(ASL,ZP),   _MU(SLO,ZP),
+    /* 08 */ _MI(PHP,IMP),  _MI(ORA,IMM),  _MI(ASL,IMP),  _MU(SLO,INV),  _MU(NOP,ABS),  _MI(ORA,ABS),  _MI(ASL,ABS),  _MU(SLO,ABS),
+    /* 10 */ _MI(BPL,REL),  _MI(ORA,IDY),  _MI(ASL,INV),  _MU(SLO,IDY),  _MU(NOP,ZPX),  _MI(ORA,ZPX),  _MI(ASL,ZPX),  _MU(SLO,ZPX),
+    /* 18 */ _MI(CLC,IMP),  _MI(ORA,ABY),  _MU(NOP,IMP),  _MU(SLO,ABY),  _MU(NOP,ABX),  _MI(ORA,ABX),  _MI(ASL,ABX),  _MU(SLO,ABX),
+    /* 20 */ _MI(JSR,ABS),  _MI(AND,IDX),  _MI(ROL,INV),  _MU(RLA,IDX),  _MI(BIT,ZP),   _MI(AND,ZP),   _MI(ROL,ZP),   _MU(RLA,ZP),
+    /* 28 */ _MI(PLP,IMP),  _MI(AND,IMM),  _MI(ROL,IMP),  _MU(RLA,INV),  _MI(BIT,ABS),  _MI(AND,ABS),  _MI(ROL,ABS),  _MU(RLA,ABS),
+    /* 30 */ _MI(BMI,REL),  _MI(AND,IDY),  _MI(ROL,INV),  _MU(RLA,IDY),  _MU(NOP,ZPX),  _MI(AND,ZPX),  _MI(ROL,ZPX),  _MU(RLA,ZPX),
+    /* 38 */ _MI(SEC,IMP),  _MI(AND,ABY),  _MU(NOP,IMP),  _MU(RLA,ABY),  _MU(NOP,ABX),  _MI(AND,ABX),  _MI(ROL,ABX),  _MU(RLA,ABX),
+    /* 40 */ _MI(RTI,IMP),  _MI(EOR,IDX),  _MI(LSR,INV),  _MU(SRE,IDX),  _MU(NOP,ZP),   _MI(EOR,ZP),   _MI(LSR,ZP),   _MU(SRE,ZP),
+    /* 48 */ _MI(PHA,IMP),  _MI(EOR,IMM),  _MI(LSR,IMP),  _MU(SRE,INV),  _MI(JMP,ABS),  _MI(EOR,ABS),  _MI(LSR,ABS),  _MU(SRE,ABS),
+    /* 50 */ _MI(BVC,REL),  _MI(EOR,IDY),  _MI(LSR,INV),  _MU(SRE,IDY),  _MU(NOP,ZPX),  _MI(EOR,ZPX),  _MI(LSR,ZPX),  _MU(SRE,ZPX),
+    /* 58 */ _MI(CLI,IMP),  _MI(EOR,ABY),  _MU(NOP,IMP),  _MU(SRE,ABY),  _MU(NOP,ABS),  _MI(EOR,ABX),  _MI(LSR,ABX),  _MU(SRE,ABX),
+    /* 60 */ _MI(RTS,IMP),  _MI(ADC,IDX),  _MI(ROR,INV),  _MU(RRA,IDX),  _MU(NOP,ZP),   _MI(ADC,ZP),   _MI(ROR,ZP),   _MU(RRA,ZP),
+    /* 68 */ _MI(PLA,IMP),  _MI(ADC,IMM),  _MI(ROR,IMP),  _MU(RRA,INV),  _MI(JMP,IND),  _MI(ADC,ABS),  _MI(ROR,ABS),  _MU(RRA,ABS),
+    /* 70 */ _MI(BVS,REL),  _MI(ADC,IDY),  _MI(ROR,INV),  _MU(RRA,IDY),  _MU(NOP,ZPX),  _MI(ADC,ZPX),  _MI(ROR,ZPX),  _MU(RRA,ZPX),
+    /* 78 */ _MI(SEI,IMP),  _MI(ADC,ABY),  _MU(NOP,IMP),  _MU(RRA,ABY),  _MU(NOP,ABS),  _MI(ADC,ABX),  _MI(ROR,ABX),  _MU(RRA,ABX),
+    /* 80 */ _MU(NOP,IMM),  _MI(STA,IDX),  _MU(NOP,IMM),  _MU(SAX,IDX),  _MI(STY,ZP),   _MI(STA,ZP),   _MI(STX,ZP),   _MU(SAX,ZP),
+    /* 88 */ _MI(DEY,IMP),  _MU(NOP,IMM),  _MI(TXA,IMP),  _MU(SAX,INV),  _MI(STY,ABS),  _MI(STA,ABS),  _MI(STX,ABS),  _MU(SAX,ABS),
+    /* 90 */ _MI(BCC,REL),  _MI(STA,IDY),  _MI(STX,INV),  _MU(SAX,INV),  _MI(STY,ZPX),  _MI(STA,ZPX),  _MI(STX,ZPY),  _MU(SAX,ZPY),
+    /* 98 */ _MI(TYA,IMP),  _MI(STA,ABY),  _MI(TXS,IMP),  _MU(SAX,INV),  _MI(STY,INV),  _MI(STA,ABX),  _MI(STX,INV),  _MU(SAX,INV),
+    /* A0 */ _MI(LDY,IMM),  _MI(LDA,IDX),  _MI(LDX,IMM),  _MU(LAX,IDX),  _MI(LDY,ZP),   _MI(LDA,ZP),   _MI(LDX,ZP),   _MU(LAX,ZP),
+    /* A8 */ _MI(TAY,IMP),  _MI(LDA,IMM),  _MI(TAX,IMP),  _MU(LAX,INV),  _MI(LDY,ABS),  _MI(LDA,ABS),  _MI(LDX,ABS),  _MU(LAX,ABS),
+    /* B0 */ _MI(BCS,REL),  _MI(LDA,IDY),  _MI(LDX,INV),  _MU(LAX,IDY),  _MI(LDY,ZPX),  _MI(LDA,ZPX),  _MI(LDX,ZPY),  _MU(LAX,ZPY),
+    /* B8 */ _MI(CLV,IMP),  _MI(LDA,ABY),  _MI(TSX,IMP),  _MU(LAX,INV),  _MI(LDY,ABX),  _MI(LDA,ABX),  _MI(LDX,ABY),  _MU(LAX,ABY),
+    /* C0 */ _MI(CPY,IMM),  _MI(CMP,IDX),  _MU(NOP,IMM),  _MU(DCP,IDX),  _MI(CPY,ZP),   _MI(CMP,ZP),   _MI(DEC,ZP),   _MU(DCP,ZP),
+    /* C8 */ _MI(INY,IMP),  _MI(CMP,IMM),  _MI(DEX,IMP),  _MU(DCP,INV),  _MI(CPY,ABS),  _MI(CMP,ABS),  _MI(DEC,ABS),  _MU(DCP,ABS),
+    /* D0 */ _MI(BNE,REL),  _MI(CMP,IDY),  _MI(DEC,INV),  _MU(DCP,IDY),  _MU(NOP,ZPX),  _MI(CMP,ZPX),  _MI(DEC,ZPX),  _MU(DCP,ZPX),
+    /* D8 */ _MI(CLD,IMP),  _MI(CMP,ABY),  _MU(NOP,IMP),  _MU(DCP,ABY),  _MU(NOP,ABX),  _MI(CMP,ABX),  _MI(DEC,ABX),  _MU(DCP,ABX),
+    /* E0 */ _MI(CPX,IMM),  _MI(SBC,IDX),  _MU(NOP,IMM),  _MU(ISB,IDX),  _MI(CPX,ZP),   _MI(SBC,ZP),   _MI(INC,ZP),   _MU(ISB,ZP),
+    /* E8 */ _MI(INX,IMP),  _MI(SBC,IMM),  _MI(NOP,IMP),  _MU(SBC,IMM),  _MI(CPX,ABS),  _MI(SBC,ABS),  _MI(INC,ABS),  _MU(ISB,ABS),
+    /* F0 */ _MI(BEQ,REL),  _MI(SBC,IDY),  _MI(INC,INV),  _MU(ISB,IDY),  _MU(NOP,ZPX),  _MI(SBC,ZPX),  _MI(INC,ZPX),  _MU(ISB,ZPX),
+    /* F8 */ _MI(SED,IMP),  _MI(SBC,ABY),  _MU(NOP,IMP),  _MU(ISB,ABY),  _MU(NOP,ABX),  _MI(SBC,ABX),  _MI(INC,ABX),  _MU(ISB,ABX),
+};
+
+/* instruction length by addressing mode */
+static const uint8_t _m6502dasm_mode_len[13] = { 1, 2, 2, 2, 2, 3, 3, 3, 2, 2, 3, 2, 1 };
+
+static const char* _m6502dasm_mn_names[M6502DASM_MN_NUM] = {
+    "ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI", "BNE", "BPL", "BRK", "BVC", "BVS", "CLC",
+    "CLD", "CLI", "CLV", "CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR", "INC", "INX", "INY", "JMP",
+    "JSR", "LDA", "LDX", "LDY", "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL", "ROR", "RTI",
+    "RTS", "SBC", "SEC", "SED", "SEI", "STA", "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA",
+    "SLO", "RLA", "SRE", "RRA", "SAX", "LAX", "DCP", "ISB",
+};
+
+int m6502dasm_decode(uint16_t pc, const uint8_t* ptr, size_t num_bytes, m6502dasm_inst_t* inst) {
+    CHIPS_ASSERT(ptr && inst);
+    if (num_bytes == 0) {
+        return 0;
+    }
+    const uint8_t op = ptr[0];
+    const _m6502dasm_desc_t* desc = &_m6502dasm_desc[op];
+    const uint8_t len = _m6502dasm_mode_len[desc->mode];
+    if (num_bytes < len) {
+        return 0;
+    }
+    inst->addr = pc;
+    inst->len = len;
+    inst->opcode = op;
+    inst->mnemonic = desc->mn;
+    inst->mode = desc->mode;
+    inst->undoc = desc->undoc != 0;
+    inst->flow = M6502DASM_FLOW_NONE;
+    inst->target = 0;
+    switch (len) {
+        case 2: inst->operand = ptr[1]; break;
+        case 3: inst->operand = (uint16_t)((ptr[2]<<8) | ptr[1]); break;
+        default: inst->operand = 0; break;
+    }
+    if (desc->mode == M6502DASM_MODE_REL) {
+        /* relative branch, compute target address */
+        inst->operand = (uint16_t)(pc + 2 + (int8_t)ptr[1]);
+        inst->target = inst->operand;
+        inst->flow = M6502DASM_FLOW_JUMP_COND;
+    }
+    else {
+        switch (op) {
+            case 0x00: inst->flow = M6502DASM_FLOW_BRK; break;
+            case 0x20: inst->flow = M6502DASM_FLOW_CALL; inst->target = inst->operand; break;
+            case 0x4C: inst->flow = M6502DASM_FLOW_JUMP; inst->target = inst->operand; break;
+            case 0x6C: inst->flow = M6502DASM_FLOW_JUMP_IND; break;
+            case 0x40: case 0x60: inst->flow = M6502DASM_FLOW_RET; break;
+            default: break;
+        }
+    }
+    return len;
+}
+
+/* output buffer for m6502dasm_format() */
+typedef struct {
+    char* buf;
+    int size;
+    int pos;
+} _m6502dasm_buf_t;
+
+static void _m6502dasm_buf_chr(_m6502dasm_buf_t* b, char c) {
+    if ((b->pos + 1) < b->size) {
+        b->buf[b->pos++] = c;
+    }
+}
+
+static void _m6502dasm_buf_str(_m6502dasm_buf_t* b, const char* str) {
+    char c;
+    while (0 != (c = *str++)) {
+        _m6502dasm_buf_chr(b, c);
+    }
+}
+
+static void _m6502dasm_buf_hex(_m6502dasm_buf_t* b, uint16_t val, int num_digits) {
+    _m6502dasm_buf_chr(b, '$');
+    for (int i = num_digits - 1; i >= 0; i--) {
+        _m6502dasm_buf_chr(b, _m6502dasm_hex[(val>>(i*4)) & 0xF]);
+    }
+}
+
+int m6502dasm_format(const m6502dasm_inst_t* inst, char* buf, int buf_size) {
+    CHIPS_ASSERT(inst && buf && (buf_size > 0));
+    CHIPS_ASSERT(inst->mnemonic < M6502DASM_MN_NUM);
+    _m6502dasm_buf_t b = { buf, buf_size, 0 };
+    if (inst->undoc) {
+        _m6502dasm_buf_chr(&b, '*');
+    }
+    _m6502dasm_buf_str(&b, _m6502dasm_mn_names[inst->mnemonic]);
+    switch (inst->mode) {
+        case M6502DASM_MODE_IMM:
+            _m6502dasm_buf_str(&b, " #"); _m6502dasm_buf_hex(&b, inst->operand, 2);
+            break;
+        case M6502DASM_MODE_ZP:
+            _m6502dasm_buf_chr(&b, ' '); _m6502dasm_buf_hex(&b, inst->operand, 2);
+            break;
+        case M6502DASM_MODE_ZPX:
+            _m6502dasm_buf_chr(&b, ' '); _m6502dasm_buf_hex(&b, inst->operand, 2); _m6502dasm_buf_str(&b, ",X");
+            break;
+        case M6502DASM_MODE_ZPY:
+            _m6502dasm_buf_chr(&b, ' '); _m6502dasm_buf_hex(&b, inst->operand, 2); _m6502dasm_buf_str(&b, ",Y");
+            break;
+        case M6502DASM_MODE_ABS:
+        case M6502DASM_MODE_REL:
+            _m6502dasm_buf_chr(&b, ' '); _m6502dasm_buf_hex(&b, inst->operand, 4);
+            break;
+        case M6502DASM_MODE_ABX:
+            _m6502dasm_buf_chr(&b, ' '); _m6502dasm_buf_hex(&b, inst->operand, 4); _m6502dasm_buf_str(&b, ",X");
+            break;
+        case M6502DASM_MODE_ABY:
+            _m6502dasm_buf_chr(&b, ' '); _m6502dasm_buf_hex(&b, inst->operand, 4); _m6502dasm_buf_str(&b, ",Y");
+            break;
+        case M6502DASM_MODE_IDX:
+            _m6502dasm_buf_str(&b, " ("); _m6502dasm_buf_hex(&b, inst->operand, 2); _m6502dasm_buf_str(&b, ",X)");
+            break;
+        case M6502DASM_MODE_IDY:
+            _m6502dasm_buf_str(&b, " ("); _m6502dasm_buf_hex(&b, inst->operand, 2); _m6502dasm_buf_str(&b, "),Y");
+            break;
+        case M6502DASM_MODE_IND:
+            _m6502dasm_buf_str(&b, " ("); _m6502dasm_buf_hex(&b, inst->operand, 4); _m6502dasm_buf_chr(&b, ')');
+            break;
+        default:
+            break;
+    }
+    buf[b.pos] = 0;
+    return b.pos;
+}
+
+size_t m6502dasm_range(const m6502dasm_range_t* range) {
+    CHIPS_ASSERT(range && range->ptr && range->out_insts);
+    uint16_t pc = range->pc;
+    size_t pos = 0;
+    size_t i = 0;
+    for (; i < range->max_insts; i++) {
+        m6502dasm_inst_t* inst = &range->out_insts[i];
+        const int len = m6502dasm_decode(pc, range->ptr + pos, range->num_bytes - pos, inst);
+        if (len == 0) {
+            break;
+        }
+        if (range->out_text) {
+            m6502dasm_format(inst, range->out_text[i].chars, M6502DASM_MAX_CHARS);
+        }
+        pos += len;
+        pc += len;
+    }
+    return i;
+}
+
+const char* m6502dasm_mnemonic_name(int mnemonic) {
+    CHIPS_ASSERT((mnemonic >= 0) && (mnemonic < M6502DASM_MN_NUM));
+    return _m6502dasm_mn_names[mnemonic];
+}
+
 #undef _FETCH_I8
 #undef _FETCH_U8
 #undef _FETCH_U16
@@ -478,6 +802,9 @@ uint16_t m6502dasm_op(uint16_t pc, m6502dasm_input_t in_cb, m6502dasm_output_t o
 #undef A_JMP
 #undef A_JSR
 #undef A_INV
+#undef A_BRA
+#undef _MI
+#undef _MU
 #undef M___
 #undef M_R_
 #undef M__W
@@ -0,0 +1,501 @@
+#pragma once
+/*#
+    # movie.h
+
+    Deterministic input recording and replay for the system emulators:
+    records the input events of a system together with the emulated tick
+    count at which they happened into a compact binary 'movie', and
+    replays a movie tick-exactly at maximum speed.
+
+    Do this:
+    ~~~C
+    #define CHIPS_UTIL_IMPL
+    ~~~
+    before you include this file in *one* C or C++ file to create the
+    implementation.
+
+    Optionally provide the following macros with your own implementation
+
+    ~~~C
+    CHIPS_ASSERT(c)
+    ~~~
+        your own assert macro (default: assert(c))
+
+    You need to include the following headers before including movie.h:
+
+        - chips_common.h
+
+    ## How it works
+
+    The system emulators report all input events (key presses, joystick
+    and arcade input bits) through the optional chips_input_callback_t in
+    their desc struct. Additionally, each exec function reports the number
+    of ticks it has executed (CHIPS_INPUT_EXEC). The recorder accumulates
+    the executed ticks to stamp each input event with the emulated tick
+    count, and records the exec events, so that a replay can run the
+    system in the exact same chunks as the recording. This is important
+    because some state (for instance the sticky-key timing in kbd.h) is
+    updated once per exec call.
+
+    To replay a movie, the exec events are replayed with the system's
+    *_exec_ticks() function, and the input events are injected between
+    them, so that each input event happens at the exact same tick as
+    during recording, no matter how long a host frame took.
+
+    A movie only contains the input events, so the replay must start from
+    the same system state as the recording, for instance by recording
+    right after initializing the system with the same ROMs and desc
+    parameters, or by saving a snapshot when the recording starts.
+    Other operations like loading files or inserting tapes and discs are
+    not recorded.
+
+    ## Recording a movie
+
+    Initialize a movie_t with a memory buffer, and an identifier for the
+    recorded system (for instance the system's snapshot version):
+
+    ~~~C
+    static uint8_t movie_buf[1024 * 1024];
+
+    movie_init(&movie, &(movie_desc_t){
+        .system_id = ZX_SNAPSHOT_VERSION,
+        .buffer = { .ptr = movie_buf, .size = sizeof(movie_buf) },
+    });
+    ~~~
+
+    ...and hook the recorder into the system emulator:
+
+    ~~~C
+    zx_init(&sys, &(zx_desc_t){
+        ...
+        .input = movie_input_callback(&movie),
+    });
+    ~~~
+
+    The movie_t struct must stay at a fixed memory location while it's
+    hooked into the system emulator.
+
+    What happens when the buffer is full depends on the 'write' callback:
+
+    - with a write callback (streaming mode), the buffer content is passed
+      to the callback (for instance to write it to a file), and the buffer
+      is reused. Call movie_flush() to also write the remaining data (e.g.
+      when recording stops). This allows recordings of any length.
+    - without a write callback, recording stops when the buffer is full
+      and movie_t.overflow is set. The recorded movie is in the first
+      movie_t.pos bytes of the buffer (see movie_data()).
+
+    ## Replaying a movie
+
+    Initialize a movie reader on a memory range with the complete movie
+    (e.g. a loaded movie file), check that the movie matches the system,
+    and call movie_replay() with a callback which forwards the events to
+    the system's *_input_event() function:
+
+    ~~~C
+    static void replay_input(void* sys, const chips_input_event_t* event) {
+        zx_input_event((zx_t*)sys, event);
+    }
+
+    movie_reader_t reader;
+    if (movie_reader_init(&reader, (chips_range_t){ .ptr = data, .size = size })
+        && (reader.system_id == ZX_SNAPSHOT_VERSION))
+    {
+        movie_replay(&reader, &(movie_replay_desc_t){
+            .sys = &sys,
+            .input = replay_input,
+            .frame = check_frame,   // optional, e.g. to compare framebuffer hashes
+        });
+    }
+    ~~~
+
+    movie_replay() replays the entire movie, or only the next num_frames
+    exec calls (for instance to replay in lockstep with a second emulator
+    instance). The decoded events can also be iterated directly with
+    movie_reader_next().
+
+    To check that a replay reproduced the recorded session, compare the
+    result of the system's *_state_hash() and *_frame_hash() functions
+    after the recording with the result after the replay.
+
+    Note that on the Bomb Jack emulator, the sound board may be at a
+    different position at the end of an exec call when the recording
+    used bombjack_exec_samples() (the main board state and the generated
+    audio are identical).
+
+    ## Movie format
+
+    All numbers are little-endian. A movie starts with a 16-byte header:
+
+    ~~~
+    0:  magic 'CMOV'
+    4:  format version (MOVIE_VERSION)
+    5:  reserved (3 bytes, zero)
+    8:  system id (uint32_t)
+    12: reserved (uint32_t, zero)
+    ~~~
+
+    The header is followed by a sequence of variable-length records, each
+    record starts with a tag byte, where the lower 4 bits are the event
+    type (CHIPS_INPUT_*):
+
+    - exec records (CHIPS_INPUT_EXEC): the number of ticks is delta-encoded
+      to the previous exec record (zigzag-encoded). If the delta fits, it's
+      stored in the upper 4 bits of the tag byte (0..14), otherwise the
+      upper 4 bits are 15 and the delta follows as LEB128 number. Since
+      the number of ticks per exec call usually only changes by a tick
+      or two, exec records are mostly a single byte.
+    - exec records with flags (CHIPS_INPUT_EXEC with a non-zero 'b', for
+      instance CHIPS_INPUT_EXEC_WARP): the lower 4 bits of the tag byte
+      are 15, the tick delta is encoded like in a plain exec record, and
+      the flags follow as LEB128 number (since format version 2).
+    - all other records: tag bit 4 is set if the event's second value ('b')
+      is not zero, the first value ('a') follows as LEB128 number, and the
+      second value as LEB128 number if tag bit 4 is set.
+
+    The tick stamps of the events are not stored, since the readers can
+    reconstruct them from the exec records. With one exec call per 50Hz
+    frame, an hour of recording is typically around 200 KBytes.
+
+    ## zlib/libpng license
+
+    Copyright (c) 2018 Andre Weissflog
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+#*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOVIE_VERSION (2)
+#define MOVIE_HEADER_SIZE (16)
+#define MOVIE_MAX_RECORD_SIZE (16)
+#define MOVIE_MIN_BUFFER_SIZE (256)
+
+// callback to write a block of movie data
+typedef void (*movie_write_t)(const uint8_t* ptr, size_t num_bytes, void* user_data);
+
+// a decoded movie event
+typedef struct {
+    uint64_t tick;              // emulated tick count since recording started
+    chips_input_event_t input;  // the input event
+} movie_event_t;
+
+// movie recorder setup parameters
+typedef struct {
+    uint32_t system_id;         // identifies the recorded system (e.g. the system's snapshot version)
+    chips_range_t buffer;       // memory for the recorded movie (at least MOVIE_MIN_BUFFER_SIZE)
+    struct {
+        movie_write_t func;     // optional, called when the buffer is full (streaming mode)
+        void* user_data;
+    } write;
+} movie_desc_t;
+
+// movie recorder state
+typedef struct {
+    bool valid;
+    bool overflow;              // true if recording has stopped because the buffer was full
+    uint32_t system_id;
+    struct {
+        movie_write_t func;
+        void* user_data;
+    } write;
+    uint8_t* buf;
+    size_t size;
+    size_t pos;                 // write position in buf
+    uint64_t tick;              // emulated ticks since recording started
+    uint64_t num_events;        // number of recorded events
+    uint32_t exec_ticks;        // number of ticks of the last exec event
+} movie_t;
+
+// movie replay parameters
+typedef struct {
+    void* sys;                  // pointer to the system emulator instance
+    // forward an input event to the system's *_input_event() function
+    void (*input)(void* sys, const chips_input_event_t* event);
+    // optional, called after each replayed exec event with the current tick
+    void (*frame)(void* sys, uint64_t tick, void* user_data);
+    void* user_data;            // user data for the frame callback
+    int num_frames;             // replay this many exec events (default: until end of movie)
+} movie_replay_desc_t;
+
+// movie reader state
+typedef struct {
+    const uint8_t* ptr;         // movie data
+    size_t size;                // movie data size
+    size_t pos;                 // current read position
+    uint32_t system_id;         // system id from the movie header
+    bool error;                 // true if corrupt movie data was encountered
+    uint64_t tick;              // emulated tick of the next event
+    uint32_t exec_ticks;        // number of ticks of the last exec event
+} movie_reader_t;
+
+// initialize a movie recorder
+void movie_init(movie_t* movie, const movie_desc_t* desc);
+// discard a movie recorder
+void movie_discard(movie_t* movie);
+// drop all recorded data and restart recording
+void movie_reset(movie_t* movie);
+// get an input callback for the system emulator desc
+chips_input_callback_t movie_input_callback(movie_t* movie);
+// record an input event (this is the input callback)
+void movie_record(movie_t* movie, const chips_input_event_t* event);
+// streaming mode: write the remaining buffered data
+void movie_flush(movie_t* movie);
+// get the recorded movie (without write callback)
+chips_range_t movie_data(movie_t* movie);
+// initialize a movie reader, returns false if the movie header is invalid
+bool movie_reader_init(movie_reader_t* reader, chips_range_t data);
+// decode the next event, returns false at the end of the movie or on error
+bool movie_reader_next(movie_reader_t* reader, movie_event_t* out_event);
+// replay a movie, returns the number of replayed exec events
+int movie_replay(movie_reader_t* reader, const movie_replay_desc_t* desc);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_UTIL_IMPL
+#include <string.h> // memset
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+#define _MOVIE_TAG_TYPE_MASK (0x0F)
+#define _MOVIE_TAG_B (1<<4)
+#define _MOVIE_EXEC_DELTA_SHIFT (4)
+#define _MOVIE_EXEC_DELTA_ESCAPE (15)
+#define _MOVIE_TAG_EXEC_FLAGS (15)     // tag type of exec records with a non-zero 'b'
+
+static inline uint32_t _movie_zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t _movie_unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static void _movie_put_leb128(movie_t* m, uint32_t val) {
+    while (val >= 0x80) {
+        m->buf[m->pos++] = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    m->buf[m->pos++] = (uint8_t)val;
+}
+
+static void _movie_write_header(movie_t* m) {
+    memset(m->buf, 0, MOVIE_HEADER_SIZE);
+    m->buf[0] = 'C'; m->buf[1] = 'M'; m->buf[2] = 'O'; m->buf[3] = 'V';
+    m->buf[4] = MOVIE_VERSION;
+    m->buf[8] = (uint8_t)m->system_id;
+    m->buf[9] = (uint8_t)(m->system_id >> 8);
+    m->buf[10] = (uint8_t)(m->system_id >> 16);
+    m->buf[11] = (uint8_t)(m->system_id >> 24);
+    m->pos = MOVIE_HEADER_SIZE;
+}
+
+void movie_init(movie_t* m, const movie_desc_t* desc) {
+    CHIPS_ASSERT(m && desc);
+    CHIPS_ASSERT(desc->buffer.ptr && (desc->buffer.size >= MOVIE_MIN_BUFFER_SIZE));
+    memset(m, 0, sizeof(movie_t));
+    m->valid = true;
+    m->system_id = desc->system_id;
+    m->write.func = desc->write.func;
+    m->write.user_data = desc->write.user_data;
+    m->buf = (uint8_t*) desc->buffer.ptr;
+    m->size = desc->buffer.size;
+    movie_reset(m);
+}
+
+void movie_discard(movie_t* m) {
+    CHIPS_ASSERT(m && m->valid);
+    m->valid = false;
+}
+
+void movie_reset(movie_t* m) {
+    CHIPS_ASSERT(m && m->valid);
+    m->overflow = false;
+    m->tick = 0;
+    m->num_events = 0;
+    m->exec_ticks = 0;
+    _movie_write_header(m);
+}
+
+static void _movie_input(const chips_input_event_t* event, void* user_data) {
+    movie_record((movie_t*)user_data, event);
+}
+
+chips_input_callback_t movie_input_callback(movie_t* m) {
+    CHIPS_ASSERT(m && m->valid);
+    chips_input_callback_t cb = { .func = _movie_input, .user_data = m };
+    return cb;
+}
+
+void movie_record(movie_t* m, const chips_input_event_t* event) {
+    CHIPS_ASSERT(m && m->valid && event);
+    CHIPS_ASSERT((event->type > CHIPS_INPUT_NONE) && (event->type < CHIPS_INPUT_NUM));
+    if (m->overflow) {
+        return;
+    }
+    if ((m->pos + MOVIE_MAX_RECORD_SIZE) > m->size) {
+        if (m->write.func) {
+            m->write.func(m->buf, m->pos, m->write.user_data);
+            m->pos = 0;
+        }
+        else {
+            m->overflow = true;
+            return;
+        }
+    }
+    const uint8_t type = (uint8_t)event->type;
+    if (event->type == CHIPS_INPUT_EXEC) {
+        const uint8_t exec_type = (event->b != 0) ? _MOVIE_TAG_EXEC_FLAGS : type;
+        const uint32_t delta = _movie_zigzag((int32_t)(event->a - m->exec_ticks));
+        if (delta < _MOVIE_EXEC_DELTA_ESCAPE) {
+            m->buf[m->pos++] = (uint8_t)(exec_type | (delta << _MOVIE_EXEC_DELTA_SHIFT));
+        }
+        else {
+            m->buf[m->pos++] = (uint8_t)(exec_type | (_MOVIE_EXEC_DELTA_ESCAPE << _MOVIE_EXEC_DELTA_SHIFT));
+            _movie_put_leb128(m, delta);
+        }
+        if (event->b != 0) {
+            _movie_put_leb128(m, event->b);
+        }
+        m->exec_ticks = event->a;
+        m->tick += event->a;
+    }
+    else {
+        m->buf[m->pos++] = type | ((event->b != 0) ? _MOVIE_TAG_B : 0);
+        _movie_put_leb128(m, event->a);
+        if (event->b != 0) {
+            _movie_put_leb128(m, event->b);
+        }
+    }
+    m->num_events++;
+}
+
+void movie_flush(movie_t* m) {
+    CHIPS_ASSERT(m && m->valid);
+    if (m->write.func && (m->pos > 0)) {
+        m->write.func(m->buf, m->pos, m->write.user_data);
+        m->pos = 0;
+    }
+}
+
+chips_range_t movie_data(movie_t* m) {
+    CHIPS_ASSERT(m && m->valid);
+    chips_range_t res = { .ptr = m->buf, .size = m->pos };
+    return res;
+}
+
+bool movie_reader_init(movie_reader_t* r, chips_range_t data) {
+    CHIPS_ASSERT(r && (data.ptr || (data.size == 0)));
+    memset(r, 0, sizeof(movie_reader_t));
+    r->ptr = (const uint8_t*) data.ptr;
+    r->size = data.size;
+    const uint8_t* p = r->ptr;
+    if ((r->size < MOVIE_HEADER_SIZE) ||
+        (p[0] != 'C') || (p[1] != 'M') || (p[2] != 'O') || (p[3] != 'V') ||
+        (p[4] < 1) || (p[4] > MOVIE_VERSION))
+    {
+        r->error = true;
+        return false;
+    }
+    r->system_id = (uint32_t)p[8] | ((uint32_t)p[9] << 8) | ((uint32_t)p[10] << 16) | ((uint32_t)p[11] << 24);
+    r->pos = MOVIE_HEADER_SIZE;
+    return true;
+}
+
+static bool _movie_get_leb128(movie_reader_t* r, uint32_t* out_val) {
+    uint32_t val = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (r->pos >= r->size) {
+            return false;
+        }
+        const uint8_t b = r->ptr[r->pos++];
+        val |= (uint32_t)(b & 0x7F) << shift;
+        if (0 == (b & 0x80)) {
+            *out_val = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool movie_reader_next(movie_reader_t* r, movie_event_t* out_event) {
+    CHIPS_ASSERT(r && out_event);
+    if (r->error || (r->pos >= r->size)) {
+        return false;
+    }
+    const uint8_t tag = r->ptr[r->pos++];
+    const bool exec_flags = (tag & _MOVIE_TAG_TYPE_MASK) == _MOVIE_TAG_EXEC_FLAGS;
+    const int type = exec_flags ? CHIPS_INPUT_EXEC : (tag & _MOVIE_TAG_TYPE_MASK);
+    if ((type <= CHIPS_INPUT_NONE) || (type >= CHIPS_INPUT_NUM)) {
+        r->error = true;
+        return false;
+    }
+    memset(out_event, 0, sizeof(movie_event_t));
+    out_event->tick = r->tick;
+    out_event->input.type = (chips_input_type_t)type;
+    if (type == CHIPS_INPUT_EXEC) {
+        uint32_t delta = (uint32_t)(tag >> _MOVIE_EXEC_DELTA_SHIFT);
+        if ((delta == _MOVIE_EXEC_DELTA_ESCAPE) && !_movie_get_leb128(r, &delta)) {
+            r->error = true;
+            return false;
+        }
+        if (exec_flags && !_movie_get_leb128(r, &out_event->input.b)) {
+            r->error = true;
+            return false;
+        }
+        r->exec_ticks += (uint32_t)_movie_unzigzag(delta);
+        out_event->input.a = r->exec_ticks;
+        r->tick += r->exec_ticks;
+    }
+    else {
+        if (!_movie_get_leb128(r, &out_event->input.a)) {
+            r->error = true;
+            return false;
+        }
+        if ((tag & _MOVIE_TAG_B) && !_movie_get_leb128(r, &out_event->input.b)) {
+            r->error = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+int movie_replay(movie_reader_t* r, const movie_replay_desc_t* desc) {
+    CHIPS_ASSERT(r && desc && desc->sys && desc->input && (desc->num_frames >= 0));
+    int num_frames = 0;
+    movie_event_t event;
+    while (((0 == desc->num_frames) || (num_frames < desc->num_frames)) && movie_reader_next(r, &event)) {
+        desc->input(desc->sys, &event.input);
+        if (event.input.type == CHIPS_INPUT_EXEC) {
+            num_frames++;
+            if (desc->frame) {
+                desc->frame(desc->sys, r->tick, desc->user_data);
+            }
+        }
+    }
+    return num_frames;
+}
+
+#endif // CHIPS_UTIL_IMPL
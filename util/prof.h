@@ -0,0 +1,445 @@
+#pragma once
+/*#
+    # prof.h
+
+    A CPU profiler which accumulates executed cycles per instruction address
+    and per reconstructed call stack, and writes the call stacks in the
+    'collapsed stack' format used by flamegraph tools.
+
+    Do this:
+    ~~~C
+    #define CHIPS_UTIL_IMPL
+    ~~~
+    before you include this file in *one* C or C++ file to create the
+    implementation.
+
+    Select the profiled CPU with the following macros (define one
+    or the other, but not both):
+
+    PROF_USE_Z80
+    PROF_USE_M6502
+
+    Optionally provide the following macros with your own implementation
+
+    ~~~C
+    CHIPS_ASSERT(c)
+    ~~~
+        your own assert macro (default: assert(c))
+
+    You need to include the following headers before including prof.h:
+
+        - chips_common.h
+        - z80.h         (only if PROF_USE_Z80 is defined)
+        - m6502.h       (only if PROF_USE_M6502 is defined)
+
+    ## Usage
+
+    The profiler is a debug hook which is called in each tick by the system
+    emulator. Initialize a prof_t with a pointer to the profiled CPU, and
+    hook it into the system emulator:
+
+    ~~~C
+    prof_init(&prof, &(prof_desc_t){ .z80 = &sys.cpu });
+    zx_init(&sys, &(zx_desc_t){
+        ...
+        .debug = prof_debug(&prof),
+    });
+    ~~~
+
+    The prof_t struct is big (around 1.2 MBytes) and must stay at a fixed
+    memory location while it's hooked into the system emulator.
+
+    After running the emulator, the per-address totals are in the prof_t
+    struct:
+
+    ~~~C
+    prof.cycles[addr]   // number of cycles spent in the instruction at addr
+    prof.ops[addr]      // number of times the instruction at addr was executed
+    prof.total_cycles   // sum of all cycles
+    ~~~
+
+    To get the cycles per call stack in the collapsed stack format (one
+    line per stack, e.g. "root;0A12;1F00 1234"), call:
+
+    ~~~C
+    size_t prof_write_collapsed(const prof_t* prof, char* buf, size_t buf_size)
+    ~~~
+
+    This works like snprintf(): the output is truncated to fit into buf and
+    always zero-terminated, and the return value is the length of the
+    complete output (so call once with buf_size 0 to get the required size).
+    Function addresses are written as 4 hex digits, unless an optional
+    name callback is provided in prof_desc_t (for instance to look up
+    symbols from an assembler listing).
+
+    ## Call stack reconstruction
+
+    Call stacks are reconstructed from stack pointer changes between
+    instructions, this covers CALL/RST/RET/RETI/RETN on the Z80,
+    JSR/RTS/BRK/RTI on the 6502, and interrupt entries on both CPUs,
+    without decoding instructions:
+
+    - when the stack pointer has decreased and the program counter
+      doesn't point to the next instruction, a call (or interrupt)
+      into a new function at the new program counter has happened
+    - when the stack pointer has increased above the stack pointer at
+      the entry of the current function, the function has returned
+
+    This also keeps the call stack in sync when programs manipulate the
+    return address on the stack (for instance popping the return address
+    and jumping through it), and when a program resets the stack pointer.
+    Calls which don't change the stack pointer (tail calls via JP/JMP) are
+    attributed to the caller.
+
+    ## zlib/libpng license
+
+    Copyright (c) 2018 Andre Weissflog
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+#*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#if !defined(PROF_USE_Z80) && !defined(PROF_USE_M6502)
+#error "please define PROF_USE_Z80 or PROF_USE_M6502"
+#endif
+#if defined(PROF_USE_Z80) && defined(PROF_USE_M6502)
+#error "please define only one of PROF_USE_Z80 or PROF_USE_M6502"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROF_MAX_DEPTH (64)         // max call stack depth
+#define PROF_MAX_NODES (8192)       // max number of unique call stacks
+
+// optional callback to get a function name for collapsed stack output
+typedef const char* (*prof_name_t)(uint16_t addr, void* user_data);
+
+// profiler setup parameters
+typedef struct {
+    #if defined(PROF_USE_Z80)
+    z80_t* z80;                 // pointer to the profiled CPU
+    #else
+    m6502_t* m6502;             // pointer to the profiled CPU
+    #endif
+    prof_name_t name_cb;        // optional function name callback
+    void* user_data;            // user data for name_cb
+} prof_desc_t;
+
+// a call tree node (a unique call stack)
+typedef struct {
+    uint16_t addr;              // function entry address
+    int32_t parent;             // parent node index, or -1 for the root node
+    int32_t child;              // first child node index, or -1
+    int32_t sibling;            // next sibling node index, or -1
+    uint64_t cycles;            // cycles spent in this function in this call stack (excluding callees)
+} prof_node_t;
+
+// a call stack frame
+typedef struct {
+    int32_t node;               // call tree node of the function
+    uint16_t sp;                // stack pointer after the call
+} prof_frame_t;
+
+// profiler state
+typedef struct {
+    bool valid;
+    bool stopped;               // always false, the profiler never stops execution
+    #if defined(PROF_USE_Z80)
+    z80_t* z80;
+    #else
+    m6502_t* m6502;
+    #endif
+    prof_name_t name_cb;
+    void* user_data;
+    uint64_t tick;              // ticks since profiling started
+    uint64_t op_tick;           // tick at start of current instruction
+    uint16_t op_pc;             // program counter of current instruction
+    uint16_t op_sp;             // stack pointer at start of current instruction
+    bool op_valid;              // false until the first instruction has started
+    int depth;                  // current call stack depth
+    int32_t num_nodes;          // number of used call tree nodes
+    uint64_t num_dropped_calls; // calls which exceeded PROF_MAX_DEPTH or PROF_MAX_NODES
+    uint64_t total_cycles;      // sum of all recorded cycles
+    prof_frame_t stack[PROF_MAX_DEPTH];
+    prof_node_t nodes[PROF_MAX_NODES];
+    uint64_t cycles[1<<16];     // cycles per instruction address
+    uint64_t ops[1<<16];        // executions per instruction address
+} prof_t;
+
+// initialize a profiler
+void prof_init(prof_t* prof, const prof_desc_t* desc);
+// discard a profiler
+void prof_discard(prof_t* prof);
+// clear all recorded data
+void prof_reset(prof_t* prof);
+// get a debug hook for the system emulator desc
+chips_debug_t prof_debug(prof_t* prof);
+// record a tick (this is the debug hook callback)
+void prof_tick(prof_t* prof, uint64_t pins);
+// write call stacks in collapsed stack format, returns length of complete output
+size_t prof_write_collapsed(const prof_t* prof, char* buf, size_t buf_size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_UTIL_IMPL
+#include <string.h> // memset
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+void prof_init(prof_t* prof, const prof_desc_t* desc) {
+    CHIPS_ASSERT(prof && desc);
+    #if defined(PROF_USE_Z80)
+        CHIPS_ASSERT(desc->z80);
+    #else
+        CHIPS_ASSERT(desc->m6502);
+    #endif
+    memset(prof, 0, sizeof(prof_t));
+    prof->valid = true;
+    #if defined(PROF_USE_Z80)
+        prof->z80 = desc->z80;
+    #else
+        prof->m6502 = desc->m6502;
+    #endif
+    prof->name_cb = desc->name_cb;
+    prof->user_data = desc->user_data;
+    prof_reset(prof);
+}
+
+void prof_discard(prof_t* prof) {
+    CHIPS_ASSERT(prof && prof->valid);
+    prof->valid = false;
+}
+
+void prof_reset(prof_t* prof) {
+    CHIPS_ASSERT(prof && prof->valid);
+    prof->tick = 0;
+    prof->op_tick = 0;
+    prof->op_pc = 0;
+    prof->op_sp = 0;
+    prof->op_valid = false;
+    prof->depth = 0;
+    prof->num_dropped_calls = 0;
+    prof->total_cycles = 0;
+    memset(prof->stack, 0, sizeof(prof->stack));
+    memset(prof->cycles, 0, sizeof(prof->cycles));
+    memset(prof->ops, 0, sizeof(prof->ops));
+    // node 0 is the root node
+    prof->num_nodes = 1;
+    prof->nodes[0].addr = 0;
+    prof->nodes[0].parent = -1;
+    prof->nodes[0].child = -1;
+    prof->nodes[0].sibling = -1;
+    prof->nodes[0].cycles = 0;
+}
+
+chips_debug_t prof_debug(prof_t* prof) {
+    CHIPS_ASSERT(prof && prof->valid);
+    chips_debug_t debug;
+    memset(&debug, 0, sizeof(debug));
+    debug.callback.func = (chips_debug_func_t)prof_tick;
+    debug.callback.user_data = prof;
+    debug.stopped = &prof->stopped;
+    return debug;
+}
+
+static inline int32_t _prof_cur_node(const prof_t* prof) {
+    return (prof->depth > 0) ? prof->stack[prof->depth - 1].node : 0;
+}
+
+// stack pointer difference (new - old), taking the CPU's stack pointer width into account
+static inline int _prof_sp_diff(uint16_t new_sp, uint16_t old_sp) {
+    #if defined(PROF_USE_Z80)
+        return (int16_t)(new_sp - old_sp);
+    #else
+        return (int8_t)(new_sp - old_sp);
+    #endif
+}
+
+// find or create the child node of the current call stack for a called function
+static int32_t _prof_child_node(prof_t* prof, uint16_t addr) {
+    const int32_t parent = _prof_cur_node(prof);
+    for (int32_t i = prof->nodes[parent].child; i >= 0; i = prof->nodes[i].sibling) {
+        if (prof->nodes[i].addr == addr) {
+            return i;
+        }
+    }
+    if (prof->num_nodes >= PROF_MAX_NODES) {
+        return -1;
+    }
+    const int32_t i = prof->num_nodes++;
+    prof_node_t* node = &prof->nodes[i];
+    node->addr = addr;
+    node->parent = parent;
+    node->child = -1;
+    node->sibling = prof->nodes[parent].child;
+    node->cycles = 0;
+    prof->nodes[parent].child = i;
+    return i;
+}
+
+static void _prof_call(prof_t* prof, uint16_t pc, uint16_t sp) {
+    if (prof->depth >= PROF_MAX_DEPTH) {
+        prof->num_dropped_calls++;
+        return;
+    }
+    int32_t node = _prof_child_node(prof, pc);
+    if (node < 0) {
+        // out of call tree nodes, keep tracking the stack, but attribute to the caller
+        prof->num_dropped_calls++;
+        node = _prof_cur_node(prof);
+    }
+    prof->stack[prof->depth].node = node;
+    prof->stack[prof->depth].sp = sp;
+    prof->depth++;
+}
+
+static void _prof_return(prof_t* prof, uint16_t sp) {
+    while ((prof->depth > 0) && (_prof_sp_diff(sp, prof->stack[prof->depth - 1].sp) > 0)) {
+        prof->depth--;
+    }
+}
+
+// called at the start of each instruction
+static void _prof_op(prof_t* prof, uint16_t pc) {
+    #if defined(PROF_USE_Z80)
+        const uint16_t sp = prof->z80->sp;
+    #else
+        const uint16_t sp = prof->m6502->S;
+    #endif
+    if (prof->op_valid) {
+        // attribute the previous instruction's cycles
+        const uint64_t cycles = prof->tick - prof->op_tick;
+        prof->cycles[prof->op_pc] += cycles;
+        prof->ops[prof->op_pc]++;
+        prof->nodes[_prof_cur_node(prof)].cycles += cycles;
+        prof->total_cycles += cycles;
+
+        // update call stack
+        const int sp_diff = _prof_sp_diff(sp, prof->op_sp);
+        if (sp_diff > 0) {
+            _prof_return(prof, sp);
+        }
+        else if (sp_diff < 0) {
+            // a push (PUSH/PHA/PHP) continues with the next instruction (at most 4 bytes away)
+            const uint16_t pc_diff = pc - prof->op_pc;
+            if ((pc_diff == 0) || (pc_diff > 4)) {
+                _prof_call(prof, pc, sp);
+            }
+        }
+    }
+    prof->op_tick = prof->tick;
+    prof->op_pc = pc;
+    prof->op_sp = sp;
+    prof->op_valid = true;
+}
+
+void prof_tick(prof_t* prof, uint64_t pins) {
+    #if defined(PROF_USE_Z80)
+        if (z80_opdone(prof->z80)) {
+            _prof_op(prof, Z80_GET_ADDR(pins));
+        }
+    #else
+        if (pins & M6502_SYNC) {
+            _prof_op(prof, M6502_GET_ADDR(pins));
+        }
+    #endif
+    prof->tick++;
+}
+
+// helper to write into a truncating output buffer
+typedef struct {
+    char* buf;
+    size_t size;
+    size_t pos;
+} _prof_out_t;
+
+static void _prof_out_chr(_prof_out_t* out, char c) {
+    if ((out->pos + 1) < out->size) {
+        out->buf[out->pos] = c;
+    }
+    out->pos++;
+}
+
+static void _prof_out_str(_prof_out_t* out, const char* str) {
+    while (*str) {
+        _prof_out_chr(out, *str++);
+    }
+}
+
+static void _prof_out_u64(_prof_out_t* out, uint64_t val) {
+    char digits[20];
+    int num = 0;
+    do {
+        digits[num++] = (char)('0' + (val % 10));
+        val /= 10;
+    } while (val > 0);
+    while (num > 0) {
+        _prof_out_chr(out, digits[--num]);
+    }
+}
+
+static void _prof_out_func(const prof_t* prof, _prof_out_t* out, uint16_t addr) {
+    const char* name = prof->name_cb ? prof->name_cb(addr, prof->user_data) : 0;
+    if (name) {
+        _prof_out_str(out, name);
+    }
+    else {
+        const char* hex = "0123456789ABCDEF";
+        for (int shift = 12; shift >= 0; shift -= 4) {
+            _prof_out_chr(out, hex[(addr >> shift) & 0xF]);
+        }
+    }
+}
+
+size_t prof_write_collapsed(const prof_t* prof, char* buf, size_t buf_size) {
+    CHIPS_ASSERT(prof && prof->valid);
+    CHIPS_ASSERT(buf || (buf_size == 0));
+    _prof_out_t out = { buf, buf_size, 0 };
+    int32_t path[PROF_MAX_DEPTH + 1];
+    for (int32_t i = 0; i < prof->num_nodes; i++) {
+        if (prof->nodes[i].cycles == 0) {
+            continue;
+        }
+        // collect path from node to root, and write from root to node
+        int num = 0;
+        for (int32_t n = i; n >= 0; n = prof->nodes[n].parent) {
+            CHIPS_ASSERT(num <= PROF_MAX_DEPTH);
+            path[num++] = n;
+        }
+        _prof_out_str(&out, "root");
+        for (int p = num - 2; p >= 0; p--) {
+            _prof_out_chr(&out, ';');
+            _prof_out_func(prof, &out, prof->nodes[path[p]].addr);
+        }
+        _prof_out_chr(&out, ' ');
+        _prof_out_u64(&out, prof->nodes[i].cycles);
+        _prof_out_chr(&out, '\n');
+    }
+    if (buf_size > 0) {
+        buf[(out.pos < buf_size) ? out.pos : (buf_size - 1)] = 0;
+    }
+    return out.pos;
+}
+
+#endif // CHIPS_UTIL_IMPL
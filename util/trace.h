@@ -0,0 +1,798 @@
+#pragma once
+/*#
+    # trace.h
+
+    A CPU execution trace recorder which writes a compact, chunked binary
+    trace, and a reader to decode recorded traces.
+
+    Do this:
+    ~~~C
+    #define CHIPS_UTIL_IMPL
+    ~~~
+    before you include this file in *one* C or C++ file to create the
+    implementation.
+
+    Select the traced CPU with the following macros (define one or the
+    other, but not both), if neither is defined, only the CPU-agnostic
+    trace reader is available:
+
+    TRACE_USE_Z80
+    TRACE_USE_M6502
+
+    Optionally provide the following macros with your own implementation
+
+    ~~~C
+    CHIPS_ASSERT(c)
+    ~~~
+        your own assert macro (default: assert(c))
+
+    You need to include the following headers before including trace.h:
+
+        - chips_common.h
+
+    ...and the following headers before including the *implementation*:
+
+        - z80.h         (only if TRACE_USE_Z80 is defined)
+        - z80dasm.h     (only if TRACE_USE_Z80 is defined)
+        - m6502.h       (only if TRACE_USE_M6502 is defined)
+        - m6502dasm.h   (only if TRACE_USE_M6502 is defined)
+
+    ## Recording a trace
+
+    The trace recorder is a debug hook, it's called in each tick by the
+    system emulator and records for every executed instruction:
+
+    - the tick count since recording started
+    - the program counter and the instruction bytes
+    - the registers which changed since the previous instruction
+
+    ...and for each bus access that can't be reconstructed from the
+    executed code:
+
+    - memory writes (address and data)
+    - Z80 IO reads and writes (port address and data)
+
+    Initialize a trace_t with a pointer to the traced CPU, a memory read
+    callback (used to fetch the instruction bytes), and a memory buffer
+    for the trace chunks:
+
+    ~~~C
+    static uint8_t trace_buf[64 * TRACE_CHUNK_SIZE];
+
+    trace_init(&trace, &(trace_desc_t){
+        .z80 = &sys.cpu,
+        .read_cb = my_read_func,
+        .buffer = { .ptr = trace_buf, .size = sizeof(trace_buf) },
+    });
+    ~~~
+
+    ...and hook the recorder into the system emulator:
+
+    ~~~C
+    zx_init(&sys, &(zx_desc_t){
+        ...
+        .debug = trace_debug(&trace),
+    });
+    ~~~
+
+    The trace_t struct must stay at a fixed memory location while it's
+    hooked into the system emulator.
+
+    The trace buffer is split into chunks of TRACE_CHUNK_SIZE bytes
+    (the buffer size must be a multiple of TRACE_CHUNK_SIZE). What happens
+    with a completed chunk depends on the 'write' callback:
+
+    - with a write callback (streaming mode), each completed chunk is
+      passed to the callback (for instance to write it to a file), and the
+      chunk's memory is reused. Call trace_flush() to also write the
+      current, partially filled chunk (e.g. when recording stops).
+    - without a write callback (ring-buffer mode), the recorder keeps the
+      most recent chunks in memory, and overwrites the oldest chunk when
+      the buffer is full. Call trace_save() to write the recorded chunks
+      in chronological order (e.g. from a crash handler to get the last
+      N million instructions before the crash).
+
+    ## Trace format
+
+    A trace is a sequence of chunks, each chunk starts with a 64-byte
+    header which contains the complete CPU state at the start of the
+    chunk, so that each chunk can be decoded on its own. All numbers
+    are little-endian:
+
+    ~~~
+    0:  magic 'CTRC'
+    4:  format version (TRACE_VERSION)
+    5:  cpu type (TRACE_CPU_Z80 or TRACE_CPU_M6502)
+    6:  number of registers
+    7:  bytes per register (1 or 2)
+    8:  payload size in bytes (uint32_t)
+    12: number of instructions in chunk (uint32_t)
+    16: tick of the last record before the chunk (uint64_t)
+    24: number of instructions before the chunk (uint64_t)
+    32: predicted PC of the first instruction (uint16_t)
+    34: register values (TRACE_MAX_REGS * uint16_t)
+    ~~~
+
+    The header is followed by the payload, a sequence of variable-length
+    records. Each record starts with a tag byte, where the lower 2 bits
+    are the record type (TRACE_ITEM_*), followed by the tick delta to the
+    previous record as unsigned LEB128 number:
+
+    - instruction records (TRACE_ITEM_OPCODE): tag bits 2..3 are the number
+      of instruction bytes minus 1, tag bit 4 is set if any register has
+      changed, tag bit 5 is set if the PC is not the predicted PC (the
+      address after the previous instruction). After the tick delta follow
+      the PC (uint16_t, only if tag bit 5 is set), the instruction bytes,
+      and if tag bit 4 is set, a LEB128 bit mask of the changed registers
+      followed by the new values of the changed registers
+    - bus access records (TRACE_ITEM_MEM_WRITE, TRACE_ITEM_IO_READ,
+      TRACE_ITEM_IO_WRITE): after the tick delta follow the address
+      (uint16_t) and the data byte
+
+    Typical instruction records are 3..6 bytes. The format is meant to be
+    further compressed with a general-purpose compressor (for instance in
+    the write callback), delta-encoding the trace makes it compress well.
+
+    ## Reading a trace
+
+    The trace reader is CPU-agnostic and works on a memory range which
+    contains one or more complete chunks (e.g. a loaded trace file):
+
+    ~~~C
+    trace_reader_t reader;
+    trace_reader_init(&reader, (chips_range_t){ .ptr = data, .size = size });
+    trace_item_t item;
+    while (trace_reader_next(&reader, &item)) {
+        if (item.type == TRACE_ITEM_OPCODE) {
+            ...
+        }
+    }
+    if (reader.error) {
+        // trace data is corrupt
+    }
+    ~~~
+
+    ## zlib/libpng license
+
+    Copyright (c) 2018 Andre Weissflog
+    This software is provided 'as-is', without any express or implied warranty.
+    In no event will the authors be held liable for any damages arising from the
+    use of this software.
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+        1. The origin of this software must not be misrepresented; you must not
+        claim that you wrote the original software. If you use this software in a
+        product, an acknowledgment in the product documentation would be
+        appreciated but is not required.
+        2. Altered source versions must be plainly marked as such, and must not
+        be misrepresented as being the original software.
+        3. This notice may not be removed or altered from any source
+        distribution.
+#*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(TRACE_USE_Z80) && defined(TRACE_USE_M6502)
+#error "please define only one of TRACE_USE_Z80 or TRACE_USE_M6502"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACE_VERSION (1)
+#define TRACE_CHUNK_SIZE (64 * 1024)
+#define TRACE_CHUNK_HEADER_SIZE (64)
+#define TRACE_MAX_RECORD_SIZE (64)
+#define TRACE_MAX_REGS (14)
+#define TRACE_MAX_OPCODE_BYTES (4)
+
+// traced CPU types
+#define TRACE_CPU_Z80 (1)
+#define TRACE_CPU_M6502 (2)
+
+// trace item types
+#define TRACE_ITEM_OPCODE (0)       // an executed instruction
+#define TRACE_ITEM_MEM_WRITE (1)    // a memory write
+#define TRACE_ITEM_IO_READ (2)      // a Z80 IO read
+#define TRACE_ITEM_IO_WRITE (3)     // a Z80 IO write
+
+// Z80 register indices in trace_item_t.regs (R is not traced since it changes with each instruction)
+enum {
+    TRACE_Z80_AF,
+    TRACE_Z80_BC,
+    TRACE_Z80_DE,
+    TRACE_Z80_HL,
+    TRACE_Z80_IX,
+    TRACE_Z80_IY,
+    TRACE_Z80_SP,
+    TRACE_Z80_AF2,
+    TRACE_Z80_BC2,
+    TRACE_Z80_DE2,
+    TRACE_Z80_HL2,
+    TRACE_Z80_I,
+    TRACE_Z80_IM,       // im | (iff1 << 8) | (iff2 << 9)
+    TRACE_Z80_NUM_REGS,
+};
+
+// 6502 register indices in trace_item_t.regs
+enum {
+    TRACE_M6502_A,
+    TRACE_M6502_X,
+    TRACE_M6502_Y,
+    TRACE_M6502_S,
+    TRACE_M6502_P,
+    TRACE_M6502_NUM_REGS,
+};
+
+// callback to write a chunk of trace data
+typedef void (*trace_write_t)(const uint8_t* ptr, size_t num_bytes, void* user_data);
+// callback to read a memory byte
+typedef uint8_t (*trace_read_t)(uint16_t addr, void* user_data);
+
+// a decoded trace item
+typedef struct {
+    int type;               // TRACE_ITEM_*
+    uint64_t tick;          // tick count since recording started
+    uint64_t index;         // index of the (current) instruction since recording started
+    uint16_t pc;            // program counter of the (current) instruction
+    uint8_t num_bytes;      // number of instruction bytes (TRACE_ITEM_OPCODE)
+    uint8_t bytes[TRACE_MAX_OPCODE_BYTES];  // instruction bytes (TRACE_ITEM_OPCODE)
+    uint16_t addr;          // memory or IO address (bus access items)
+    uint8_t data;           // data byte (bus access items)
+    uint16_t regs[TRACE_MAX_REGS];  // register values before the (current) instruction
+} trace_item_t;
+
+// trace reader state
+typedef struct {
+    const uint8_t* ptr;     // trace data
+    size_t size;            // trace data size
+    size_t pos;             // current read position
+    size_t end;             // end of current chunk payload
+    int cpu;                // TRACE_CPU_* of current chunk
+    int num_regs;           // number of registers in current chunk
+    int reg_bytes;          // bytes per register in current chunk
+    bool error;             // true if corrupt trace data was encountered
+    trace_item_t cur;       // current decoder state
+    uint64_t num_ops;       // number of instructions before the next instruction
+    uint16_t next_pc;       // predicted PC of next instruction
+} trace_reader_t;
+
+// initialize a trace reader
+void trace_reader_init(trace_reader_t* reader, chips_range_t data);
+// decode the next trace item, returns false at the end of the trace or on error
+bool trace_reader_next(trace_reader_t* reader, trace_item_t* out_item);
+
+#if defined(TRACE_USE_Z80) || defined(TRACE_USE_M6502)
+
+// trace recorder setup parameters
+typedef struct {
+    #if defined(TRACE_USE_Z80)
+    z80_t* z80;             // pointer to the traced CPU
+    #else
+    m6502_t* m6502;         // pointer to the traced CPU
+    #endif
+    trace_read_t read_cb;   // callback to read instruction bytes
+    void* user_data;        // user data for read_cb
+    chips_range_t buffer;   // memory for the trace chunks, must be a multiple of TRACE_CHUNK_SIZE
+    struct {
+        trace_write_t func; // optional, called with each completed chunk (streaming mode)
+        void* user_data;
+    } write;
+} trace_desc_t;
+
+// trace recorder state
+typedef struct {
+    bool valid;
+    bool stopped;           // always false, the recorder never stops execution
+    #if defined(TRACE_USE_Z80)
+    z80_t* z80;
+    #else
+    m6502_t* m6502;
+    #endif
+    trace_read_t read_cb;
+    void* user_data;
+    struct {
+        trace_write_t func;
+        void* user_data;
+    } write;
+    uint8_t* buf;
+    size_t num_chunks;      // number of chunks in buf
+    size_t chunk;           // index of current chunk
+    size_t num_full;        // number of completed chunks in ring-buffer
+    size_t pos;             // write position in current chunk
+    uint32_t chunk_ops;     // number of instructions in current chunk
+    uint64_t tick;          // ticks since recording started
+    uint64_t last_tick;     // tick of last record
+    uint64_t index;         // number of recorded instructions
+    uint16_t next_pc;       // predicted PC of next instruction
+    uint16_t regs[TRACE_MAX_REGS];  // register values at last instruction
+} trace_t;
+
+// initialize a trace recorder
+void trace_init(trace_t* trace, const trace_desc_t* desc);
+// discard a trace recorder
+void trace_discard(trace_t* trace);
+// drop all recorded data and restart recording
+void trace_reset(trace_t* trace);
+// get a debug hook for the system emulator desc
+chips_debug_t trace_debug(trace_t* trace);
+// record a tick (this is the debug hook callback)
+void trace_tick(trace_t* trace, uint64_t pins);
+// streaming mode: write the current, partially filled chunk
+void trace_flush(trace_t* trace);
+// ring-buffer mode: write all recorded chunks from oldest to newest
+void trace_save(trace_t* trace, trace_write_t func, void* user_data);
+
+#endif // TRACE_USE_Z80 || TRACE_USE_M6502
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_UTIL_IMPL
+#include <string.h> // memset, memcpy
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
+
+#define _TRACE_TAG_OPBYTES_SHIFT (2)
+#define _TRACE_TAG_REGS (1<<4)
+#define _TRACE_TAG_PC (1<<5)
+
+static inline uint16_t _trace_rd16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t _trace_rd32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t _trace_rd64(const uint8_t* p) {
+    return (uint64_t)_trace_rd32(p) | ((uint64_t)_trace_rd32(p + 4) << 32);
+}
+
+// decode an unsigned LEB128 number, returns false on overflow or end of data
+static bool _trace_rd_varint(trace_reader_t* r, uint64_t* out_val) {
+    uint64_t val = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->pos >= r->end) {
+            return false;
+        }
+        const uint8_t b = r->ptr[r->pos++];
+        val |= (uint64_t)(b & 0x7F) << shift;
+        if (0 == (b & 0x80)) {
+            *out_val = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+// start decoding the chunk at the current read position
+static bool _trace_reader_begin_chunk(trace_reader_t* r) {
+    if ((r->size - r->pos) < TRACE_CHUNK_HEADER_SIZE) {
+        return false;
+    }
+    const uint8_t* h = r->ptr + r->pos;
+    if ((h[0] != 'C') || (h[1] != 'T') || (h[2] != 'R') || (h[3] != 'C') || (h[4] != TRACE_VERSION)) {
+        return false;
+    }
+    const int cpu = h[5];
+    const int num_regs = h[6];
+    const int reg_bytes = h[7];
+    const uint32_t payload_size = _trace_rd32(h + 8);
+    if (((cpu != TRACE_CPU_Z80) && (cpu != TRACE_CPU_M6502)) ||
+        (num_regs > TRACE_MAX_REGS) ||
+        ((reg_bytes != 1) && (reg_bytes != 2)) ||
+        (payload_size > (r->size - r->pos - TRACE_CHUNK_HEADER_SIZE)))
+    {
+        return false;
+    }
+    r->cpu = cpu;
+    r->num_regs = num_regs;
+    r->reg_bytes = reg_bytes;
+    r->cur.tick = _trace_rd64(h + 16);
+    r->num_ops = _trace_rd64(h + 24);
+    r->cur.index = (r->num_ops > 0) ? (r->num_ops - 1) : 0;
+    r->next_pc = _trace_rd16(h + 32);
+    for (int i = 0; i < TRACE_MAX_REGS; i++) {
+        r->cur.regs[i] = _trace_rd16(h + 34 + 2 * i);
+    }
+    r->pos += TRACE_CHUNK_HEADER_SIZE;
+    r->end = r->pos + payload_size;
+    return true;
+}
+
+void trace_reader_init(trace_reader_t* r, chips_range_t data) {
+    CHIPS_ASSERT(r);
+    memset(r, 0, sizeof(trace_reader_t));
+    r->ptr = (const uint8_t*) data.ptr;
+    r->size = data.ptr ? data.size : 0;
+}
+
+bool trace_reader_next(trace_reader_t* r, trace_item_t* out_item) {
+    CHIPS_ASSERT(r && out_item);
+    if (r->error) {
+        return false;
+    }
+    while (r->pos >= r->end) {
+        if (r->pos >= r->size) {
+            return false;
+        }
+        if (!_trace_reader_begin_chunk(r)) {
+            r->error = true;
+            return false;
+        }
+    }
+    const uint8_t tag = r->ptr[r->pos++];
+    uint64_t tick_delta;
+    if (!_trace_rd_varint(r, &tick_delta)) {
+        r->error = true;
+        return false;
+    }
+    r->cur.tick += tick_delta;
+    r->cur.type = tag & 3;
+    if (r->cur.type == TRACE_ITEM_OPCODE) {
+        const int num_bytes = ((tag >> _TRACE_TAG_OPBYTES_SHIFT) & 3) + 1;
+        const size_t pc_size = (tag & _TRACE_TAG_PC) ? 2 : 0;
+        if ((r->end - r->pos) < (pc_size + (size_t)num_bytes)) {
+            r->error = true;
+            return false;
+        }
+        r->cur.index = r->num_ops++;
+        if (tag & _TRACE_TAG_PC) {
+            r->cur.pc = _trace_rd16(r->ptr + r->pos);
+            r->pos += 2;
+        }
+        else {
+            r->cur.pc = r->next_pc;
+        }
+        r->cur.num_bytes = (uint8_t)num_bytes;
+        memset(r->cur.bytes, 0, sizeof(r->cur.bytes));
+        memcpy(r->cur.bytes, r->ptr + r->pos, (size_t)num_bytes);
+        r->pos += (size_t)num_bytes;
+        r->next_pc = (uint16_t)(r->cur.pc + num_bytes);
+        if (tag & _TRACE_TAG_REGS) {
+            uint64_t mask;
+            if (!_trace_rd_varint(r, &mask) || (mask >> r->num_regs)) {
+                r->error = true;
+                return false;
+            }
+            for (int i = 0; i < r->num_regs; i++) {
+                if (mask & (1 << i)) {
+                    if ((r->end - r->pos) < (size_t)r->reg_bytes) {
+                        r->error = true;
+                        return false;
+                    }
+                    if (r->reg_bytes == 2) {
+                        r->cur.regs[i] = _trace_rd16(r->ptr + r->pos);
+                    }
+                    else {
+                        r->cur.regs[i] = r->ptr[r->pos];
+                    }
+                    r->pos += (size_t)r->reg_bytes;
+                }
+            }
+        }
+    }
+    else {
+        if ((r->end - r->pos) < 3) {
+            r->error = true;
+            return false;
+        }
+        r->cur.addr = _trace_rd16(r->ptr + r->pos);
+        r->cur.data = r->ptr[r->pos + 2];
+        r->pos += 3;
+    }
+    *out_item = r->cur;
+    return true;
+}
+
+#if defined(TRACE_USE_Z80) || defined(TRACE_USE_M6502)
+
+#if defined(TRACE_USE_Z80)
+#define _TRACE_CPU (TRACE_CPU_Z80)
+#define _TRACE_NUM_REGS (TRACE_Z80_NUM_REGS)
+#define _TRACE_REG_BYTES (2)
+#else
+#define _TRACE_CPU (TRACE_CPU_M6502)
+#define _TRACE_NUM_REGS (TRACE_M6502_NUM_REGS)
+#define _TRACE_REG_BYTES (1)
+#endif
+
+static inline void _trace_wr16(uint8_t* p, uint16_t val) {
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+}
+
+static inline void _trace_wr32(uint8_t* p, uint32_t val) {
+    _trace_wr16(p, (uint16_t)val);
+    _trace_wr16(p + 2, (uint16_t)(val >> 16));
+}
+
+static inline void _trace_wr64(uint8_t* p, uint64_t val) {
+    _trace_wr32(p, (uint32_t)val);
+    _trace_wr32(p + 4, (uint32_t)(val >> 32));
+}
+
+static inline uint8_t* _trace_chunk_ptr(trace_t* t, size_t chunk) {
+    return t->buf + chunk * TRACE_CHUNK_SIZE;
+}
+
+static inline size_t _trace_wr_varint(uint8_t* p, uint64_t val) {
+    size_t n = 0;
+    while (val >= 0x80) {
+        p[n++] = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    p[n++] = (uint8_t)val;
+    return n;
+}
+
+static void _trace_read_regs(trace_t* t, uint16_t* regs) {
+    #if defined(TRACE_USE_Z80)
+        const z80_t* cpu = t->z80;
+        regs[TRACE_Z80_AF] = cpu->af;
+        regs[TRACE_Z80_BC] = cpu->bc;
+        regs[TRACE_Z80_DE] = cpu->de;
+        regs[TRACE_Z80_HL] = cpu->hl;
+        regs[TRACE_Z80_IX] = cpu->ix;
+        regs[TRACE_Z80_IY] = cpu->iy;
+        regs[TRACE_Z80_SP] = cpu->sp;
+        regs[TRACE_Z80_AF2] = cpu->af2;
+        regs[TRACE_Z80_BC2] = cpu->bc2;
+        regs[TRACE_Z80_DE2] = cpu->de2;
+        regs[TRACE_Z80_HL2] = cpu->hl2;
+        regs[TRACE_Z80_I] = cpu->i;
+        regs[TRACE_Z80_IM] = (uint16_t)(cpu->im | (cpu->iff1 ? 0x100 : 0) | (cpu->iff2 ? 0x200 : 0));
+    #else
+        const m6502_t* cpu = t->m6502;
+        regs[TRACE_M6502_A] = cpu->A;
+        regs[TRACE_M6502_X] = cpu->X;
+        regs[TRACE_M6502_Y] = cpu->Y;
+        regs[TRACE_M6502_S] = cpu->S;
+        regs[TRACE_M6502_P] = cpu->P;
+    #endif
+}
+
+// start a new chunk, the header contains the complete decoder state
+static void _trace_begin_chunk(trace_t* t) {
+    uint8_t* h = _trace_chunk_ptr(t, t->chunk);
+    memset(h, 0, TRACE_CHUNK_HEADER_SIZE);
+    h[0] = 'C'; h[1] = 'T'; h[2] = 'R'; h[3] = 'C';
+    h[4] = TRACE_VERSION;
+    h[5] = _TRACE_CPU;
+    h[6] = _TRACE_NUM_REGS;
+    h[7] = _TRACE_REG_BYTES;
+    _trace_wr64(h + 16, t->last_tick);
+    _trace_wr64(h + 24, t->index);
+    _trace_wr16(h + 32, t->next_pc);
+    for (int i = 0; i < TRACE_MAX_REGS; i++) {
+        _trace_wr16(h + 34 + 2 * i, t->regs[i]);
+    }
+    t->pos = TRACE_CHUNK_HEADER_SIZE;
+    t->chunk_ops = 0;
+}
+
+// patch the payload size and instruction count into the current chunk's header
+static void _trace_close_chunk(trace_t* t) {
+    uint8_t* h = _trace_chunk_ptr(t, t->chunk);
+    _trace_wr32(h + 8, (uint32_t)(t->pos - TRACE_CHUNK_HEADER_SIZE));
+    _trace_wr32(h + 12, t->chunk_ops);
+}
+
+static void _trace_next_chunk(trace_t* t) {
+    _trace_close_chunk(t);
+    if (t->write.func) {
+        t->write.func(_trace_chunk_ptr(t, t->chunk), t->pos, t->write.user_data);
+    }
+    else if (t->num_full < (t->num_chunks - 1)) {
+        t->num_full++;
+    }
+    t->chunk = (t->chunk + 1) % t->num_chunks;
+    _trace_begin_chunk(t);
+}
+
+static inline uint8_t* _trace_begin_record(trace_t* t, uint8_t tag, uint64_t tick) {
+    if ((t->pos + TRACE_MAX_RECORD_SIZE) > TRACE_CHUNK_SIZE) {
+        _trace_next_chunk(t);
+    }
+    uint8_t* p = _trace_chunk_ptr(t, t->chunk) + t->pos;
+    *p++ = tag;
+    p += _trace_wr_varint(p, tick - t->last_tick);
+    t->last_tick = tick;
+    return p;
+}
+
+typedef struct {
+    trace_t* trace;
+    uint16_t addr;
+    int num_bytes;
+    uint8_t bytes[TRACE_MAX_OPCODE_BYTES];
+} _trace_fetch_t;
+
+static uint8_t _trace_fetch(void* user_data) {
+    _trace_fetch_t* f = (_trace_fetch_t*) user_data;
+    const uint8_t val = f->trace->read_cb(f->addr++, f->trace->user_data);
+    if (f->num_bytes < TRACE_MAX_OPCODE_BYTES) {
+        f->bytes[f->num_bytes++] = val;
+    }
+    return val;
+}
+
+static void _trace_record_op(trace_t* t, uint64_t tick, uint16_t pc) {
+    // fetch instruction bytes, the disassembler computes the instruction length
+    _trace_fetch_t fetch;
+    memset(&fetch, 0, sizeof(fetch));
+    fetch.trace = t;
+    fetch.addr = pc;
+    #if defined(TRACE_USE_Z80)
+        z80dasm_op(pc, _trace_fetch, 0, &fetch);
+    #else
+        m6502dasm_op(pc, _trace_fetch, 0, &fetch);
+    #endif
+    CHIPS_ASSERT((fetch.num_bytes > 0) && (fetch.num_bytes <= TRACE_MAX_OPCODE_BYTES));
+
+    // find changed registers
+    uint16_t regs[TRACE_MAX_REGS] = {0};
+    _trace_read_regs(t, regs);
+    uint32_t reg_mask = 0;
+    for (int i = 0; i < _TRACE_NUM_REGS; i++) {
+        if (regs[i] != t->regs[i]) {
+            reg_mask |= 1 << i;
+        }
+    }
+
+    uint8_t tag = TRACE_ITEM_OPCODE | (uint8_t)((fetch.num_bytes - 1) << _TRACE_TAG_OPBYTES_SHIFT);
+    if (reg_mask) {
+        tag |= _TRACE_TAG_REGS;
+    }
+    if (pc != t->next_pc) {
+        tag |= _TRACE_TAG_PC;
+    }
+    uint8_t* p = _trace_begin_record(t, tag, tick);
+    // NOTE: _trace_begin_record() may have started a new chunk
+    const uint8_t* start = _trace_chunk_ptr(t, t->chunk) + t->pos;
+    if (tag & _TRACE_TAG_PC) {
+        _trace_wr16(p, pc);
+        p += 2;
+    }
+    for (int i = 0; i < fetch.num_bytes; i++) {
+        *p++ = fetch.bytes[i];
+    }
+    if (reg_mask) {
+        p += _trace_wr_varint(p, reg_mask);
+        for (int i = 0; i < _TRACE_NUM_REGS; i++) {
+            if (reg_mask & (1 << i)) {
+                #if (_TRACE_REG_BYTES == 2)
+                    _trace_wr16(p, regs[i]);
+                    p += 2;
+                #else
+                    *p++ = (uint8_t)regs[i];
+                #endif
+                t->regs[i] = regs[i];
+            }
+        }
+    }
+    t->pos += (size_t)(p - start);
+    t->chunk_ops++;
+    t->index++;
+    t->next_pc = (uint16_t)(pc + fetch.num_bytes);
+}
+
+static void _trace_record_bus(trace_t* t, uint64_t tick, int type, uint16_t addr, uint8_t data) {
+    uint8_t* p = _trace_begin_record(t, (uint8_t)type, tick);
+    const uint8_t* start = _trace_chunk_ptr(t, t->chunk) + t->pos;
+    _trace_wr16(p, addr);
+    p[2] = data;
+    p += 3;
+    t->pos += (size_t)(p - start);
+}
+
+void trace_init(trace_t* t, const trace_desc_t* desc) {
+    CHIPS_ASSERT(t && desc);
+    #if defined(TRACE_USE_Z80)
+        CHIPS_ASSERT(desc->z80);
+    #else
+        CHIPS_ASSERT(desc->m6502);
+    #endif
+    CHIPS_ASSERT(desc->read_cb);
+    CHIPS_ASSERT(desc->buffer.ptr && (desc->buffer.size >= TRACE_CHUNK_SIZE));
+    CHIPS_ASSERT((desc->buffer.size % TRACE_CHUNK_SIZE) == 0);
+    memset(t, 0, sizeof(trace_t));
+    t->valid = true;
+    #if defined(TRACE_USE_Z80)
+        t->z80 = desc->z80;
+    #else
+        t->m6502 = desc->m6502;
+    #endif
+    t->read_cb = desc->read_cb;
+    t->user_data = desc->user_data;
+    t->write.func = desc->write.func;
+    t->write.user_data = desc->write.user_data;
+    t->buf = (uint8_t*) desc->buffer.ptr;
+    t->num_chunks = desc->buffer.size / TRACE_CHUNK_SIZE;
+    trace_reset(t);
+}
+
+void trace_discard(trace_t* t) {
+    CHIPS_ASSERT(t && t->valid);
+    t->valid = false;
+}
+
+void trace_reset(trace_t* t) {
+    CHIPS_ASSERT(t && t->valid);
+    t->chunk = 0;
+    t->num_full = 0;
+    t->tick = 0;
+    t->last_tick = 0;
+    t->index = 0;
+    _trace_read_regs(t, t->regs);
+    #if defined(TRACE_USE_Z80)
+        t->next_pc = t->z80->pc;
+    #else
+        t->next_pc = t->m6502->PC;
+    #endif
+    _trace_begin_chunk(t);
+}
+
+chips_debug_t trace_debug(trace_t* t) {
+    CHIPS_ASSERT(t && t->valid);
+    chips_debug_t debug;
+    memset(&debug, 0, sizeof(debug));
+    debug.callback.func = (chips_debug_func_t)trace_tick;
+    debug.callback.user_data = t;
+    debug.stopped = &t->stopped;
+    return debug;
+}
+
+void trace_tick(trace_t* t, uint64_t pins) {
+    const uint64_t tick = t->tick++;
+    #if defined(TRACE_USE_Z80)
+        if (z80_opdone(t->z80)) {
+            _trace_record_op(t, tick, Z80_GET_ADDR(pins));
+        }
+        else if ((pins & Z80_CTRL_PIN_MASK) == (Z80_MREQ|Z80_WR)) {
+            _trace_record_bus(t, tick, TRACE_ITEM_MEM_WRITE, Z80_GET_ADDR(pins), Z80_GET_DATA(pins));
+        }
+        else if ((pins & (Z80_IORQ|Z80_M1)) == Z80_IORQ) {
+            const int type = (pins & Z80_RD) ? TRACE_ITEM_IO_READ : TRACE_ITEM_IO_WRITE;
+            _trace_record_bus(t, tick, type, Z80_GET_ADDR(pins), Z80_GET_DATA(pins));
+        }
+    #else
+        if (pins & M6502_SYNC) {
+            _trace_record_op(t, tick, M6502_GET_ADDR(pins));
+        }
+        else if (!(pins & M6502_RW)) {
+            _trace_record_bus(t, tick, TRACE_ITEM_MEM_WRITE, M6502_GET_ADDR(pins), M6502_GET_DATA(pins));
+        }
+    #endif
+}
+
+void trace_flush(trace_t* t) {
+    CHIPS_ASSERT(t && t->valid);
+    if (t->write.func && (t->pos > TRACE_CHUNK_HEADER_SIZE)) {
+        _trace_next_chunk(t);
+    }
+}
+
+void trace_save(trace_t* t, trace_write_t func, void* user_data) {
+    CHIPS_ASSERT(t && t->valid && func);
+    const size_t first = (t->chunk + t->num_chunks - t->num_full) % t->num_chunks;
+    for (size_t i = 0; i < t->num_full; i++) {
+        const uint8_t* h = _trace_chunk_ptr(t, (first + i) % t->num_chunks);
+        func(h, TRACE_CHUNK_HEADER_SIZE + _trace_rd32(h + 8), user_data);
+    }
+    if (t->pos > TRACE_CHUNK_HEADER_SIZE) {
+        _trace_close_chunk(t);
+        func(_trace_chunk_ptr(t, t->chunk), t->pos, user_data);
+    }
+}
+
+#endif // TRACE_USE_Z80 || TRACE_USE_M6502
+#endif // CHIPS_UTIL_IMPL
@@ -20,7 +20,7 @@
 
     ## Usage
 
-    There's only one function to call which consumes a stream of instruction bytes
+    The original callback-driven function consumes a stream of instruction bytes
     and produces a stream of ASCII characters for exactly one instruction:
 
     ~~~C
@@ -44,6 +44,43 @@
     All undocumented instructions are supported, but are currently
     not marked as such.
 
+    ## Buffer-based API
+
+    When disassembling many instructions (for instance a debugger listing,
+    or a backward scan which only needs instruction lengths), it is
+    much faster to decode directly from a byte buffer into a
+    z80dasm_inst_t struct, and only build the text when needed:
+
+    ~~~C
+    int z80dasm_decode(uint16_t pc, const uint8_t* ptr, size_t num_bytes, z80dasm_inst_t* out_inst)
+    ~~~
+
+    Decodes one instruction from the bytes at ptr (which is located at
+    address pc), and returns the instruction length in bytes, or 0 if
+    num_bytes is too short to hold the complete instruction (at most
+    Z80DASM_MAX_BYTES bytes are needed). The decoded instruction contains
+    the mnemonic id (Z80DASM_MN_*), the operands, a control-flow
+    class (Z80DASM_FLOW_*) and the absolute target address for
+    direct jumps and calls.
+
+    ~~~C
+    int z80dasm_format(const z80dasm_inst_t* inst, char* buf, int buf_size)
+    ~~~
+
+    Writes the zero-terminated text of a decoded instruction into buf, and
+    returns the number of characters written (not including the terminating
+    zero). The output is identical with the output of z80dasm_op(). The text
+    is truncated if buf_size is smaller than Z80DASM_MAX_CHARS.
+
+    ~~~C
+    size_t z80dasm_range(const z80dasm_range_t* range)
+    ~~~
+
+    Decodes (and optionally formats) up to range->max_insts instructions
+    from a byte buffer in one go, stops at the first instruction
+    which doesn't completely fit into the buffer, and returns the
+    number of decoded instructions.
+
     ## Links
 
     The disassembler uses this decoding strategy:
@@ -69,18 +106,127 @@
         distribution. 
 #*/
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define Z80DASM_MAX_BYTES (5)       /* max length of an instruction (DD/FD prefix + ED op with 16-bit operand) */
+#define Z80DASM_MAX_CHARS (32)      /* max length of a formatted instruction, including terminating zero */
+#define Z80DASM_MAX_OPERANDS (3)    /* max number of operands (undocumented BIT/RES/SET n,(IX+d),r) */
+
+/* mnemonics */
+enum {
+    Z80DASM_MN_NOP, Z80DASM_MN_LD, Z80DASM_MN_EX, Z80DASM_MN_EXX, Z80DASM_MN_PUSH, Z80DASM_MN_POP,
+    Z80DASM_MN_ADD, Z80DASM_MN_ADC, Z80DASM_MN_SUB, Z80DASM_MN_SBC, Z80DASM_MN_AND, Z80DASM_MN_XOR,
+    Z80DASM_MN_OR, Z80DASM_MN_CP, Z80DASM_MN_INC, Z80DASM_MN_DEC, Z80DASM_MN_RLCA, Z80DASM_MN_RRCA,
+    Z80DASM_MN_RLA, Z80DASM_MN_RRA, Z80DASM_MN_DAA, Z80DASM_MN_CPL, Z80DASM_MN_SCF, Z80DASM_MN_CCF,
+    Z80DASM_MN_HALT, Z80DASM_MN_DI, Z80DASM_MN_EI, Z80DASM_MN_DJNZ, Z80DASM_MN_JR, Z80DASM_MN_JP,
+    Z80DASM_MN_CALL, Z80DASM_MN_RET, Z80DASM_MN_RETI, Z80DASM_MN_RETN, Z80DASM_MN_RST, Z80DASM_MN_IN,
+    Z80DASM_MN_OUT, Z80DASM_MN_RLC, Z80DASM_MN_RRC, Z80DASM_MN_RL, Z80DASM_MN_RR, Z80DASM_MN_SLA,
+    Z80DASM_MN_SRA, Z80DASM_MN_SLL, Z80DASM_MN_SRL, Z80DASM_MN_BIT, Z80DASM_MN_RES, Z80DASM_MN_SET,
+    Z80DASM_MN_NEG, Z80DASM_MN_IM, Z80DASM_MN_RRD, Z80DASM_MN_RLD, Z80DASM_MN_LDI, Z80DASM_MN_CPI,
+    Z80DASM_MN_INI, Z80DASM_MN_OUTI, Z80DASM_MN_LDD, Z80DASM_MN_CPD, Z80DASM_MN_IND, Z80DASM_MN_OUTD,
+    Z80DASM_MN_LDIR, Z80DASM_MN_CPIR, Z80DASM_MN_INIR, Z80DASM_MN_OTIR, Z80DASM_MN_LDDR, Z80DASM_MN_CPDR,
+    Z80DASM_MN_INDR, Z80DASM_MN_OTDR,
+    Z80DASM_MN_NOP_ED,      /* invalid ED-prefixed op: "NOP (ED)" */
+    Z80DASM_MN_DBL_PREFIX,  /* DD/FD prefix followed by another DD/FD prefix */
+    Z80DASM_MN_NUM,
+};
+
+/* operand types */
+enum {
+    Z80DASM_OPERAND_NONE,
+    Z80DASM_OPERAND_REG,    /* register: reg */
+    Z80DASM_OPERAND_IND,    /* register indirect: (reg) */
+    Z80DASM_OPERAND_IDX,    /* indexed: (reg+val), reg is IX or IY, val is the signed displacement */
+    Z80DASM_OPERAND_IMM8,   /* 8-bit immediate value: val */
+    Z80DASM_OPERAND_IMM16,  /* 16-bit immediate value: val */
+    Z80DASM_OPERAND_MEM,    /* absolute memory address: (val) */
+    Z80DASM_OPERAND_PORT,   /* 8-bit IO port: (val) */
+    Z80DASM_OPERAND_ADDR,   /* jump or call target address: val */
+    Z80DASM_OPERAND_COND,   /* condition code: reg is Z80DASM_COND_* */
+    Z80DASM_OPERAND_NUM,    /* small decimal number (bit index, interrupt mode, OUT (C),0): val */
+};
+
+/* registers */
+enum {
+    Z80DASM_REG_B, Z80DASM_REG_C, Z80DASM_REG_D, Z80DASM_REG_E,
+    Z80DASM_REG_H, Z80DASM_REG_L, Z80DASM_REG_A, Z80DASM_REG_I, Z80DASM_REG_R,
+    Z80DASM_REG_IXH, Z80DASM_REG_IXL, Z80DASM_REG_IYH, Z80DASM_REG_IYL,
+    Z80DASM_REG_BC, Z80DASM_REG_DE, Z80DASM_REG_HL, Z80DASM_REG_SP,
+    Z80DASM_REG_AF, Z80DASM_REG_AF2, Z80DASM_REG_IX, Z80DASM_REG_IY,
+    Z80DASM_REG_NUM,
+};
+
+/* condition codes */
+enum {
+    Z80DASM_COND_NZ, Z80DASM_COND_Z, Z80DASM_COND_NC, Z80DASM_COND_C,
+    Z80DASM_COND_PO, Z80DASM_COND_PE, Z80DASM_COND_P, Z80DASM_COND_M,
+};
+
+/* control-flow classes */
+enum {
+    Z80DASM_FLOW_NONE,      /* not a control-flow instruction */
+    Z80DASM_FLOW_JUMP,      /* unconditional jump: JP nn, JR d */
+    Z80DASM_FLOW_JUMP_COND, /* conditional jump: JP cc,nn, JR cc,d, DJNZ d */
+    Z80DASM_FLOW_JUMP_IND,  /* indirect jump without known target: JP (HL), JP (IX), JP (IY) */
+    Z80DASM_FLOW_CALL,      /* unconditional call: CALL nn, RST n */
+    Z80DASM_FLOW_CALL_COND, /* conditional call: CALL cc,nn */
+    Z80DASM_FLOW_RET,       /* unconditional return: RET, RETI, RETN */
+    Z80DASM_FLOW_RET_COND,  /* conditional return: RET cc */
+    Z80DASM_FLOW_HALT,      /* HALT */
+};
+
 /* the input callback type */
 typedef uint8_t (*z80dasm_input_t)(void* user_data);
 /* the output callback type */
 typedef void (*z80dasm_output_t)(char c, void* user_data);
 
+/* a decoded instruction operand */
+typedef struct {
+    uint8_t type;           /* Z80DASM_OPERAND_* */
+    uint8_t reg;            /* Z80DASM_REG_* or Z80DASM_COND_* */
+    int32_t val;            /* immediate value, address, displacement or number */
+} z80dasm_operand_t;
+
+/* a decoded instruction */
+typedef struct {
+    uint16_t addr;          /* address of the first instruction byte */
+    uint16_t target;        /* target address (only valid for JUMP, JUMP_COND, CALL and CALL_COND flow) */
+    uint8_t len;            /* instruction length in bytes */
+    uint8_t mnemonic;       /* Z80DASM_MN_* */
+    uint8_t flow;           /* Z80DASM_FLOW_* */
+    z80dasm_operand_t operands[Z80DASM_MAX_OPERANDS];
+} z80dasm_inst_t;
+
+/* text output item for z80dasm_range() */
+typedef struct {
+    char chars[Z80DASM_MAX_CHARS];
+} z80dasm_text_t;
+
+/* parameters for z80dasm_range() */
+typedef struct {
+    uint16_t pc;                /* address of the first byte at ptr */
+    const uint8_t* ptr;         /* pointer to instruction bytes */
+    size_t num_bytes;           /* number of bytes at ptr */
+    z80dasm_inst_t* out_insts;  /* decoded instructions, must have room for max_insts items */
+    z80dasm_text_t* out_text;   /* optional formatted instructions, must have room for max_insts items */
+    size_t max_insts;           /* max number of instructions to decode */
+} z80dasm_range_t;
+
 /* disassemble a single Z80 instruction into a stream of ASCII characters */
 uint16_t z80dasm_op(uint16_t pc, z80dasm_input_t in_cb, z80dasm_output_t out_cb, void* user_data);
+/* decode a single instruction from a byte buffer, returns instruction length, or 0 if the buffer is too short */
+int z80dasm_decode(uint16_t pc, const uint8_t* ptr, size_t num_bytes, z80dasm_inst_t* out_inst);
+/* format a decoded instruction into a zero-terminated string, returns string length */
+int z80dasm_format(const z80dasm_inst_t* inst, char* buf, int buf_size);
+/* decode (and optionally format) consecutive instructions, returns number of decoded instructions */
+size_t z80dasm_range(const z80dasm_range_t* range);
+/* return the name of a mnemonic */
+const char* z80dasm_mnemonic_name(int mnemonic);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -200,8 +346,9 @@ static void _z80dasm_str(const char* str, z80dasm_output_t out_cb, void* user_da
 }
 
 /* output a signed 8-bit offset value as decimal string */
-static void _z80dasm_d8(int8_t val, z80dasm_output_t out_cb, void* user_data) {
+static void _z80dasm_d8(int8_t d8, z80dasm_output_t out_cb, void* user_data) {
     if (out_cb) {
+        int val = d8;
         if (val < 0) {
             out_cb('-', user_data);
             val = -val;
@@ -211,10 +358,9 @@ static void _z80dasm_d8(int8_t val, z80dasm_output_t out_cb, void* user_data) {
         }
         if (val >= 100) {
             out_cb('1', user_data);
-            val -= 100;
         }
-        if ((val/10) != 0) {
-            out_cb(_z80dasm_dec[val/10], user_data);
+        if (val >= 10) {
+            out_cb(_z80dasm_dec[(val/10)%10], user_data);
         }
         out_cb(_z80dasm_dec[val%10], user_data);
     }
@@ -475,6 +621,536 @@ uint16_t z80dasm_op(uint16_t pc, z80dasm_input_t in_cb, z80dasm_output_t out_cb,
     return pc;
 }
 
+/*-- buffer-based decoder ----------------------------------------------------*/
+
+/* operand templates in the decoder tables */
+enum {
+    _Z80DASM_O_NONE,
+    _Z80DASM_O_RY,      /* r[y] */
+    _Z80DASM_O_RZ,      /* r[z] */
+    _Z80DASM_O_RY_,     /* r[y], H/L not replaced with IXH/IXL */
+    _Z80DASM_O_RZ_,     /* r[z], H/L not replaced with IXH/IXL */
+    _Z80DASM_O_RP,      /* rp[p] */
+    _Z80DASM_O_RP2,     /* rp2[p] */
+    _Z80DASM_O_HL,      /* HL, IX or IY */
+    _Z80DASM_O_HL_,     /* HL, not replaced with IX/IY */
+    _Z80DASM_O_A,
+    _Z80DASM_O_I,
+    _Z80DASM_O_R,
+    _Z80DASM_O_DE,
+    _Z80DASM_O_SP,
+    _Z80DASM_O_AF,
+    _Z80DASM_O_AF2,
+    _Z80DASM_O_IHL,     /* (HL), (IX) or (IY) without displacement */
+    _Z80DASM_O_IBC,     /* (BC) */
+    _Z80DASM_O_IDE,     /* (DE) */
+    _Z80DASM_O_ISP,     /* (SP) */
+    _Z80DASM_O_IC,      /* (C) */
+    _Z80DASM_O_CC,      /* cc[y] */
+    _Z80DASM_O_CC4,     /* cc[y-4] */
+    _Z80DASM_O_N,       /* 8-bit immediate */
+    _Z80DASM_O_NN,      /* 16-bit immediate */
+    _Z80DASM_O_MNN,     /* (nn) */
+    _Z80DASM_O_PN,      /* (n) */
+    _Z80DASM_O_ABS,     /* absolute jump target */
+    _Z80DASM_O_REL,     /* relative jump target */
+    _Z80DASM_O_RST,     /* RST target y*8 */
+    _Z80DASM_O_IM,      /* interrupt mode */
+    _Z80DASM_O_ZERO,    /* the 0 in OUT (C),0 */
+};
+
+/* table markers for the CB and ED prefixes */
+enum {
+    _Z80DASM_MN_CB = Z80DASM_MN_NUM,
+    _Z80DASM_MN_ED,
+};
+
+/* an instruction description in the decoder tables */
+typedef struct {
+    uint8_t mn;
+    uint8_t op[2];
+    uint8_t flow;
+} _z80dasm_desc_t;
+
+#define _ZD(mn,o1,o2,fl) { Z80DASM_MN_##mn, { _Z80DASM_O_##o1, _Z80DASM_O_##o2 }, Z80DASM_FLOW_##fl }
+#define _ZP(mn) { mn, { _Z80DASM_O_NONE, _Z80DASM_O_NONE }, Z80DASM_FLOW_NONE }
+
+/* x=0 instructions, indexed by [z][y] */
+static const _z80dasm_desc_t _z80dasm_x0[8][8] = {
+    { _ZD(NOP,NONE,NONE,NONE), _ZD(EX,AF,AF2,NONE), _ZD(DJNZ,REL,NONE,JUMP_COND), _ZD(JR,REL,NONE,JUMP),
+      _ZD(JR,CC4,REL,JUMP_COND), _ZD(JR,CC4,REL,JUMP_COND), _ZD(JR,CC4,REL,JUMP_COND), _ZD(JR,CC4,REL,JUMP_COND) },
+    { _ZD(LD,RP,NN,NONE), _ZD(ADD,HL,RP,NONE), _ZD(LD,RP,NN,NONE), _ZD(ADD,HL,RP,NONE),
+      _ZD(LD,RP,NN,NONE), _ZD(ADD,HL,RP,NONE), _ZD(LD,RP,NN,NONE), _ZD(ADD,HL,RP,NONE) },
+    { _ZD(LD,IBC,A,NONE), _ZD(LD,A,IBC,NONE), _ZD(LD,IDE,A,NONE), _ZD(LD,A,IDE,NONE),
+      _ZD(LD,MNN,HL,NONE), _ZD(LD,HL,MNN,NONE), _ZD(LD,MNN,A,NONE), _ZD(LD,A,MNN,NONE) },
+    { _ZD(INC,RP,NONE,NONE), _ZD(DEC,RP,NONE,NONE), _ZD(INC,RP,NONE,NONE), _ZD(DEC,RP,NONE,NONE),
+      _ZD(INC,RP,NONE,NONE), _ZD(DEC,RP,NONE,NONE), _ZD(INC,RP,NONE,NONE), _ZD(DEC,RP,NONE,NONE) },
+    { _ZD(INC,RY,NONE,NONE), _ZD(INC,RY,NONE,NONE), _ZD(INC,RY,NONE,NONE), _ZD(INC,RY,NONE,NONE),
+      _ZD(INC,RY,NONE,NONE), _ZD(INC,RY,NONE,NONE), _ZD(INC,RY,NONE,NONE), _ZD(INC,RY,NONE,NONE) },
+    { _ZD(DEC,RY,NONE,NONE), _ZD(DEC,RY,NONE,NONE), _ZD(DEC,RY,NONE,NONE), _ZD(DEC,RY,NONE,NONE),
+      _ZD(DEC,RY,NONE,NONE), _ZD(DEC,RY,NONE,NONE), _ZD(DEC,RY,NONE,NONE), _ZD(DEC,RY,NONE,NONE) },
+    { _ZD(LD,RY,N,NONE), _ZD(LD,RY,N,NONE), _ZD(LD,RY,N,NONE), _ZD(LD,RY,N,NONE),
+      _ZD(LD,RY,N,NONE), _ZD(LD,RY,N,NONE), _ZD(LD,RY,N,NONE), _ZD(LD,RY,N,NONE) },
+    { _ZD(RLCA,NONE,NONE,NONE), _ZD(RRCA,NONE,NONE,NONE), _ZD(RLA,NONE,NONE,NONE), _ZD(RRA,NONE,NONE,NONE),
+      _ZD(DAA,NONE,NONE,NONE), _ZD(CPL,NONE,NONE,NONE), _ZD(SCF,NONE,NONE,NONE), _ZD(CCF,NONE,NONE,NONE) },
+};
+
+/* x=2 instructions (8-bit ALU with register), indexed by [y] */
+static const _z80dasm_desc_t _z80dasm_x2[8] = {
+    _ZD(ADD,A,RZ,NONE), _ZD(ADC,A,RZ,NONE), _ZD(SUB,RZ,NONE,NONE), _ZD(SBC,A,RZ,NONE),
+    _ZD(AND,RZ,NONE,NONE), _ZD(XOR,RZ,NONE,NONE), _ZD(OR,RZ,NONE,NONE), _ZD(CP,RZ,NONE,NONE),
+};
+
+/* x=3 instructions, indexed by [z][y] */
+static const _z80dasm_desc_t _z80dasm_x3[8][8] = {
+    { _ZD(RET,CC,NONE,RET_COND), _ZD(RET,CC,NONE,RET_COND), _ZD(RET,CC,NONE,RET_COND), _ZD(RET,CC,NONE,RET_COND),
+      _ZD(RET,CC,NONE,RET_COND), _ZD(RET,CC,NONE,RET_COND), _ZD(RET,CC,NONE,RET_COND), _ZD(RET,CC,NONE,RET_COND) },
+    { _ZD(POP,RP2,NONE,NONE), _ZD(RET,NONE,NONE,RET), _ZD(POP,RP2,NONE,NONE), _ZD(EXX,NONE,NONE,NONE),
+      _ZD(POP,RP2,NONE,NONE), _ZD(JP,IHL,NONE,JUMP_IND), _ZD(POP,RP2,NONE,NONE), _ZD(LD,SP,HL,NONE) },
+    { _ZD(JP,CC,ABS,JUMP_COND), _ZD(JP,CC,ABS,JUMP_COND), _ZD(JP,CC,ABS,JUMP_COND), _ZD(JP,CC,ABS,JUMP_COND),
+      _ZD(JP,CC,ABS,JUMP_COND), _ZD(JP,CC,ABS,JUMP_COND), _ZD(JP,CC,ABS,JUMP_COND), _ZD(JP,CC,ABS,JUMP_COND) },
+    { _ZD(JP,ABS,NONE,JUMP), _ZP(_Z80DASM_MN_CB), _ZD(OUT,PN,A,NONE), _ZD(IN,A,PN,NONE),
+      _ZD(EX,ISP,HL,NONE), _ZD(EX,DE,HL_,NONE), _ZD(DI,NONE,NONE,NONE), _ZD(EI,NONE,NONE,NONE) },
+    { _ZD(CALL,CC,ABS,CALL_COND), _ZD(CALL,CC,ABS,CALL_COND), _ZD(CALL,CC,ABS,CALL_COND), _ZD(CALL,CC,ABS,CALL_COND),
+      _ZD(CALL,CC,ABS,CALL_COND), _ZD(CALL,CC,ABS,CALL_COND), _ZD(CALL,CC,ABS,CALL_COND), _ZD(CALL,CC,ABS,CALL_COND) },
+    { _ZD(PUSH,RP2,NONE,NONE), _ZD(CALL,ABS,NONE,CALL), _ZD(PUSH,RP2,NONE,NONE), _ZD(DBL_PREFIX,NONE,NONE,NONE),
+      _ZD(PUSH,RP2,NONE,NONE), _ZP(_Z80DASM_MN_ED), _ZD(PUSH,RP2,NONE,NONE), _ZD(DBL_PREFIX,NONE,NONE,NONE) },
+    { _ZD(ADD,A,N,NONE), _ZD(ADC,A,N,NONE), _ZD(SUB,N,NONE,NONE), _ZD(SBC,A,N,NONE),
+      _ZD(AND,N,NONE,NONE), _ZD(XOR,N,NONE,NONE), _ZD(OR,N,NONE,NONE), _ZD(CP,N,NONE,NONE) },
+    { _ZD(RST,RST,NONE,CALL), _ZD(RST,RST,NONE,CALL), _ZD(RST,RST,NONE,CALL), _ZD(RST,RST,NONE,CALL),
+      _ZD(RST,RST,NONE,CALL), _ZD(RST,RST,NONE,CALL), _ZD(RST,RST,NONE,CALL), _ZD(RST,RST,NONE,CALL) },
+};
+
+/* ED-prefixed x=1 instructions, indexed by [z][y] */
+static const _z80dasm_desc_t _z80dasm_ed1[8][8] = {
+    { _ZD(IN,RY,IC,NONE), _ZD(IN,RY,IC,NONE), _ZD(IN,RY,IC,NONE), _ZD(IN,RY,IC,NONE),
+      _ZD(IN,RY,IC,NONE), _ZD(IN,RY,IC,NONE), _ZD(IN,IC,NONE,NONE), _ZD(IN,RY,IC,NONE) },
+    { _ZD(OUT,IC,RY,NONE), _ZD(OUT,IC,RY,NONE), _ZD(OUT,IC,RY,NONE), _ZD(OUT,IC,RY,NONE),
+      _ZD(OUT,IC,RY,NONE), _ZD(OUT,IC,RY,NONE), _ZD(OUT,IC,ZERO,NONE), _ZD(OUT,IC,RY,NONE) },
+    { _ZD(SBC,HL_,RP,NONE), _ZD(ADC,HL_,RP,NONE), _ZD(SBC,HL_,RP,NONE), _ZD(ADC,HL_,RP,NONE),
+      _ZD(SBC,HL_,RP,NONE), _ZD(ADC,HL_,RP,NONE), _ZD(SBC,HL_,RP,NONE), _ZD(ADC,HL_,RP,NONE) },
+    { _ZD(LD,MNN,RP,NONE), _ZD(LD,RP,MNN,NONE), _ZD(LD,MNN,RP,NONE), _ZD(LD,RP,MNN,NONE),
+      _ZD(LD,MNN,RP,NONE), _ZD(LD,RP,MNN,NONE), _ZD(LD,MNN,RP,NONE), _ZD(LD,RP,MNN,NONE) },
+    { _ZD(NEG,NONE,NONE,NONE), _ZD(NEG,NONE,NONE,NONE), _ZD(NEG,NONE,NONE,NONE), _ZD(NEG,NONE,NONE,NONE),
+      _ZD(NEG,NONE,NONE,NONE), _ZD(NEG,NONE,NONE,NONE), _ZD(NEG,NONE,NONE,NONE), _ZD(NEG,NONE,NONE,NONE) },
+    { _ZD(RETN,NONE,NONE,RET), _ZD(RETI,NONE,NONE,RET), _ZD(RETN,NONE,NONE,RET), _ZD(RETN,NONE,NONE,RET),
+      _ZD(RETN,NONE,NONE,RET), _ZD(RETN,NONE,NONE,RET), _ZD(RETN,NONE,NONE,RET), _ZD(RETN,NONE,NONE,RET) },
+    { _ZD(IM,IM,NONE,NONE), _ZD(IM,IM,NONE,NONE), _ZD(IM,IM,NONE,NONE), _ZD(IM,IM,NONE,NONE),
+      _ZD(IM,IM,NONE,NONE), _ZD(IM,IM,NONE,NONE), _ZD(IM,IM,NONE,NONE), _ZD(IM,IM,NONE,NONE) },
+    { _ZD(LD,I,A,NONE), _ZD(LD,R,A,NONE), _ZD(LD,A,I,NONE), _ZD(LD,A,R,NONE),
+      _ZD(RRD,NONE,NONE,NONE), _ZD(RLD,NONE,NONE,NONE), _ZD(NOP_ED,NONE,NONE,NONE), _ZD(NOP_ED,NONE,NONE,NONE) },
+};
+
+/* the remaining instructions which don't fit into a table */
+static const _z80dasm_desc_t _z80dasm_halt = _ZD(HALT,NONE,NONE,HALT);
+static const _z80dasm_desc_t _z80dasm_ld_rr[3] = { _ZD(LD,RY,RZ,NONE), _ZD(LD,RY,RZ_,NONE), _ZD(LD,RY_,RZ,NONE) };
+static const _z80dasm_desc_t _z80dasm_nop_ed = _ZD(NOP_ED,NONE,NONE,NONE);
+static const uint8_t _z80dasm_bli_mn[4][4] = {
+    { Z80DASM_MN_LDI, Z80DASM_MN_CPI, Z80DASM_MN_INI, Z80DASM_MN_OUTI },
+    { Z80DASM_MN_LDD, Z80DASM_MN_CPD, Z80DASM_MN_IND, Z80DASM_MN_OUTD },
+    { Z80DASM_MN_LDIR, Z80DASM_MN_CPIR, Z80DASM_MN_INIR, Z80DASM_MN_OTIR },
+    { Z80DASM_MN_LDDR, Z80DASM_MN_CPDR, Z80DASM_MN_INDR, Z80DASM_MN_OTDR }
+};
+static const uint8_t _z80dasm_rot_mn[8] = {
+    Z80DASM_MN_RLC, Z80DASM_MN_RRC, Z80DASM_MN_RL, Z80DASM_MN_RR,
+    Z80DASM_MN_SLA, Z80DASM_MN_SRA, Z80DASM_MN_SLL, Z80DASM_MN_SRL
+};
+static const uint8_t _z80dasm_bit_mn[3] = { Z80DASM_MN_BIT, Z80DASM_MN_RES, Z80DASM_MN_SET };
+static const uint8_t _z80dasm_r_reg[8] = {
+    Z80DASM_REG_B, Z80DASM_REG_C, Z80DASM_REG_D, Z80DASM_REG_E,
+    Z80DASM_REG_H, Z80DASM_REG_L, Z80DASM_REG_HL, Z80DASM_REG_A
+};
+static const uint8_t _z80dasm_rp_reg[4] = { Z80DASM_REG_BC, Z80DASM_REG_DE, Z80DASM_REG_HL, Z80DASM_REG_SP };
+static const uint8_t _z80dasm_rp2_reg[4] = { Z80DASM_REG_BC, Z80DASM_REG_DE, Z80DASM_REG_HL, Z80DASM_REG_AF };
+static const uint8_t _z80dasm_im_num[8] = { 0, 0, 1, 2, 0, 0, 1, 2 };
+
+static const char* _z80dasm_mn_names[Z80DASM_MN_NUM] = {
+    "NOP", "LD", "EX", "EXX", "PUSH", "POP", "ADD", "ADC", "SUB", "SBC", "AND", "XOR", "OR", "CP",
+    "INC", "DEC", "RLCA", "RRCA", "RLA", "RRA", "DAA", "CPL", "SCF", "CCF", "HALT", "DI", "EI",
+    "DJNZ", "JR", "JP", "CALL", "RET", "RETI", "RETN", "RST", "IN", "OUT", "RLC", "RRC", "RL", "RR",
+    "SLA", "SRA", "SLL", "SRL", "BIT", "RES", "SET", "NEG", "IM", "RRD", "RLD", "LDI", "CPI", "INI",
+    "OUTI", "LDD", "CPD", "IND", "OUTD", "LDIR", "CPIR", "INIR", "OTIR", "LDDR", "CPDR", "INDR", "OTDR",
+    "NOP (ED)", "DBL PREFIX"
+};
+static const char* _z80dasm_reg_names[Z80DASM_REG_NUM] = {
+    "B", "C", "D", "E", "H", "L", "A", "I", "R", "IXH", "IXL", "IYH", "IYL",
+    "BC", "DE", "HL", "SP", "AF", "AF'", "IX", "IY"
+};
+
+/* decoder state */
+typedef struct {
+    const uint8_t* ptr;
+    size_t num_bytes;
+    size_t pos;
+    uint16_t pc;
+    uint8_t pre;
+    uint8_t y, z, p;
+    z80dasm_inst_t* inst;
+} _z80dasm_dec_t;
+
+/* fetch the next instruction byte, return false if the end of the buffer is reached */
+static inline bool _z80dasm_fetch(_z80dasm_dec_t* dec, uint8_t* out) {
+    if (dec->pos >= dec->num_bytes) {
+        return false;
+    }
+    *out = dec->ptr[dec->pos++];
+    return true;
+}
+
+static inline void _z80dasm_set(z80dasm_operand_t* op, uint8_t type, uint8_t reg, int32_t val) {
+    op->type = type;
+    op->reg = reg;
+    op->val = val;
+}
+
+/* HL, or IX/IY if prefixed */
+static inline uint8_t _z80dasm_hl(const _z80dasm_dec_t* dec) {
+    return (dec->pre == 0xDD) ? Z80DASM_REG_IX : ((dec->pre == 0xFD) ? Z80DASM_REG_IY : Z80DASM_REG_HL);
+}
+
+/* resolve r[i] into (HL), (IX+d), (IY+d) or a register */
+static inline bool _z80dasm_reg8(_z80dasm_dec_t* dec, uint8_t i, bool replace_hl, z80dasm_operand_t* op) {
+    if (i == 6) {
+        if (dec->pre) {
+            uint8_t d;
+            if (!_z80dasm_fetch(dec, &d)) {
+                return false;
+            }
+            _z80dasm_set(op, Z80DASM_OPERAND_IDX, _z80dasm_hl(dec), (int8_t)d);
+        }
+        else {
+            _z80dasm_set(op, Z80DASM_OPERAND_IND, Z80DASM_REG_HL, 0);
+        }
+    }
+    else if (replace_hl && dec->pre && ((i == 4) || (i == 5))) {
+        const uint8_t reg = (dec->pre == 0xDD) ? Z80DASM_REG_IXH : Z80DASM_REG_IYH;
+        _z80dasm_set(op, Z80DASM_OPERAND_REG, reg + (i - 4), 0);
+    }
+    else {
+        _z80dasm_set(op, Z80DASM_OPERAND_REG, _z80dasm_r_reg[i], 0);
+    }
+    return true;
+}
+
+/* resolve an operand template, fetching operand bytes as needed */
+static bool _z80dasm_operand(_z80dasm_dec_t* dec, uint8_t tmpl, z80dasm_operand_t* op) {
+    uint8_t l, h;
+    switch (tmpl) {
+        case _Z80DASM_O_NONE: break;
+        case _Z80DASM_O_RY:   return _z80dasm_reg8(dec, dec->y, true, op);
+        case _Z80DASM_O_RZ:   return _z80dasm_reg8(dec, dec->z, true, op);
+        case _Z80DASM_O_RY_:  return _z80dasm_reg8(dec, dec->y, false, op);
+        case _Z80DASM_O_RZ_:  return _z80dasm_reg8(dec, dec->z, false, op);
+        case _Z80DASM_O_RP:   _z80dasm_set(op, Z80DASM_OPERAND_REG, (dec->p == 2) ? _z80dasm_hl(dec) : _z80dasm_rp_reg[dec->p], 0); break;
+        case _Z80DASM_O_RP2:  _z80dasm_set(op, Z80DASM_OPERAND_REG, (dec->p == 2) ? _z80dasm_hl(dec) : _z80dasm_rp2_reg[dec->p], 0); break;
+        case _Z80DASM_O_HL:   _z80dasm_set(op, Z80DASM_OPERAND_REG, _z80dasm_hl(dec), 0); break;
+        case _Z80DASM_O_HL_:  _z80dasm_set(op, Z80DASM_OPERAND_REG, Z80DASM_REG_HL, 0); break;
+        case _Z80DASM_O_A:    _z80dasm_set(op, Z80DASM_OPERAND_REG, Z80DASM_REG_A, 0); break;
+        case _Z80DASM_O_I:    _z80dasm_set(op, Z80DASM_OPERAND_REG, Z80DASM_REG_I, 0); break;
+        case _Z80DASM_O_R:    _z80dasm_set(op, Z80DASM_OPERAND_REG, Z80DASM_REG_R, 0); break;
+        case _Z80DASM_O_DE:   _z80dasm_set(op, Z80DASM_OPERAND_REG, Z80DASM_REG_DE, 0); break;
+        case _Z80DASM_O_SP:   _z80dasm_set(op, Z80DASM_OPERAND_REG, Z80DASM_REG_SP, 0); break;
+        case _Z80DASM_O_AF:   _z80dasm_set(op, Z80DASM_OPERAND_REG, Z80DASM_REG_AF, 0); break;
+        case _Z80DASM_O_AF2:  _z80dasm_set(op, Z80DASM_OPERAND_REG, Z80DASM_REG_AF2, 0); break;
+        case _Z80DASM_O_IHL:  _z80dasm_set(op, Z80DASM_OPERAND_IND, _z80dasm_hl(dec), 0); break;
+        case _Z80DASM_O_IBC:  _z80dasm_set(op, Z80DASM_OPERAND_IND, Z80DASM_REG_BC, 0); break;
+        case _Z80DASM_O_IDE:  _z80dasm_set(op, Z80DASM_OPERAND_IND, Z80DASM_REG_DE, 0); break;
+        case _Z80DASM_O_ISP:  _z80dasm_set(op, Z80DASM_OPERAND_IND, Z80DASM_REG_SP, 0); break;
+        case _Z80DASM_O_IC:   _z80dasm_set(op, Z80DASM_OPERAND_IND, Z80DASM_REG_C, 0); break;
+        case _Z80DASM_O_CC:   _z80dasm_set(op, Z80DASM_OPERAND_COND, dec->y, 0); break;
+        case _Z80DASM_O_CC4:  _z80dasm_set(op, Z80DASM_OPERAND_COND, dec->y - 4, 0); break;
+        case _Z80DASM_O_IM:   _z80dasm_set(op, Z80DASM_OPERAND_NUM, 0, _z80dasm_im_num[dec->y]); break;
+        case _Z80DASM_O_ZERO: _z80dasm_set(op, Z80DASM_OPERAND_NUM, 0, 0); break;
+        case _Z80DASM_O_RST:
+            _z80dasm_set(op, Z80DASM_OPERAND_IMM8, 0, dec->y * 8);
+            dec->inst->target = dec->y * 8;
+            break;
+        case _Z80DASM_O_N:
+        case _Z80DASM_O_PN:
+            if (!_z80dasm_fetch(dec, &l)) {
+                return false;
+            }
+            _z80dasm_set(op, (tmpl == _Z80DASM_O_N) ? Z80DASM_OPERAND_IMM8 : Z80DASM_OPERAND_PORT, 0, l);
+            break;
+        case _Z80DASM_O_REL:
+            if (!_z80dasm_fetch(dec, &l)) {
+                return false;
+            }
+            dec->inst->target = (uint16_t)(dec->pc + dec->pos + (int8_t)l);
+            _z80dasm_set(op, Z80DASM_OPERAND_ADDR, 0, dec->inst->target);
+            break;
+        default:
+            /* 16-bit operands */
+            if (!_z80dasm_fetch(dec, &l) || !_z80dasm_fetch(dec, &h)) {
+                return false;
+            }
+            switch (tmpl) {
+                case _Z80DASM_O_NN:  _z80dasm_set(op, Z80DASM_OPERAND_IMM16, 0, (h<<8)|l); break;
+                case _Z80DASM_O_MNN: _z80dasm_set(op, Z80DASM_OPERAND_MEM, 0, (h<<8)|l); break;
+                default:
+                    dec->inst->target = (uint16_t)((h<<8)|l);
+                    _z80dasm_set(op, Z80DASM_OPERAND_ADDR, 0, dec->inst->target);
+                    break;
+            }
+            break;
+    }
+    return true;
+}
+
+/* decode CB-prefixed instructions (rotate, shift and bit ops) */
+static bool _z80dasm_decode_cb(_z80dasm_dec_t* dec) {
+    z80dasm_inst_t* inst = dec->inst;
+    uint8_t d = 0, op;
+    if (dec->pre && !_z80dasm_fetch(dec, &d)) {
+        return false;
+    }
+    if (!_z80dasm_fetch(dec, &op)) {
+        return false;
+    }
+    const uint8_t x = op >> 6;
+    const uint8_t y = (op >> 3) & 7;
+    const uint8_t z = op & 7;
+    z80dasm_operand_t* ops = inst->operands;
+    if (x == 0) {
+        inst->mnemonic = _z80dasm_rot_mn[y];
+        if (dec->pre && (z == 6)) {
+            _z80dasm_set(&ops[0], Z80DASM_OPERAND_IDX, _z80dasm_hl(dec), (int8_t)d);
+        }
+        else {
+            _z80dasm_reg8(dec, z, true, &ops[0]);
+        }
+    }
+    else {
+        inst->mnemonic = _z80dasm_bit_mn[x - 1];
+        _z80dasm_set(&ops[0], Z80DASM_OPERAND_NUM, 0, y);
+        if (dec->pre) {
+            _z80dasm_set(&ops[1], Z80DASM_OPERAND_IDX, _z80dasm_hl(dec), (int8_t)d);
+            if (z != 6) {
+                _z80dasm_reg8(dec, z, true, &ops[2]);
+            }
+        }
+        else {
+            _z80dasm_reg8(dec, z, true, &ops[1]);
+        }
+    }
+    return true;
+}
+
+int z80dasm_decode(uint16_t pc, const uint8_t* ptr, size_t num_bytes, z80dasm_inst_t* out_inst) {
+    CHIPS_ASSERT(ptr && out_inst);
+    /* the instruction is built in the decoder state and copied out at the end,
+       stores through an outside pointer would force reloads of the decoder state
+    */
+    _z80dasm_dec_t dec;
+    dec.ptr = ptr;
+    dec.num_bytes = num_bytes;
+    dec.pos = 0;
+    dec.pc = pc;
+    dec.pre = 0;
+    z80dasm_inst_t* inst = out_inst; dec.inst = inst;
+    inst->addr = pc;
+    inst->target = 0;
+    inst->len = 0;
+    inst->flow = Z80DASM_FLOW_NONE;
+    for (int i = 0; i < Z80DASM_MAX_OPERANDS; i++) {
+        _z80dasm_set(&inst->operands[i], Z80DASM_OPERAND_NONE, 0, 0);
+    }
+
+    uint8_t op;
+    if (!_z80dasm_fetch(&dec, &op)) {
+        return 0;
+    }
+    if ((0xFD == op) || (0xDD == op)) {
+        dec.pre = op;
+        if (!_z80dasm_fetch(&dec, &op)) {
+            return 0;
+        }
+        if (op == 0xED) {
+            dec.pre = 0; /* an ED following a prefix cancels the prefix */
+        }
+    }
+    uint8_t x = op >> 6;
+    dec.y = (op >> 3) & 7;
+    dec.z = op & 7;
+    dec.p = dec.y >> 1;
+    const _z80dasm_desc_t* desc;
+    _z80dasm_desc_t bli;
+    switch (x) {
+        case 0: desc = &_z80dasm_x0[dec.z][dec.y]; break;
+        case 1:
+            /* LD r,s, special case LD (HL),(HL) is HALT, and LD H/L,(IX+d)/LD (IX+d),H/L don't use IXH/IXL */
+            if ((dec.y == 6) && (dec.z == 6)) {
+                desc = &_z80dasm_halt;
+            }
+            else {
+                desc = &_z80dasm_ld_rr[(dec.y == 6) ? 1 : ((dec.z == 6) ? 2 : 0)];
+            }
+            break;
+        case 2: desc = &_z80dasm_x2[dec.y]; break;
+        default:
+            desc = &_z80dasm_x3[dec.z][dec.y];
+            if (desc->mn == _Z80DASM_MN_CB) {
+                if (!_z80dasm_decode_cb(&dec)) {
+                    return 0;
+                }
+                inst->len = (uint8_t)dec.pos;
+                                return inst->len;
+            }
+            else if (desc->mn == _Z80DASM_MN_ED) {
+                if (!_z80dasm_fetch(&dec, &op)) {
+                    return 0;
+                }
+                x = op >> 6;
+                dec.y = (op >> 3) & 7;
+                dec.z = op & 7;
+                dec.p = dec.y >> 1;
+                if (x == 1) {
+                    desc = &_z80dasm_ed1[dec.z][dec.y];
+                }
+                else if ((x == 2) && (dec.y >= 4) && (dec.z <= 3)) {
+                    /* block instructions */
+                    bli = _z80dasm_nop_ed;
+                    bli.mn = _z80dasm_bli_mn[dec.y - 4][dec.z];
+                    desc = &bli;
+                }
+                else {
+                    desc = &_z80dasm_nop_ed;
+                }
+            }
+            break;
+    }
+    inst->mnemonic = desc->mn;
+    inst->flow = desc->flow;
+    for (int i = 0; i < 2; i++) {
+        if (!_z80dasm_operand(&dec, desc->op[i], &inst->operands[i])) {
+            return 0;
+        }
+    }
+    inst->len = (uint8_t)dec.pos;
+        return inst->len;
+}
+
+/* z80dasm_format() helpers, these write into a scratch buffer which is big enough for any instruction */
+static inline char* _z80dasm_put_str(char* p, const char* str) {
+    char c;
+    while (0 != (c = *str++)) {
+        *p++ = c;
+    }
+    return p;
+}
+
+static inline char* _z80dasm_put_hex(char* p, uint16_t val, int num_digits) {
+    for (int i = num_digits - 1; i >= 0; i--) {
+        *p++ = _z80dasm_hex[(val>>(i*4)) & 0xF];
+    }
+    *p++ = 'h';
+    return p;
+}
+
+static inline char* _z80dasm_put_dec(char* p, int val) {
+    if (val >= 100) {
+        *p++ = _z80dasm_dec[val/100];
+    }
+    if (val >= 10) {
+        *p++ = _z80dasm_dec[(val/10)%10];
+    }
+    *p++ = _z80dasm_dec[val%10];
+    return p;
+}
+
+int z80dasm_format(const z80dasm_inst_t* inst, char* buf, int buf_size) {
+    CHIPS_ASSERT(inst && buf && (buf_size > 0));
+    CHIPS_ASSERT(inst->mnemonic < Z80DASM_MN_NUM);
+    /* write directly into the output buffer if it is big enough, otherwise into a scratch buffer */
+    char tmp[Z80DASM_MAX_CHARS];
+    char* str = (buf_size >= Z80DASM_MAX_CHARS) ? buf : tmp;
+    char* p = _z80dasm_put_str(str, _z80dasm_mn_names[inst->mnemonic]);
+    for (int i = 0; i < Z80DASM_MAX_OPERANDS; i++) {
+        const z80dasm_operand_t* op = &inst->operands[i];
+        if (op->type == Z80DASM_OPERAND_NONE) {
+            break;
+        }
+        *p++ = (i == 0) ? ' ' : ',';
+        switch (op->type) {
+            case Z80DASM_OPERAND_REG:
+                p = _z80dasm_put_str(p, _z80dasm_reg_names[op->reg]);
+                break;
+            case Z80DASM_OPERAND_IND:
+                *p++ = '(';
+                p = _z80dasm_put_str(p, _z80dasm_reg_names[op->reg]);
+                *p++ = ')';
+                break;
+            case Z80DASM_OPERAND_IDX:
+                *p++ = '(';
+                p = _z80dasm_put_str(p, _z80dasm_reg_names[op->reg]);
+                *p++ = (op->val < 0) ? '-' : '+';
+                p = _z80dasm_put_dec(p, (op->val < 0) ? -op->val : op->val);
+                *p++ = ')';
+                break;
+            case Z80DASM_OPERAND_IMM8:
+                p = _z80dasm_put_hex(p, (uint16_t)op->val, 2);
+                break;
+            case Z80DASM_OPERAND_IMM16:
+            case Z80DASM_OPERAND_ADDR:
+                p = _z80dasm_put_hex(p, (uint16_t)op->val, 4);
+                break;
+            case Z80DASM_OPERAND_MEM:
+                *p++ = '(';
+                p = _z80dasm_put_hex(p, (uint16_t)op->val, 4);
+                *p++ = ')';
+                break;
+            case Z80DASM_OPERAND_PORT:
+                *p++ = '(';
+                p = _z80dasm_put_hex(p, (uint16_t)op->val, 2);
+                *p++ = ')';
+                break;
+            case Z80DASM_OPERAND_COND:
+                p = _z80dasm_put_str(p, _z80dasm_cc[op->reg]);
+                break;
+            case Z80DASM_OPERAND_NUM:
+                p = _z80dasm_put_dec(p, op->val);
+                break;
+        }
+    }
+    int len = (int)(p - str);
+    if (str == tmp) {
+        /* copy to the output buffer, truncate if needed */
+        if (len >= buf_size) {
+            len = buf_size - 1;
+        }
+        for (int i = 0; i < len; i++) {
+            buf[i] = tmp[i];
+        }
+    }
+    buf[len] = 0;
+    return len;
+}
+
+size_t z80dasm_range(const z80dasm_range_t* range) {
+    CHIPS_ASSERT(range && range->ptr && range->out_insts);
+    uint16_t pc = range->pc;
+    size_t pos = 0;
+    size_t i = 0;
+    for (; i < range->max_insts; i++) {
+        z80dasm_inst_t* inst = &range->out_insts[i];
+        const int len = z80dasm_decode(pc, range->ptr + pos, range->num_bytes - pos, inst);
+        if (len == 0) {
+            break;
+        }
+        if (range->out_text) {
+            z80dasm_format(inst, range->out_text[i].chars, Z80DASM_MAX_CHARS);
+        }
+        pos += len;
+        pc += len;
+    }
+    return i;
+}
+
+const char* z80dasm_mnemonic_name(int mnemonic) {
+    CHIPS_ASSERT((mnemonic >= 0) && (mnemonic < Z80DASM_MN_NUM));
+    return _z80dasm_mn_names[mnemonic];
+}
+
 #undef _FETCH_U8
 #undef _FETCH_I8
 #undef _FETCH_U16
@@ -489,4 +1165,6 @@ uint16_t z80dasm_op(uint16_t pc, z80dasm_input_t in_cb, z80dasm_output_t out_cb,
 #undef _MRd
 #undef _IMM16
 #undef _IMM8
+#undef _ZD
+#undef _ZP
 #endif /* CHIPS_UTIL_IMPL */